@@ -160,5 +160,10 @@ let package = Package(
             dependencies: ["Benchmark"],
             swiftSettings: [.swiftLanguageMode(.v5)]
         ),
+        .testTarget(
+            name: "BenchmarkToolTests",
+            dependencies: ["BenchmarkTool", "Benchmark", "BenchmarkShared"],
+            swiftSettings: [.swiftLanguageMode(.v5)]
+        ),
     ]
 )
@@ -18,6 +18,15 @@
 #include <string.h> // memset
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/personality.h>
+#include <sched.h>
+#include <time.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
 static void CLinuxPerformanceCountersInit();
 static void CLinuxPerformanceCountersDeinit();
@@ -28,6 +37,172 @@ static void CLinuxPerformanceCountersDeinit();
 // need each CPU to be tracked idependently and can only track the calling thread
 // and it's descendants (if set up properly), so we need to do this as early as possible.
 
+// When the benchmark tool runs benchmarks in parallel or with the stabilization profile, each
+// benchmark process is given its own CPU set in BENCHMARK_CPU_SET (e.g. "0-3,8-11") and the
+// stabilization settings in BENCHMARK_STABILIZATION (e.g. "norandomize,mlockall,prefault,fifo").
+// They're applied before the other constructors run, so that all threads and performance counters
+// of the process are created with them in effect.
+
+#define CPU_SET_MAX_CPUS 4096
+#define PREFAULT_STACK_SIZE (512 * 1024)
+#define PREFAULT_HEAP_SIZE (16 * 1024 * 1024)
+
+static void applyCPUSet(const char *cpuSet) {
+    unsigned long mask[CPU_SET_MAX_CPUS / (8 * sizeof(unsigned long))];
+    const char *cursor = cpuSet;
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    long first, last, cpu;
+    int cpus = 0;
+
+    memset(mask, 0, sizeof(mask));
+
+    while (*cursor != '\0') {
+        if (*cursor < '0' || *cursor > '9') {
+            return; // malformed, leave the affinity alone
+        }
+        first = strtol(cursor, (char **)&cursor, 10);
+        last = first;
+        if (*cursor == '-') {
+            cursor++;
+            last = strtol(cursor, (char **)&cursor, 10);
+        }
+        for (cpu = first; cpu <= last && cpu < CPU_SET_MAX_CPUS; cpu++) {
+            mask[cpu / bitsPerWord] |= 1UL << (cpu % bitsPerWord);
+            cpus++;
+        }
+        if (*cursor == ',') {
+            cursor++;
+        }
+    }
+
+    if (cpus > 0 && syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) != 0) {
+        fprintf(stderr, "Failed to set CPU affinity to %s (errno %d)\n", cpuSet, errno);
+    }
+}
+
+static int stabilizationRequested(const char *settings, const char *name) {
+    size_t length = strlen(name);
+    const char *cursor = settings;
+
+    while ((cursor = strstr(cursor, name)) != NULL) {
+        if ((cursor == settings || cursor[-1] == ',') && (cursor[length] == ',' || cursor[length] == '\0')) {
+            return 1;
+        }
+        cursor += length;
+    }
+    return 0;
+}
+
+// Address space randomization is decided at exec time, so we re-exec ourselves once with it disabled
+static void disableAddressSpaceRandomization(char **argv, char **envp) {
+    int persona = personality(0xffffffff);
+
+    if (persona == -1 || (persona & ADDR_NO_RANDOMIZE) || argv == NULL) {
+        return;
+    }
+
+    if (personality((unsigned long)persona | ADDR_NO_RANDOMIZE) == -1) {
+        fprintf(stderr, "Failed to disable address space randomization (errno %d)\n", errno);
+        return;
+    }
+
+    if ((personality(0xffffffff) & ADDR_NO_RANDOMIZE) == 0) {
+        return; // not applied, avoid exec loops
+    }
+
+    execve("/proc/self/exe", argv, envp);
+    fprintf(stderr, "Failed to re-exec with address space randomization disabled (errno %d)\n", errno);
+}
+
+static void lockMemory(void) {
+    struct rlimit limit;
+    int flags = MCL_CURRENT;
+
+    // Only lock future mappings when the limit allows it, otherwise later allocations would fail
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY) {
+        flags |= MCL_FUTURE;
+    }
+
+    if (mlockall(flags) != 0) {
+        fprintf(stderr, "Failed to lock memory with mlockall (errno %d), check RLIMIT_MEMLOCK\n", errno);
+    }
+}
+
+static void useRealtimeScheduling(void) {
+    struct sched_param parameters = {0};
+
+    parameters.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (sched_setscheduler(0, SCHED_FIFO, &parameters) != 0) {
+        fprintf(stderr, "Failed to set SCHED_FIFO scheduling (errno %d), requires CAP_SYS_NICE\n", errno);
+    }
+}
+
+static void __attribute__((noinline)) prefaultStack(void) {
+    volatile char stack[PREFAULT_STACK_SIZE];
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    for (long offset = 0; offset < PREFAULT_STACK_SIZE; offset += pageSize) {
+        stack[offset] = 0;
+    }
+    (void)stack[0];
+}
+
+// Touches the pages of a large allocation, which the allocator keeps for reuse after it's freed
+static void prefaultHeap(void) {
+    volatile char *heap = malloc(PREFAULT_HEAP_SIZE);
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    if (heap == NULL) {
+        return;
+    }
+    for (long offset = 0; offset < PREFAULT_HEAP_SIZE; offset += pageSize) {
+        heap[offset] = 0;
+    }
+    free((void *)heap);
+}
+
+// glibc passes argc, argv and envp to the constructors in .init_array, which isn't part of the ELF ABI.
+// Other C libraries (e.g. musl) pass nothing, so there the process can't be re-executed and address space
+// randomization stays enabled, the other settings only need the environment.
+#ifdef __GLIBC__
+__attribute__((constructor(101)))
+void applyProcessSettings(int argc, char **argv, char **envp) {
+    (void)argc;
+#else
+__attribute__((constructor(101)))
+void applyProcessSettings(void) {
+    char **argv = NULL;
+    char **envp = NULL;
+#endif
+    const char *cpuSet = getenv("BENCHMARK_CPU_SET");
+    const char *stabilization = getenv("BENCHMARK_STABILIZATION");
+
+    if (stabilization != NULL && stabilizationRequested(stabilization, "norandomize")) {
+        disableAddressSpaceRandomization(argv, envp);
+    }
+
+    if (cpuSet != NULL && *cpuSet != '\0') {
+        applyCPUSet(cpuSet);
+    }
+
+    if (stabilization == NULL) {
+        return;
+    }
+
+    if (stabilizationRequested(stabilization, "fifo")) {
+        useRealtimeScheduling();
+    }
+
+    if (stabilizationRequested(stabilization, "mlockall")) {
+        lockMemory();
+    }
+
+    if (stabilizationRequested(stabilization, "prefault")) {
+        prefaultStack();
+        prefaultHeap();
+    }
+}
+
 __attribute__((constructor))
 void startPerformanceCounters(void) {
     CLinuxPerformanceCountersInit();
@@ -38,13 +213,38 @@ void myDestructor(void) {
     CLinuxPerformanceCountersDeinit();
 }
 
+#define PERFORMANCE_COUNTERS_MAX_EVENTS 6
+
+struct performance_counter_event {
+    const char *name; // matches the BenchmarkMetric raw description
+    unsigned int mask;
+    __u32 type;
+    __u64 config;
+};
+
+#define HW_CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// Index 0 is always the group leader
+static const struct performance_counter_event performanceCounterEvents[PERFORMANCE_COUNTERS_MAX_EVENTS] = {
+    {"instructions", CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cpuCycles", CLINUX_PERFORMANCE_COUNTER_CPU_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"branchMisses", CLINUX_PERFORMANCE_COUNTER_BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"cacheMisses", CLINUX_PERFORMANCE_COUNTER_CACHE_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"l1dCacheMisses", CLINUX_PERFORMANCE_COUNTER_L1D_CACHE_MISSES, PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {"dTLBMisses", CLINUX_PERFORMANCE_COUNTER_DTLB_MISSES, PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
 struct performance_counters_context {
     int cpuCount;
 	int *cpus;
-	int *fds;
+	int *fds; // cpuCount rows of eventCount fds, the first one in each row is the group leader
+    int eventCount; // number of events opened per cpu
+    int grouped; // true if the leader was opened with PERF_FORMAT_GROUP, otherwise each event is opened on its own
+    int events[PERFORMANCE_COUNTERS_MAX_EVENTS]; // index into performanceCounterEvents for each opened event
+    unsigned int available;
 } performance_counters_context;
 
-struct performance_counters_context performanceCountersContext = {0, NULL, NULL};
+struct performance_counters_context performanceCountersContext = {0, NULL, NULL, 0, 0, {0}, 0};
 
 // Utility function to read CPU IDs from /proc/cpuinfo, thanks to ChatGPT...
 int get_cpu_identifiers(int *cpu_array, int max_cpus) {
@@ -74,13 +274,139 @@ int get_cpu_identifiers(int *cpu_array, int max_cpus) {
     return cpu_count;
 }
 
+// True if name is in the comma separated list of event names, e.g. "cpuCycles,branchMisses", that
+// the benchmark tool passes in the BENCHMARK_PERFORMANCE_COUNTERS environment variable
+static int performanceCounterRequested(const char *name) {
+    const char *requested = getenv("BENCHMARK_PERFORMANCE_COUNTERS");
+    size_t nameLength = strlen(name);
+
+    if (requested == NULL) {
+        return 0;
+    }
+
+    while (*requested != '\0') {
+        const char *end = strchr(requested, ',');
+        size_t length = end ? (size_t)(end - requested) : strlen(requested);
+
+        if (length == nameLength && strncmp(name, requested, length) == 0) {
+            return 1;
+        }
+
+        requested += length;
+        if (*requested == ',') {
+            requested++;
+        }
+    }
+
+    return 0;
+}
+
+static unsigned int requestedPerformanceCounterEvents() {
+    unsigned int mask = CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS;
+    int event;
+
+    for (event = 1; event < PERFORMANCE_COUNTERS_MAX_EVENTS; event++) {
+        if (performanceCounterRequested(performanceCounterEvents[event].name)) {
+            mask |= performanceCounterEvents[event].mask;
+        }
+    }
+
+    return mask;
+}
+
+static int openPerformanceCounter(int event, int cpu, int groupFd, int grouped) {
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.type = performanceCounterEvents[event].type;
+    pe.size = sizeof(pe);
+    pe.config = performanceCounterEvents[event].config;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.inherit = 1;
+//    pe.inherit_thread = 1; // Disabled for now as Linux 5.13 is not in widespread use yet
+    pe.inherit_stat = 1;
+
+    if (groupFd == -1) { // group leader, members follow the leader for enable/disable and scheduling
+        pe.disabled = 1;
+        pe.pinned = 1;
+        if (grouped) {
+            pe.read_format = PERF_FORMAT_GROUP;
+        }
+    }
+
+    return (int)syscall(SYS_perf_event_open, &pe, 0, cpu, groupFd, 0);
+}
+
+static inline int memberGroupFd(const int *fds) {
+    return performanceCountersContext.grouped ? fds[0] : -1;
+}
+
+// Opens one counter group per entry in performanceCountersContext.cpus, returns 0 and closes
+// everything opened so far if any of the groups can't be opened.
+static int openPerformanceCounterGroups(unsigned int requested) {
+    int cpu, event, fd;
+
+    // Older kernels refuse PERF_FORMAT_GROUP for inherited events, then each event is opened on its own
+    performanceCountersContext.grouped = requested != CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS;
+
+    for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu++) {
+        int *fds = &performanceCountersContext.fds[cpu * PERFORMANCE_COUNTERS_MAX_EVENTS];
+
+        fds[0] = openPerformanceCounter(0, performanceCountersContext.cpus[cpu], -1, performanceCountersContext.grouped);
+        if (fds[0] == -1 && cpu == 0 && performanceCountersContext.grouped) {
+            fds[0] = openPerformanceCounter(0, performanceCountersContext.cpus[cpu], -1, 0);
+            if (fds[0] != -1) {
+                performanceCountersContext.grouped = 0;
+                fprintf(stderr, "Performance counters can't be read as a group, reading them one at a time instead, "
+                                "so the values of different counters are from slightly different instants\n");
+            }
+        }
+
+        if (fds[0] == -1) {
+            performanceCountersContext.cpuCount = cpu; // only close what we've opened so far
+            CLinuxPerformanceCountersDeinit();
+            return 0;
+        }
+
+        if (cpu == 0) { // the first cpu decides which of the requested events the PMU can provide
+            performanceCountersContext.events[0] = 0;
+            performanceCountersContext.eventCount = 1;
+            performanceCountersContext.available = CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS;
+
+            for (event = 1; event < PERFORMANCE_COUNTERS_MAX_EVENTS; event++) {
+                if ((requested & performanceCounterEvents[event].mask) == 0) {
+                    continue;
+                }
+                fd = openPerformanceCounter(event, performanceCountersContext.cpus[cpu], memberGroupFd(fds), performanceCountersContext.grouped);
+                if (fd != -1) {
+                    fds[performanceCountersContext.eventCount] = fd;
+                    performanceCountersContext.events[performanceCountersContext.eventCount] = event;
+                    performanceCountersContext.eventCount++;
+                    performanceCountersContext.available |= performanceCounterEvents[event].mask;
+                }
+            }
+        } else {
+            for (event = 1; event < performanceCountersContext.eventCount; event++) {
+                fds[event] = openPerformanceCounter(performanceCountersContext.events[event], performanceCountersContext.cpus[cpu], memberGroupFd(fds), performanceCountersContext.grouped);
+                if (fds[event] == -1) {
+                    performanceCountersContext.cpuCount = cpu + 1; // only close what we've opened so far
+                    CLinuxPerformanceCountersDeinit();
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
 static void CLinuxPerformanceCountersInit() {
-    int cpu, errorCode, readCPUCount, i;
-    struct perf_event_attr  pe;
+    int cpu, readCPUCount, onlineCPUCount;
+    unsigned int requested = requestedPerformanceCounterEvents();
 
-    performanceCountersContext.cpuCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
-    performanceCountersContext.cpus = (int *)calloc(sizeof(int), performanceCountersContext.cpuCount);
-    performanceCountersContext.fds = (int *)calloc(sizeof(int), performanceCountersContext.cpuCount);
+    onlineCPUCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    performanceCountersContext.cpus = (int *)calloc(sizeof(int), onlineCPUCount);
+    performanceCountersContext.fds = (int *)calloc(sizeof(int), onlineCPUCount * PERFORMANCE_COUNTERS_MAX_EVENTS);
 
      if (!performanceCountersContext.cpus || !performanceCountersContext.fds) {
         performanceCountersContext.cpuCount = 0;
@@ -88,6 +414,16 @@ static void CLinuxPerformanceCountersInit() {
         return;
     }
 
+    // Prefer a single group following the process on any cpu (cpu == -1), so that each
+    // read/reset/enable is a single syscall instead of one per online cpu.
+    performanceCountersContext.cpuCount = 1;
+    performanceCountersContext.cpus[0] = -1;
+    if (openPerformanceCounterGroups(requested)) {
+        return;
+    }
+
+    // Otherwise fall back to one group per cpu
+    performanceCountersContext.cpuCount = onlineCPUCount;
     readCPUCount = get_cpu_identifiers(performanceCountersContext.cpus, performanceCountersContext.cpuCount);
     if (performanceCountersContext.cpuCount != readCPUCount) {
         performanceCountersContext.cpuCount = 0;
@@ -95,108 +431,1420 @@ static void CLinuxPerformanceCountersInit() {
         return;
     }
 
-    memset(&pe, 0, sizeof(pe));
-    pe.type = PERF_TYPE_HARDWARE;
-    pe.size = sizeof(pe);
-    pe.config = PERF_COUNT_HW_INSTRUCTIONS;
-    pe.disabled = 1;
-    pe.exclude_kernel = 1;
-    pe.exclude_hv = 1;
-    pe.inherit = 1;
-//    pe.inherit_thread = 1; // Disabled for now as Linux 5.13 is not in widespread use yet
-    pe.inherit_stat = 1;
-    pe.pinned = 1;
-
-    for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu++) {
-        performanceCountersContext.fds[cpu] = syscall(SYS_perf_event_open, &pe, 0, performanceCountersContext.cpus[cpu], -1, 0);
-        errorCode = errno;
-        if (performanceCountersContext.fds[cpu] == -1) {
-            performanceCountersContext.cpuCount = 0;
-//            fprintf(stderr, "Can't enable performance counters for instructions metric, error in perf_event_open syscall, failed with [%d], error: %s\n", errorCode, strerror(errorCode));
-            return;
-        } 
+    for (cpu = 0; cpu < onlineCPUCount * PERFORMANCE_COUNTERS_MAX_EVENTS; cpu++) {
+        performanceCountersContext.fds[cpu] = 0;
     }
+
+    openPerformanceCounterGroups(requested);
     return;
 }
 
 static void CLinuxPerformanceCountersDeinit() {
-    int cpu;
+    int cpu, event;
     for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu ++) {
-        close(performanceCountersContext.fds[cpu]);
+        for (event = 0; event < performanceCountersContext.eventCount; event++) {
+            int fd = performanceCountersContext.fds[cpu * PERFORMANCE_COUNTERS_MAX_EVENTS + event];
+            if (fd > 0) {
+                close(fd);
+            }
+        }
+    }
+    performanceCountersContext.cpuCount = 0;
+    performanceCountersContext.eventCount = 0;
+    performanceCountersContext.available = 0;
+}
+
+static inline int leaderFd(int cpu) {
+    return performanceCountersContext.fds[cpu * PERFORMANCE_COUNTERS_MAX_EVENTS];
+}
+
+// A single ioctl on the leader applies to the whole group, ungrouped events need one each
+static void performanceCountersIoctl(int cpu, unsigned long request) {
+    int event;
+
+    if (performanceCountersContext.grouped) {
+        ioctl(leaderFd(cpu), request, PERF_IOC_FLAG_GROUP);
+        return;
+    }
+
+    for (event = 0; event < performanceCountersContext.eventCount; event++) {
+        ioctl(performanceCountersContext.fds[cpu * PERFORMANCE_COUNTERS_MAX_EVENTS + event], request, 0);
     }
 }
 
+unsigned int CLinuxPerformanceCountersAvailable() {
+    return performanceCountersContext.cpuCount > 0 ? performanceCountersContext.available : 0;
+}
+
 void CLinuxPerformanceCountersEnable() {
     int cpu;
     for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu ++) {
-        ioctl(performanceCountersContext.fds[cpu], PERF_EVENT_IOC_ENABLE, 0);
-        ioctl(performanceCountersContext.fds[cpu], PERF_EVENT_IOC_RESET, 0);
+        performanceCountersIoctl(cpu, PERF_EVENT_IOC_ENABLE);
+        performanceCountersIoctl(cpu, PERF_EVENT_IOC_RESET);
     }
 }
 
 void CLinuxPerformanceCountersDisable() {
     int cpu;
     for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu ++) {
-        ioctl(performanceCountersContext.fds[cpu], PERF_EVENT_IOC_DISABLE, 0);
+        performanceCountersIoctl(cpu, PERF_EVENT_IOC_DISABLE);
     }
 }
 
 void CLinuxPerformanceCountersReset() {
     int cpu;
     for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu ++) {
-        ioctl(performanceCountersContext.fds[cpu], PERF_EVENT_IOC_RESET, 0);
+        performanceCountersIoctl(cpu, PERF_EVENT_IOC_RESET);
+    }
+}
+
+static void addPerformanceCounter(struct performanceCounters *performanceCounters, int event, unsigned long long value) {
+    switch (performanceCounterEvents[event].mask) {
+        case CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS:
+            performanceCounters->instructions += value;
+            break;
+        case CLINUX_PERFORMANCE_COUNTER_CPU_CYCLES:
+            performanceCounters->cpuCycles += value;
+            break;
+        case CLINUX_PERFORMANCE_COUNTER_BRANCH_MISSES:
+            performanceCounters->branchMisses += value;
+            break;
+        case CLINUX_PERFORMANCE_COUNTER_CACHE_MISSES:
+            performanceCounters->cacheMisses += value;
+            break;
+        case CLINUX_PERFORMANCE_COUNTER_L1D_CACHE_MISSES:
+            performanceCounters->l1dCacheMisses += value;
+            break;
+        case CLINUX_PERFORMANCE_COUNTER_DTLB_MISSES:
+            performanceCounters->dTLBMisses += value;
+            break;
+        default:
+            break;
+    }
+}
+
+// Without PERF_FORMAT_GROUP each event reads as a single u64
+static void readUngroupedPerformanceCounters(int cpu, struct performanceCounters *performanceCounters) {
+    unsigned long long value;
+    int event, fd;
+
+    for (event = 0; event < performanceCountersContext.eventCount; event++) {
+        fd = performanceCountersContext.fds[cpu * PERFORMANCE_COUNTERS_MAX_EVENTS + event];
+        ssize_t bytesRead = read(fd, &value, sizeof(value));
+
+        if (bytesRead == 0) { // Pinned error state, should reenable the counter
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        } else if (bytesRead == sizeof(value)) {
+            addPerformanceCounter(performanceCounters, performanceCountersContext.events[event], value);
+        }
     }
 }
 
 void CLinuxPerformanceCountersCurrent(struct performanceCounters *performanceCounters) {
-    int cpu;
-    unsigned long long readCounter = 0;
+    int cpu, event;
+    // PERF_FORMAT_GROUP layout: { u64 nr; u64 values[nr]; }, a single read gives all counters atomically
+    unsigned long long readBuffer[1 + PERFORMANCE_COUNTERS_MAX_EVENTS];
+    size_t expectedBytes = sizeof(unsigned long long) * (1 + performanceCountersContext.eventCount);
     ssize_t bytesRead;
 
     // Loop through each CPU to read the counter values
     for (cpu = 0; cpu < performanceCountersContext.cpuCount; cpu++) {
-        bytesRead = read(performanceCountersContext.fds[cpu], &readCounter, sizeof(readCounter));
-        
+        if (performanceCountersContext.grouped == 0) {
+            readUngroupedPerformanceCounters(cpu, performanceCounters);
+            continue;
+        }
+
+        bytesRead = read(leaderFd(cpu), readBuffer, expectedBytes);
+
         if (bytesRead == 0) { // Pinned error state, should reenable the counters for this cpu
-            ioctl(performanceCountersContext.fds[cpu], PERF_EVENT_IOC_ENABLE, 0);
-            ioctl(performanceCountersContext.fds[cpu], PERF_EVENT_IOC_RESET, 0);
+            performanceCountersIoctl(cpu, PERF_EVENT_IOC_ENABLE);
+            performanceCountersIoctl(cpu, PERF_EVENT_IOC_RESET);
             continue;
         } else if (bytesRead == -1) {
             continue;  // Continue with the next CPU in case of error
-        } else if (bytesRead != sizeof(readCounter)) {
+        } else if ((size_t)bytesRead != expectedBytes) {
             continue;  // Continue with the next CPU in case of incomplete data
         }
 
-        performanceCounters->instructions += readCounter;
+        for (event = 0; event < performanceCountersContext.eventCount && event < (int)readBuffer[0]; event++) {
+            addPerformanceCounter(performanceCounters, performanceCountersContext.events[event], readBuffer[1 + event]);
+        }
     }
-  
+
     return;
 }
 
-void CLinuxIOStats(const char *s, struct ioStats *ioStats) {
-    sscanf(s, "rchar: %lld\nwchar: %lld\nsyscr: %lld\nsyscw: %lld\nread_bytes: %lld\nwrite_bytes: %lld\n%*s",
-           &ioStats->readBytesLogical, &ioStats->writeBytesLogical,
-           &ioStats->readSyscalls, &ioStats->writeSyscalls,
-           &ioStats->readBytesPhysical, &ioStats->writeBytesPhysical);
-    return;
+// Counters for the calling thread only (no inheritance), opened on demand by the thread
+// running the benchmark. The first page of each event is mapped, so that on x86_64 the
+// counters can be read from user space with rdpmc without any syscalls at all.
+
+struct thread_performance_counters_context {
+    int eventCount;
+    int fds[PERFORMANCE_COUNTERS_MAX_EVENTS];
+    struct perf_event_mmap_page *pages[PERFORMANCE_COUNTERS_MAX_EVENTS];
+    int userSpaceReads; // true if all pages allow rdpmc
+};
+
+static __thread struct thread_performance_counters_context threadPerformanceCountersContext = {0};
+
+static int openThreadPerformanceCounter(int event, int groupFd) {
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.type = performanceCounterEvents[event].type;
+    pe.size = sizeof(pe);
+    pe.config = performanceCounterEvents[event].config;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.read_format = groupFd == -1 ? PERF_FORMAT_GROUP : 0;
+    pe.pinned = groupFd == -1;
+
+    return (int)syscall(SYS_perf_event_open, &pe, 0, -1, groupFd, 0);
+}
+
+int CLinuxPerformanceCountersThreadInit() {
+    struct thread_performance_counters_context *context = &threadPerformanceCountersContext;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    int event;
+
+    CLinuxPerformanceCountersThreadDeinit();
+
+    // Open the same set of events that could be opened for the process
+    if (performanceCountersContext.cpuCount == 0) {
+        return 0;
+    }
+
+    for (event = 0; event < performanceCountersContext.eventCount; event++) {
+        context->fds[event] = openThreadPerformanceCounter(performanceCountersContext.events[event], event == 0 ? -1 : context->fds[0]);
+        if (context->fds[event] == -1) {
+            context->eventCount = event;
+            CLinuxPerformanceCountersThreadDeinit();
+            return 0;
+        }
+        context->eventCount = event + 1;
+        context->pages[event] = NULL;
+    }
+
+    context->userSpaceReads = 0;
+#if defined(__x86_64__)
+    context->userSpaceReads = 1;
+    for (event = 0; event < context->eventCount; event++) {
+        void *page = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, context->fds[event], 0);
+        if (page == MAP_FAILED) {
+            context->userSpaceReads = 0;
+            break;
+        }
+        context->pages[event] = (struct perf_event_mmap_page *)page;
+        if (context->pages[event]->cap_user_rdpmc == 0) {
+            context->userSpaceReads = 0;
+        }
+    }
+#else
+    (void)pageSize;
+#endif
+
+    return context->userSpaceReads ? 2 : 1;
+}
+
+void CLinuxPerformanceCountersThreadDeinit() {
+    struct thread_performance_counters_context *context = &threadPerformanceCountersContext;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    int event;
+
+    for (event = 0; event < context->eventCount; event++) {
+        if (context->pages[event] != NULL) {
+            munmap(context->pages[event], pageSize);
+            context->pages[event] = NULL;
+        }
+        close(context->fds[event]);
+    }
+    context->eventCount = 0;
+    context->userSpaceReads = 0;
+}
+
+#if defined(__x86_64__)
+static inline unsigned long long rdpmc(unsigned int counter) {
+    unsigned int low, high;
+    __asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+    return (unsigned long long)low | ((unsigned long long)high << 32);
+}
+#endif
+
+// Lock free read of the counter using the seqlock protocol documented in perf_event_open(2)
+// for struct perf_event_mmap_page, returns 0 if the counter isn't currently active on this
+// cpu for this thread (e.g. read from another thread than the one that opened it).
+static inline int readUserSpaceCounter(struct perf_event_mmap_page *page, unsigned long long *value) {
+#if defined(__x86_64__)
+    unsigned int seq, index;
+    long long count, pmc;
+
+    do {
+        seq = page->lock;
+        __asm__ __volatile__("" ::: "memory");
+        index = page->index;
+        count = page->offset;
+        if (page->cap_user_rdpmc == 0 || index == 0) {
+            return 0;
+        }
+        pmc = (long long)rdpmc(index - 1);
+        pmc <<= 64 - page->pmc_width; // sign extend the raw counter
+        pmc >>= 64 - page->pmc_width;
+        count += pmc;
+        __asm__ __volatile__("" ::: "memory");
+    } while (page->lock != seq);
+
+    *value = (unsigned long long)count;
+    return 1;
+#else
+    (void)page;
+    (void)value;
+    return 0;
+#endif
+}
+
+void CLinuxPerformanceCountersThreadCurrent(struct performanceCounters *performanceCounters) {
+    struct thread_performance_counters_context *context = &threadPerformanceCountersContext;
+    unsigned long long readBuffer[1 + PERFORMANCE_COUNTERS_MAX_EVENTS];
+    size_t expectedBytes = sizeof(unsigned long long) * (1 + context->eventCount);
+    int event;
+
+    if (context->userSpaceReads) {
+        for (event = 0; event < context->eventCount; event++) {
+            if (readUserSpaceCounter(context->pages[event], &readBuffer[1 + event]) == 0) {
+                break;
+            }
+        }
+        if (event == context->eventCount) {
+            for (event = 0; event < context->eventCount; event++) {
+                addPerformanceCounter(performanceCounters, performanceCountersContext.events[event], readBuffer[1 + event]);
+            }
+            return;
+        }
+    }
+
+    // Single syscall for the whole group if not possible to read from user space
+    if (context->eventCount > 0 && read(context->fds[0], readBuffer, expectedBytes) == (ssize_t)expectedBytes) {
+        for (event = 0; event < context->eventCount && event < (int)readBuffer[0]; event++) {
+            addPerformanceCounter(performanceCounters, performanceCountersContext.events[event], readBuffer[1 + event]);
+        }
+    }
+}
+
+
+// The procfs files are kept open for the lifetime of the process and are read with pread at
+// offset 0 into a stack buffer, which makes the kernel regenerate the contents. This avoids
+// any allocations and open/close syscalls in the runner while sampling, as those would
+// otherwise show up in the metrics of the benchmark under test.
+
+static int procSelfStatFd = -1;
+static int procSelfIOFd = -1;
+static int procSelfTaskFd = -1;
+static int procSelfStatusFd = -1;
+static int procSelfClearRefsFd = -1;
+static int procSelfSmapsRollupFd = -1;
+
+__attribute__((constructor))
+void openProcfsFiles(void) {
+    procSelfStatFd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+    procSelfIOFd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+    procSelfTaskFd = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    procSelfStatusFd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+    procSelfClearRefsFd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    procSelfSmapsRollupFd = open("/proc/self/smaps_rollup", O_RDONLY | O_CLOEXEC); // Linux 4.14+
+}
+
+__attribute__((destructor))
+void closeProcfsFiles(void) {
+    if (procSelfStatFd != -1) {
+        close(procSelfStatFd);
+    }
+    if (procSelfIOFd != -1) {
+        close(procSelfIOFd);
+    }
+    if (procSelfTaskFd != -1) {
+        close(procSelfTaskFd);
+    }
+    if (procSelfStatusFd != -1) {
+        close(procSelfStatusFd);
+    }
+    if (procSelfClearRefsFd != -1) {
+        close(procSelfClearRefsFd);
+    }
+    if (procSelfSmapsRollupFd != -1) {
+        close(procSelfSmapsRollupFd);
+    }
+}
+
+// Reads the whole file into buffer and null terminates it, returns the number of bytes read or -1
+static ssize_t preadProcfsFile(int fd, char *buffer, size_t bufferSize) {
+    ssize_t bytesRead;
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    do {
+        bytesRead = pread(fd, buffer, bufferSize - 1, 0);
+    } while (bytesRead == -1 && errno == EINTR);
+
+    if (bytesRead <= 0 || (size_t)bytesRead == bufferSize - 1) { // error, empty or possibly truncated
+        return -1;
+    }
+
+    buffer[bytesRead] = '\0';
+    return bytesRead;
+}
+
+// Parses an unsigned decimal number, leaves *cursor at the first character after it
+static inline long long parseNumber(const char **cursor) {
+    const char *p = *cursor;
+    long long value = 0;
+    int negative = 0;
+
+    if (*p == '-') {
+        negative = 1;
+        p++;
+    }
+
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+
+    *cursor = p;
+    return negative ? -value : value;
 }
 
-void CLinuxProcessStats(const char *s, struct processStats *processStats) {
-    long cpuUser;
-    long cpuSystem;
-    long threads;
-    long peakMemoryVirtual;
-    long peakMemoryResident;
-    
-    sscanf(s, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*lu %*lu %*lu %*lu %lu %lu %*ld %*ld %*ld %*ld %ld %*ld %*llu %lu %ld %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*d %*d %*u %*u %*llu %*lu %*ld %*lu %*lu %*lu %*lu %*lu %*lu %*lu %*d",
-           &cpuUser, &cpuSystem, &threads, &peakMemoryVirtual, &peakMemoryResident);
-
-    processStats->cpuUser = cpuUser;
-    processStats->cpuSystem = cpuSystem;
-    processStats->threads = threads;
-    processStats->peakMemoryVirtual = peakMemoryVirtual;
-    processStats->peakMemoryResident = peakMemoryResident;
-    processStats->cpuTotal = cpuUser + cpuSystem;
+int CLinuxIOStatsCurrent(struct ioStats *ioStats) {
+    char buffer[512];
+    const char *cursor = buffer;
+
+    if (preadProcfsFile(procSelfIOFd, buffer, sizeof(buffer)) == -1) {
+        return 0;
+    }
+
+    // Each line is "name: value", in fixed order by the kernel, see sample contents below
+    while (*cursor != '\0') {
+        const char *name = cursor;
+        long long value;
+
+        while (*cursor != ':' && *cursor != '\0') {
+            cursor++;
+        }
+        if (*cursor == '\0') {
+            break;
+        }
+        cursor++;
+        while (*cursor == ' ') {
+            cursor++;
+        }
+        value = parseNumber(&cursor);
+
+        switch (name[0]) {
+            case 'r':
+                if (strncmp(name, "rchar:", 6) == 0) {
+                    ioStats->readBytesLogical = value;
+                } else if (strncmp(name, "read_bytes:", 11) == 0) {
+                    ioStats->readBytesPhysical = value;
+                }
+                break;
+            case 'w':
+                if (strncmp(name, "wchar:", 6) == 0) {
+                    ioStats->writeBytesLogical = value;
+                } else if (strncmp(name, "write_bytes:", 12) == 0) {
+                    ioStats->writeBytesPhysical = value;
+                }
+                break;
+            case 's':
+                if (strncmp(name, "syscr:", 6) == 0) {
+                    ioStats->readSyscalls = value;
+                } else if (strncmp(name, "syscw:", 6) == 0) {
+                    ioStats->writeSyscalls = value;
+                }
+                break;
+            default:
+                break;
+        }
+
+        while (*cursor != '\n' && *cursor != '\0') {
+            cursor++;
+        }
+        if (*cursor == '\n') {
+            cursor++;
+        }
+    }
+
+    return 1;
+}
+
+int CLinuxProcessStatsCurrent(struct processStats *processStats) {
+    char buffer[1024];
+    const char *cursor;
+    int field;
+
+    if (preadProcfsFile(procSelfStatFd, buffer, sizeof(buffer)) == -1) {
+        return 0;
+    }
+
+    // The command name (field 2) is in parentheses and may contain spaces or parentheses itself,
+    // so start parsing after the last ')' - the first field following it is the state (field 3).
+    cursor = strrchr(buffer, ')');
+    if (cursor == NULL) {
+        return 0;
+    }
+    cursor++;
+
+    for (field = 3; field <= 24 && *cursor != '\0'; field++) {
+        while (*cursor == ' ') {
+            cursor++;
+        }
+
+        switch (field) {
+            case 10: // minflt
+                processStats->minorPageFaults = (long)parseNumber(&cursor);
+                break;
+            case 12: // majflt
+                processStats->majorPageFaults = (long)parseNumber(&cursor);
+                break;
+            case 14: // utime
+                processStats->cpuUser = (long)parseNumber(&cursor);
+                break;
+            case 15: // stime
+                processStats->cpuSystem = (long)parseNumber(&cursor);
+                break;
+            case 20: // num_threads
+                processStats->threads = (long)parseNumber(&cursor);
+                break;
+            case 23: // vsize
+                processStats->peakMemoryVirtual = (long)parseNumber(&cursor);
+                break;
+            case 24: // rss
+                processStats->peakMemoryResident = (long)parseNumber(&cursor);
+                break;
+            default:
+                break;
+        }
+
+        while (*cursor != ' ' && *cursor != '\0') {
+            cursor++;
+        }
+    }
+
+    processStats->cpuTotal = processStats->cpuUser + processStats->cpuSystem;
+    return field > 24;
+}
+
+// Syscall counts are taken from the raw_syscalls:sys_enter tracepoint (and a few specific syscall
+// tracepoints for the breakdown), counted for the process and all threads created after startup.
+// Like the hardware counters they are only opened if requested, as enabling tracepoints has a cost.
+// Writes have no tracepoint of their own here, as the syscw count of /proc/self/io already counts
+// write(2) and the rest of the write family, without requiring tracefs.
+
+#define SYSCALL_COUNTERS_MAX_EVENTS 5
+
+struct syscall_counter_event {
+    const char *name; // matches the BenchmarkMetric raw description
+    const char *tracepoint; // relative to the tracefs events directory
+    unsigned int mask;
+};
+
+static const struct syscall_counter_event syscallCounterEvents[SYSCALL_COUNTERS_MAX_EVENTS] = {
+    {"syscalls", "raw_syscalls/sys_enter", CLINUX_SYSCALL_COUNTER_TOTAL},
+    {"futexSyscalls", "syscalls/sys_enter_futex", CLINUX_SYSCALL_COUNTER_FUTEX},
+    {"epollWaitSyscalls", "syscalls/sys_enter_epoll_wait", CLINUX_SYSCALL_COUNTER_EPOLL_WAIT},
+    {"epollWaitSyscalls", "syscalls/sys_enter_epoll_pwait", CLINUX_SYSCALL_COUNTER_EPOLL_WAIT}, // arm64 only has this one
+    {"epollWaitSyscalls", "syscalls/sys_enter_epoll_pwait2", CLINUX_SYSCALL_COUNTER_EPOLL_WAIT},
+};
+
+static int syscallCounterFds[SYSCALL_COUNTERS_MAX_EVENTS] = {-1, -1, -1, -1, -1};
+static unsigned int syscallCountersAvailable = 0;
+
+static long long readTracepointIdentifier(const char *tracepoint) {
+    static const char *tracefsRoots[] = {"/sys/kernel/tracing/events/", "/sys/kernel/debug/tracing/events/"};
+    char path[256];
+    char buffer[32];
+    const char *cursor = buffer;
+    size_t root;
+    int fd;
+
+    for (root = 0; root < sizeof(tracefsRoots) / sizeof(tracefsRoots[0]); root++) {
+        snprintf(path, sizeof(path), "%s%s/id", tracefsRoots[root], tracepoint);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+        if (preadProcfsFile(fd, buffer, sizeof(buffer)) == -1) {
+            close(fd);
+            continue;
+        }
+        close(fd);
+        return parseNumber(&cursor);
+    }
+
+    return -1;
+}
+
+__attribute__((constructor))
+void openSyscallCounters(void) {
+    struct perf_event_attr pe;
+    long long identifier;
+    int event;
+
+    for (event = 0; event < SYSCALL_COUNTERS_MAX_EVENTS; event++) {
+        if (performanceCounterRequested(syscallCounterEvents[event].name) == 0) {
+            continue;
+        }
+
+        identifier = readTracepointIdentifier(syscallCounterEvents[event].tracepoint);
+        if (identifier <= 0) {
+            continue;
+        }
+
+        memset(&pe, 0, sizeof(pe));
+        pe.type = PERF_TYPE_TRACEPOINT;
+        pe.size = sizeof(pe);
+        pe.config = (__u64)identifier;
+        pe.inherit = 1;
+
+        syscallCounterFds[event] = (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+        if (syscallCounterFds[event] != -1) {
+            syscallCountersAvailable |= syscallCounterEvents[event].mask;
+        }
+    }
+}
+
+__attribute__((destructor))
+void closeSyscallCounters(void) {
+    int event;
+
+    for (event = 0; event < SYSCALL_COUNTERS_MAX_EVENTS; event++) {
+        if (syscallCounterFds[event] != -1) {
+            close(syscallCounterFds[event]);
+            syscallCounterFds[event] = -1;
+        }
+    }
+    syscallCountersAvailable = 0;
+}
+
+unsigned int CLinuxSyscallStatsAvailable() {
+    return syscallCountersAvailable;
+}
+
+void CLinuxSyscallStatsCurrent(struct syscallStats *syscallStats) {
+    unsigned long long value;
+    int event;
+
+    for (event = 0; event < SYSCALL_COUNTERS_MAX_EVENTS; event++) {
+        if (syscallCounterFds[event] == -1 ||
+            read(syscallCounterFds[event], &value, sizeof(value)) != sizeof(value)) {
+            continue;
+        }
+
+        switch (syscallCounterEvents[event].mask) {
+            case CLINUX_SYSCALL_COUNTER_TOTAL:
+                syscallStats->syscalls += (long long)value;
+                break;
+            case CLINUX_SYSCALL_COUNTER_FUTEX:
+                syscallStats->futexSyscalls += (long long)value;
+                break;
+            case CLINUX_SYSCALL_COUNTER_EPOLL_WAIT:
+                syscallStats->epollWaitSyscalls += (long long)value;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Page faults from the minor-faults and major-faults software events, counted for the process and all
+// threads created after startup. Opened only if requested, as reading them is cheaper than having the
+// kernel sum the counts of all threads for /proc/self/stat, which is used otherwise.
+
+#define PAGE_FAULT_COUNTERS_MAX_EVENTS 2
+
+struct page_fault_counter_event {
+    const char *name; // matches the BenchmarkMetric raw description
+    unsigned long long config;
+    unsigned int mask;
+};
+
+static const struct page_fault_counter_event pageFaultCounterEvents[PAGE_FAULT_COUNTERS_MAX_EVENTS] = {
+    {"minorPageFaults", PERF_COUNT_SW_PAGE_FAULTS_MIN, CLINUX_PAGE_FAULT_COUNTER_MINOR},
+    {"majorPageFaults", PERF_COUNT_SW_PAGE_FAULTS_MAJ, CLINUX_PAGE_FAULT_COUNTER_MAJOR},
+};
+
+static int pageFaultCounterFds[PAGE_FAULT_COUNTERS_MAX_EVENTS] = {-1, -1};
+static unsigned int pageFaultCountersAvailable = 0;
+
+__attribute__((constructor))
+void openPageFaultCounters(void) {
+    struct perf_event_attr pe;
+    int event;
+
+    for (event = 0; event < PAGE_FAULT_COUNTERS_MAX_EVENTS; event++) {
+        if (performanceCounterRequested(pageFaultCounterEvents[event].name) == 0) {
+            continue;
+        }
+
+        memset(&pe, 0, sizeof(pe));
+        pe.type = PERF_TYPE_SOFTWARE;
+        pe.size = sizeof(pe);
+        pe.config = pageFaultCounterEvents[event].config;
+        pe.inherit = 1;
+
+        pageFaultCounterFds[event] = (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+        if (pageFaultCounterFds[event] != -1) {
+            pageFaultCountersAvailable |= pageFaultCounterEvents[event].mask;
+        }
+    }
+}
+
+__attribute__((destructor))
+void closePageFaultCounters(void) {
+    int event;
+
+    for (event = 0; event < PAGE_FAULT_COUNTERS_MAX_EVENTS; event++) {
+        if (pageFaultCounterFds[event] != -1) {
+            close(pageFaultCounterFds[event]);
+            pageFaultCounterFds[event] = -1;
+        }
+    }
+    pageFaultCountersAvailable = 0;
+}
+
+unsigned int CLinuxPageFaultCountersAvailable() {
+    return pageFaultCountersAvailable;
+}
+
+void CLinuxPageFaultCountersCurrent(struct pageFaultStats *pageFaultStats) {
+    unsigned long long value;
+
+    if (pageFaultCounterFds[0] != -1 && read(pageFaultCounterFds[0], &value, sizeof(value)) == sizeof(value)) {
+        pageFaultStats->minorPageFaults = (long long)value;
+    }
+    if (pageFaultCounterFds[1] != -1 && read(pageFaultCounterFds[1], &value, sizeof(value)) == sizeof(value)) {
+        pageFaultStats->majorPageFaults = (long long)value;
+    }
+}
+
+// The proportional (Pss) and anonymous resident memory summed over all mappings. The kernel walks
+// the page tables of the whole address space to produce it, so it's only read when requested.
+int CLinuxMemoryRollupCurrent(struct memoryRollup *memoryRollup) {
+    char buffer[4096];
+    const char *cursor;
+
+    if (preadProcfsFile(procSelfSmapsRollupFd, buffer, sizeof(buffer)) == -1) {
+        return 0;
+    }
+
+    cursor = strstr(buffer, "\nPss:");
+    if (cursor == NULL) {
+        return 0;
+    }
+    cursor += sizeof("\nPss:") - 1;
+    while (*cursor == ' ' || *cursor == '\t') {
+        cursor++;
+    }
+    memoryRollup->proportionalResident = parseNumber(&cursor) * 1024; // reported in kB
+
+    cursor = strstr(cursor, "\nAnonymous:");
+    if (cursor == NULL) {
+        return 0;
+    }
+    cursor += sizeof("\nAnonymous:") - 1;
+    while (*cursor == ' ' || *cursor == '\t') {
+        cursor++;
+    }
+    memoryRollup->anonymousResident = parseNumber(&cursor) * 1024;
+
+    return 1;
+}
+
+// Writing 5 to clear_refs resets the resident set high water mark (VmHWM) to the current
+// resident set size (Linux 4.0+), so VmHWM read afterwards is the peak since the reset.
+int CLinuxPeakMemoryResidentReset() {
+    ssize_t bytesWritten;
+
+    if (procSelfClearRefsFd == -1) {
+        return 0;
+    }
+
+    do {
+        bytesWritten = pwrite(procSelfClearRefsFd, "5", 1, 0);
+    } while (bytesWritten == -1 && errno == EINTR);
+
+    return bytesWritten == 1 ? 1 : 0;
+}
+
+// /proc/self/status can be larger than the buffer on hosts with many CPUs, as the Cpus_allowed and
+// Mems_allowed lines grow with them. VmHWM comes well before those, so only the start of the file is
+// read, and the value is only used if its whole line was read.
+long long CLinuxPeakMemoryResidentCurrent() {
+    char buffer[4096];
+    const char *cursor;
+    long long peakResident;
+    ssize_t bytesRead;
+
+    if (procSelfStatusFd == -1) {
+        return 0;
+    }
+
+    do {
+        bytesRead = pread(procSelfStatusFd, buffer, sizeof(buffer) - 1, 0);
+    } while (bytesRead == -1 && errno == EINTR);
+
+    if (bytesRead <= 0) {
+        return 0;
+    }
+    buffer[bytesRead] = '\0';
+
+    cursor = strstr(buffer, "\nVmHWM:");
+    if (cursor == NULL) {
+        return 0;
+    }
+
+    cursor += sizeof("\nVmHWM:") - 1;
+    while (*cursor == ' ' || *cursor == '\t') {
+        cursor++;
+    }
+
+    peakResident = parseNumber(&cursor);
+    if (strncmp(cursor, " kB\n", 4) != 0) { // the line continues past the end of the buffer
+        return 0;
+    }
+
+    return peakResident * 1024;
+}
+
+long long CLinuxContextSwitchesCurrent() {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    return (long long)usage.ru_nvcsw + (long long)usage.ru_nivcsw;
+}
+
+// Calls visit with the contents of the given file of each thread of the process, optionally not including
+// the calling thread. Uses getdents64 with a stack buffer instead of opendir() as this is called from the
+// sampling thread, and shouldn't allocate.
+static void forEachThread(const char *file, int includeSelf, void (*visit)(const char *contents, void *context),
+                          void *context) {
+    char entries[4096];
+    char path[64];
+    char buffer[1024];
+    long bytes, offset;
+    int fd;
+    long self = (long)syscall(SYS_gettid);
+
+    if (procSelfTaskFd == -1 || lseek(procSelfTaskFd, 0, SEEK_SET) == -1) {
+        return;
+    }
+
+    while ((bytes = (long)syscall(SYS_getdents64, procSelfTaskFd, entries, sizeof(entries))) > 0) {
+        for (offset = 0; offset < bytes;) {
+            struct linux_dirent64 {
+                unsigned long long d_ino;
+                long long d_off;
+                unsigned short d_reclen;
+                unsigned char d_type;
+                char d_name[];
+            } *entry = (struct linux_dirent64 *)(entries + offset);
+
+            offset += entry->d_reclen;
+
+            if (entry->d_name[0] < '0' || entry->d_name[0] > '9' ||
+                (includeSelf == 0 && atol(entry->d_name) == self)) {
+                continue;
+            }
+
+            snprintf(path, sizeof(path), "%s/%s", entry->d_name, file);
+            fd = openat(procSelfTaskFd, path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) { // thread exited
+                continue;
+            }
+
+            if (preadProcfsFile(fd, buffer, sizeof(buffer)) != -1) {
+                visit(buffer, context);
+            }
+            close(fd);
+        }
+    }
+}
+
+static void countThreadRunning(const char *stat, void *context) {
+    const char *state = strrchr(stat, ')');
+
+    if (state != NULL && state[1] == ' ' && state[2] == 'R') {
+        (*(int *)context)++;
+    }
+}
+
+// Counts the threads of the process that are running or runnable ('R' in /proc/self/task/<tid>/stat),
+// not including the calling thread.
+int CLinuxThreadsRunningCurrent() {
+    int threadsRunning = 0;
+
+    forEachThread("stat", 0, countThreadRunning, &threadsRunning);
+    return threadsRunning;
+}
+
+// Scheduler statistics of the threads running the benchmark. The executor and the workers of a thread group
+// register themselves before measuring, which opens /proc/self/task/<tid>/schedstat once per thread, so that
+// reading the statistics at the start and stop of each iteration is one pread per thread, the same as for
+// the other procfs files, and the threads of the runner and the runtime aren't included in the sums.
+
+#define SCHEDSTAT_MAX_THREADS 512
+
+static int schedstatFds[SCHEDSTAT_MAX_THREADS] = {[0 ... SCHEDSTAT_MAX_THREADS - 1] = -1};
+static int schedstatThreads = 0; // slots taken, a slot's fd is -1 until it's opened
+
+static int openThreadSchedstat(void) {
+    char path[64];
+
+    if (procSelfTaskFd == -1) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%ld/schedstat", (long)syscall(SYS_gettid));
+    return openat(procSelfTaskFd, path, O_RDONLY | O_CLOEXEC);
+}
+
+// /proc/self/task/<tid>/schedstat is "<time on cpu in ns> <time waiting on a run queue in ns> <timeslices>"
+static int addThreadSchedStats(const char *schedstat, struct schedStats *schedStats) {
+    const char *cursor = schedstat;
+    long long runTime, runQueueWait;
+
+    runTime = parseNumber(&cursor);
+    if (*cursor++ != ' ') {
+        return 0;
+    }
+    runQueueWait = parseNumber(&cursor);
+    if (*cursor++ != ' ') {
+        return 0;
+    }
+
+    schedStats->runTime += runTime;
+    schedStats->runQueueWait += runQueueWait;
+    schedStats->timeslices += parseNumber(&cursor);
+    schedStats->threads++;
+    return 1;
+}
+
+int CLinuxSchedStatsAvailable() {
+    char buffer[128];
+    struct schedStats schedStats = {0};
+    int fd = openThreadSchedstat();
+    int available;
+
+    if (fd == -1) {
+        return 0;
+    }
+
+    available = preadProcfsFile(fd, buffer, sizeof(buffer)) != -1 && addThreadSchedStats(buffer, &schedStats);
+    close(fd);
+    return available;
+}
+
+// Called by the threads of a thread group concurrently, so the slot is taken atomically
+int CLinuxSchedStatsRegisterThread() {
+    int slot = __atomic_fetch_add(&schedstatThreads, 1, __ATOMIC_ACQ_REL);
+    int fd;
+
+    if (slot >= SCHEDSTAT_MAX_THREADS) {
+        return 0;
+    }
+
+    fd = openThreadSchedstat();
+    __atomic_store_n(&schedstatFds[slot], fd, __ATOMIC_RELEASE);
+    return fd != -1;
+}
+
+void CLinuxSchedStatsResetThreads() {
+    int threads = __atomic_load_n(&schedstatThreads, __ATOMIC_ACQUIRE);
+
+    if (threads > SCHEDSTAT_MAX_THREADS) {
+        threads = SCHEDSTAT_MAX_THREADS;
+    }
+
+    for (int slot = 0; slot < threads; slot++) {
+        if (schedstatFds[slot] != -1) {
+            close(schedstatFds[slot]);
+        }
+        schedstatFds[slot] = -1;
+    }
+
+    __atomic_store_n(&schedstatThreads, 0, __ATOMIC_RELEASE);
+}
+
+int CLinuxSchedStatsCurrent(struct schedStats *schedStats) {
+    char buffer[128];
+    int threads = __atomic_load_n(&schedstatThreads, __ATOMIC_ACQUIRE);
+    int fd;
+
+    if (threads > SCHEDSTAT_MAX_THREADS) {
+        threads = SCHEDSTAT_MAX_THREADS;
+    }
+
+    for (int slot = 0; slot < threads; slot++) {
+        fd = __atomic_load_n(&schedstatFds[slot], __ATOMIC_ACQUIRE);
+        if (preadProcfsFile(fd, buffer, sizeof(buffer)) != -1) { // fails for threads that have exited
+            addThreadSchedStats(buffer, schedStats);
+        }
+    }
+
+    return schedStats->threads > 0;
+}
+
+// Cycle counter clock. Reading the time stamp counter (x86_64) or the virtual counter (arm64) directly
+// is cheaper than clock_gettime(), but only usable as a clock if the counter runs at a constant rate on
+// all CPUs. The rate is calibrated against CLOCK_MONOTONIC_RAW in a few rounds that must agree, and the
+// clock is anchored to CLOCK_BOOTTIME, so that its instants are close to those of clock_gettime().
+
+#define CYCLE_CLOCK_CALIBRATION_ROUNDS 3
+#define CYCLE_CLOCK_CALIBRATION_NANOSECONDS 5000000ULL // per round
+#define CYCLE_CLOCK_CALIBRATION_TOLERANCE 1000 // the rounds must agree within 1/1000
+#define CYCLE_CLOCK_READ_ATTEMPTS 5
+
+static int cycleCounterInvariant(void) {
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    char buffer[32];
+    int fd;
+
+    // Invariant TSC, CPUID.80000007H:EDX[8]
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+        return 0;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    if ((edx & (1U << 8)) == 0) {
+        return 0;
+    }
+
+    // The kernel switches to another clocksource if it finds the TSC unstable, e.g. not in sync between sockets
+    fd = open("/sys/devices/system/clocksource/clocksource0/current_clocksource", O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        ssize_t bytesRead = preadProcfsFile(fd, buffer, sizeof(buffer));
+        close(fd);
+        if (bytesRead != -1 && strncmp(buffer, "tsc", 3) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+#elif defined(__aarch64__)
+    unsigned long long frequency;
+
+    // The generic timer runs at a fixed frequency, it's only missing if the firmware didn't set it up
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+    return frequency != 0;
+#else
+    return 0;
+#endif
+}
+
+static unsigned long long clockNanoseconds(clockid_t clock) {
+    struct timespec time;
+
+    clock_gettime(clock, &time);
+    return (unsigned long long)time.tv_sec * 1000000000ULL + (unsigned long long)time.tv_nsec;
+}
+
+// Reads the counter and the clock at the same time, as far as possible: the counter is read on both
+// sides of the clock, and the attempt with the shortest read is used
+static void readCycleClockPair(clockid_t clock, unsigned long long *ticks, unsigned long long *nanoseconds) {
+    unsigned long long before, after, shortest = ~0ULL, now;
+    int attempt;
+
+    for (attempt = 0; attempt < CYCLE_CLOCK_READ_ATTEMPTS; attempt++) {
+        before = CLinuxCycleClockTicks();
+        now = clockNanoseconds(clock);
+        after = CLinuxCycleClockTicks();
+        if (after - before < shortest) {
+            shortest = after - before;
+            *ticks = before + (after - before) / 2;
+            *nanoseconds = now;
+        }
+    }
+}
+
+int CLinuxCycleClockInit(struct cycleClockCalibration *calibration) {
+    unsigned long long multipliers[CYCLE_CLOCK_CALIBRATION_ROUNDS];
+    unsigned long long startTicks, startNanoseconds, stopTicks, stopNanoseconds, swap;
+    int round, index;
+
+    if (cycleCounterInvariant() == 0) {
+        return 0;
+    }
+
+    for (round = 0; round < CYCLE_CLOCK_CALIBRATION_ROUNDS; round++) {
+        readCycleClockPair(CLOCK_MONOTONIC_RAW, &startTicks, &startNanoseconds);
+        do {
+            readCycleClockPair(CLOCK_MONOTONIC_RAW, &stopTicks, &stopNanoseconds);
+        } while (stopNanoseconds - startNanoseconds < CYCLE_CLOCK_CALIBRATION_NANOSECONDS);
+
+        if (stopTicks <= startTicks) {
+            return 0;
+        }
+
+        // nanoseconds per tick as 32.32 fixed point
+        multipliers[round] = (unsigned long long)(((unsigned __int128)(stopNanoseconds - startNanoseconds) << 32) /
+                                                  (stopTicks - startTicks));
+
+        for (index = round; index > 0 && multipliers[index - 1] > multipliers[index]; index--) {
+            swap = multipliers[index - 1];
+            multipliers[index - 1] = multipliers[index];
+            multipliers[index] = swap;
+        }
+    }
+
+    if ((multipliers[CYCLE_CLOCK_CALIBRATION_ROUNDS - 1] - multipliers[0]) * CYCLE_CLOCK_CALIBRATION_TOLERANCE >
+        multipliers[CYCLE_CLOCK_CALIBRATION_ROUNDS - 1]) {
+        return 0;
+    }
+
+    calibration->multiplier = multipliers[CYCLE_CLOCK_CALIBRATION_ROUNDS / 2];
+    readCycleClockPair(CLOCK_BOOTTIME, &calibration->baseTicks, &calibration->baseNanoseconds);
+    return 1;
+}
+
+// Sampling profiler. If BENCHMARK_CPU_PROFILE_FREQUENCY is set at startup, a sampling event with the
+// user space call chain is opened per CPU for the process and all threads it creates (inherited events
+// can only be mmapped per CPU). Sampling is only enabled for the measured region, and the ring buffers
+// are drained when it's disabled into a table of distinct call chains and their counts. The addresses
+// are symbolicated after the benchmark has finished, nothing is allocated with malloc while measuring.
+
+#define SAMPLING_PROFILER_MAX_CPUS 1024
+#define SAMPLING_PROFILER_RING_PAGES 256 // data pages per CPU, must be a power of two
+#define SAMPLING_PROFILER_MAX_DEPTH 256 // deeper call chains are truncated
+#define SAMPLING_PROFILER_MIN_SLOTS 4096 // power of two
+
+struct sampling_profiler_context {
+    int cpuCount; // number of CPUs with an event opened
+    int fds[SAMPLING_PROFILER_MAX_CPUS];
+    struct perf_event_mmap_page *rings[SAMPLING_PROFILER_MAX_CPUS];
+    size_t pageSize;
+    int frequency;
+    unsigned long long samples;
+    unsigned long long lost;
+    unsigned long long *stacks; // count, depth and the addresses of each distinct call chain, back to back
+    size_t stacksUsed; // in words
+    size_t stacksCapacity; // in words
+    unsigned long long *slots; // open addressing table of offsets into stacks + 1, 0 if empty
+    size_t slotCount;
+    size_t stackCount;
+};
+
+static struct sampling_profiler_context samplingProfilerContext = {0};
+
+static inline size_t samplingRingSize(void) {
+    return (1 + SAMPLING_PROFILER_RING_PAGES) * samplingProfilerContext.pageSize;
+}
+
+__attribute__((constructor))
+void openSamplingProfiler(void) {
+    struct sampling_profiler_context *context = &samplingProfilerContext;
+    const char *frequency = getenv("BENCHMARK_CPU_PROFILE_FREQUENCY");
+    int cpus[SAMPLING_PROFILER_MAX_CPUS];
+    struct perf_event_attr pe;
+    int cpuCount, cpu, fd;
+    void *ring;
+
+    if (frequency == NULL || atoi(frequency) <= 0) {
+        return;
+    }
+
+    cpuCount = get_cpu_identifiers(cpus, SAMPLING_PROFILER_MAX_CPUS);
+    if (cpuCount <= 0) {
+        return;
+    }
+
+    context->pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    memset(&pe, 0, sizeof(pe));
+    pe.type = PERF_TYPE_SOFTWARE;
+    pe.size = sizeof(pe);
+    pe.config = PERF_COUNT_SW_CPU_CLOCK;
+    pe.sample_freq = (__u64)atoi(frequency);
+    pe.freq = 1;
+    pe.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+    pe.disabled = 1;
+    pe.inherit = 1;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    pe.exclude_callchain_kernel = 1;
+
+    for (cpu = 0; cpu < cpuCount; cpu++) {
+        fd = (int)syscall(SYS_perf_event_open, &pe, 0, cpus[cpu], -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+
+        ring = mmap(NULL, samplingRingSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ring == MAP_FAILED) {
+            close(fd);
+            continue;
+        }
+
+        context->fds[context->cpuCount] = fd;
+        context->rings[context->cpuCount] = ring;
+        context->cpuCount++;
+    }
+
+    if (context->cpuCount > 0) {
+        context->frequency = (int)pe.sample_freq;
+    }
+}
+
+__attribute__((destructor))
+void closeSamplingProfiler(void) {
+    struct sampling_profiler_context *context = &samplingProfilerContext;
+    int cpu;
+
+    for (cpu = 0; cpu < context->cpuCount; cpu++) {
+        munmap(context->rings[cpu], samplingRingSize());
+        close(context->fds[cpu]);
+    }
+    context->cpuCount = 0;
+    context->frequency = 0;
+
+    if (context->stacks != NULL) {
+        munmap(context->stacks, context->stacksCapacity * sizeof(unsigned long long));
+        context->stacks = NULL;
+    }
+    if (context->slots != NULL) {
+        munmap(context->slots, context->slotCount * sizeof(unsigned long long));
+        context->slots = NULL;
+    }
+}
+
+// mmap rather than malloc, so that the table doesn't show up in the malloc metrics of the benchmark
+static unsigned long long *mapSamplingTable(size_t words) {
+    void *table = mmap(NULL, words * sizeof(unsigned long long), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return table == MAP_FAILED ? NULL : table;
+}
+
+static inline unsigned long long hashCallchain(const unsigned long long *addresses, unsigned long long depth) {
+    unsigned long long hash = 0xcbf29ce484222325ULL; // FNV-1a over the addresses
+    unsigned long long frame;
+
+    for (frame = 0; frame < depth; frame++) {
+        hash = (hash ^ addresses[frame]) * 0x100000001b3ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+static void insertSamplingSlot(struct sampling_profiler_context *context, size_t offset) {
+    const unsigned long long *stack = &context->stacks[offset];
+    size_t index = (size_t)hashCallchain(stack + 2, stack[1]) & (context->slotCount - 1);
+
+    while (context->slots[index] != 0) {
+        index = (index + 1) & (context->slotCount - 1);
+    }
+    context->slots[index] = offset + 1;
+}
+
+// Keeps the load factor of the slots at most 1/2, rehashing the stacks into a table twice the size
+static int growSamplingSlots(struct sampling_profiler_context *context) {
+    size_t slotCount = context->slotCount == 0 ? SAMPLING_PROFILER_MIN_SLOTS : 2 * context->slotCount;
+    unsigned long long *slots = mapSamplingTable(slotCount);
+    size_t offset;
+
+    if (slots == NULL) {
+        return 0;
+    }
+
+    if (context->slots != NULL) {
+        munmap(context->slots, context->slotCount * sizeof(unsigned long long));
+    }
+    context->slots = slots;
+    context->slotCount = slotCount;
+
+    for (offset = 0; offset < context->stacksUsed; offset += 2 + context->stacks[offset + 1]) {
+        insertSamplingSlot(context, offset);
+    }
+    return 1;
+}
+
+static int growSamplingStacks(struct sampling_profiler_context *context, size_t words) {
+    size_t capacity = context->stacksCapacity == 0 ? 64 * 1024 : 2 * context->stacksCapacity;
+    unsigned long long *stacks;
+
+    while (capacity < context->stacksUsed + words) {
+        capacity *= 2;
+    }
+
+    stacks = mapSamplingTable(capacity);
+    if (stacks == NULL) {
+        return 0;
+    }
+
+    if (context->stacks != NULL) {
+        memcpy(stacks, context->stacks, context->stacksUsed * sizeof(unsigned long long));
+        munmap(context->stacks, context->stacksCapacity * sizeof(unsigned long long));
+    }
+    context->stacks = stacks;
+    context->stacksCapacity = capacity;
+    return 1;
+}
+
+static void addSamplingCallchain(struct sampling_profiler_context *context,
+                                 const unsigned long long *addresses, unsigned long long depth) {
+    unsigned long long *stack;
+    size_t index;
+
+    if (2 * (context->stackCount + 1) > context->slotCount && growSamplingSlots(context) == 0) {
+        context->lost++;
+        return;
+    }
+
+    index = (size_t)hashCallchain(addresses, depth) & (context->slotCount - 1);
+    while (context->slots[index] != 0) {
+        stack = &context->stacks[context->slots[index] - 1];
+        if (stack[1] == depth && memcmp(stack + 2, addresses, depth * sizeof(unsigned long long)) == 0) {
+            stack[0]++;
+            return;
+        }
+        index = (index + 1) & (context->slotCount - 1);
+    }
+
+    if (context->stacksUsed + 2 + depth > context->stacksCapacity && growSamplingStacks(context, 2 + depth) == 0) {
+        context->lost++;
+        return;
+    }
+
+    stack = &context->stacks[context->stacksUsed];
+    stack[0] = 1;
+    stack[1] = depth;
+    memcpy(stack + 2, addresses, depth * sizeof(unsigned long long));
+    context->slots[index] = context->stacksUsed + 1;
+    context->stacksUsed += 2 + depth;
+    context->stackCount++;
+}
+
+static void copyFromSamplingRing(const unsigned char *data, size_t size, unsigned long long position,
+                                 void *destination, size_t length) {
+    size_t offset = (size_t)(position & (size - 1));
+    size_t first = length < size - offset ? length : size - offset;
+
+    memcpy(destination, data + offset, first);
+    memcpy((unsigned char *)destination + first, data, length - first);
+}
+
+// A sample is the header, the sampled ip, the number of entries in the call chain and the entries,
+// where the entries include markers for the context (user/kernel) of the entries following them
+static void drainSamplingRing(struct sampling_profiler_context *context, struct perf_event_mmap_page *page) {
+    const unsigned char *data = (const unsigned char *)page + context->pageSize;
+    const size_t size = SAMPLING_PROFILER_RING_PAGES * context->pageSize;
+    unsigned long long head = __atomic_load_n(&page->data_head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = page->data_tail;
+    unsigned long long record[3 + SAMPLING_PROFILER_MAX_DEPTH];
+    unsigned long long addresses[SAMPLING_PROFILER_MAX_DEPTH];
+    unsigned long long entry, entries, depth;
+    struct perf_event_header header;
+
+    while (tail < head) {
+        copyFromSamplingRing(data, size, tail, &header, sizeof(header));
+        if (header.size < sizeof(header)) {
+            break;
+        }
+
+        if (header.type == PERF_RECORD_SAMPLE && header.size >= 3 * sizeof(unsigned long long)) {
+            size_t length = header.size < sizeof(record) ? header.size : sizeof(record); // truncates the chain
+            copyFromSamplingRing(data, size, tail, record, length);
+            entries = length / sizeof(unsigned long long) - 3;
+            if (record[2] < entries) {
+                entries = record[2];
+            }
+
+            for (entry = 0, depth = 0; entry < entries; entry++) {
+                if (record[3 + entry] < PERF_CONTEXT_MAX) {
+                    addresses[depth++] = record[3 + entry];
+                }
+            }
+            if (depth == 0) { // no call chain could be walked, use the sampled ip alone
+                addresses[depth++] = record[1];
+            }
+
+            addSamplingCallchain(context, addresses, depth);
+            context->samples++;
+        } else if (header.type == PERF_RECORD_LOST) { // header, id, lost
+            copyFromSamplingRing(data, size, tail, record, 3 * sizeof(unsigned long long));
+            context->lost += record[2];
+        }
+
+        tail += header.size;
+    }
+
+    __atomic_store_n(&page->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+int CLinuxSamplingProfilerFrequency() {
+    return samplingProfilerContext.frequency;
+}
+
+void CLinuxSamplingProfilerEnable() {
+    int cpu;
+
+    for (cpu = 0; cpu < samplingProfilerContext.cpuCount; cpu++) {
+        ioctl(samplingProfilerContext.fds[cpu], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void CLinuxSamplingProfilerDisable() {
+    int cpu;
+
+    for (cpu = 0; cpu < samplingProfilerContext.cpuCount; cpu++) {
+        ioctl(samplingProfilerContext.fds[cpu], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (cpu = 0; cpu < samplingProfilerContext.cpuCount; cpu++) {
+        drainSamplingRing(&samplingProfilerContext, samplingProfilerContext.rings[cpu]);
+    }
+}
+
+void CLinuxSamplingProfilerReset() {
+    struct sampling_profiler_context *context = &samplingProfilerContext;
+    struct perf_event_mmap_page *page;
+    int cpu;
+
+    for (cpu = 0; cpu < context->cpuCount; cpu++) { // discard anything not drained yet
+        page = context->rings[cpu];
+        __atomic_store_n(&page->data_tail, __atomic_load_n(&page->data_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+
+    if (context->slots != NULL) {
+        memset(context->slots, 0, context->slotCount * sizeof(unsigned long long));
+    }
+    context->stacksUsed = 0;
+    context->stackCount = 0;
+    context->samples = 0;
+    context->lost = 0;
+}
+
+unsigned long long CLinuxSamplingProfilerSamples() {
+    return samplingProfilerContext.samples;
+}
+
+unsigned long long CLinuxSamplingProfilerLost() {
+    return samplingProfilerContext.lost;
+}
+
+int CLinuxSamplingProfilerStack(unsigned long long *cursor, const unsigned long long **addresses, int *depth,
+                                unsigned long long *count) {
+    const unsigned long long *stack;
+
+    if (*cursor >= samplingProfilerContext.stacksUsed) {
+        return 0;
+    }
+
+    stack = &samplingProfilerContext.stacks[*cursor];
+    *count = stack[0];
+    *depth = (int)stack[1];
+    *addresses = stack + 2;
+    *cursor += 2 + stack[1];
+    return 1;
 }
 
 /*
@@ -20,7 +20,7 @@ struct ioStats {
     long long writeBytesPhysical;
 } ioStats;
 
-void CLinuxIOStats(const char *s, struct ioStats *ioStats);
+int CLinuxIOStatsCurrent(struct ioStats *ioStats); // returns 0 if /proc/self/io couldn't be read
 
 struct processStats {
     long cpuUser;
@@ -29,17 +29,137 @@ struct processStats {
     long threads;
     long peakMemoryVirtual;
     long peakMemoryResident;
+    long minorPageFaults;
+    long majorPageFaults;
 } processStats;
 
-void CLinuxProcessStats(const char *s, struct processStats *processStats);
+int CLinuxProcessStatsCurrent(struct processStats *processStats); // returns 0 if /proc/self/stat couldn't be read
+
+// Bitmask of the hardware events that can be opened as a single perf event group,
+// instructions is always the group leader. The set of additional events to open is
+// taken from the BENCHMARK_PERFORMANCE_COUNTERS environment variable at startup.
+#define CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS    0x01
+#define CLINUX_PERFORMANCE_COUNTER_CPU_CYCLES      0x02
+#define CLINUX_PERFORMANCE_COUNTER_BRANCH_MISSES   0x04
+#define CLINUX_PERFORMANCE_COUNTER_CACHE_MISSES    0x08
+#define CLINUX_PERFORMANCE_COUNTER_L1D_CACHE_MISSES 0x10
+#define CLINUX_PERFORMANCE_COUNTER_DTLB_MISSES     0x20
 
 struct performanceCounters {
     unsigned long long instructions;
+    unsigned long long cpuCycles;
+    unsigned long long branchMisses;
+    unsigned long long cacheMisses;
+    unsigned long long l1dCacheMisses;
+    unsigned long long dTLBMisses;
 } performanceCounters;
 
 void CLinuxPerformanceCountersCurrent(struct performanceCounters *performanceCounters); // return current counters
+unsigned int CLinuxPerformanceCountersAvailable(); // bitmask of the events successfully opened
 void CLinuxPerformanceCountersEnable();
 void CLinuxPerformanceCountersDisable();
 void CLinuxPerformanceCountersReset();
 
+// Counters for the calling thread only, read from user space with rdpmc where the CPU and kernel allows it.
+int CLinuxPerformanceCountersThreadInit(); // returns 0 if unavailable, 1 if read with syscalls, 2 if read with rdpmc
+void CLinuxPerformanceCountersThreadDeinit();
+void CLinuxPerformanceCountersThreadCurrent(struct performanceCounters *performanceCounters); // return current counters
+
+// Syscall counters from tracepoints, opened at startup if requested in BENCHMARK_PERFORMANCE_COUNTERS
+#define CLINUX_SYSCALL_COUNTER_TOTAL      0x01
+#define CLINUX_SYSCALL_COUNTER_FUTEX      0x02
+#define CLINUX_SYSCALL_COUNTER_EPOLL_WAIT 0x04
+
+struct syscallStats {
+    long long syscalls;
+    long long futexSyscalls;
+    long long epollWaitSyscalls;
+} syscallStats;
+
+void CLinuxSyscallStatsCurrent(struct syscallStats *syscallStats); // return current counters
+unsigned int CLinuxSyscallStatsAvailable(); // bitmask of the counters successfully opened
+
+long long CLinuxContextSwitchesCurrent(); // voluntary + involuntary context switches for the process
+int CLinuxThreadsRunningCurrent(); // number of running threads, excluding the calling thread
+
+// Scheduler statistics summed over the threads registered as running the benchmark, threads that have
+// exited aren't included
+struct schedStats {
+    long long runTime; // nanoseconds on a CPU
+    long long runQueueWait; // nanoseconds runnable but waiting for a CPU
+    long long timeslices; // number of times a thread was put on a CPU
+    long long threads; // number of threads read
+} schedStats;
+
+int CLinuxSchedStatsAvailable(); // returns 0 if schedstat can't be read
+int CLinuxSchedStatsRegisterThread(); // adds the calling thread to the sums, returns 0 if it couldn't be added
+void CLinuxSchedStatsResetThreads(); // removes all registered threads, not to be called while reading
+int CLinuxSchedStatsCurrent(struct schedStats *schedStats); // returns 0 if no registered thread could be read
+
+// Page faults from perf software events, opened at startup if requested in BENCHMARK_PERFORMANCE_COUNTERS
+#define CLINUX_PAGE_FAULT_COUNTER_MINOR 0x01
+#define CLINUX_PAGE_FAULT_COUNTER_MAJOR 0x02
+
+struct pageFaultStats {
+    long long minorPageFaults;
+    long long majorPageFaults;
+} pageFaultStats;
+
+void CLinuxPageFaultCountersCurrent(struct pageFaultStats *pageFaultStats); // return current counters
+unsigned int CLinuxPageFaultCountersAvailable(); // bitmask of the counters successfully opened
+
+// Memory summed over all mappings from /proc/self/smaps_rollup
+struct memoryRollup {
+    long long proportionalResident; // Pss in bytes, shared pages divided by the number of processes mapping them
+    long long anonymousResident; // in bytes
+} memoryRollup;
+
+int CLinuxMemoryRollupCurrent(struct memoryRollup *memoryRollup); // returns 0 if smaps_rollup couldn't be read
+
+// Precise peak resident memory using /proc/self/clear_refs and VmHWM in /proc/self/status
+int CLinuxPeakMemoryResidentReset(); // returns 0 if the high water mark couldn't be reset
+long long CLinuxPeakMemoryResidentCurrent(); // peak resident memory in bytes since the last reset
+
+// Sampling profiler with user space call chains, opened at startup if BENCHMARK_CPU_PROFILE_FREQUENCY is set
+int CLinuxSamplingProfilerFrequency(); // samples per second, 0 if the profiler isn't available
+void CLinuxSamplingProfilerEnable();
+void CLinuxSamplingProfilerDisable(); // stops sampling and aggregates the samples taken into distinct call chains
+void CLinuxSamplingProfilerReset(); // discards the samples taken so far
+unsigned long long CLinuxSamplingProfilerSamples(); // samples taken since the last reset
+unsigned long long CLinuxSamplingProfilerLost(); // samples lost to full ring buffers since the last reset
+// Iterates the distinct call chains, innermost frame first, starting with *cursor = 0. Returns 0 at the end.
+int CLinuxSamplingProfilerStack(unsigned long long *cursor, const unsigned long long **addresses, int *depth,
+                                unsigned long long *count);
+
+// Cycle counter clock, reading the time stamp counter on x86_64 and the virtual counter on arm64
+struct cycleClockCalibration {
+    unsigned long long baseTicks;
+    unsigned long long baseNanoseconds; // CLOCK_BOOTTIME at baseTicks
+    unsigned long long multiplier; // nanoseconds per tick as 32.32 fixed point
+};
+
+// Returns 0 if the counter isn't invariant or doesn't calibrate consistently against CLOCK_MONOTONIC_RAW
+int CLinuxCycleClockInit(struct cycleClockCalibration *calibration);
+
+static inline unsigned long long CLinuxCycleClockTicks(void) {
+#if defined(__x86_64__)
+    unsigned int low, high;
+    __asm__ __volatile__("lfence\n\trdtsc" : "=a"(low), "=d"(high) : : "memory"); // not before earlier instructions
+    return ((unsigned long long)high << 32) | low;
+#elif defined(__aarch64__)
+    unsigned long long ticks;
+    __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(ticks) : : "memory");
+    return ticks;
+#else
+    return 0;
+#endif
+}
+
+// A counter read on another CPU than the one calibrated on may be slightly behind the base, clamped to it
+static inline unsigned long long CLinuxCycleClockNanoseconds(struct cycleClockCalibration calibration) {
+    unsigned long long now = CLinuxCycleClockTicks();
+    unsigned long long ticks = now > calibration.baseTicks ? now - calibration.baseTicks : 0;
+    return calibration.baseNanoseconds + (unsigned long long)(((unsigned __int128)ticks * calibration.multiplier) >> 32);
+}
+
 #endif /* CLinuxOperatingSystemStats_h */
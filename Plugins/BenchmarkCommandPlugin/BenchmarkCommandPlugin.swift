@@ -71,6 +71,22 @@ import PackagePlugin
         let benchmarkBuildConfiguration = argumentExtractor.extractOption(named: "benchmark-build-configuration")
         let debug = argumentExtractor.extractFlag(named: "debug")
         let scale = argumentExtractor.extractFlag(named: "scale")
+        let parallel = argumentExtractor.extractOption(named: "parallel")
+        let cpuPartitioning = argumentExtractor.extractOption(named: "cpu-partitioning")
+        let stabilize = argumentExtractor.extractFlag(named: "stabilize")
+        let stabilizeCPU = argumentExtractor.extractOption(named: "stabilize-cpu")
+        let stabilizeRealtime = argumentExtractor.extractFlag(named: "stabilize-realtime")
+        let allocationProfile = argumentExtractor.extractFlag(named: "allocation-profile")
+        let allocationProfileLgSample = argumentExtractor.extractOption(named: "allocation-profile-lg-sample")
+        let arcTypes = argumentExtractor.extractFlag(named: "arc-types")
+        let cpuProfile = argumentExtractor.extractFlag(named: "cpu-profile")
+        let cpuProfileFrequency = argumentExtractor.extractOption(named: "cpu-profile-frequency")
+        let recordHistory = argumentExtractor.extractFlag(named: "record-history")
+        let trace = argumentExtractor.extractFlag(named: "trace")
+        let traceCapacity = argumentExtractor.extractOption(named: "trace-capacity")
+        let stream = argumentExtractor.extractOption(named: "stream")
+        let streamFormat = argumentExtractor.extractOption(named: "stream-format")
+        let binaryBaselines = argumentExtractor.extractFlag(named: "binary-baselines")
         let helpRequested = argumentExtractor.extractFlag(named: "help")
         let otherSwiftFlagsSpecified = argumentExtractor.extractOption(named: "Xswiftc")
         var outputFormat: OutputFormat = .text
@@ -234,6 +250,98 @@ import PackagePlugin
             args.append(contentsOf: ["--scale"])
         }
 
+        if let firstValue = parallel.first {
+            guard let processes = Int(firstValue), processes > 0 else {
+                print("Invalid number of parallel benchmarks specified '\(firstValue)'")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--parallel", String(processes)])
+        }
+
+        if let firstValue = cpuPartitioning.first {
+            guard ["cores", "cache", "numa"].contains(firstValue) else {
+                print("Unknown CPU partitioning specified '\(firstValue)', valid values are: cores, cache, numa")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--cpu-partitioning", firstValue])
+        }
+
+        if stabilize > 0 || stabilizeCPU.isEmpty == false || stabilizeRealtime > 0 {
+            args.append(contentsOf: ["--stabilize"])
+        }
+
+        if let firstValue = stabilizeCPU.first {
+            guard let cpu = Int(firstValue), cpu >= 0 else {
+                print("Invalid CPU specified for --stabilize-cpu '\(firstValue)'")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--stabilize-cpu", String(cpu)])
+        }
+
+        if stabilizeRealtime > 0 {
+            args.append(contentsOf: ["--stabilize-realtime"])
+        }
+
+        if allocationProfile > 0 || allocationProfileLgSample.isEmpty == false {
+            args.append(contentsOf: ["--allocation-profile"])
+        }
+
+        if let firstValue = allocationProfileLgSample.first {
+            guard let lgSample = Int(firstValue), (0...40).contains(lgSample) else {
+                print("Invalid sample interval specified for --allocation-profile-lg-sample '\(firstValue)'")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--allocation-profile-lg-sample", String(lgSample)])
+        }
+
+        if arcTypes > 0 {
+            args.append(contentsOf: ["--arc-types"])
+        }
+
+        if cpuProfile > 0 || cpuProfileFrequency.isEmpty == false {
+            args.append(contentsOf: ["--cpu-profile"])
+        }
+
+        if let firstValue = cpuProfileFrequency.first {
+            guard let frequency = Int(firstValue), (1...100_000).contains(frequency) else {
+                print("Invalid sampling frequency specified for --cpu-profile-frequency '\(firstValue)'")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--cpu-profile-frequency", String(frequency)])
+        }
+
+        if recordHistory > 0 {
+            args.append(contentsOf: ["--record-history"])
+        }
+
+        if trace > 0 || traceCapacity.isEmpty == false {
+            args.append(contentsOf: ["--trace"])
+        }
+
+        if let firstValue = traceCapacity.first {
+            guard let capacity = Int(firstValue), capacity > 0 else {
+                print("Invalid number of iterations specified for --trace-capacity '\(firstValue)'")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--trace-capacity", String(capacity)])
+        }
+
+        if let firstValue = stream.first {
+            args.append(contentsOf: ["--stream", firstValue])
+        }
+
+        if let firstValue = streamFormat.first {
+            guard ["ndjson", "influx"].contains(firstValue) else {
+                print("Unknown stream format specified '\(firstValue)', valid values are: ndjson, influx")
+                throw MyError.invalidArgument
+            }
+            args.append(contentsOf: ["--stream-format", firstValue])
+        }
+
+        if binaryBaselines > 0 {
+            args.append(contentsOf: ["--binary-baselines"])
+        }
+
         filterSpecified.forEach { filter in
             args.append(contentsOf: ["--filter", filter])
         }
@@ -256,6 +364,14 @@ import PackagePlugin
             throw MyError.invalidArgument
         }
 
+        if commandToPerform == .history {
+            guard positionalArguments.isEmpty else {
+                print("Can't specify baselines for history operation, superfluous arguments [\(positionalArguments)]")
+                throw MyError.invalidArgument
+            }
+            shouldBuildTargets = false
+        }
+
         if commandToPerform == .thresholds {
             guard positionalArguments.count > 0,
                 let thresholdsOperation = ThresholdsOperation(rawValue: positionalArguments.removeFirst())
@@ -350,7 +466,7 @@ import PackagePlugin
                 if positionalArguments.count == 2 {
                     shouldBuildTargets = false
                 }
-            case .read, .list, .delete:
+            case .read, .list, .delete, .convert:
                 shouldBuildTargets = false
             }
 
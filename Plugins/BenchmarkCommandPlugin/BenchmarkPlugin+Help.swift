@@ -35,15 +35,17 @@ let help =
        swift package benchmark baseline read <baseline> [<baseline2> ... <baselineN>] [<options>]
        swift package benchmark baseline update <baseline> [<options>]
        swift package benchmark baseline delete <baseline> [<baseline2> ... <baselineN>] [<options>]
+       swift package benchmark baseline convert [<baseline> ... <baselineN>] [<options>]
        swift package benchmark baseline check <baseline> [<otherBaseline>] [<options>]
        swift package benchmark baseline compare <baseline> [<otherBaseline>] [<options>]
        swift package benchmark thresholds read [<options>]
        swift package benchmark thresholds update [<baseline>] [<options>]
        swift package benchmark thresholds check [<baseline>] [<options>]
+       swift package benchmark history [<options>]
        swift package benchmark help
 
     ARGUMENTS:
-    <command>               The benchmark command to perform. If not specified, 'run' is implied. (values: run, list, baseline, thresholds, help, init)
+    <command>               The benchmark command to perform. If not specified, 'run' is implied. (values: run, list, baseline, thresholds, help, init, history)
 
     OPTIONS:
     --filter <filter>       Benchmarks matching the regexp filter that should be run
@@ -54,7 +56,7 @@ let help =
     --format <format>       The output format to use, default is 'text' (values: text, markdown, influx, jmh, jsonSmallerIsBetter, jsonBiggerIsBetter, histogramEncoded, histogram, histogramSamples, histogramPercentiles, metricP90AbsoluteThresholds)
     --metric <metric>       Specifies that the benchmark run should use one or more specific metrics instead of the ones defined by the benchmarks. (values: cpuUser, cpuSystem, cpuTotal, wallClock, throughput,
                           peakMemoryResident, peakMemoryResidentDelta, peakMemoryVirtual, mallocCountSmall, mallocCountLarge, mallocCountTotal, allocatedResidentMemory, memoryLeaked, syscalls, contextSwitches, threads,
-                          threadsRunning, readSyscalls, writeSyscalls, readBytesLogical, writeBytesLogical, readBytesPhysical, writeBytesPhysical, instructions, retainCount, releaseCount, retainReleaseDelta, custom)
+                          threadsRunning, readSyscalls, writeSyscalls, readBytesLogical, writeBytesLogical, readBytesPhysical, writeBytesPhysical, instructions, retainCount, releaseCount, retainReleaseDelta, cpuCycles, branchMisses, cacheMisses, l1dCacheMisses, dTLBMisses, instructionsPerCycle, cacheMissesPerKiloInstructions, branchMissesPerKiloInstructions, futexSyscalls, epollWaitSyscalls, scalingEfficiency, bytesAllocated, bytesFreed, mallocThreadCacheFills, mallocThreadCacheFlushes, mallocSizeClass, growthExponent, minorPageFaults, majorPageFaults, proportionalResidentMemory, anonymousResidentMemory, runQueueDelay, offCPUTime, timeslices, custom)
     --path <path>           The path to operate on for data export or threshold operations, default is the current directory (".") for exports and the ("./Thresholds") directory for thresholds.
     --quiet                 Specifies that output should be suppressed (useful for if you just want to check return code)
     --scale                 Specifies that some of the text output should be scaled using the scalingFactor (denoted by '*' in output)
@@ -73,6 +75,36 @@ let help =
                           This implicitly sets --check-absolute to true as well.
     --no-progress           Specifies that benchmark progress information should not be displayed
     --grouping <grouping>   The grouping to use, one of: ["metric", "benchmark"]. default is 'benchmark' (values: metric, benchmark)
+    --parallel <parallel>   The number of benchmarks to run in parallel, each pinned to a disjoint set of CPUs (Linux only). Default is 1.
+    --cpu-partitioning <cpu-partitioning>
+                          How CPUs are partitioned between parallel benchmarks, one of: ["cores", "cache", "numa"]. default is 'cores' (values: cores, cache, numa)
+    --stabilize             Run benchmarks in a stabilized measurement environment (Linux only): pinned to a single CPU,
+                          with memory locked, address space randomization disabled and the stack and heap pre-faulted.
+    --stabilize-cpu <stabilize-cpu>
+                          The CPU to pin benchmarks to with --stabilize (implies --stabilize). Default is an isolated CPU if available, else the last CPU.
+    --stabilize-realtime    Use SCHED_FIFO realtime scheduling with --stabilize (implies --stabilize), requires CAP_SYS_NICE
+    --allocation-profile    Attribute the allocations of the measured region to their call stacks with the jemalloc heap profiler
+                          (requires jemalloc built with --enable-prof), writing folded stacks and printing the top allocating stacks.
+    --allocation-profile-lg-sample <allocation-profile-lg-sample>
+                          The average interval between allocation samples as a power of two in bytes (implies --allocation-profile). Default is 10 (1 KiB).
+    --arc-types             Attribute the retains, releases and object allocations of the measured region to types,
+                          printing the top types by retain/release traffic and by allocations.
+    --cpu-profile           Sample the call stacks of the measured region with perf events (Linux only), writing folded stacks
+                          and printing the functions with the most samples.
+    --cpu-profile-frequency <cpu-profile-frequency>
+                          The number of call stack samples per second (implies --cpu-profile). Default is 999.
+    --record-history        Append the percentiles of the run to the history of each benchmark target in .benchmarkHistory,
+                          for change point detection with the history command.
+    --trace                 Record the values of each measured iteration in order, writing them as a columnar trace and as CSV,
+                          and flag the benchmarks whose samples are not independent.
+    --trace-capacity <trace-capacity>
+                          The number of iterations kept in the trace of each benchmark (implies --trace). Default is 65536.
+    --stream <stream>       Append the results of each benchmark to a file, FIFO or Unix socket as soon as it has run,
+                          one line per benchmark and metric.
+    --stream-format <stream-format>
+                          The format of the streamed results, one of: ["ndjson", "influx"]. default is 'ndjson' (values: ndjson, influx)
+    --binary-baselines      Store baselines as results.bmb in an indexed binary format instead of results.json,
+                          and prefer it when reading baselines.
     --benchmark-build-configuration <configuration>
                             Build configuration to build the benchmark targets with, one of: ["debug", "release"]. Default is "release". (values: debug, release)
     --xswiftc <xswiftc>     Pass an argument to the Swift compiler when building the benchmark
@@ -22,6 +22,7 @@ public enum Command: String, CaseIterable {
     case thresholds
     case help
     case `init`
+    case history
 }
 
 /// The benchmark data output format.
@@ -76,6 +77,7 @@ public enum BaselineOperation: String, CaseIterable {
     case update
     case list
     case delete
+    case convert
     case compare
     case check
 }
@@ -42,6 +42,30 @@ let availableMetrics = [
     "retainCount",
     "releaseCount",
     "retainReleaseDelta",
+    "cpuCycles",
+    "branchMisses",
+    "cacheMisses",
+    "l1dCacheMisses",
+    "dTLBMisses",
+    "instructionsPerCycle",
+    "cacheMissesPerKiloInstructions",
+    "branchMissesPerKiloInstructions",
+    "futexSyscalls",
+    "epollWaitSyscalls",
+    "scalingEfficiency",
+    "bytesAllocated",
+    "bytesFreed",
+    "mallocThreadCacheFills",
+    "mallocThreadCacheFlushes",
+    "mallocSizeClass",
+    "growthExponent",
+    "minorPageFaults",
+    "majorPageFaults",
+    "proportionalResidentMemory",
+    "anonymousResidentMemory",
+    "runQueueDelay",
+    "offCPUTime",
+    "timeslices",
     "custom",
 ]
 
@@ -65,11 +89,13 @@ struct Benchmark: AsyncParsableCommand {
             swift package benchmark baseline read <baseline> [<baseline2> ... <baselineN>] [<options>]
             swift package benchmark baseline update <baseline> [<options>]
             swift package benchmark baseline delete <baseline> [<baseline2> ... <baselineN>] [<options>]
+            swift package benchmark baseline convert [<baseline> ... <baselineN>] [<options>]
             swift package benchmark baseline check <baseline> [<otherBaseline>] [<options>]
             swift package benchmark baseline compare <baseline> [<otherBaseline>] [<options>]
             swift package benchmark thresholds read [<options>]
             swift package benchmark thresholds update [<baseline>] [<options>]
             swift package benchmark thresholds check [<baseline>] [<options>]
+            swift package benchmark history [<options>]
             swift package benchmark help
             """,
         discussion: """
@@ -173,6 +199,132 @@ struct Benchmark: AsyncParsableCommand {
     )
     var grouping: Grouping
 
+    @Option(
+        name: .long,
+        help: "The number of benchmarks to run in parallel, each pinned to a disjoint set of CPUs (Linux only). Default is 1."
+    )
+    var parallel: Int
+
+    @Option(
+        name: .long,
+        help:
+            "How CPUs are partitioned between parallel benchmarks, one of: [\"cores\", \"cache\", \"numa\"]. default is 'cores'"
+    )
+    var cpuPartitioning: String
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Run benchmarks in a stabilized measurement environment (Linux only): pinned to a single CPU,
+            with memory locked, address space randomization disabled and the stack and heap pre-faulted.
+            """
+    )
+    var stabilize: Int
+
+    @Option(
+        name: .long,
+        help: "The CPU to pin benchmarks to with --stabilize (implies --stabilize). Default is an isolated CPU if available, else the last CPU."
+    )
+    var stabilizeCpu: Int
+
+    @Flag(name: .long, help: "Use SCHED_FIFO realtime scheduling with --stabilize (implies --stabilize), requires CAP_SYS_NICE")
+    var stabilizeRealtime: Int
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Attribute the allocations of the measured region to their call stacks with the jemalloc heap profiler
+            (requires jemalloc built with --enable-prof), writing folded stacks and printing the top allocating stacks.
+            """
+    )
+    var allocationProfile: Int
+
+    @Option(
+        name: .long,
+        help: "The average interval between allocation samples as a power of two in bytes (implies --allocation-profile). Default is 10 (1 KiB)."
+    )
+    var allocationProfileLgSample: Int
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Attribute the retains, releases and object allocations of the measured region to types,
+            printing the top types by retain/release traffic and by allocations.
+            """
+    )
+    var arcTypes: Int
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Sample the call stacks of the measured region with perf events (Linux only), writing folded stacks
+            and printing the functions with the most samples.
+            """
+    )
+    var cpuProfile: Int
+
+    @Option(
+        name: .long,
+        help: "The number of call stack samples per second (implies --cpu-profile). Default is 999."
+    )
+    var cpuProfileFrequency: Int
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Append the percentiles of the run to the history of each benchmark target in .benchmarkHistory,
+            for change point detection with the history command.
+            """
+    )
+    var recordHistory: Int
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Record the values of each measured iteration in order, writing them as a columnar trace and as CSV,
+            and flag the benchmarks whose samples are not independent.
+            """
+    )
+    var trace: Int
+
+    @Option(
+        name: .long,
+        help: "The number of iterations kept in the trace of each benchmark (implies --trace). Default is 65536."
+    )
+    var traceCapacity: Int
+
+    @Option(
+        name: .long,
+        help:
+            """
+            Append the results of each benchmark to a file, FIFO or Unix socket as soon as it has run,
+            one line per benchmark and metric.
+            """
+    )
+    var stream: String
+
+    @Option(
+        name: .long,
+        help: "The format of the streamed results, one of: [\"ndjson\", \"influx\"]. default is 'ndjson'"
+    )
+    var streamFormat: String
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Store baselines as results.bmb in an indexed binary format instead of results.json,
+            and prefer it when reading baselines.
+            """
+    )
+    var binaryBaselines: Int
+
     @Option(name: .long, help: "Pass an argument to the Swift compiler when building the benchmark")
     var Xswiftc: String
 
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2023 Ordo One AB
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Attribution of retains, releases and object allocations to types, see ARCStatsProducer in the benchmark process
+
+import Benchmark
+import Foundation
+import TextTable
+
+private let storedTypes = 100 // per benchmark and ordering in baselines
+private let printedTypes = 10
+
+private struct ARCTypeEntry {
+    var retains: Int
+    var releases: Int
+    var allocations: Int
+    var share: String
+    var type: String
+}
+
+extension BenchmarkTool {
+    // Reads the profiles written by the benchmark processes, keeping the top types of each benchmark
+    func readARCTypeProfiles(_ benchmarks: [Benchmark]) -> [BenchmarkIdentifier: BenchmarkARCTypeProfile] {
+        var profiles: [BenchmarkIdentifier: BenchmarkARCTypeProfile] = [:]
+
+        for benchmark in benchmarks {
+            let fileName = BenchmarkARCTypeProfile.fileName(target: benchmark.target, name: benchmark.name)
+
+            guard let data = FileManager.default.contents(atPath: "\(profileDirectory)/\(fileName)"),
+                let profile = try? JSONDecoder().decode(BenchmarkARCTypeProfile.self, from: data)
+            else {
+                print("No ARC type profile for \(benchmark.target):\(benchmark.name)")
+                continue
+            }
+
+            profiles[benchmark.benchmarkIdentifier] = profile.top(storedTypes)
+        }
+
+        return profiles
+    }
+
+    // Prints the types with the most retain/release traffic, and the types with the most object allocations
+    func prettyPrintARCTypeProfiles(_ baseline: BenchmarkBaseline) {
+        guard let arcTypeProfiles = baseline.arcTypeProfiles else {
+            return
+        }
+
+        let trafficTable = TextTable<ARCTypeEntry> {
+            [
+                Column(title: "Retains", value: "\($0.retains)", width: 14, align: .right),
+                Column(title: "Releases", value: "\($0.releases)", width: 14, align: .right),
+                Column(title: "%", value: $0.share, width: 7, align: .right),
+                Column(title: "Allocations", value: "\($0.allocations)", width: 14, align: .right),
+                Column(title: "Type", value: $0.type, width: 80, align: .left),
+            ]
+        }
+
+        let allocationsTable = TextTable<ARCTypeEntry> {
+            [
+                Column(title: "Allocations", value: "\($0.allocations)", width: 14, align: .right),
+                Column(title: "%", value: $0.share, width: 7, align: .right),
+                Column(title: "Retains", value: "\($0.retains)", width: 14, align: .right),
+                Column(title: "Releases", value: "\($0.releases)", width: 14, align: .right),
+                Column(title: "Type", value: $0.type, width: 80, align: .left),
+            ]
+        }
+
+        for identifier in arcTypeProfiles.keys.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let profile = arcTypeProfiles[identifier]!
+
+            func entry(_ type: BenchmarkARCTypeProfile.Entry, share: Int, total: Int) -> ARCTypeEntry {
+                ARCTypeEntry(
+                    retains: type.retains,
+                    releases: type.releases,
+                    allocations: type.allocations,
+                    share: String(format: "%.1f", 100.0 * Double(share) / Double(max(total, 1))),
+                    type: type.type.count > 80 ? String(type.type.prefix(79)) + "…" : type.type
+                )
+            }
+
+            let trafficEntries = profile.types.prefix(printedTypes)
+                .filter { $0.traffic > 0 }
+                .map { entry($0, share: $0.traffic, total: profile.totalTraffic) }
+            let allocationEntries = profile.typesByAllocations.prefix(printedTypes)
+                .map { entry($0, share: $0.allocations, total: profile.totalAllocations) }
+
+            for (title, table, entries) in [
+                ("top types by retain/release traffic", trafficTable, trafficEntries),
+                ("top types by object allocations", allocationsTable, allocationEntries),
+            ] where entries.isEmpty == false {
+                print("")
+                if format == .markdown {
+                    print("### ", terminator: "")
+                }
+                print("\(identifier.target):\(identifier.name) \(title)")
+                if format == .markdown {
+                    print("")
+                }
+                table.print(entries, style: format.tableStyle)
+            }
+        }
+    }
+}
@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Allocation call site attribution with the jemalloc heap profiler, see AllocationProfiler in the benchmark process
+
+import Benchmark
+import BenchmarkShared
+import Foundation
+import TextTable
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+private let storedAllocationSites = 100 // per benchmark in baselines, the folded stacks written have all sites
+private let printedAllocationSites = 10
+
+// The allocator entry points, skipped when describing where an allocation was made
+private let allocationEntryPoints = [
+    "malloc", "calloc", "realloc", "free", "posix_memalign", "aligned_alloc", "swift_slowAlloc", "swift_allocObject",
+]
+
+private struct AllocationSiteEntry {
+    var allocations: String
+    var share: String
+    var bytes: String
+    var site: String
+}
+
+private struct AllocationSiteDeltaEntry {
+    var delta: Int
+    var reference: Int
+    var comparison: Int
+    var site: String
+}
+
+extension BenchmarkTool {
+    // Shared by all copies of the tool when running in parallel, the benchmark processes write their
+    // allocation and ARC type profiles here
+    var profileDirectory: String {
+        FileManager.default.temporaryDirectory.appendingPathComponent("benchmark-profiles-\(getpid())").path
+    }
+
+    func createProfileDirectory() throws {
+        try FileManager.default.createDirectory(atPath: profileDirectory, withIntermediateDirectories: true)
+    }
+
+    func removeProfileDirectory() {
+        try? FileManager.default.removeItem(atPath: profileDirectory)
+    }
+
+    // Enables profiling at startup with sampling inactive, the benchmark process activates it for the measured region.
+    // Accumulated counts (prof_accum) are needed, as the allocations of interest are usually freed by the end.
+    func allocationProfileEnvironment() -> [String] {
+        var options = "prof:true,prof_active:false,prof_accum:true,lg_prof_sample:\(allocationProfileLgSample)"
+        if let mallocConf = getenv("MALLOC_CONF"), strlen(mallocConf) > 0 {
+            options = "\(String(cString: mallocConf)),\(options)"
+        }
+        return ["\(allocationProfileEnvironmentVariable)=\(profileDirectory)", "MALLOC_CONF=\(options)"]
+    }
+
+    // Reads the profiles written by the benchmark processes and writes them as folded stacks,
+    // returning the top allocation sites of each benchmark for storing in the baseline.
+    func readAllocationProfiles(_ benchmarks: [Benchmark]) -> [BenchmarkIdentifier: BenchmarkAllocationProfile] {
+        var profiles: [BenchmarkIdentifier: BenchmarkAllocationProfile] = [:]
+
+        for benchmark in benchmarks {
+            let fileName = BenchmarkAllocationProfile.fileName(target: benchmark.target, name: benchmark.name)
+            let path = "\(profileDirectory)/\(fileName)"
+
+            guard let data = FileManager.default.contents(atPath: path),
+                let profile = try? JSONDecoder().decode(BenchmarkAllocationProfile.self, from: data)
+            else {
+                print("No allocation profile for \(benchmark.target):\(benchmark.name)")
+                continue
+            }
+
+            let baseName = cleanupStringForShellSafety("\(benchmark.target).\(benchmark.name)")
+            do {
+                try write(exportData: profile.folded(\.allocations), fileName: "\(baseName).allocations.folded")
+                try write(exportData: profile.folded(\.bytes), fileName: "\(baseName).bytes.folded")
+            } catch {
+                print("Failed to write folded stacks for \(benchmark.target):\(benchmark.name): \(error)")
+            }
+
+            profiles[benchmark.benchmarkIdentifier] = profile.top(storedAllocationSites)
+        }
+
+        return profiles
+    }
+
+    // The innermost frame that isn't the allocator itself
+    private func siteDescription(_ stack: [String], width: Int = 80) -> String {
+        let frame = stack.last { frame in
+            allocationEntryPoints.contains { frame == $0 || frame.hasPrefix("\($0)(") } == false
+        } ?? stack.last ?? "<unknown>"
+        return frame.count > width ? String(frame.prefix(width - 1)) + "…" : frame
+    }
+
+    private func printAllocationProfileHeader(_ title: String) {
+        print("")
+        if format == .markdown {
+            print("### ", terminator: "")
+        }
+        print(title)
+        if format == .markdown {
+            print("")
+        }
+    }
+
+    // Prints the top allocating call sites of each profiled benchmark
+    func prettyPrintAllocationProfiles(_ baseline: BenchmarkBaseline) {
+        guard let allocationProfiles = baseline.allocationProfiles else {
+            return
+        }
+
+        let table = TextTable<AllocationSiteEntry> {
+            [
+                Column(title: "Allocations", value: $0.allocations, width: 14, align: .right),
+                Column(title: "%", value: $0.share, width: 7, align: .right),
+                Column(title: "Bytes", value: $0.bytes, width: 14, align: .right),
+                Column(title: "Allocation site", value: $0.site, width: 80, align: .left),
+            ]
+        }
+
+        for identifier in allocationProfiles.keys.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let profile = allocationProfiles[identifier]!
+            let totalAllocations = max(profile.totalAllocations, 1)
+
+            let entries = profile.sites.prefix(printedAllocationSites).map { site in
+                AllocationSiteEntry(
+                    allocations: "\(site.allocations)",
+                    share: String(format: "%.1f", 100.0 * Double(site.allocations) / Double(totalAllocations)),
+                    bytes: "\(site.bytes)",
+                    site: siteDescription(site.stack)
+                )
+            }
+
+            printAllocationProfileHeader(
+                "\(identifier.target):\(identifier.name) top allocation sites (sampled every ~\(profile.sampleInterval) bytes)"
+            )
+            table.print(entries, style: format.tableStyle)
+        }
+    }
+
+    // Prints the allocation sites with the largest change in allocations between two baselines, and writes
+    // the differential folded stacks ("stack reference comparison") for a differential flame graph.
+    func prettyPrintAllocationProfileDelta(currentBaseline: BenchmarkBaseline, baseline: BenchmarkBaseline) {
+        guard let referenceProfiles = currentBaseline.allocationProfiles,
+            let comparisonProfiles = baseline.allocationProfiles
+        else {
+            return
+        }
+
+        let table = TextTable<AllocationSiteDeltaEntry> {
+            [
+                Column(title: "Δ Allocations", value: "\($0.delta > 0 ? "+" : "")\($0.delta)", width: 14, align: .right),
+                Column(title: currentBaseline.baselineName, value: "\($0.reference)", width: 14, align: .right),
+                Column(title: baseline.baselineName, value: "\($0.comparison)", width: 14, align: .right),
+                Column(title: "Allocation site", value: $0.site, width: 80, align: .left),
+            ]
+        }
+
+        let identifiers = Set(referenceProfiles.keys).intersection(comparisonProfiles.keys)
+
+        for identifier in identifiers.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            var sites: [String: (stack: [String], reference: Int, comparison: Int)] = [:]
+
+            for site in referenceProfiles[identifier]!.sites {
+                sites[site.foldedStack, default: (site.stack, 0, 0)].reference += site.allocations
+            }
+            for site in comparisonProfiles[identifier]!.sites {
+                sites[site.foldedStack, default: (site.stack, 0, 0)].comparison += site.allocations
+            }
+
+            let differential = sites.keys.sorted()
+                .map { "\($0) \(sites[$0]!.reference) \(sites[$0]!.comparison)\n" }
+                .joined()
+            let baseName = cleanupStringForShellSafety("\(identifier.target).\(identifier.name)")
+            do {
+                try write(exportData: differential, fileName: "\(baseName).allocations.diff.folded")
+            } catch {
+                print("Failed to write differential folded stacks for \(identifier.target):\(identifier.name): \(error)")
+            }
+
+            let entries = sites.values
+                .filter { $0.comparison != $0.reference }
+                .sorted { abs($0.comparison - $0.reference) > abs($1.comparison - $1.reference) }
+                .prefix(printedAllocationSites)
+                .map { site in
+                    AllocationSiteDeltaEntry(
+                        delta: site.comparison - site.reference,
+                        reference: site.reference,
+                        comparison: site.comparison,
+                        site: siteDescription(site.stack)
+                    )
+                }
+
+            guard entries.isEmpty == false else {
+                continue
+            }
+
+            printAllocationProfileHeader("\(identifier.target):\(identifier.name) allocation site changes")
+            table.print(entries, style: format.tableStyle)
+        }
+    }
+}
@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Binary storage of baselines, see BenchmarkResultStore for the format
+
+import Benchmark
+import Foundation
+import SystemPackage
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+let binaryBaselineExtension = "bmb"
+
+extension BenchmarkBaseline {
+    // The results are stored as records of the store, everything else as JSON in its metadata
+    func encodeBinary() throws -> [UInt8] {
+        var metadata = self
+        metadata.results = [:]
+
+        return try BenchmarkResultStore.encode(
+            metadata: Array(try JSONEncoder().encode(metadata)),
+            results: benchmarkIdentifiers.map { (target: $0.target, name: $0.name, results: results[$0] ?? []) }
+        )
+    }
+
+    // Decodes only the results `including` accepts
+    static func decodeBinary(
+        _ bytes: UnsafeRawBufferPointer,
+        including: (BenchmarkIdentifier, BenchmarkMetric) -> Bool
+    ) throws -> BenchmarkBaseline {
+        let reader = try BenchmarkResultStore.Reader(bytes)
+        var baseline = try JSONDecoder().decode(BenchmarkBaseline.self, from: Data(reader.metadata))
+
+        for entry in reader.index {
+            let identifier = BenchmarkIdentifier(target: entry.target, name: entry.name)
+            if including(identifier, entry.metric) {
+                baseline.results[identifier, default: []].append(try reader.result(entry))
+            }
+        }
+
+        return baseline
+    }
+}
+
+extension BenchmarkTool {
+    // Maps the baseline stored at `path` and decodes it, nil if there is no such file
+    func readBinaryBaseline(
+        _ path: FilePath,
+        including: (BenchmarkIdentifier, BenchmarkMetric) -> Bool
+    ) throws -> BenchmarkBaseline? {
+        let fd: FileDescriptor
+        do {
+            fd = try FileDescriptor.open(path, .readOnly)
+        } catch Errno.noSuchFileOrDirectory {
+            return nil
+        }
+
+        return try fd.closeAfter {
+            var status = stat()
+            guard fstat(fd.rawValue, &status) == 0 else {
+                throw Errno(rawValue: errno)
+            }
+
+            let size = Int(status.st_size)
+            guard size > 0 else {
+                throw BenchmarkResultStoreError.truncated
+            }
+
+            // Only the pages of the index and of the included records are read from disk
+            guard let address = mmap(nil, size, PROT_READ, MAP_PRIVATE, fd.rawValue, 0),
+                address != UnsafeMutableRawPointer(bitPattern: -1)
+            else {
+                throw Errno(rawValue: errno)
+            }
+            defer {
+                munmap(address, size)
+            }
+
+            let bytes = UnsafeRawBufferPointer(start: address, count: size)
+            return try BenchmarkBaseline.decodeBinary(bytes, including: including)
+        }
+    }
+
+    // Accepts the results of the benchmarks and metrics selected on the command line, so that only
+    // those are decoded from the stored baselines
+    func includedInBaselines(_ identifier: BenchmarkIdentifier, _ metric: BenchmarkMetric) -> Bool {
+        if metrics.isEmpty == false, metrics.contains(metric) == false {
+            return false
+        }
+
+        // Filters match the name without tags when running, and the name with tags when checking
+        var baseName = identifier.name
+        if baseName.hasSuffix(")"), let tags = baseName.range(of: " (", options: .backwards) {
+            baseName = String(baseName[..<tags.lowerBound])
+        }
+
+        return (try? shouldIncludeBenchmark(identifier.name) || shouldIncludeBenchmark(baseName)) ?? true
+    }
+
+    // Migrates the stored JSON baselines to the binary format used with --binary-baselines, all of them unless
+    // baselines are specified. The JSON files are removed once the binary files read back.
+    func convertBaselines() {
+        var storagePath = FilePath(baselineStoragePath)
+        storagePath.append(baselinesDirectory) // package/.benchmarkBaselines
+
+        // Collected up front, as converting adds files to the directories
+        func entries(_ path: FilePath) -> [FilePath] {
+            path.directoryEntries.filter { $0.ends(with: ".") == false && $0.ends(with: "..") == false }
+        }
+
+        var converted = 0
+
+        for targetPath in entries(storagePath) {
+            for baselinePath in entries(targetPath) {
+                guard let baselineName = baselinePath.lastComponent?.description,
+                    baseline.isEmpty || baseline.contains(baselineName)
+                else {
+                    continue
+                }
+
+                for jsonPath in entries(baselinePath) where jsonPath.extension == "json" {
+                    guard jsonPath.stem?.hasSuffix("results") == true else {
+                        continue
+                    }
+                    guard let jsonBaseline = readJSONBaseline(jsonPath) else {
+                        print("Failed to convert \(jsonPath)")
+                        continue
+                    }
+
+                    var binaryPath = jsonPath
+                    binaryPath.extension = binaryBaselineExtension
+
+                    do {
+                        // write(baseline:to:) reports failures itself, only remove the JSON once it reads back
+                        try write(baseline: jsonBaseline, to: binaryPath)
+                        guard try readBinaryBaseline(binaryPath, including: { _, _ in true }) != nil else {
+                            print("Failed to convert \(jsonPath)")
+                            return
+                        }
+                        try FileManager.default.removeItem(atPath: jsonPath.description)
+                        print("Converted \(jsonPath) to \(binaryPath.lastComponent!)")
+                        converted += 1
+                    } catch {
+                        print("Failed to convert \(jsonPath), error \(String(reflecting: error))")
+                        print("Give benchmark plugin permissions to write files by running with e.g.:")
+                        print("")
+                        print("swift package --allow-writing-to-package-directory benchmark baseline convert")
+                        print("")
+                        return
+                    }
+                }
+            }
+        }
+
+        print("Converted \(converted) baseline file\(converted == 1 ? "" : "s").")
+    }
+}
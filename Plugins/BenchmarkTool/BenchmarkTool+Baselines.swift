@@ -24,13 +24,82 @@ import Musl
 #error("Unsupported Platform")
 #endif
 
+// The conditions the benchmarks were measured under, results taken under different
+// conditions may differ without any change to the code being benchmarked.
+struct BenchmarkMeasurementEnvironment: Codable, Equatable, CustomStringConvertible {
+    var stabilized: Bool // true if run with the --stabilize profile
+    var cpu: Int? // the CPU the benchmark processes were pinned to
+    var realtimeScheduling: Bool // SCHED_FIFO
+    var governor: String? // the cpufreq scaling governor of the CPU
+    var isolatedCPU: Bool? // true if the CPU is excluded from general scheduling (isolcpus)
+    var smtActive: Bool? // true if simultaneous multithreading is enabled
+
+    var description: String {
+        var settings: [String] = []
+        if stabilized {
+            settings.append(cpu.map { "stabilized on CPU \($0)" } ?? "stabilized")
+        }
+        if realtimeScheduling {
+            settings.append("SCHED_FIFO")
+        }
+        settings.append("governor '\(governor ?? "unknown")'")
+        if let isolatedCPU {
+            settings.append(isolatedCPU ? "isolated" : "not isolated")
+        }
+        if let smtActive {
+            settings.append(smtActive ? "SMT active" : "SMT inactive")
+        }
+        return settings.joined(separator: ", ")
+    }
+
+    // Human readable descriptions of the settings that differ from `other`
+    func differences(from other: BenchmarkMeasurementEnvironment) -> [String] {
+        var differences: [String] = []
+
+        func describe<T>(_ value: T?) -> String {
+            value.map { "\($0)" } ?? "unknown"
+        }
+
+        if stabilized != other.stabilized {
+            differences.append("stabilized \(stabilized) vs \(other.stabilized)")
+        }
+        if cpu != other.cpu {
+            differences.append("pinned to CPU \(describe(cpu)) vs \(describe(other.cpu))")
+        }
+        if realtimeScheduling != other.realtimeScheduling {
+            differences.append("realtime scheduling \(realtimeScheduling) vs \(other.realtimeScheduling)")
+        }
+        if governor != other.governor {
+            differences.append("governor \(describe(governor)) vs \(describe(other.governor))")
+        }
+        if isolatedCPU != other.isolatedCPU {
+            differences.append("isolated CPU \(describe(isolatedCPU)) vs \(describe(other.isolatedCPU))")
+        }
+        if smtActive != other.smtActive {
+            differences.append("SMT active \(describe(smtActive)) vs \(describe(other.smtActive))")
+        }
+
+        return differences
+    }
+}
+
 struct BenchmarkMachine: Codable, Equatable {
-    init(hostname: String, processors: Int, processorType: String, memory: Int, kernelVersion: String) {
+    init(
+        hostname: String,
+        processors: Int,
+        processorType: String,
+        memory: Int,
+        kernelVersion: String,
+        environment: BenchmarkMeasurementEnvironment? = nil,
+        cacheLevels: [BenchmarkCacheLevel]? = nil
+    ) {
         self.hostname = hostname
         self.processors = processors
         self.processorType = processorType
         self.memory = memory
         self.kernelVersion = kernelVersion
+        self.environment = environment
+        self.cacheLevels = cacheLevels
     }
 
     var hostname: String
@@ -38,6 +107,17 @@ struct BenchmarkMachine: Codable, Equatable {
     var processorType: String // e.g. arm64e
     var memory: Int // in GB
     var kernelVersion: String
+    var environment: BenchmarkMeasurementEnvironment? // not stored in baselines from older versions
+    var cacheLevels: [BenchmarkCacheLevel]? // data caches and TLB reach, smallest first, where known
+
+    // Differences in measurement environment, compared separately from the machine configuration
+    func environmentDifferences(from other: BenchmarkMachine) -> [String] {
+        guard let environment, let otherEnvironment = other.environment else {
+            let known = environment ?? other.environment
+            return known?.stabilized == true ? ["measurement environment not recorded for one baseline"] : []
+        }
+        return environment.differences(from: otherEnvironment)
+    }
 
     public static func == (lhs: BenchmarkMachine, rhs: BenchmarkMachine) -> Bool {
         lhs.processors == rhs.processors && lhs.processorType == rhs.processorType && lhs.memory == rhs.memory
@@ -84,10 +164,28 @@ struct BenchmarkBaseline: Codable {
         var metrics: BenchmarkResult
     }
 
-    init(baselineName: String, machine: BenchmarkMachine, results: [BenchmarkIdentifier: [BenchmarkResult]]) {
+    init(
+        baselineName: String,
+        machine: BenchmarkMachine,
+        results: [BenchmarkIdentifier: [BenchmarkResult]],
+        cpuSets: [BenchmarkIdentifier: [Int]]? = nil,
+        durations: [BenchmarkIdentifier: Double]? = nil,
+        allocationProfiles: [BenchmarkIdentifier: BenchmarkAllocationProfile]? = nil,
+        arcTypeProfiles: [BenchmarkIdentifier: BenchmarkARCTypeProfile]? = nil,
+        cpuProfiles: [BenchmarkIdentifier: BenchmarkCPUProfile]? = nil,
+        traceSummaries: [BenchmarkIdentifier: [String: BenchmarkTraceSummary]]? = nil,
+        complexityFits: [BenchmarkIdentifier: BenchmarkComplexityFit]? = nil
+    ) {
         self.baselineName = baselineName
         self.machine = machine
         self.results = results
+        self.cpuSets = cpuSets
+        self.durations = durations
+        self.allocationProfiles = allocationProfiles
+        self.arcTypeProfiles = arcTypeProfiles
+        self.cpuProfiles = cpuProfiles
+        self.traceSummaries = traceSummaries
+        self.complexityFits = complexityFits
     }
 
     //    @discardableResult
@@ -95,7 +193,31 @@ struct BenchmarkBaseline: Codable {
         if machine != otherBaseline.machine {
             print("Warning: Merging baselines from two different machine configurations")
         }
+        if machine.environmentDifferences(from: otherBaseline.machine).isEmpty == false {
+            print("Warning: Merging baselines measured in different environments")
+        }
         results.merge(otherBaseline.results) { first, _ in first }
+        if let otherCPUSets = otherBaseline.cpuSets {
+            cpuSets = (cpuSets ?? [:]).merging(otherCPUSets) { first, _ in first }
+        }
+        if let otherDurations = otherBaseline.durations {
+            durations = (durations ?? [:]).merging(otherDurations) { first, _ in first }
+        }
+        if let otherAllocationProfiles = otherBaseline.allocationProfiles {
+            allocationProfiles = (allocationProfiles ?? [:]).merging(otherAllocationProfiles) { first, _ in first }
+        }
+        if let otherARCTypeProfiles = otherBaseline.arcTypeProfiles {
+            arcTypeProfiles = (arcTypeProfiles ?? [:]).merging(otherARCTypeProfiles) { first, _ in first }
+        }
+        if let otherCPUProfiles = otherBaseline.cpuProfiles {
+            cpuProfiles = (cpuProfiles ?? [:]).merging(otherCPUProfiles) { first, _ in first }
+        }
+        if let otherTraceSummaries = otherBaseline.traceSummaries {
+            traceSummaries = (traceSummaries ?? [:]).merging(otherTraceSummaries) { first, _ in first }
+        }
+        if let otherComplexityFits = otherBaseline.complexityFits {
+            complexityFits = (complexityFits ?? [:]).merging(otherComplexityFits) { first, _ in first }
+        }
 
         return self
     }
@@ -103,6 +225,13 @@ struct BenchmarkBaseline: Codable {
     var baselineName: String
     var machine: BenchmarkMachine
     var results: BenchmarkResultsByIdentifier
+    var cpuSets: [BenchmarkIdentifier: [Int]]? // the CPUs each benchmark was pinned to, if run in parallel
+    var durations: [BenchmarkIdentifier: Double]? // wall clock seconds for running each benchmark process
+    var allocationProfiles: [BenchmarkIdentifier: BenchmarkAllocationProfile]? // top allocating stacks, if profiled
+    var arcTypeProfiles: [BenchmarkIdentifier: BenchmarkARCTypeProfile]? // top retained/allocated types, if profiled
+    var cpuProfiles: [BenchmarkIdentifier: BenchmarkCPUProfile]? // sampled stacks, the top ones when stored, if profiled
+    var traceSummaries: [BenchmarkIdentifier: [String: BenchmarkTraceSummary]]? // by traced metric, if traced
+    var complexityFits: [BenchmarkIdentifier: BenchmarkComplexityFit]? // fitted per size sweep, keyed without the size
 
     var benchmarkIdentifiers: [BenchmarkIdentifier] {
         Array(results.keys).sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) })
@@ -265,6 +394,9 @@ extension BenchmarkTool {
          we by default store results in 'results.json', otherwise we will use the environment variable
          or command line to optionally specify a 'hostIdentifier' that allow for separation between
          different hosts if checking in baselines in repos.
+
+         With --binary-baselines the results are stored as 'results.bmb' instead, in the indexed binary
+         format of BenchmarkResultStore. Both formats are read, preferring the one written.
         
          .benchmarkBaselines
          ├── target1
@@ -297,12 +429,14 @@ extension BenchmarkTool {
 
         outputPath.append(subPath.components)
 
-        if let hostIdentifier {
-            outputPath.append("\(hostIdentifier).results.json")
-        } else {
-            outputPath.append("results.json")
-        }
+        let resultsFileName = hostIdentifier.map { "\($0).results" } ?? "results"
+        outputPath.append("\(resultsFileName).\(binaryBaselines ? binaryBaselineExtension : "json")")
+
+        try write(baseline: baseline, to: outputPath)
+    }
 
+    // Writes the baseline in the binary format if the path has its extension, otherwise as JSON
+    func write(baseline: BenchmarkBaseline, to outputPath: FilePath) throws {
         // Write out benchmark baselines
         do {
             let fd = try FileDescriptor.open(
@@ -315,7 +449,12 @@ extension BenchmarkTool {
             do {
                 try fd.closeAfter {
                     do {
-                        let bytesArray = try JSONEncoder().encode(baseline)
+                        let bytesArray: [UInt8]
+                        if outputPath.extension == binaryBaselineExtension {
+                            bytesArray = try baseline.encodeBinary()
+                        } else {
+                            bytesArray = Array(try JSONEncoder().encode(baseline))
+                        }
 
                         try bytesArray.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
                             _ = try fd.write(bytes)
@@ -344,10 +483,13 @@ extension BenchmarkTool {
         }
     }
 
+    // Reads a stored baseline, with only the results `including` accepts. Results in the binary format
+    // are decoded lazily, so the histograms of the results not included are never decoded.
     func read(
         hostIdentifier: String? = nil,
         target: String,
-        baselineIdentifier: String? = nil
+        baselineIdentifier: String? = nil,
+        including: (BenchmarkIdentifier, BenchmarkMetric) -> Bool = { _, _ in true }
     ) throws -> BenchmarkBaseline? {
         var path = FilePath(baselineStoragePath)
         path.append(baselinesDirectory) // package/.benchmarkBaselines
@@ -359,12 +501,43 @@ extension BenchmarkTool {
             path.append("default") // // package/.benchmarkBaselines/myTarget1/default
         }
 
-        if let hostIdentifier {
-            path.append("\(hostIdentifier).results.json")
-        } else {
-            path.append("results.json")
+        let resultsFileName = hostIdentifier.map { "\($0).results" } ?? "results"
+        var binaryPath = path
+        binaryPath.append("\(resultsFileName).\(binaryBaselineExtension)")
+        path.append("\(resultsFileName).json")
+
+        // Both formats may be stored under the same name, the one written with the current options is preferred
+        if binaryBaselines == false, let baseline = readJSONBaseline(path, including: including) {
+            return baseline
         }
 
+        do {
+            if let baseline = try readBinaryBaseline(binaryPath, including: including) {
+                return baseline
+            }
+        } catch {
+            print("Failed to read \(binaryPath) [\(String(reflecting: error))]")
+            return nil
+        }
+
+        return binaryBaselines ? readJSONBaseline(path, including: including) : nil
+    }
+
+    func readJSONBaseline(
+        _ path: FilePath,
+        including: (BenchmarkIdentifier, BenchmarkMetric) -> Bool
+    ) -> BenchmarkBaseline? {
+        guard var baseline = readJSONBaseline(path) else {
+            return nil
+        }
+        for (identifier, results) in baseline.results {
+            let included = results.filter { including(identifier, $0.metric) }
+            baseline.results[identifier] = included.isEmpty ? nil : included
+        }
+        return baseline
+    }
+
+    func readJSONBaseline(_ path: FilePath) -> BenchmarkBaseline? {
         var baseline: BenchmarkBaseline?
 
         // Read from the file
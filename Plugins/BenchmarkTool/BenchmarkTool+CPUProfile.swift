@@ -0,0 +1,215 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Sampled call stacks of the measured region, see CPUProfiler in the benchmark process
+
+import Benchmark
+import Foundation
+import SystemPackage
+import TextTable
+
+let storedCPUStacks = 1_000 // per benchmark in baselines, the folded stacks written have all stacks
+private let printedFunctions = 10
+
+private struct CPUFunctionEntry {
+    var selfShare: String
+    var totalShare: String
+    var samples: Int
+    var function: String
+}
+
+private struct CPUFunctionDeltaEntry {
+    var delta: Double
+    var reference: Double
+    var comparison: Double
+    var function: String
+}
+
+extension BenchmarkTool {
+    // Reads the profiles written by the benchmark processes and writes them as folded stacks
+    func readCPUProfiles(_ benchmarks: [Benchmark]) -> [BenchmarkIdentifier: BenchmarkCPUProfile] {
+        var profiles: [BenchmarkIdentifier: BenchmarkCPUProfile] = [:]
+
+        for benchmark in benchmarks {
+            let fileName = BenchmarkCPUProfile.fileName(target: benchmark.target, name: benchmark.name)
+
+            guard let data = FileManager.default.contents(atPath: "\(profileDirectory)/\(fileName)"),
+                let profile = try? JSONDecoder().decode(BenchmarkCPUProfile.self, from: data)
+            else {
+                print("No CPU profile for \(benchmark.target):\(benchmark.name)")
+                continue
+            }
+
+            let baseName = cleanupStringForShellSafety("\(benchmark.target).\(benchmark.name)")
+            do {
+                try write(exportData: profile.folded(), fileName: "\(baseName).cpu.folded")
+            } catch {
+                print("Failed to write folded stacks for \(benchmark.target):\(benchmark.name): \(error)")
+            }
+
+            profiles[benchmark.benchmarkIdentifier] = profile
+        }
+
+        return profiles
+    }
+
+    // Writes the folded stacks of each profiled benchmark of the target next to the stored baseline,
+    // package/.benchmarkBaselines/myTarget1/named1/myBenchmark.cpu.folded
+    func writeCPUProfiles(_ baseline: BenchmarkBaseline, baselineName: String, target: String) {
+        guard let cpuProfiles = baseline.cpuProfiles?.filter({ $0.key.target == target }), cpuProfiles.isEmpty == false
+        else {
+            return
+        }
+
+        var directory = FilePath(baselineStoragePath)
+        directory.append(baselinesDirectory)
+        directory.append(target)
+        directory.append(baselineName)
+
+        for (identifier, profile) in cpuProfiles {
+            var path = directory
+            path.append("\(cleanupStringForShellSafety(identifier.name)).cpu.folded")
+            do {
+                try profile.folded().write(toFile: path.description, atomically: true, encoding: .utf8)
+            } catch {
+                print("Failed to write folded stacks to \(path): \(error)")
+            }
+        }
+    }
+
+    private func functionDescription(_ name: String, width: Int = 80) -> String {
+        name.count > width ? String(name.prefix(width - 1)) + "…" : name
+    }
+
+    private func printCPUProfileHeader(_ title: String) {
+        print("")
+        if format == .markdown {
+            print("### ", terminator: "")
+        }
+        print(title)
+        if format == .markdown {
+            print("")
+        }
+    }
+
+    // Prints the functions with the most samples of each profiled benchmark
+    func prettyPrintCPUProfiles(_ baseline: BenchmarkBaseline) {
+        guard let cpuProfiles = baseline.cpuProfiles else {
+            return
+        }
+
+        let table = TextTable<CPUFunctionEntry> {
+            [
+                Column(title: "Self %", value: $0.selfShare, width: 8, align: .right),
+                Column(title: "Total %", value: $0.totalShare, width: 8, align: .right),
+                Column(title: "Samples", value: "\($0.samples)", width: 10, align: .right),
+                Column(title: "Function", value: $0.function, width: 80, align: .left),
+            ]
+        }
+
+        for identifier in cpuProfiles.keys.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let profile = cpuProfiles[identifier]!
+            let totalSamples = Double(max(profile.totalSamples, 1))
+
+            let entries = profile.functions().prefix(printedFunctions).map { function in
+                CPUFunctionEntry(
+                    selfShare: String(format: "%.1f", 100.0 * Double(function.selfSamples) / totalSamples),
+                    totalShare: String(format: "%.1f", 100.0 * Double(function.totalSamples) / totalSamples),
+                    samples: function.selfSamples,
+                    function: functionDescription(function.name)
+                )
+            }
+
+            guard entries.isEmpty == false else {
+                continue
+            }
+
+            printCPUProfileHeader(
+                "\(identifier.target):\(identifier.name) top functions (\(profile.totalSamples) samples at \(profile.frequency) Hz)"
+            )
+            table.print(entries, style: format.tableStyle)
+        }
+    }
+
+    // Prints the functions with the largest change in their share of the samples between two baselines,
+    // as the number of samples depends on how long each run was, and writes the differential folded
+    // stacks ("stack reference comparison") for a differential flame graph.
+    func prettyPrintCPUProfileDelta(currentBaseline: BenchmarkBaseline, baseline: BenchmarkBaseline) {
+        guard let referenceProfiles = currentBaseline.cpuProfiles,
+            let comparisonProfiles = baseline.cpuProfiles
+        else {
+            return
+        }
+
+        let table = TextTable<CPUFunctionDeltaEntry> {
+            [
+                Column(title: "Δ Self %", value: String(format: "%+.1f", $0.delta), width: 10, align: .right),
+                Column(title: currentBaseline.baselineName, value: String(format: "%.1f", $0.reference), width: 14, align: .right),
+                Column(title: baseline.baselineName, value: String(format: "%.1f", $0.comparison), width: 14, align: .right),
+                Column(title: "Function", value: $0.function, width: 80, align: .left),
+            ]
+        }
+
+        let identifiers = Set(referenceProfiles.keys).intersection(comparisonProfiles.keys)
+
+        for identifier in identifiers.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let reference = referenceProfiles[identifier]!
+            let comparison = comparisonProfiles[identifier]!
+
+            var stacks: [String: (reference: Int, comparison: Int)] = [:]
+            for stack in reference.stacks {
+                stacks[stack.foldedStack, default: (0, 0)].reference += stack.samples
+            }
+            for stack in comparison.stacks {
+                stacks[stack.foldedStack, default: (0, 0)].comparison += stack.samples
+            }
+
+            let differential = stacks.keys.sorted()
+                .map { "\($0) \(stacks[$0]!.reference) \(stacks[$0]!.comparison)\n" }
+                .joined()
+            let baseName = cleanupStringForShellSafety("\(identifier.target).\(identifier.name)")
+            do {
+                try write(exportData: differential, fileName: "\(baseName).cpu.diff.folded")
+            } catch {
+                print("Failed to write differential folded stacks for \(identifier.target):\(identifier.name): \(error)")
+            }
+
+            func shares(_ profile: BenchmarkCPUProfile) -> [String: Double] {
+                let totalSamples = Double(max(profile.totalSamples, 1))
+                return Dictionary(
+                    uniqueKeysWithValues: profile.functions().map { ($0.name, 100.0 * Double($0.selfSamples) / totalSamples) }
+                )
+            }
+
+            let referenceShares = shares(reference)
+            let comparisonShares = shares(comparison)
+
+            let entries = Set(referenceShares.keys).union(comparisonShares.keys)
+                .map { name in
+                    CPUFunctionDeltaEntry(
+                        delta: (comparisonShares[name] ?? 0) - (referenceShares[name] ?? 0),
+                        reference: referenceShares[name] ?? 0,
+                        comparison: comparisonShares[name] ?? 0,
+                        function: functionDescription(name)
+                    )
+                }
+                .filter { abs($0.delta) >= 0.1 }
+                .sorted { (abs($0.delta), $1.function) > (abs($1.delta), $0.function) }
+                .prefix(printedFunctions)
+
+            guard entries.isEmpty == false else {
+                continue
+            }
+
+            printCPUProfileHeader("\(identifier.target):\(identifier.name) CPU profile changes")
+            table.print(Array(entries), style: format.tableStyle)
+        }
+    }
+}
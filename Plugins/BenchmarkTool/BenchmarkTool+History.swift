@@ -0,0 +1,266 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Append-only history of benchmark runs, and detection of the runs where a metric changed
+
+import Benchmark
+import Foundation
+import SystemPackage
+import TextTable
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+let historyDirectory = ".benchmarkHistory"
+
+private let historyPercentileIndex = 2 // p50 of Statistics.defaultPercentilesToCalculate
+
+/// One line of .benchmarkHistory/<target>/history.jsonl per run
+struct BenchmarkHistoryEntry: Codable {
+    struct Result: Codable {
+        var name: String
+        var metric: BenchmarkMetric
+        var percentiles: [Int] // Statistics.defaultPercentilesToCalculate
+    }
+
+    var commit: String? // the git commit the run was made at, if run in a git repository
+    var timestamp: Double // seconds since 1970
+    var machine: BenchmarkMachine
+    var results: [Result]
+
+    var date: String {
+        ISO8601DateFormatter().string(from: Date(timeIntervalSince1970: timestamp))
+    }
+
+    // The commit, or the time of the run outside of git repositories
+    var key: String {
+        commit ?? date
+    }
+
+    // Runs on other kinds of machines aren't comparable
+    func isComparable(with other: BenchmarkHistoryEntry) -> Bool {
+        machine.hostname == other.machine.hostname && machine.processors == other.machine.processors
+            && machine.processorType == other.machine.processorType && machine.memory == other.machine.memory
+    }
+}
+
+private struct HistoryChangeEntry {
+    var benchmark: String
+    var metric: String
+    var key: String
+    var date: String
+    var runs: Int
+    var before: Int
+    var after: Int
+    var change: String
+}
+
+extension BenchmarkTool {
+    private func historyPath(target: String) -> FilePath {
+        var path = FilePath(baselineStoragePath)
+        path.append(historyDirectory) // package/.benchmarkHistory
+        path.append(FilePath.Component(target)!) // package/.benchmarkHistory/myTarget1
+        path.append("history.jsonl")
+        return path
+    }
+
+    // The abbreviated commit of the package, nil if it isn't a git repository
+    func currentCommit() -> String? {
+        let process = Process()
+        process.executableURL = URL(fileURLWithPath: "/usr/bin/env")
+        process.arguments = ["git", "-C", baselineStoragePath, "rev-parse", "--short=12", "HEAD"]
+        let output = Pipe()
+        process.standardOutput = output
+        process.standardError = FileHandle.nullDevice
+
+        do {
+            try process.run()
+        } catch {
+            return nil
+        }
+        let data = output.fileHandleForReading.readDataToEndOfFile()
+        process.waitUntilExit()
+
+        let commit = String(decoding: data, as: UTF8.self).trimmingCharacters(in: .whitespacesAndNewlines)
+        return process.terminationStatus == 0 && commit.isEmpty == false ? commit : nil
+    }
+
+    // Appends the percentiles of the run to the history of each target
+    func appendHistory(_ baseline: BenchmarkBaseline) {
+        let commit = currentCommit()
+        let timestamp = Date().timeIntervalSince1970
+
+        for target in baseline.targets {
+            let results = baseline.benchmarkIdentifiers.filter { $0.target == target }.flatMap { identifier in
+                (baseline.results[identifier] ?? []).map {
+                    BenchmarkHistoryEntry.Result(
+                        name: identifier.name,
+                        metric: $0.metric,
+                        percentiles: $0.statistics.percentiles()
+                    )
+                }
+            }
+            let entry = BenchmarkHistoryEntry(
+                commit: commit,
+                timestamp: timestamp,
+                machine: baseline.machine,
+                results: results
+            )
+
+            var subPath = FilePath()
+            subPath.append(historyDirectory)
+            subPath.append(target)
+            FilePath(baselineStoragePath).createSubPath(subPath)
+
+            let path = historyPath(target: target)
+            do {
+                var line = [UInt8](try JSONEncoder().encode(entry))
+                line.append(UInt8(ascii: "\n"))
+
+                let fd = try FileDescriptor.open(
+                    path,
+                    .writeOnly,
+                    options: [.append, .create],
+                    permissions: .ownerReadWrite
+                )
+                try fd.closeAfter {
+                    _ = try fd.writeAll(line)
+                }
+            } catch {
+                print("Failed to append to \(path) [\(String(reflecting: error))]")
+                if errno == EPERM {
+                    print("Give benchmark plugin permissions by running with e.g.:")
+                    print("")
+                    print("swift package --allow-writing-to-package-directory benchmark --record-history")
+                    print("")
+                }
+            }
+        }
+    }
+
+    func readHistory(target: String) -> [BenchmarkHistoryEntry] {
+        let path = historyPath(target: target)
+        guard let data = FileManager.default.contents(atPath: path.description) else {
+            return []
+        }
+
+        let decoder = JSONDecoder()
+        var skipped = 0
+        let entries = data.split(separator: UInt8(ascii: "\n")).compactMap { line -> BenchmarkHistoryEntry? in
+            guard let entry = try? decoder.decode(BenchmarkHistoryEntry.self, from: Data(line)) else {
+                skipped += 1
+                return nil
+            }
+            return entry
+        }
+
+        if skipped > 0 {
+            print("Skipped \(skipped) unreadable entries of \(path)")
+        }
+        return entries
+    }
+
+    // Finds the runs where the median of a benchmark metric changed, in the history of the runs
+    // on the same kind of machine as the latest run
+    func printHistory() {
+        var changes: [HistoryChangeEntry] = []
+        var analyzedRuns = 0
+
+        for target in targets {
+            let history = readHistory(target: target)
+            guard let latest = history.last else {
+                print("No history recorded for \(target), record runs with --record-history")
+                continue
+            }
+
+            let runs = history.filter { $0.isComparable(with: latest) }
+            analyzedRuns = max(analyzedRuns, runs.count)
+
+            var series: [BenchmarkIdentifier: [BenchmarkMetric: [(run: Int, value: Int)]]] = [:]
+            for (run, entry) in runs.enumerated() {
+                for result in entry.results where result.percentiles.count > historyPercentileIndex {
+                    let identifier = BenchmarkIdentifier(target: target, name: result.name)
+                    guard includedInBaselines(identifier, result.metric) else {
+                        continue
+                    }
+                    series[identifier, default: [:]][result.metric, default: []]
+                        .append((run, result.percentiles[historyPercentileIndex]))
+                }
+            }
+
+            for identifier in series.keys.sorted(by: { $0.name < $1.name }) {
+                let metrics = series[identifier]!
+                for metric in metrics.keys.sorted(by: { $0.description < $1.description }) {
+                    let points = metrics[metric]!
+                    let changePoints = ChangePointDetection.eDivisive(points.map { Double($0.value) })
+                    let boundaries = [0] + changePoints + [points.count]
+
+                    func median(_ range: Range<Int>) -> Int {
+                        let values = points[range].map(\.value).sorted()
+                        return values[values.count / 2]
+                    }
+
+                    for (index, changePoint) in changePoints.enumerated() {
+                        let before = median(boundaries[index]..<changePoint)
+                        let after = median(changePoint..<boundaries[index + 2])
+                        let change = before != 0 ? 100.0 * Double(after - before) / Double(before) : 0
+                        let run = runs[points[changePoint].run]
+
+                        changes.append(HistoryChangeEntry(
+                            benchmark: "\(target):\(identifier.name)",
+                            metric: metric.description,
+                            key: run.commit ?? "-",
+                            date: run.date,
+                            runs: changePoint - boundaries[index],
+                            before: before,
+                            after: after,
+                            change: String(format: "%+.1f", change)
+                        ))
+                    }
+                }
+            }
+        }
+
+        print("")
+        if format == .markdown {
+            print("### ", terminator: "")
+        }
+        print("Changes in the p50 of \(analyzedRuns) recorded runs")
+        if format == .markdown {
+            print("")
+        }
+
+        guard changes.isEmpty == false else {
+            print("No changes detected.")
+            return
+        }
+
+        let table = TextTable<HistoryChangeEntry> {
+            [
+                Column(title: "Benchmark", value: $0.benchmark, width: 40, align: .left),
+                Column(title: "Metric", value: $0.metric, width: 30, align: .left),
+                Column(title: "Commit", value: $0.key, width: 12, align: .left),
+                Column(title: "Date", value: $0.date, width: 20, align: .left),
+                Column(title: "Runs before", value: "\($0.runs)", width: 11, align: .right),
+                Column(title: "Before", value: "\($0.before)", width: 14, align: .right),
+                Column(title: "After", value: "\($0.after)", width: 14, align: .right),
+                Column(title: "%", value: $0.change, width: 8, align: .right),
+            ]
+        }
+        table.print(changes, style: format.tableStyle)
+    }
+}
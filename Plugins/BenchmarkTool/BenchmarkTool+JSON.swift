@@ -8,7 +8,8 @@
 // http://www.apache.org/licenses/LICENSE-2.0
 //
 
-// JSON serialization of benchmark request/reply command sent to controlled process
+// Serialization of benchmark request/reply command sent to controlled process, requests are
+// JSON encoded and replies use the binary framing unless the JSON protocol is requested
 
 import Benchmark
 import Foundation
@@ -32,6 +33,20 @@ extension BenchmarkTool {
     }
 
     func read() throws -> BenchmarkCommandReply {
+        if jsonProtocol {
+            return try JSONDecoder().decode(BenchmarkCommandReply.self, from: Data(readFrame()))
+        }
+
+        // Binary encoding, results are decoded one metric frame at a time
+        var replyDecoder = BenchmarkReplyDecoder()
+        while true {
+            if let reply = try replyDecoder.decode(readFrame()) {
+                return reply
+            }
+        }
+    }
+
+    private func readFrame() throws -> [UInt8] {
         let input = FileDescriptor(rawValue: inputFD)
         var bufferLength = 0
 
@@ -43,6 +58,7 @@ extension BenchmarkTool {
         }
 
         var readBytes = [UInt8]()
+        readBytes.reserveCapacity(bufferLength)
 
         while readBytes.count < bufferLength {
             let nextBytes = try [UInt8](unsafeUninitializedCapacity: bufferLength - readBytes.count) { buf, count in
@@ -51,8 +67,6 @@ extension BenchmarkTool {
             readBytes.append(contentsOf: nextBytes)
         }
 
-        let request = try JSONDecoder().decode(BenchmarkCommandReply.self, from: Data(readBytes))
-
-        return request
+        return readBytes
     }
 }
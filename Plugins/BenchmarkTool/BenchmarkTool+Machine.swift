@@ -11,6 +11,7 @@
 // Getting running machine configuration information
 
 import Benchmark
+import Foundation
 
 #if canImport(Darwin)
 import Darwin
@@ -71,7 +72,163 @@ extension BenchmarkTool {
             processors: processors,
             processorType: machine,
             memory: memory,
-            kernelVersion: version
+            kernelVersion: version,
+            environment: measurementEnvironment(),
+            cacheLevels: cacheLevels()
         )
     }
+
+    // The data caches of the first CPU and the reach of its TLB where reported, smallest first, which
+    // the cliffs of size sweeps are matched against
+    func cacheLevels() -> [BenchmarkCacheLevel]? {
+        var cacheLevels: [BenchmarkCacheLevel] = []
+
+        #if os(Linux)
+        var index = 0
+        while let level = readSysfs("/sys/devices/system/cpu/cpu0/cache/index\(index)/level"),
+            let type = readSysfs("/sys/devices/system/cpu/cpu0/cache/index\(index)/type")
+        {
+            if type != "Instruction",
+                let size = readSysfs("/sys/devices/system/cpu/cpu0/cache/index\(index)/size").flatMap(parseSize)
+            {
+                cacheLevels.append(BenchmarkCacheLevel(name: type == "Data" ? "L\(level)d" : "L\(level)", bytes: size))
+            }
+            index += 1
+        }
+
+        // The TLB isn't described in sysfs, but AMD processors report its entries, e.g. "TLB size : 3072 4K pages"
+        if let cpuinfo = try? String(contentsOfFile: "/proc/cpuinfo", encoding: .utf8),
+            let line = cpuinfo.split(separator: "\n").first(where: { $0.hasPrefix("TLB size") }),
+            let value = line.split(separator: ":").last?.split(separator: " "),
+            value.count >= 2,
+            let entries = Int(value[0]),
+            let pageSize = parseSize(String(value[1]))
+        {
+            cacheLevels.append(BenchmarkCacheLevel(name: "TLB", bytes: entries * pageSize))
+        }
+        #elseif canImport(Darwin)
+        for (name, key) in [("L1d", "hw.l1dcachesize"), ("L2", "hw.l2cachesize"), ("L3", "hw.l3cachesize")] {
+            var size: Int64 = 0
+            var length = MemoryLayout<Int64>.size
+            if sysctlbyname(key, &size, &length, nil, 0) == 0, size > 0 {
+                cacheLevels.append(BenchmarkCacheLevel(name: name, bytes: Int(size)))
+            }
+        }
+        #endif
+
+        return cacheLevels.isEmpty ? nil : cacheLevels.sorted(by: { $0.bytes < $1.bytes })
+    }
+
+    // Sizes as written by the kernel, e.g. 48K or 32M
+    private func parseSize(_ size: String) -> Int? {
+        let multipliers: [Character: Int] = ["K": 1_024, "M": 1_024 * 1_024, "G": 1_024 * 1_024 * 1_024]
+        guard let last = size.last else {
+            return nil
+        }
+        if let multiplier = multipliers[last] {
+            return Int(size.dropLast()).map { $0 * multiplier }
+        }
+        return Int(size)
+    }
+
+    private func readSysfs(_ path: String) -> String? {
+        (try? String(contentsOfFile: path, encoding: .utf8))?.trimmingCharacters(in: .whitespacesAndNewlines)
+    }
+
+    // The CPU used by the stabilization profile, preferring one isolated from general scheduling
+    // and otherwise the last allowed CPU, as the first CPUs tend to handle more interrupts.
+    func stabilizationCPU() -> Int {
+        if let stabilizeCPU {
+            return stabilizeCPU
+        }
+        return Self.stabilizationCPU(isolated: CPUTopology.isolatedCPUs(), allowed: CPUTopology.allowedCPUs())
+    }
+
+    // Isolated CPUs outside of the affinity mask of the tool (e.g. of a container) can't be pinned to
+    static func stabilizationCPU(isolated: [Int], allowed: [Int]) -> Int {
+        isolated.first { allowed.contains($0) } ?? allowed.last ?? 0
+    }
+
+    // The benchmark processes are pinned to a single CPU when stabilizing and to their CPU set when running in
+    // parallel. Multi-threaded benchmarks with more threads than that would only measure the threads taking turns,
+    // and with SCHED_FIFO a spinning thread never gives way to the others, so they aren't run at all.
+    mutating func checkThreadsFitCPUs(_ benchmarks: [Benchmark]) {
+        #if os(Linux)
+        let cpus: Int
+        if parallel > 1 {
+            cpus = CPUTopology.cpuSets(count: parallel, partitioning: cpuPartitioning).map(\.count).min() ?? 1
+        } else if stabilize {
+            cpus = 1
+        } else {
+            return
+        }
+
+        let oversubscribed = benchmarks.filter { $0.configuration.threads > cpus }
+        guard oversubscribed.isEmpty == false else {
+            return
+        }
+
+        let names = oversubscribed.map { "\($0.target):\($0.name) (\($0.configuration.threads) threads)" }
+        failBenchmark(
+            "Benchmarks with more threads than the \(cpus) CPU\(cpus == 1 ? "" : "s") each benchmark process is pinned to "
+                + "with \(parallel > 1 ? "--parallel \(parallel)" : "--stabilize"): \(names.joined(separator: ", ")). "
+                + "Run them without \(parallel > 1 ? "--parallel or with fewer parallel processes" : "--stabilize"), "
+                + "or exclude them with --skip."
+        )
+        #endif
+    }
+
+    func measurementEnvironment() -> BenchmarkMeasurementEnvironment {
+        var environment = BenchmarkMeasurementEnvironment(stabilized: stabilize, realtimeScheduling: false)
+
+        #if os(Linux)
+        if stabilize {
+            environment.realtimeScheduling = stabilizeRealtime
+            if parallel <= 1 {
+                environment.cpu = stabilizationCPU()
+            }
+        }
+
+        let cpu = environment.cpu ?? CPUTopology.allowedCPUs().first ?? 0
+        environment.governor = readSysfs("/sys/devices/system/cpu/cpu\(cpu)/cpufreq/scaling_governor")
+        if environment.cpu != nil {
+            environment.isolatedCPU = CPUTopology.isolatedCPUs().contains(cpu)
+        }
+        if let smt = readSysfs("/sys/devices/system/cpu/smt/active") {
+            environment.smtActive = smt == "1"
+        }
+        #endif
+
+        return environment
+    }
+
+    // Warns about settings of the measurement environment that are known to add noise
+    func printMeasurementEnvironmentReport() {
+        #if !os(Linux)
+        print("Warning: --stabilize is only supported on Linux, benchmarks will run in the default environment.")
+        print("")
+        #else
+        let environment = measurementEnvironment()
+        let cpus = environment.cpu.map { "CPU \($0)" } ?? "the parallel CPU sets"
+        var warnings: [String] = []
+
+        print("Stabilized measurement environment on \(cpus): \(environment)")
+
+        if let governor = environment.governor, governor != "performance" {
+            warnings.append("CPU frequency scaling governor is '\(governor)', set it to 'performance' for stable results")
+        }
+        if let cpu = environment.cpu, environment.isolatedCPU == false {
+            warnings.append("CPU \(cpu) is not isolated, consider booting with isolcpus=\(cpu) nohz_full=\(cpu)")
+        }
+        if let cpu = environment.cpu, environment.smtActive == true,
+            let siblings = CPUTopology.coreSiblings(cpu)?.filter({ $0 != cpu }), siblings.isEmpty == false
+        {
+            let siblingList = CPUTopology.formatList(siblings)
+            warnings.append("SMT is active, CPU \(cpu) shares its core with CPU \(siblingList) which should be kept idle")
+        }
+
+        warnings.forEach { print("  Warning: \($0)") }
+        print("")
+        #endif
+    }
 }
@@ -235,6 +235,8 @@ extension BenchmarkTool {
                 return
             case .list:
                 printAllBaselines()
+            case .convert:
+                convertBaselines()
             case .compare:
                 guard benchmarkBaselines.count == 2 else {
                     print("Can only compare exactly 2 benchmark baselines, got: \(benchmarkBaselines.count) baselines.")
@@ -242,6 +244,9 @@ extension BenchmarkTool {
                 }
 
                 prettyPrintDelta(currentBaseline: benchmarkBaselines[0], baseline: benchmarkBaselines[1])
+                prettyPrintAllocationProfileDelta(currentBaseline: benchmarkBaselines[0], baseline: benchmarkBaselines[1])
+                prettyPrintCPUProfileDelta(currentBaseline: benchmarkBaselines[0], baseline: benchmarkBaselines[1])
+                prettyPrintComplexityDelta(currentBaseline: benchmarkBaselines[0], baseline: benchmarkBaselines[1])
             case .update:
                 guard benchmarkBaselines.count == 1 else {
                     print("Can only update a single benchmark baseline, got: \(benchmarkBaselines.count) baselines.")
@@ -255,13 +260,20 @@ extension BenchmarkTool {
                         let subset = BenchmarkBaseline(
                             baselineName: baselineName,
                             machine: baseline.machine,
-                            results: results
+                            results: results,
+                            cpuSets: baseline.cpuSets?.filter { $0.key.target == target },
+                            durations: baseline.durations?.filter { $0.key.target == target },
+                            cpuProfiles: baseline.cpuProfiles?.filter { $0.key.target == target }
+                                .mapValues { $0.top(storedCPUStacks) },
+                            traceSummaries: baseline.traceSummaries?.filter { $0.key.target == target },
+                            complexityFits: baseline.complexityFits?.filter { $0.key.target == target }
                         )
                         try write(
                             baseline: subset,
                             baselineName: baselineName,
                             target: target
                         )
+                        writeCPUProfiles(baseline, baselineName: baselineName, target: target)
                     }
 
                     if quiet == false {
@@ -379,6 +391,13 @@ extension BenchmarkTool {
                     let checkBaseline = benchmarkBaselines[1]
                     let baselineName = baseline[0]
                     let checkBaselineName = baseline[1]
+
+                    let environmentDifferences = checkBaseline.machine.environmentDifferences(from: currentBaseline.machine)
+                    if environmentDifferences.isEmpty == false {
+                        print("Warning: Baselines were measured in different environments, results may not be comparable:")
+                        environmentDifferences.forEach { print("  \($0)") }
+                    }
+
                     let deviationResults = checkBaseline.deviationsComparedToBaseline(
                         currentBaseline,
                         benchmarks: benchmarks
@@ -432,6 +451,8 @@ extension BenchmarkTool {
             break
         case .list:
             break
+        case .history:
+            break
         }
     }
 
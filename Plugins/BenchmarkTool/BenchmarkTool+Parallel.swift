@@ -0,0 +1,335 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Running benchmark processes in parallel, each pinned to a disjoint set of CPUs
+
+import ArgumentParser
+import Benchmark
+import Dispatch
+import Foundation
+import SystemPackage
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+enum CPUPartitioning: String, ExpressibleByArgument, CaseIterable {
+    case cores // physical cores, SMT siblings are kept in the same set
+    case cache // last level (L3) cache domains
+    case numa // NUMA nodes
+}
+
+// The CPU topology as exposed by Linux sysfs, used to partition the CPUs we're allowed to run on
+enum CPUTopology {
+    static func parseList(_ list: String) -> [Int] {
+        var cpus: [Int] = []
+        for range in list.trimmingCharacters(in: .whitespacesAndNewlines).split(separator: ",") {
+            let bounds = range.split(separator: "-").compactMap { Int($0) }
+            if bounds.count == 1 {
+                cpus.append(bounds[0])
+            } else if bounds.count == 2, bounds[0] <= bounds[1] {
+                cpus.append(contentsOf: bounds[0]...bounds[1])
+            }
+        }
+        return cpus
+    }
+
+    static func formatList(_ cpus: [Int]) -> String {
+        var ranges: [String] = []
+        var index = 0
+        let cpus = cpus.sorted()
+
+        while index < cpus.count {
+            var end = index
+            while end + 1 < cpus.count, cpus[end + 1] == cpus[end] + 1 {
+                end += 1
+            }
+            ranges.append(end == index ? "\(cpus[index])" : "\(cpus[index])-\(cpus[end])")
+            index = end + 1
+        }
+        return ranges.joined(separator: ",")
+    }
+
+    private static func readList(_ path: String) -> [Int]? {
+        guard let contents = try? String(contentsOfFile: path, encoding: .utf8) else {
+            return nil
+        }
+        let cpus = parseList(contents)
+        return cpus.isEmpty ? nil : cpus
+    }
+
+    static func allowedCPUs() -> [Int] {
+        if let status = try? String(contentsOfFile: "/proc/self/status", encoding: .utf8),
+            let line = status.split(separator: "\n").first(where: { $0.hasPrefix("Cpus_allowed_list:") })
+        {
+            let cpus = parseList(String(line.dropFirst("Cpus_allowed_list:".count)))
+            if cpus.isEmpty == false {
+                return cpus
+            }
+        }
+        return Array(0..<sysconf(Int32(_SC_NPROCESSORS_ONLN)))
+    }
+
+    // CPUs excluded from general scheduling with the isolcpus kernel parameter
+    static func isolatedCPUs() -> [Int] {
+        readList("/sys/devices/system/cpu/isolated") ?? []
+    }
+
+    static func coreSiblings(_ cpu: Int) -> [Int]? {
+        readList("/sys/devices/system/cpu/cpu\(cpu)/topology/thread_siblings_list")
+    }
+
+    private static func lastLevelCacheSiblings(_ cpu: Int) -> [Int]? {
+        for index in 0..<8 {
+            let cache = "/sys/devices/system/cpu/cpu\(cpu)/cache/index\(index)"
+            guard let level = try? String(contentsOfFile: "\(cache)/level", encoding: .utf8) else {
+                break
+            }
+            if level.trimmingCharacters(in: .whitespacesAndNewlines) == "3" {
+                return readList("\(cache)/shared_cpu_list")
+            }
+        }
+        return nil
+    }
+
+    private static func numaSiblings(_ cpu: Int) -> [Int]? {
+        for node in 0..<1_024 {
+            guard let cpus = readList("/sys/devices/system/node/node\(node)/cpulist") else {
+                if FileManager.default.fileExists(atPath: "/sys/devices/system/node/node\(node)") == false {
+                    break
+                }
+                continue
+            }
+            if cpus.contains(cpu) {
+                return cpus
+            }
+        }
+        return nil
+    }
+
+    // Groups the allowed CPUs into the units of the partitioning, falling back to single CPUs
+    // if the topology isn't available, and then splits the units into `count` disjoint sets.
+    static func cpuSets(count: Int, partitioning: CPUPartitioning) -> [[Int]] {
+        let topologyUnits = units(allowed: allowedCPUs()) { cpu in
+            switch partitioning {
+            case .cores:
+                return coreSiblings(cpu)
+            case .cache:
+                return lastLevelCacheSiblings(cpu)
+            case .numa:
+                return numaSiblings(cpu)
+            }
+        }
+        return cpuSets(count: count, units: topologyUnits)
+    }
+
+    // Each allowed CPU is in exactly one unit, siblings that aren't allowed or already in a unit are left out
+    static func units(allowed: [Int], siblings: (Int) -> [Int]?) -> [[Int]] {
+        let allowedSet = Set(allowed)
+        var assigned: Set<Int> = []
+        var units: [[Int]] = []
+
+        for cpu in allowed where assigned.contains(cpu) == false {
+            let unit = (siblings(cpu) ?? [cpu]).filter { allowedSet.contains($0) && assigned.contains($0) == false }
+            assigned.formUnion(unit)
+            units.append(unit.isEmpty ? [cpu] : unit)
+        }
+
+        return units
+    }
+
+    // Splits the units into at most `count` sets of consecutive units, the first sets get one more unit
+    // if they can't be split evenly
+    static func cpuSets(count: Int, units: [[Int]]) -> [[Int]] {
+        let sets = min(max(count, 1), units.count)
+        var cpuSets: [[Int]] = []
+        var unitIndex = 0
+
+        for set in 0..<sets {
+            let unitsInSet = units.count / sets + (set < units.count % sets ? 1 : 0)
+            cpuSets.append(units[unitIndex..<unitIndex + unitsInSet].flatMap { $0 }.sorted())
+            unitIndex += unitsInSet
+        }
+
+        return cpuSets
+    }
+}
+
+extension BenchmarkTool {
+    // Durations of the benchmarks from the stored default baselines, used to schedule the longest first
+    func historicalDurations() -> [BenchmarkIdentifier: Double] {
+        var durations: [BenchmarkIdentifier: Double] = [:]
+
+        for target in benchmarks.map(\.target).unique() {
+            guard let baseline = try? read(target: target, including: { $1 == .wallClock }) else {
+                continue
+            }
+            durations.merge(baseline.durations ?? [:]) { current, _ in current }
+
+            // Older baselines have no durations, estimate them from the wall clock samples instead
+            for (identifier, results) in baseline.results where durations[identifier] == nil {
+                if let wallClock = results.first(where: { $0.metric == .wallClock }) {
+                    let statistics = wallClock.statistics
+                    durations[identifier] = Double(statistics.measurementCount) * statistics.average / 1_000_000_000
+                }
+            }
+        }
+
+        return durations
+    }
+
+    mutating func runBenchmarksInParallel(
+        _ benchmarksToRun: [Benchmark],
+        streamWriter: BenchmarkStreamWriter?
+    ) throws -> (results: BenchmarkResults, cpuSets: [BenchmarkIdentifier: [Int]], durations: [BenchmarkIdentifier: Double]) {
+        let cpuSets = CPUTopology.cpuSets(count: parallel, partitioning: cpuPartitioning)
+
+        #if !os(Linux)
+        print("Warning: CPU sets are only supported on Linux, parallel benchmarks will share CPUs.")
+        print("")
+        #endif
+
+        if quiet == false, format == .text {
+            print("Running \(benchmarksToRun.count) benchmarks on \(cpuSets.count) CPU sets (\(cpuPartitioning)):")
+            cpuSets.forEach { print("  \(CPUTopology.formatList($0))") }
+            print("")
+        }
+
+        // Longest running first, with unknown durations scheduled before any known ones
+        let durations = historicalDurations()
+        let queue = benchmarksToRun.sorted {
+            (durations[$0.benchmarkIdentifier] ?? .infinity) > (durations[$1.benchmarkIdentifier] ?? .infinity)
+        }
+
+        // The outcome of each benchmark is written to its own slot by the worker that ran it, and the failed
+        // benchmarks of each worker to the slot of the worker, so the lock is only taken for the queue
+        struct Outcome {
+            var results: BenchmarkResults = [:]
+            var cpuSet: [Int] = []
+            var seconds: Double = 0
+            var error: Error?
+        }
+
+        let outcomes = UnsafeMutableBufferPointer<Outcome?>.allocate(capacity: queue.count)
+        outcomes.initialize(repeating: nil)
+        let failedBenchmarks = UnsafeMutableBufferPointer<[String]>.allocate(capacity: cpuSets.count)
+        failedBenchmarks.initialize(repeating: [])
+        defer {
+            outcomes.deinitialize()
+            outcomes.deallocate()
+            failedBenchmarks.deinitialize()
+            failedBenchmarks.deallocate()
+        }
+
+        let lock = NSLock()
+        func locked<T>(_ body: () throws -> T) rethrows -> T {
+            lock.lock()
+            defer { lock.unlock() }
+            return try body()
+        }
+
+        let template = self
+        var nextBenchmark = 0
+
+        DispatchQueue.concurrentPerform(iterations: cpuSets.count) { worker in
+            var tool = template
+            tool.cpuSet = cpuSets[worker]
+            tool.noProgress = true // progress output from several processes would be interleaved
+
+            while true {
+                let index: Int? = locked {
+                    guard nextBenchmark < queue.count else {
+                        return nil
+                    }
+                    nextBenchmark += 1
+                    return nextBenchmark - 1
+                }
+
+                guard let index else {
+                    break
+                }
+
+                let benchmark = queue[index]
+                let startTime = ContinuousClock.now
+
+                do {
+                    let benchmarkResults = try tool.runChild(
+                        benchmarkPath: benchmark.executablePath!,
+                        benchmarkCommand: template.command,
+                        benchmark: benchmark
+                    ) { result in
+                        if result != 0 {
+                            locked { // keeps the output of the workers from being interleaved
+                                template.printChildRunError(error: result, benchmarkExecutablePath: benchmark.executablePath!)
+                            }
+                        }
+                    }
+                    let duration = ContinuousClock.now - startTime
+                    let seconds = Double(duration.components.seconds)
+                        + Double(duration.components.attoseconds) / 1_000_000_000_000_000_000
+
+                    streamWriter?.write(benchmarkResults)
+
+                    outcomes[index] = Outcome(results: benchmarkResults, cpuSet: cpuSets[worker], seconds: seconds)
+                } catch {
+                    outcomes[index] = Outcome(error: error)
+                    locked {
+                        nextBenchmark = queue.count // no more benchmarks are started after an error
+                    }
+                }
+            }
+
+            failedBenchmarks[worker] = tool.failedBenchmarkList
+        }
+
+        let allFailedBenchmarks = failedBenchmarks.flatMap { $0 }
+        failedBenchmarkList.append(contentsOf: allFailedBenchmarks.filter { failedBenchmarkList.contains($0) == false })
+
+        if let firstError = outcomes.lazy.compactMap({ $0?.error }).first {
+            throw firstError
+        }
+
+        var results: BenchmarkResults = [:]
+        var benchmarkCPUSets: [BenchmarkIdentifier: [Int]] = [:]
+        var benchmarkDurations: [BenchmarkIdentifier: Double] = [:]
+
+        for (index, benchmark) in queue.enumerated() {
+            guard let outcome = outcomes[index] else {
+                continue
+            }
+            results.merge(outcome.results) { _, new in new }
+            benchmarkCPUSets[benchmark.benchmarkIdentifier] = outcome.cpuSet
+            benchmarkDurations[benchmark.benchmarkIdentifier] = outcome.seconds
+        }
+
+        return (results, benchmarkCPUSets, benchmarkDurations)
+    }
+}
+
+// Parallel workers spawn benchmarks concurrently, so the pipes are created close-on-exec, with the spawns
+// serialized with their creation, so that no child inherits the pipes of another worker
+let spawnLock = NSLock()
+
+func closeOnExecPipe() throws -> (readEnd: FileDescriptor, writeEnd: FileDescriptor) {
+    let pipe = try FileDescriptor.pipe()
+    for fd in [pipe.readEnd, pipe.writeEnd] where fcntl(fd.rawValue, F_SETFD, FD_CLOEXEC) == -1 {
+        let error = Errno(rawValue: errno)
+        try? pipe.readEnd.close()
+        try? pipe.writeEnd.close()
+        throw error
+    }
+    return pipe
+}
@@ -73,6 +73,9 @@ extension BenchmarkTool {
             "Host '\(machine.hostname)' with \(machine.processors) '\(machine.processorType)' processors with \(machine.memory) GB memory, running:"
         )
         print("\(machine.kernelVersion)")
+        if let environment = machine.environment, environment.stabilized {
+            print("Measured with \(environment)")
+        }
         printMarkdown("```")
         printText("")
     }
@@ -189,6 +192,59 @@ extension BenchmarkTool {
         printMarkdown("")
 
         table.print(scaledResults, style: format.tableStyle)
+
+        if useGroupingDescription == false,
+            let batched = results.first(where: { $0.metrics.batchSize != nil })?.metrics,
+            let batchSize = batched.batchSize
+        {
+            print(
+                "Automatic batching: \(batchSize) invocations per sample, "
+                    + "empty batch overhead \(batched.emptyBatchOverhead ?? 0) ns (results are per invocation)"
+            )
+            print("")
+        }
+
+        // Only worth mentioning when the subtracted overhead is a noticeable part of the measurement
+        if useGroupingDescription == false,
+            let wallClock = results.first(where: { $0.metrics.metric == .wallClock })?.metrics,
+            let timingOverhead = wallClock.timingOverhead
+        {
+            let overheadPerInvocation = Double(timingOverhead) / Double(wallClock.batchSize ?? 1)
+            let median = Double(wallClock.statistics.histogram.valueAtPercentile(50.0))
+            if overheadPerInvocation >= 0.01 * median {
+                print("Timing overhead of \(timingOverhead) ns per sample subtracted from wall clock")
+                print("")
+            }
+        }
+
+        // Not part of the samples, but when comparable to them the benchmark runs with caches and branch predictors
+        // disturbed by the measurements between its iterations
+        if useGroupingDescription == false,
+            let wallClock = results.first(where: { $0.metrics.metric == .wallClock })?.metrics,
+            let measurementOverhead = wallClock.measurementOverhead
+        {
+            let sampleDuration = Double(wallClock.statistics.histogram.valueAtPercentile(50.0)) * Double(wallClock.batchSize ?? 1)
+            if Double(measurementOverhead) >= 0.1 * sampleDuration {
+                print("Measurement overhead of \(measurementOverhead) ns per sample between the measured iterations")
+                print("")
+            }
+        }
+
+        if useGroupingDescription == false,
+            let precision = results.first(where: { $0.metrics.runPrecision != nil })?.metrics.runPrecision
+        {
+            let widths = zip(precision.percentiles, precision.relativeWidths)
+                .map { percentile, width in
+                    "\(percentile) ±" + (width.isFinite ? String(format: "%.1f%%", 50.0 * width) : "?")
+                }
+            print(
+                "Adaptive run length: \(precision.warmupIterations) warmup iterations "
+                    + (precision.steadyStateDetected ? "detected" : "(no steady state detected)")
+                    + ", 95% confidence \(widths.joined(separator: ", "))"
+                    + (precision.converged ? "" : " (stopped by maxIterations/maxDuration)")
+            )
+            print("")
+        }
     }
 
     func prettyPrint(
@@ -252,6 +308,14 @@ extension BenchmarkTool {
                 )
             }
         }
+
+        prettyPrintScaling(baseline)
+        prettyPrintComplexity(baseline)
+        prettyPrintSizeClasses(baseline)
+        prettyPrintAllocationProfiles(baseline)
+        prettyPrintARCTypeProfiles(baseline)
+        prettyPrintCPUProfiles(baseline)
+        prettyPrintTraces(baseline)
     }
 
     func prettyPrintDelta(
@@ -267,6 +331,12 @@ extension BenchmarkTool {
             print("Warning: Machine configuration is different when comparing baselines, other config:")
             printMachine(currentBaseline.machine, "")
         }
+        let environmentDifferences = baseline.machine.environmentDifferences(from: currentBaseline.machine)
+        if environmentDifferences.isEmpty == false {
+            print("Warning: Baselines were measured in different environments, results may not be comparable:")
+            environmentDifferences.forEach { print("  \($0)") }
+            print("")
+        }
 
         baseline.targets.forEach { target in
             let baseBaselineName = currentBaseline.baselineName
@@ -305,6 +375,14 @@ extension BenchmarkTool {
                     )
                     print("")
 
+                    if let wallClock = value.first(where: { $0.metric == .wallClock }),
+                        let baseWallClock = baselineComparison.first(where: { $0.metric == .wallClock }),
+                        (wallClock.timingOverhead == nil) != (baseWallClock.timingOverhead == nil)
+                    {
+                        print("Warning: The timing overhead was only subtracted from the wall clock in one of the baselines")
+                        print("")
+                    }
+
                     value.forEach { currentResult in
                         var result = currentResult
                         if let base = baselineComparison.first(where: { $0.metric == result.metric }) {
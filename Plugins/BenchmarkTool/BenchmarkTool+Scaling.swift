@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Scalability sweeps registered with Benchmark.scalability(), one benchmark per thread count
+
+import Benchmark
+import Foundation
+import TextTable
+
+private struct ScalingEntry {
+    var threads: Int
+    var throughput: Int
+    var speedup: Double
+    var efficiency: Int
+    var latency: String
+}
+
+extension BenchmarkTool {
+    private func medianThroughput(_ results: [BenchmarkResult]?) -> Double? {
+        guard let throughput = results?.first(where: { $0.metric == .throughput }),
+            throughput.statistics.measurementCount > 0
+        else {
+            return nil
+        }
+        return Double(throughput.statistics.histogram.valueAtPercentile(50.0))
+    }
+
+    // Adds scalingEfficiency to the results of each benchmark in a sweep: its median throughput
+    // relative to the single threaded median throughput times the number of threads.
+    func addScalingEfficiency(to results: inout BenchmarkResults) {
+        let sweeps = Dictionary(grouping: benchmarks) {
+            BenchmarkSweep(
+                BenchmarkIdentifier(target: $0.target, name: $0.name),
+                tags: $0.configuration.tags,
+                sweepTag: Benchmark.threadsTag
+            )
+        }
+
+        for (sweep, members) in sweeps where sweep != nil {
+            guard let singleThreaded = members.first(where: { $0.configuration.threads == 1 }),
+                let singleThreadedThroughput = medianThroughput(results[singleThreaded.benchmarkIdentifier]),
+                singleThreadedThroughput > 0
+            else {
+                continue
+            }
+
+            for member in members where member.configuration.metrics.contains(.scalingEfficiency) {
+                let identifier = member.benchmarkIdentifier
+                guard var memberResults = results[identifier], let throughput = medianThroughput(memberResults) else {
+                    continue
+                }
+
+                let threads = Double(max(member.configuration.threads, 1))
+                let statistics = Statistics(units: .count, prefersLarger: true)
+                statistics.add(Int((100.0 * throughput / (threads * singleThreadedThroughput)).rounded()))
+
+                memberResults.removeAll { $0.metric == .scalingEfficiency }
+                memberResults.append(
+                    BenchmarkResult(
+                        metric: .scalingEfficiency,
+                        timeUnits: .automatic,
+                        scalingFactor: .one,
+                        warmupIterations: member.configuration.warmupIterations,
+                        thresholds: member.configuration.thresholds?[.scalingEfficiency],
+                        tags: member.configuration.tags,
+                        statistics: statistics
+                    )
+                )
+                memberResults.sort(by: { $0.metric.description > $1.metric.description })
+                results[identifier] = memberResults
+            }
+        }
+    }
+
+    // Prints a table per sweep with the throughput, speedup and efficiency for each thread count
+    func prettyPrintScaling(_ baseline: BenchmarkBaseline) {
+        var sweeps: [BenchmarkSweep: [(threads: Int, results: [BenchmarkResult])]] = [:]
+
+        for (identifier, results) in baseline.results {
+            guard let tags = results.first?.tags,
+                let threads = tags[Benchmark.threadsTag].flatMap({ Int($0) }),
+                let sweep = BenchmarkSweep(identifier, tags: tags, sweepTag: Benchmark.threadsTag)
+            else {
+                continue
+            }
+            sweeps[sweep, default: []].append((threads, results))
+        }
+
+        let table = TextTable<ScalingEntry> {
+            [
+                Column(title: "Threads", value: "\($0.threads)", width: 9, align: .right),
+                Column(title: "Throughput (# / s) p50", value: "\($0.throughput)", width: 24, align: .right),
+                Column(title: "Speedup", value: String(format: "%.2f", $0.speedup), width: 9, align: .right),
+                Column(title: "Efficiency (%)", value: "\($0.efficiency)", width: 16, align: .right),
+                Column(title: "Latency p50 / p99", value: $0.latency, width: 24, align: .right),
+            ]
+        }
+
+        for sweep in sweeps.keys.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let members = sweeps[sweep]!.sorted(by: { $0.threads < $1.threads })
+            let singleThreadedThroughput = members.first(where: { $0.threads == 1 })
+                .flatMap { medianThroughput($0.results) }
+
+            let entries = members.map { member -> ScalingEntry in
+                let throughput = medianThroughput(member.results) ?? 0
+                let speedup = singleThreadedThroughput.map { $0 > 0 ? throughput / $0 : 0 } ?? 0
+                let efficiency =
+                    member.results.first(where: { $0.metric == .scalingEfficiency })
+                    .map { Int($0.statistics.histogram.valueAtPercentile(50.0)) }
+                    ?? Int(100.0 * speedup / Double(member.threads))
+                var latency = ""
+                if let wallClock = member.results.first(where: { $0.metric == .wallClock }) {
+                    let percentiles = wallClock.statistics.percentiles(for: [50.0, 99.0])
+                    latency = "\(wallClock.normalize(percentiles[0])) / \(wallClock.normalize(percentiles[1]))"
+                        + " \(wallClock.unitDescriptionPretty)"
+                }
+                return ScalingEntry(
+                    threads: member.threads,
+                    throughput: Int(throughput),
+                    speedup: speedup,
+                    efficiency: efficiency,
+                    latency: latency
+                )
+            }
+
+            print("")
+            if format == .markdown {
+                print("### ", terminator: "")
+            }
+            print("\(sweep.target):\(sweep.identifier.name) scaling")
+            if format == .markdown {
+                print("")
+            }
+            table.print(entries, style: format.tableStyle)
+        }
+    }
+}
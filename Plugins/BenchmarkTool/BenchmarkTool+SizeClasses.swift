@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// The allocation size class histogram of the mallocSizeClass metric, one sample per allocation
+
+import Benchmark
+import Foundation
+import TextTable
+
+private struct SizeClassEntry {
+    var sizeClass: UInt64
+    var allocations: UInt64
+    var percentage: Double
+    var cumulativePercentage: Double
+}
+
+extension BenchmarkTool {
+    // Prints a table per benchmark with the number of allocations served from each size class
+    func prettyPrintSizeClasses(_ baseline: BenchmarkBaseline) {
+        let table = TextTable<SizeClassEntry> {
+            [
+                Column(title: "Size class (bytes)", value: "\($0.sizeClass)", width: 20, align: .right),
+                Column(title: "Allocations", value: "\($0.allocations)", width: 14, align: .right),
+                Column(title: "%", value: String(format: "%.1f", $0.percentage), width: 8, align: .right),
+                Column(title: "Cumulative %", value: String(format: "%.1f", $0.cumulativePercentage), width: 14, align: .right),
+            ]
+        }
+
+        for identifier in baseline.benchmarkIdentifiers.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            guard let sizeClasses = baseline.results[identifier]?.first(where: { $0.metric == .mallocSizeClass }),
+                sizeClasses.statistics.histogram.totalCount > 0
+            else {
+                continue
+            }
+
+            let total = Double(sizeClasses.statistics.histogram.totalCount)
+            var cumulative: UInt64 = 0
+            let histogram = sizeClasses.statistics.histogram
+            let entries = histogram.recordedValues().map { recordedValue -> SizeClassEntry in
+                cumulative += UInt64(recordedValue.count)
+                return SizeClassEntry(
+                    sizeClass: histogram.lowestEquivalentValue(recordedValue.value), // the size classes are exact
+                    allocations: UInt64(recordedValue.count),
+                    percentage: 100.0 * Double(recordedValue.count) / total,
+                    cumulativePercentage: 100.0 * Double(cumulative) / total
+                )
+            }
+
+            print("")
+            if format == .markdown {
+                print("### ", terminator: "")
+            }
+            print("\(identifier.target):\(identifier.name) allocation size classes")
+            if format == .markdown {
+                print("")
+            }
+            table.print(entries, style: format.tableStyle)
+        }
+    }
+}
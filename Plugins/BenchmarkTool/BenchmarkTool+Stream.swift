@@ -0,0 +1,257 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Streaming export of the results of each benchmark as soon as it has run, one line per benchmark and metric
+
+import ArgumentParser
+import Benchmark
+import Foundation
+import SystemPackage
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+enum StreamFormat: String, ExpressibleByArgument, CaseIterable {
+    case ndjson // one JSON object per line
+    case influx // Influx line protocol
+}
+
+/// One line of the ndjson stream
+struct BenchmarkStreamRecord: Codable {
+    var timestamp: Double // seconds since 1970 when the benchmark completed
+    var hostname: String
+    var target: String
+    var name: String
+    var metric: String
+    var iterations: Int
+    var warmupIterations: Int
+    var tags: [String: String]
+    var percentiles: [String: Int] // p0, p25, ... p100, in nanoseconds for time metrics
+}
+
+enum BenchmarkStreamError: Error {
+    case socketPathTooLong(String)
+    case socketConnectFailed(String, CInt)
+}
+
+// The lines of each benchmark are written with a single write under a lock, so that they aren't
+// interleaved with those of benchmarks running in parallel.
+final class BenchmarkStreamWriter {
+    let format: StreamFormat
+    private let path: String
+    private let machine: BenchmarkMachine
+    private let lock = NSLock()
+    private var fd: FileDescriptor?
+
+    // Opens a local Unix socket for connecting to, otherwise a file or FIFO for appending to.
+    // Opening a FIFO blocks until the reading end has been opened.
+    init(path: String, format: StreamFormat, machine: BenchmarkMachine) throws {
+        self.path = path
+        self.format = format
+        self.machine = machine
+
+        var status = stat()
+        if stat(path, &status) == 0, (status.st_mode & S_IFMT) == S_IFSOCK {
+            fd = try Self.connectSocket(path)
+        } else {
+            fd = try FileDescriptor.open(
+                FilePath(path),
+                .writeOnly,
+                options: [.append, .create],
+                permissions: .ownerReadWrite
+            )
+        }
+
+        // A reader going away should stop the stream, not the benchmark run. Benchmark processes are
+        // spawned with the default SIGPIPE handling restored, see runChild().
+        signal(SIGPIPE, SIG_IGN)
+    }
+
+    deinit {
+        try? fd?.close()
+    }
+
+    private static func connectSocket(_ path: String) throws -> FileDescriptor {
+        var address = sockaddr_un()
+        address.sun_family = sa_family_t(AF_UNIX)
+
+        let pathBytes = Array(path.utf8)
+        guard pathBytes.count < MemoryLayout.size(ofValue: address.sun_path) else {
+            throw BenchmarkStreamError.socketPathTooLong(path)
+        }
+        withUnsafeMutableBytes(of: &address.sun_path) { sunPath in
+            sunPath.copyBytes(from: pathBytes)
+            sunPath[pathBytes.count] = 0
+        }
+
+        #if canImport(Glibc)
+        let socketFD = socket(AF_UNIX, Int32(SOCK_STREAM.rawValue), 0)
+        #else
+        let socketFD = socket(AF_UNIX, SOCK_STREAM, 0)
+        #endif
+        guard socketFD >= 0 else {
+            throw BenchmarkStreamError.socketConnectFailed(path, errno)
+        }
+
+        let result = withUnsafePointer(to: &address) {
+            $0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+                connect(socketFD, $0, socklen_t(MemoryLayout<sockaddr_un>.size))
+            }
+        }
+        guard result == 0 else {
+            let error = errno
+            close(socketFD)
+            throw BenchmarkStreamError.socketConnectFailed(path, error)
+        }
+
+        return FileDescriptor(rawValue: socketFD)
+    }
+
+    // Writes the lines for the results of a benchmark, giving up on the stream if the reader went away
+    func write(_ results: BenchmarkResults) {
+        let timestamp = Date().timeIntervalSince1970
+        var lines: [UInt8] = []
+
+        for (identifier, benchmarkResults) in results {
+            for result in benchmarkResults.sorted(by: { $0.metric.description < $1.metric.description })
+            where result.statistics.measurementCount > 0 {
+                switch format {
+                case .ndjson:
+                    lines.append(contentsOf: ndjsonLine(identifier, result, timestamp: timestamp))
+                case .influx:
+                    lines.append(contentsOf: influxLine(identifier, result, timestamp: timestamp).utf8)
+                }
+                lines.append(UInt8(ascii: "\n"))
+            }
+        }
+
+        guard lines.isEmpty == false else {
+            return
+        }
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard let fd else {
+            return
+        }
+
+        do {
+            _ = try fd.writeAll(lines)
+        } catch {
+            print("Failed to write to stream \(path) [\(String(reflecting: error))], no further results will be streamed.")
+            try? fd.close()
+            self.fd = nil
+        }
+    }
+
+    private func percentiles(_ result: BenchmarkResult) -> [(String, Int)] {
+        zip(Statistics.defaultPercentilesToCalculate, result.statistics.percentiles()).map { percentile, value in
+            let name = percentile.rounded() == percentile ? "p\(Int(percentile))" : "p\(percentile)"
+            return (name, value)
+        }
+    }
+
+    func ndjsonLine(_ identifier: BenchmarkIdentifier, _ result: BenchmarkResult, timestamp: Double) -> [UInt8] {
+        let record = BenchmarkStreamRecord(
+            timestamp: timestamp,
+            hostname: machine.hostname,
+            target: identifier.target,
+            name: identifier.name,
+            metric: result.metric.rawDescription,
+            iterations: result.statistics.measurementCount,
+            warmupIterations: result.warmupIterations,
+            tags: result.tags,
+            percentiles: Dictionary(uniqueKeysWithValues: percentiles(result))
+        )
+
+        let encoder = JSONEncoder()
+        encoder.outputFormatting = [.sortedKeys, .withoutEscapingSlashes]
+        return (try? [UInt8](encoder.encode(record))) ?? []
+    }
+
+    // measurement,tag=value,... field=value,... timestamp in nanoseconds
+    func influxLine(_ identifier: BenchmarkIdentifier, _ result: BenchmarkResult, timestamp: Double) -> String {
+        func escape(_ string: String, _ characters: String) -> String {
+            var escaped = ""
+            for character in string {
+                if characters.contains(character) {
+                    escaped.append("\\")
+                }
+                escaped.append(character)
+            }
+            return escaped
+        }
+
+        var tags = [
+            ("hostName", machine.hostname),
+            ("processorType", machine.processorType),
+            ("processors", String(machine.processors)),
+            ("memory", String(machine.memory)),
+            ("kernelVersion", machine.kernelVersion),
+            ("test", identifier.name),
+            ("metric", result.metric.rawDescription),
+        ]
+        tags.append(contentsOf: result.tags.sorted(by: { $0.key < $1.key }).map { ($0.key, $0.value) })
+
+        var fields = percentiles(result).map { "\($0)=\($1)i" }
+        fields.append("iterations=\(result.statistics.measurementCount)i")
+        fields.append("warmup_iterations=\(result.warmupIterations)i")
+
+        // Empty tag values aren't allowed by the line protocol
+        let tagSet = tags.filter { $0.1.isEmpty == false }
+            .map { "\(escape($0.0, ", ="))=\(escape($0.1, ", ="))" }
+            .joined(separator: ",")
+
+        return "\(escape(identifier.target, ", ")),\(tagSet) \(fields.joined(separator: ",")) \(Int64(timestamp * 1_000_000_000))"
+    }
+}
+
+extension BenchmarkTool {
+    // The stream of the run, nil if not streaming or it couldn't be opened
+    func openStream() -> BenchmarkStreamWriter? {
+        guard let stream else {
+            return nil
+        }
+
+        do {
+            return try BenchmarkStreamWriter(path: stream, format: streamFormat, machine: benchmarkMachine())
+        } catch {
+            // The error thrown carries the errno, which may have been changed since
+            let permissionDenied: Bool
+            switch error {
+            case let error as Errno:
+                permissionDenied = error == .permissionDenied || error == .notPermitted
+            case let BenchmarkStreamError.socketConnectFailed(_, code):
+                permissionDenied = code == EACCES || code == EPERM
+            default:
+                permissionDenied = false
+            }
+
+            if permissionDenied {
+                print("Lacking permissions to write to \(stream)")
+                print("Give benchmark plugin permissions by running with e.g.:")
+                print("")
+                print("swift package --allow-writing-to-package-directory benchmark --stream \(stream)")
+                print("")
+            } else {
+                print("Failed to open stream \(stream) [\(String(reflecting: error))]")
+            }
+            return nil
+        }
+    }
+}
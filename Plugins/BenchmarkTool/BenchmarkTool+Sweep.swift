@@ -0,0 +1,247 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Size sweeps registered with Benchmark.sweep(), one benchmark per size
+
+import Benchmark
+import Foundation
+import TextTable
+
+// Identifies the benchmarks of a sweep, which only differ in the tag swept over
+struct BenchmarkSweep: Hashable {
+    var target: String
+    var name: String
+    var tags: [String: String]
+
+    init?(_ identifier: BenchmarkIdentifier, tags: [String: String], sweepTag: String) {
+        guard tags[sweepTag] != nil else {
+            return nil
+        }
+        // Strip the tags appended to the name, as done by Benchmark.name
+        let suffix = " (" + tags.sorted(by: { $0.key < $1.key })
+            .map { "\($0.key): \($0.value)" }
+            .joined(separator: ", ") + ")"
+        target = identifier.target
+        name = identifier.name.hasSuffix(suffix) ? String(identifier.name.dropLast(suffix.count)) : identifier.name
+        self.tags = tags.filter { $0.key != sweepTag }
+    }
+
+    // The name with the tags shared by all benchmarks of the sweep
+    var identifier: BenchmarkIdentifier {
+        let description = tags.sorted(by: { $0.key < $1.key })
+            .map { "\($0.key): \($0.value)" }
+            .joined(separator: ", ")
+        return BenchmarkIdentifier(target: target, name: description.isEmpty ? name : "\(name) (\(description))")
+    }
+}
+
+private struct ComplexityEntry {
+    var size: Int
+    var workingSet: String
+    var time: String
+    var timePerElement: String
+    var exponent: Int
+    var note: String
+}
+
+extension BenchmarkTool {
+    private func medianWallClock(_ results: [BenchmarkResult]?) -> Double? {
+        guard let wallClock = results?.first(where: { $0.metric == .wallClock }),
+            wallClock.statistics.measurementCount > 0
+        else {
+            return nil
+        }
+        return Double(wallClock.statistics.histogram.valueAtPercentile(50.0))
+    }
+
+    // The median wall clock time of each size of the sweeps found in results
+    private func sizeSweeps(_ results: BenchmarkResults) -> [BenchmarkSweep: [BenchmarkComplexityFit.Point]] {
+        var sweeps: [BenchmarkSweep: [BenchmarkComplexityFit.Point]] = [:]
+
+        for (identifier, results) in results {
+            guard let tags = results.first?.tags,
+                let size = tags[Benchmark.sizeTag].flatMap({ Int($0) }),
+                let sweep = BenchmarkSweep(identifier, tags: tags, sweepTag: Benchmark.sizeTag),
+                let nanoseconds = medianWallClock(results)
+            else {
+                continue
+            }
+            sweeps[sweep, default: []].append(.init(size: size, nanoseconds: nanoseconds))
+        }
+
+        return sweeps.mapValues { $0.sorted(by: { $0.size < $1.size }) }
+    }
+
+    // Adds growthExponent to the results of each benchmark in a sweep: the slope of its median wall clock
+    // time from the next smaller size on a log-log scale, times 100.
+    func addGrowthExponents(to results: inout BenchmarkResults) {
+        let sweeps = Dictionary(grouping: benchmarks) {
+            BenchmarkSweep(
+                BenchmarkIdentifier(target: $0.target, name: $0.name),
+                tags: $0.configuration.tags,
+                sweepTag: Benchmark.sizeTag
+            )
+        }
+
+        for (sweep, members) in sweeps where sweep != nil {
+            let sizedMembers = members.compactMap { member -> (benchmark: Benchmark, point: BenchmarkComplexityFit.Point)? in
+                guard let size = member.configuration.tags[Benchmark.sizeTag].flatMap({ Int($0) }),
+                    let nanoseconds = medianWallClock(results[member.benchmarkIdentifier])
+                else {
+                    return nil
+                }
+                return (member, .init(size: size, nanoseconds: nanoseconds))
+            }
+            .sorted(by: { $0.point.size < $1.point.size })
+
+            guard sizedMembers.count >= 2 else {
+                continue
+            }
+
+            let exponents = BenchmarkComplexityFit.growthExponents(sizedMembers.map(\.point))
+
+            for (member, exponent) in zip(sizedMembers.map(\.benchmark), exponents)
+            where member.configuration.metrics.contains(.growthExponent) {
+                let identifier = member.benchmarkIdentifier
+                guard var memberResults = results[identifier] else {
+                    continue
+                }
+
+                // Shrinking times are noise around constant time, as negative measurements can't be recorded
+                let statistics = Statistics(units: .count)
+                statistics.add(max(Int((100.0 * exponent).rounded()), 0))
+
+                memberResults.removeAll { $0.metric == .growthExponent }
+                memberResults.append(
+                    BenchmarkResult(
+                        metric: .growthExponent,
+                        timeUnits: .automatic,
+                        scalingFactor: .one,
+                        warmupIterations: member.configuration.warmupIterations,
+                        thresholds: member.configuration.thresholds?[.growthExponent],
+                        tags: member.configuration.tags,
+                        statistics: statistics
+                    )
+                )
+                memberResults.sort(by: { $0.metric.description > $1.metric.description })
+                results[identifier] = memberResults
+            }
+        }
+    }
+
+    // Fits the complexity models to each sweep, keyed by the identifier of the sweep without the size
+    func fitComplexity(
+        _ results: BenchmarkResults,
+        cacheLevels: [BenchmarkCacheLevel]
+    ) -> [BenchmarkIdentifier: BenchmarkComplexityFit]? {
+        var complexityFits: [BenchmarkIdentifier: BenchmarkComplexityFit] = [:]
+
+        for (sweep, points) in sizeSweeps(results) {
+            let bytesPerElement = sweep.tags[Benchmark.bytesPerElementTag].flatMap { Int($0) } ?? 1
+            if let fit = BenchmarkComplexityFit.fit(points, bytesPerElement: bytesPerElement, cacheLevels: cacheLevels) {
+                complexityFits[sweep.identifier] = fit
+            }
+        }
+
+        return complexityFits.isEmpty ? nil : complexityFits
+    }
+
+    // Prints a table per sweep with the time per element and growth exponent of each size,
+    // marking the cliffs and the cache level crossed, followed by the best fitting model
+    func prettyPrintComplexity(_ baseline: BenchmarkBaseline) {
+        guard let complexityFits = baseline.complexityFits, complexityFits.isEmpty == false else {
+            return
+        }
+
+        let table = TextTable<ComplexityEntry> {
+            [
+                Column(title: "Size", value: "\($0.size)", width: 12, align: .right),
+                Column(title: "Working set", value: $0.workingSet, width: 13, align: .right),
+                Column(title: "Time p50", value: $0.time, width: 14, align: .right),
+                Column(title: "Time / element", value: $0.timePerElement, width: 16, align: .right),
+                Column(title: "Exponent", value: String(format: "%.2f", Double($0.exponent) / 100), width: 10, align: .right),
+                Column(title: "", value: $0.note, width: 40, align: .left),
+            ]
+        }
+
+        for identifier in complexityFits.keys.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let fit = complexityFits[identifier]!
+            let exponents = BenchmarkComplexityFit.growthExponents(fit.points)
+
+            let entries = zip(fit.points, exponents).map { point, exponent -> ComplexityEntry in
+                var note = ""
+                if let cliff = fit.cliffs.first(where: { $0.toSize == point.size }) {
+                    note = String(format: "%.1fx slower per element", cliff.slowdown)
+                    if let cacheLevel = cliff.cacheLevel {
+                        note += ", past \(cacheLevel.description)"
+                    }
+                }
+                return ComplexityEntry(
+                    size: point.size,
+                    workingSet: BenchmarkComplexityFit.formatBytes(point.size * fit.bytesPerElement),
+                    time: formatNanoseconds(point.nanoseconds),
+                    timePerElement: formatNanoseconds(point.nanoseconds / Double(point.size)),
+                    exponent: Int((100.0 * exponent).rounded()),
+                    note: note
+                )
+            }
+
+            print("")
+            if format == .markdown {
+                print("### ", terminator: "")
+            }
+            print("\(identifier.target):\(identifier.name) complexity")
+            if format == .markdown {
+                print("")
+            }
+            table.print(entries, style: format.tableStyle)
+            print("Best fit: \(fit.description)")
+        }
+    }
+
+    // Warns about sweeps whose best fitting model differs between two baselines
+    func prettyPrintComplexityDelta(currentBaseline: BenchmarkBaseline, baseline: BenchmarkBaseline) {
+        guard let referenceFits = currentBaseline.complexityFits, let comparisonFits = baseline.complexityFits else {
+            return
+        }
+
+        let identifiers = Set(referenceFits.keys).intersection(comparisonFits.keys)
+        var printedHeader = false
+
+        for identifier in identifiers.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let reference = referenceFits[identifier]!
+            let comparison = comparisonFits[identifier]!
+            guard reference.model != comparison.model else {
+                continue
+            }
+
+            if printedHeader == false {
+                print("")
+                print("Complexity changes")
+                print("")
+                printedHeader = true
+            }
+            let change = comparison.model > reference.model ? "grows faster" : "grows slower"
+            print(
+                "  Warning: \(identifier.target):\(identifier.name) \(change), \(comparison.model.rawValue) in"
+                    + " '\(baseline.baselineName)' compared to \(reference.model.rawValue) in"
+                    + " '\(currentBaseline.baselineName)'"
+            )
+        }
+    }
+
+    private func formatNanoseconds(_ nanoseconds: Double) -> String {
+        let units = [(1_000_000_000.0, "s"), (1_000_000.0, "ms"), (1_000.0, "μs")]
+        for (divisor, unit) in units where nanoseconds >= divisor {
+            return String(format: "%.2f ", nanoseconds / divisor) + unit
+        }
+        return String(format: nanoseconds >= 10 ? "%.0f ns" : "%.2f ns", nanoseconds)
+    }
+}
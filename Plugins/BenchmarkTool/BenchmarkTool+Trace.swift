@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// The values of each measured iteration in order, see IterationTraceRecorder in the benchmark process
+
+import Benchmark
+import Foundation
+import TextTable
+
+private struct TraceEntry {
+    var metric: String
+    var samples: Int
+    var lag1Autocorrelation: Double
+    var period: String
+    var drift: Double
+    var note: String
+}
+
+extension BenchmarkTool {
+    // Reads the traces written by the benchmark processes, writes them as is and as CSV,
+    // and summarizes the metrics of each
+    func readTraces(_ benchmarks: [Benchmark]) -> [BenchmarkIdentifier: [String: BenchmarkTraceSummary]] {
+        var summaries: [BenchmarkIdentifier: [String: BenchmarkTraceSummary]] = [:]
+
+        for benchmark in benchmarks {
+            let fileName = BenchmarkTrace.fileName(target: benchmark.target, name: benchmark.name)
+
+            guard let data = FileManager.default.contents(atPath: "\(profileDirectory)/\(fileName)"),
+                let trace = BenchmarkTrace([UInt8](data))
+            else {
+                print("No trace for \(benchmark.target):\(benchmark.name)")
+                continue
+            }
+
+            if trace.iterations > trace.values[0].count {
+                print(
+                    "Warning: the trace of \(benchmark.target):\(benchmark.name) only has the last \(trace.values[0].count)"
+                        + " of \(trace.iterations) iterations, increase --trace-capacity to keep all."
+                )
+            }
+
+            let baseName = cleanupStringForShellSafety("\(benchmark.target).\(benchmark.name)")
+            do {
+                try write(exportData: [UInt8](data), fileName: "\(baseName).trace")
+                try write(exportData: trace.csv(), fileName: "\(baseName).trace.csv")
+            } catch {
+                print("Failed to write the trace of \(benchmark.target):\(benchmark.name): \(error)")
+            }
+
+            summaries[benchmark.benchmarkIdentifier] = trace.summaries()
+        }
+
+        return summaries
+    }
+
+    // Prints the autocorrelation, period and drift of each traced metric, flagging the benchmarks
+    // whose samples aren't independent, as the percentiles and comparisons assume they are
+    func prettyPrintTraces(_ baseline: BenchmarkBaseline) {
+        guard let traceSummaries = baseline.traceSummaries else {
+            return
+        }
+
+        let table = TextTable<TraceEntry> {
+            [
+                Column(title: "Metric", value: $0.metric, width: 32, align: .left),
+                Column(title: "Samples", value: "\($0.samples)", width: 10, align: .right),
+                Column(title: "Lag 1 r", value: String(format: "%.2f", $0.lag1Autocorrelation), width: 9, align: .right),
+                Column(title: "Period", value: $0.period, width: 12, align: .right),
+                Column(title: "Drift %", value: String(format: "%+.1f", 100 * $0.drift), width: 9, align: .right),
+                Column(title: "", value: $0.note, width: 20, align: .left),
+            ]
+        }
+
+        for identifier in traceSummaries.keys.sorted(by: { ($0.target, $0.name) < ($1.target, $1.name) }) {
+            let summaries = traceSummaries[identifier]!
+            guard summaries.isEmpty == false else {
+                continue
+            }
+
+            let entries = summaries.keys.sorted().map { metric -> TraceEntry in
+                let summary = summaries[metric]!
+                return TraceEntry(
+                    metric: metric,
+                    samples: summary.samples,
+                    lag1Autocorrelation: summary.lag1Autocorrelation,
+                    period: summary.period.map { "\($0) iter" } ?? "",
+                    drift: summary.drift,
+                    note: summary.independent ? "" : "not independent"
+                )
+            }
+
+            print("")
+            if format == .markdown {
+                print("### ", terminator: "")
+            }
+            print("\(identifier.target):\(identifier.name) iteration trace")
+            if format == .markdown {
+                print("")
+            }
+            table.print(entries, style: format.tableStyle)
+
+            let dependent = summaries.keys.sorted().filter { summaries[$0]!.independent == false }
+            if dependent.isEmpty == false {
+                print(
+                    "Warning: the samples of \(dependent.joined(separator: ", ")) are not independent, consecutive"
+                        + " iterations are correlated or repeat periodically, percentiles and comparisons may mislead."
+                )
+            }
+        }
+    }
+}
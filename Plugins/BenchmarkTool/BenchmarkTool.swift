@@ -32,6 +32,7 @@ enum BenchmarkOperation: String, ExpressibleByArgument {
     case run
     case query // query all benchmarks from target, used internally in tool
     case `init`
+    case history
 }
 
 extension Grouping: ExpressibleByArgument {}
@@ -125,8 +126,67 @@ struct BenchmarkTool: AsyncParsableCommand {
     @Option(name: .long, help: "Benchmarks matching the regexp filter that should be skipped")
     var skip: [String] = []
 
+    @Option(name: .long, help: "The number of benchmarks to run in parallel, each pinned to a disjoint set of CPUs (Linux only)")
+    var parallel: Int = 1
+
+    @Option(name: .long, help: "How CPUs are partitioned between parallel benchmarks \((CPUPartitioning.allCases).map { String(describing: $0) })")
+    var cpuPartitioning: CPUPartitioning = .cores
+
+    @Flag(
+        name: .long,
+        help:
+            """
+            Run benchmarks in a stabilized measurement environment (Linux only): pinned to a single CPU,
+            with memory locked, address space randomization disabled and the stack and heap pre-faulted.
+            """
+    )
+    var stabilize: Bool = false
+
+    @Option(name: .customLong("stabilize-cpu"), help: "The CPU to pin benchmarks to with --stabilize, defaults to an isolated CPU if available")
+    var stabilizeCPU: Int?
+
+    @Flag(name: .long, help: "Use SCHED_FIFO realtime scheduling with --stabilize, requires CAP_SYS_NICE")
+    var stabilizeRealtime: Bool = false
+
+    @Flag(name: .long, help: "Attribute the allocations of the measured region to their call stacks with the jemalloc heap profiler")
+    var allocationProfile: Bool = false
+
+    @Option(name: .long, help: "The average interval between allocation samples as a power of two in bytes")
+    var allocationProfileLgSample: Int = 10
+
+    @Flag(name: .long, help: "Attribute the retains, releases and object allocations of the measured region to types")
+    var arcTypes: Bool = false
+
+    @Flag(name: .long, help: "Sample the call stacks of the measured region with perf events and write them as folded stacks (Linux)")
+    var cpuProfile: Bool = false
+
+    @Option(name: .long, help: "The number of call stack samples per second when CPU profiling")
+    var cpuProfileFrequency: Int = 999
+
+    @Flag(name: .long, help: "Append the percentiles of the run to the history of each benchmark target")
+    var recordHistory: Bool = false
+
+    @Flag(name: .long, help: "Record the values of each measured iteration in order and test whether they are independent")
+    var trace: Bool = false
+
+    @Option(name: .long, help: "The number of iterations kept in the trace of each benchmark")
+    var traceCapacity: Int = BenchmarkTrace.defaultCapacity
+
+    @Option(name: .long, help: "The file, FIFO or Unix socket to stream the results of each benchmark to as it completes")
+    var stream: String?
+
+    @Option(name: .long, help: "The format of the streamed results \((StreamFormat.allCases).map { String(describing: $0) })")
+    var streamFormat: StreamFormat = .ndjson
+
+    @Flag(name: .long, help: "Store baselines in the indexed binary format instead of JSON, and prefer it when reading")
+    var binaryBaselines: Bool = false
+
     var inputFD: CInt = 0
     var outputFD: CInt = 0
+    var cpuSet: [Int]? // the CPUs the benchmark process is pinned to, if running in parallel or stabilized
+    var jsonProtocol: Bool {
+        getenv(jsonProtocolEnvironmentVariable) != nil
+    }
 
     var benchmarks: [Benchmark] = []
     var benchmarkBaselines: [BenchmarkBaseline] = [] // The baselines read from disk, merged + current run if needed
@@ -197,7 +257,9 @@ struct BenchmarkTool: AsyncParsableCommand {
             var readBaselines: [BenchmarkBaseline] = [] // The baselines read from disk
 
             try targets.forEach { target in // read from all the targets (baselines are stored separately)
-                let currentBaseline = try read(target: target, baselineIdentifier: baselineName)
+                let currentBaseline = try read(target: target, baselineIdentifier: baselineName) {
+                    includedInBaselines($0, $1)
+                }
 
                 if let currentBaseline {
                     readBaselines.append(currentBaseline)
@@ -234,8 +296,13 @@ struct BenchmarkTool: AsyncParsableCommand {
             return
         }
 
+        guard command != .history else {
+            printHistory()
+            return
+        }
+
         // Skip reading baselines for baseline operations not needing them
-        if let operation = baselineOperation, [.delete, .list, .update].contains(operation) == false {
+        if let operation = baselineOperation, [.delete, .list, .update, .convert].contains(operation) == false {
             try readBaselines()
             if [.compare, .check].contains(operation), benchmarkBaselines.count < 1, checkAbsolute == false {
                 print("Failed to read at least one benchmark baseline for compare/check operations.")
@@ -284,7 +351,7 @@ struct BenchmarkTool: AsyncParsableCommand {
             return
         }
 
-        if let operation = baselineOperation, [.delete, .list, .read].contains(operation) {
+        if let operation = baselineOperation, [.delete, .list, .read, .convert].contains(operation) {
             try postProcessBenchmarkResults()
             return
         }
@@ -311,13 +378,42 @@ struct BenchmarkTool: AsyncParsableCommand {
             "Running Benchmarks".printAsHeader()
         }
 
-        var benchmarkResults: BenchmarkResults = [:]
-
         benchmarks.sort { ($0.target, $0.name) < ($1.target, $1.name) }
 
-        // run each benchmark for the target as a separate process
-        try benchmarks.forEach { benchmark in
-            if try shouldIncludeBenchmark(benchmark.baseName) {
+        let benchmarksToRun = try benchmarks.filter { try shouldIncludeBenchmark($0.baseName) }
+
+        checkThreadsFitCPUs(benchmarksToRun)
+
+        if stabilize {
+            if quiet == false, format == .text {
+                printMeasurementEnvironmentReport()
+            }
+            #if os(Linux)
+            if parallel <= 1 {
+                cpuSet = [stabilizationCPU()]
+            }
+            #endif
+        }
+
+        if allocationProfile || arcTypes || cpuProfile || trace {
+            try createProfileDirectory()
+        }
+
+        let streamWriter = openStream()
+
+        var benchmarkResults: BenchmarkResults = [:]
+        var benchmarkCPUSets: [BenchmarkIdentifier: [Int]]?
+        var benchmarkDurations: [BenchmarkIdentifier: Double] = [:]
+
+        if parallel > 1 {
+            let parallelRun = try runBenchmarksInParallel(benchmarksToRun, streamWriter: streamWriter)
+            benchmarkResults = parallelRun.results
+            benchmarkCPUSets = parallelRun.cpuSets
+            benchmarkDurations = parallelRun.durations
+        } else {
+            // run each benchmark for the target as a separate process
+            try benchmarksToRun.forEach { benchmark in
+                let startTime = ContinuousClock.now
                 let results = try runChild(
                     benchmarkPath: benchmark.executablePath!,
                     benchmarkCommand: command,
@@ -327,21 +423,50 @@ struct BenchmarkTool: AsyncParsableCommand {
                         printChildRunError(error: result, benchmarkExecutablePath: benchmark.executablePath!)
                     }
                 }
+                let duration = (ContinuousClock.now - startTime).components
+                benchmarkDurations[benchmark.benchmarkIdentifier] =
+                    Double(duration.seconds) + Double(duration.attoseconds) / 1_000_000_000_000_000_000
 
+                streamWriter?.write(results)
                 benchmarkResults = benchmarkResults.merging(results) { _, new in new }
             }
         }
 
+        addScalingEfficiency(to: &benchmarkResults)
+        addGrowthExponents(to: &benchmarkResults)
+
+        let allocationProfiles = allocationProfile ? readAllocationProfiles(benchmarksToRun) : nil
+        let arcTypeProfiles = arcTypes ? readARCTypeProfiles(benchmarksToRun) : nil
+        let cpuProfiles = cpuProfile ? readCPUProfiles(benchmarksToRun) : nil
+        let traceSummaries = trace ? readTraces(benchmarksToRun) : nil
+
+        if allocationProfile || arcTypes || cpuProfile || trace {
+            removeProfileDirectory()
+        }
+
+        let machine = benchmarkMachine()
+
         // Insert benchmark run at first position of baselines
         baseline.append("Current_run")
         benchmarkBaselines.append(
             BenchmarkBaseline(
                 baselineName: "Current_run",
-                machine: benchmarkMachine(),
-                results: benchmarkResults
+                machine: machine,
+                results: benchmarkResults,
+                cpuSets: benchmarkCPUSets,
+                durations: benchmarkDurations,
+                allocationProfiles: allocationProfiles,
+                arcTypeProfiles: arcTypeProfiles,
+                cpuProfiles: cpuProfiles,
+                traceSummaries: traceSummaries,
+                complexityFits: fitComplexity(benchmarkResults, cacheLevels: machine.cacheLevels ?? [])
             )
         )
 
+        if recordHistory {
+            appendHistory(benchmarkBaselines[benchmarkBaselines.count - 1])
+        }
+
         try postProcessBenchmarkResults()
 
         if failedBenchmarkRuns > 0 {
@@ -355,6 +480,67 @@ struct BenchmarkTool: AsyncParsableCommand {
         cStrings.forEach { free($0) }
     }
 
+    // The parent environment, with the performance counters needed by the benchmark, the CPU set to run on,
+    // the stabilization, allocation/ARC/CPU profiling and trace settings added, as these must be applied at process startup.
+    func childEnvironment(benchmark: Benchmark?) -> [String] {
+        var environment: [String] = []
+        var index = 0
+
+        while let entry = environ[index] {
+            let variable = String(cString: entry)
+            if variable.hasPrefix("\(performanceCountersEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(cpuSetEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(stabilizationEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(allocationProfileEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(arcTypeProfileEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(cpuProfileEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(cpuProfileFrequencyEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(traceEnvironmentVariable)=") == false,
+                variable.hasPrefix("\(traceCapacityEnvironmentVariable)=") == false,
+                allocationProfile == false || benchmark == nil || variable.hasPrefix("MALLOC_CONF=") == false
+            {
+                environment.append(variable)
+            }
+            index += 1
+        }
+
+        if let cpuSet {
+            environment.append("\(cpuSetEnvironmentVariable)=\(CPUTopology.formatList(cpuSet))")
+        }
+
+        if stabilize, benchmark != nil {
+            let settings = ["norandomize", "mlockall", "prefault"] + (stabilizeRealtime ? ["fifo"] : [])
+            environment.append("\(stabilizationEnvironmentVariable)=\(settings.joined(separator: ","))")
+        }
+
+        if allocationProfile, benchmark != nil {
+            environment.append(contentsOf: allocationProfileEnvironment())
+        }
+
+        if arcTypes, benchmark != nil {
+            environment.append("\(arcTypeProfileEnvironmentVariable)=\(profileDirectory)")
+        }
+
+        if cpuProfile, benchmark != nil {
+            environment.append("\(cpuProfileEnvironmentVariable)=\(profileDirectory)")
+            environment.append("\(cpuProfileFrequencyEnvironmentVariable)=\(cpuProfileFrequency)")
+        }
+
+        if trace, benchmark != nil {
+            environment.append("\(traceEnvironmentVariable)=\(profileDirectory)")
+            environment.append("\(traceCapacityEnvironmentVariable)=\(traceCapacity)")
+        }
+
+        if let benchmark {
+            let events = benchmark.configuration.metrics.performanceCounterEvents
+            if events.isEmpty == false {
+                environment.append("\(performanceCountersEnvironmentVariable)=\(events.joined(separator: ","))")
+            }
+        }
+
+        return environment
+    }
+
     enum RunCommandError: Error {
         case WaitPIDError
         case POSIXSpawnError(Int32)
@@ -370,13 +556,14 @@ struct BenchmarkTool: AsyncParsableCommand {
         var pid: pid_t = 0
 
         var benchmarkResults: BenchmarkResults = [:]
-        let fromChild = try FileDescriptor.pipe()
-        let toChild = try FileDescriptor.pipe()
+        let (fromChild, toChild) = try spawnLock.withLock {
+            (try closeOnExecPipe(), try closeOnExecPipe())
+        }
         let path = FilePath(benchmarkPath)
         var args: [String] = [
             path.lastComponent!.description,
-            "--input-fd", toChild.readEnd.rawValue.description,
-            "--output-fd", fromChild.writeEnd.rawValue.description,
+            "--input-fd", childInputFD.description,
+            "--output-fd", childOutputFD.description,
             "--quiet", noProgress.description,
         ]
 
@@ -388,11 +575,58 @@ struct BenchmarkTool: AsyncParsableCommand {
             args.append(contentsOf: ["--time-units", timeUnits.rawValue])
         }
 
+        if jsonProtocol {
+            args.append("--json-protocol")
+        }
+
         inputFD = fromChild.readEnd.rawValue
         outputFD = toChild.writeEnd.rawValue
 
+        let environment = childEnvironment(benchmark: benchmark)
+
+        // The benchmark runs with the default handling of SIGPIPE, which the tool ignores when streaming
+        #if canImport(Darwin)
+        var attributes: posix_spawnattr_t?
+        #else
+        var attributes = posix_spawnattr_t()
+        #endif
+        posix_spawnattr_init(&attributes)
+        defer {
+            posix_spawnattr_destroy(&attributes)
+        }
+        var defaultSignals = sigset_t()
+        sigemptyset(&defaultSignals)
+        sigaddset(&defaultSignals, SIGPIPE)
+        posix_spawnattr_setsigdefault(&attributes, &defaultSignals)
+        posix_spawnattr_setflags(&attributes, Int16(POSIX_SPAWN_SETSIGDEF))
+
+        // The child only inherits its own ends of the pipes, as childInputFD and childOutputFD. They're first
+        // duplicated above all of them, so that no end is duplicated onto itself, which would keep it
+        // close-on-exec.
+        #if canImport(Darwin)
+        var fileActions: posix_spawn_file_actions_t?
+        #else
+        var fileActions = posix_spawn_file_actions_t()
+        #endif
+        posix_spawn_file_actions_init(&fileActions)
+        defer {
+            posix_spawn_file_actions_destroy(&fileActions)
+        }
+        let temporaryFD = max(toChild.readEnd.rawValue, fromChild.writeEnd.rawValue, childOutputFD) + 1
+        posix_spawn_file_actions_adddup2(&fileActions, toChild.readEnd.rawValue, temporaryFD)
+        posix_spawn_file_actions_adddup2(&fileActions, fromChild.writeEnd.rawValue, temporaryFD + 1)
+        posix_spawn_file_actions_adddup2(&fileActions, temporaryFD, childInputFD)
+        posix_spawn_file_actions_adddup2(&fileActions, temporaryFD + 1, childOutputFD)
+        posix_spawn_file_actions_addclose(&fileActions, temporaryFD)
+        posix_spawn_file_actions_addclose(&fileActions, temporaryFD + 1)
+
         try withCStrings(args) { cArgs in
-            var status = posix_spawn(&pid, path.string, nil, nil, cArgs, environ)
+            var status: Int32 = 0
+            withCStrings(environment) { cEnvironment in
+                spawnLock.withLock {
+                    status = posix_spawn(&pid, path.string, &fileActions, &attributes, cArgs, cEnvironment)
+                }
+            }
 
             // Close child ends of the pipes
             try toChild.readEnd.close()
@@ -400,7 +634,7 @@ struct BenchmarkTool: AsyncParsableCommand {
 
             do {
                 switch benchmarkCommand {
-                case .`init`:
+                case .`init`, .history:
                     fatalError("Should never come here")
                 case .query:
                     try queryBenchmarks(benchmarkPath) // Get all available benchmarks first
@@ -431,6 +665,10 @@ struct BenchmarkTool: AsyncParsableCommand {
         return benchmarkResults
     }
 
+    // The fds of the pipes in the benchmark process
+    private var childInputFD: Int32 { 3 }
+    private var childOutputFD: Int32 { 4 }
+
     struct FailedBenchmark: Codable {
         let benchmarkName: String
         let failureReason: String
@@ -8,16 +8,29 @@
 // http://www.apache.org/licenses/LICENSE-2.0
 //
 
+import BenchmarkShared
+import Foundation
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#endif
+
 #if os(Linux) && compiler(>=6.3) && canImport(SwiftRuntimeInterposerSwift)
 import SwiftRuntimeInterposerSwift
 #else
-import Atomics
 import SwiftRuntimeHooks
 #endif
 
 // swiftlint:disable prefer_self_in_static_references
 
 final class ARCStatsProducer {
+    // Set by the benchmark tool to attribute the ARC traffic to types, the directory to write the profiles to
+    static let typeProfileDirectory: String? = getenv(arcTypeProfileEnvironmentVariable).map { String(cString: $0) }
+
     #if os(Linux) && compiler(>=6.3) && canImport(SwiftRuntimeInterposerSwift)
     static let usesPreloadedInterposer = true
 
@@ -41,50 +54,132 @@ final class ARCStatsProducer {
             releaseCount: statistics.releaseCount
         )
     }
+
+    // The interposer only keeps totals
+    static let typeAttributionEnabled: Bool = {
+        if typeProfileDirectory != nil {
+            print("Warning: ARC type attribution isn't supported with the preloaded runtime interposer, not attributing.")
+        }
+        return false
+    }()
+
+    static func attributeTypes(_: Bool) {}
+
+    static func resetTypes() {}
+
+    static func typeProfile() -> BenchmarkARCTypeProfile {
+        BenchmarkARCTypeProfile(types: [])
+    }
+
+    static func writeTypeProfile(_: Benchmark) {}
     #else
-    typealias SwiftRuntimeHook = @convention(c) (UnsafeRawPointer?, UnsafeMutableRawPointer?) -> Void
     static let usesPreloadedInterposer = false
 
-    static var allocCount: UnsafeAtomic<Int> = .create(0)
-    static var retainCount: UnsafeAtomic<Int> = .create(0)
-    static var releaseCount: UnsafeAtomic<Int> = .create(0)
+    static let typeAttributionEnabled = typeProfileDirectory != nil
 
+    // The counters are thread-local in the hooks and summed over all threads when read
     static func hook() {
-        let allocObjectHook: SwiftRuntimeHook = { _, _ in
-            ARCStatsProducer.allocCount.wrappingIncrement(ordering: .relaxed)
-        }
+        swift_runtime_arc_counters_hook()
+    }
+
+    static func unhook() {
+        swift_runtime_arc_counters_unhook()
+    }
+
+    static func makeARCStats() -> ARCStats {
+        let counts = swift_runtime_arc_counters_read()
+        return ARCStats(
+            objectAllocCount: Int(counts.allocs),
+            retainCount: Int(counts.retains),
+            releaseCount: Int(counts.releases)
+        )
+    }
 
-        let retainHook: SwiftRuntimeHook = { _, _ in
-            ARCStatsProducer.retainCount.wrappingIncrement(ordering: .relaxed)
+    // Keys the counts by the metadata of the objects, only enabled for the measured region
+    static func attributeTypes(_ enabled: Bool) {
+        swift_runtime_arc_counters_attribute_types(enabled ? 1 : 0)
+    }
+
+    static func resetTypes() {
+        swift_runtime_arc_counters_reset_types()
+    }
+
+    // Resolves the metadata of the counted objects to type names
+    static func typeProfile() -> BenchmarkARCTypeProfile {
+        let capacity = 4_097 // the size of the merged table in the hooks
+        var counts = [swift_runtime_arc_type_counts_t](repeating: .init(), count: capacity)
+        let count = counts.withUnsafeMutableBufferPointer {
+            swift_runtime_arc_counters_types($0.baseAddress, capacity)
         }
 
-        let releaseHook: SwiftRuntimeHook = { _, _ in
-            ARCStatsProducer.releaseCount.wrappingIncrement(ordering: .relaxed)
+        var types: [String: BenchmarkARCTypeProfile.Entry] = [:]
+        for typeCounts in counts.prefix(count) {
+            let name = typeName(typeCounts.metadata)
+            var entry = types[name] ?? .init(type: name, allocations: 0, retains: 0, releases: 0)
+            entry.allocations += Int(typeCounts.allocs)
+            entry.retains += Int(typeCounts.retains)
+            entry.releases += Int(typeCounts.releases)
+            types[name] = entry
         }
 
-        swift_runtime_set_alloc_object_hook(allocObjectHook, nil)
-        swift_runtime_set_retain_hook(retainHook, nil)
-        swift_runtime_set_release_hook(releaseHook, nil)
+        return BenchmarkARCTypeProfile(types: Array(types.values))
     }
 
-    static func unhook() {
-        swift_runtime_set_release_hook(nil, nil)
-        swift_runtime_set_retain_hook(nil, nil)
-        swift_runtime_set_alloc_object_hook(nil, nil)
+    static func writeTypeProfile(_ benchmark: Benchmark) {
+        guard let typeProfileDirectory else {
+            return
+        }
+
+        let profile = typeProfile()
+        let fileName = BenchmarkARCTypeProfile.fileName(target: benchmark.target, name: benchmark.name)
+
+        do {
+            try JSONEncoder().encode(profile).write(to: URL(fileURLWithPath: "\(typeProfileDirectory)/\(fileName)"))
+        } catch {
+            print("Failed to write the ARC type profile for \(benchmark.name): \(error)")
+        }
     }
 
-    static func reset() {
-        allocCount.store(0, ordering: .relaxed)
-        retainCount.store(0, ordering: .relaxed)
-        releaseCount.store(0, ordering: .relaxed)
+    // The metadata kinds of heap objects that aren't class instances, see MetadataKind.def in the Swift runtime
+    private static let heapLocalVariableKind: UInt = 0x400
+    private static let heapGenericLocalVariableKind: UInt = 0x500
+    private static let errorObjectKind: UInt = 0x501
+    private static let taskKind: UInt = 0x502
+    private static let jobKind: UInt = 0x503
+    private static let lastEnumeratedKind: UInt = 0x7FF
+
+    static func typeName(_ metadata: UnsafeRawPointer?) -> String {
+        guard let metadata else {
+            return "<other types>"
+        }
+
+        let kind = metadata.load(as: UInt.self)
+        switch kind {
+        case 0, (lastEnumeratedKind + 1)...: // a class, with Objective-C interop the kind is the isa pointer
+            return _typeName(unsafeBitCast(metadata, to: Any.Type.self), qualified: true)
+        case heapLocalVariableKind:
+            // closure contexts and boxes have no name, but their metadata is emitted in the defining image
+            return "<closure context or box \(imageLocation(metadata))>"
+        case heapGenericLocalVariableKind:
+            return "<generic box>"
+        case errorObjectKind:
+            return "<error box>"
+        case taskKind:
+            return "<async task>"
+        case jobKind:
+            return "<async job>"
+        default:
+            return "<metadata kind 0x\(String(kind, radix: 16))>"
+        }
     }
 
-    static func makeARCStats() -> ARCStats {
-        ARCStats(
-            objectAllocCount: allocCount.load(ordering: .relaxed),
-            retainCount: retainCount.load(ordering: .relaxed),
-            releaseCount: releaseCount.load(ordering: .relaxed)
-        )
+    private static func imageLocation(_ address: UnsafeRawPointer) -> String {
+        var info = Dl_info()
+        guard dladdr(address, &info) != 0, let fileName = info.dli_fname, let base = info.dli_fbase else {
+            return String(format: "0x%lx", UInt(bitPattern: address))
+        }
+        let image = String(cString: fileName).split(separator: "/").last.map(String.init) ?? ""
+        return "\(image)+0x\(String(UInt(bitPattern: address) - UInt(bitPattern: base), radix: 16))"
     }
     #endif
 }
@@ -0,0 +1,71 @@
+//
+// Copyright (c) 2023 Ordo One AB
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Foundation
+
+/// The retains, releases and object allocations of the measured region of a benchmark attributed to
+/// the types of the objects, to find unwanted boxing and closure contexts.
+@_documentation(visibility: internal)
+public struct BenchmarkARCTypeProfile: Codable, Equatable {
+    public struct Entry: Codable, Equatable {
+        /// The type name, or a description of the heap object for boxes and closure contexts
+        public var type: String
+        public var allocations: Int
+        public var retains: Int
+        public var releases: Int
+
+        public init(type: String, allocations: Int, retains: Int, releases: Int) {
+            self.type = type
+            self.allocations = allocations
+            self.retains = retains
+            self.releases = releases
+        }
+
+        /// The retain/release traffic of the type
+        public var traffic: Int {
+            retains + releases
+        }
+    }
+
+    /// The types, most retain/release traffic first
+    public var types: [Entry]
+
+    public init(types: [Entry]) {
+        self.types = types.sorted { ($0.traffic, $0.allocations, $1.type) > ($1.traffic, $1.allocations, $0.type) }
+    }
+
+    public var totalTraffic: Int {
+        types.reduce(0) { $0 + $1.traffic }
+    }
+
+    public var totalAllocations: Int {
+        types.reduce(0) { $0 + $1.allocations }
+    }
+
+    /// The types with the most allocations first
+    public var typesByAllocations: [Entry] {
+        types.filter { $0.allocations > 0 }
+            .sorted { ($0.allocations, $0.traffic, $1.type) > ($1.allocations, $1.traffic, $0.type) }
+    }
+
+    /// Keeps the `count` types with the most traffic and the `count` types with the most allocations,
+    /// to bound the size of stored baselines
+    public func top(_ count: Int) -> BenchmarkARCTypeProfile {
+        let kept = Set(types.prefix(count).map(\.type)).union(typesByAllocations.prefix(count).map(\.type))
+        return BenchmarkARCTypeProfile(types: types.filter { kept.contains($0.type) })
+    }
+
+    /// The name of the file a benchmark process stores the profile of a benchmark in
+    public static func fileName(target: String, name: String) -> String {
+        "\(target).\(name).arc-types.json"
+            .replacingOccurrences(of: "/", with: "_")
+            .replacingOccurrences(of: " ", with: "_")
+    }
+}
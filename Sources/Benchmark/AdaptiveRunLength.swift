@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Histogram
+
+// Decides when warmup is over and when enough samples have been measured for BenchmarkRunLength.adaptive,
+// fed with the running time of each iteration by the executor.
+struct AdaptiveRunLength {
+    static let confidenceZ = 1.96 // 95% two-sided
+
+    let percentiles: [BenchmarkResult.Percentile]
+    let relativeWidth: Double
+    let window: Int // samples per window of the warmup change test
+    let maxWarmupIterations: Int
+
+    private(set) var warmupIterations = 0
+    private(set) var steadyStateDetected = false
+    private(set) var relativeWidths: [Double]
+    private(set) var converged = false
+
+    private var warmupSamples: [Int] // the last two windows, as a ring buffer
+    private var stableWindows = 0 // consecutive comparisons without a significant change
+    private let samples = Statistics(units: .count)
+    private var nextCheck: Int
+
+    init(percentiles: [BenchmarkResult.Percentile], relativeWidth: Double, maxIterations: Int) {
+        // p0 and p100 have no confidence interval
+        let percentiles = percentiles.filter { $0 != .p0 && $0 != .p100 }
+        self.percentiles = percentiles.isEmpty ? [.p50] : percentiles
+        self.relativeWidth = relativeWidth
+        window = min(max(maxIterations / 40, 5), 25)
+        maxWarmupIterations = max(2 * window, maxIterations / 4)
+        relativeWidths = .init(repeating: .infinity, count: self.percentiles.count)
+        warmupSamples = .init(repeating: 0, count: 2 * window)
+        nextCheck = 2 * window
+    }
+
+    var precision: BenchmarkRunPrecision {
+        BenchmarkRunPrecision(
+            warmupIterations: warmupIterations,
+            steadyStateDetected: steadyStateDetected,
+            percentiles: percentiles,
+            relativeWidths: relativeWidths,
+            converged: converged
+        )
+    }
+
+    // Returns true when the samples have settled down, or warmup has run out of iterations
+    mutating func addWarmupSample(_ value: Int) -> Bool {
+        warmupSamples[warmupIterations % warmupSamples.count] = value
+        warmupIterations += 1
+
+        if warmupIterations >= warmupSamples.count {
+            // A change test on a sliding window: compare the last window with the window before it,
+            // and require a few comparisons in a row without a significant change
+            let oldest = warmupIterations % warmupSamples.count
+            let previous = (0..<window).map { warmupSamples[(oldest + $0) % warmupSamples.count] }
+            let last = (window..<2 * window).map { warmupSamples[(oldest + $0) % warmupSamples.count] }
+
+            if abs(Self.mannWhitneyZ(previous, last)) < Self.confidenceZ {
+                stableWindows += 1
+            } else {
+                stableWindows = 0
+            }
+
+            if stableWindows >= max(window / 2, 2) {
+                steadyStateDetected = true
+                return true
+            }
+        }
+
+        return warmupIterations >= maxWarmupIterations
+    }
+
+    // Returns true when the confidence intervals of all percentiles are narrower than the target
+    mutating func addSample(_ value: Int) -> Bool {
+        samples.add(value)
+
+        guard samples.measurementCount >= nextCheck else {
+            return false
+        }
+        // Checking walks the histogram, so check less often as the samples accumulate
+        nextCheck = samples.measurementCount + max(window, samples.measurementCount / 20)
+
+        for (index, percentile) in percentiles.enumerated() {
+            relativeWidths[index] = Self.relativeConfidenceIntervalWidth(
+                samples.histogram,
+                percentile: Statistics.defaultPercentilesToCalculate[percentile.rawValue]
+            )
+        }
+
+        converged = relativeWidths.allSatisfy { $0 <= relativeWidth }
+        return converged
+    }
+
+    // The distribution free confidence interval of a percentile, between the order statistics whose ranks
+    // are the normal approximation of the binomial interval around n * p. Infinite until there are enough
+    // samples for both ends of the interval.
+    static func relativeConfidenceIntervalWidth(_ histogram: Histogram<UInt>, percentile: Double) -> Double {
+        let count = Double(histogram.totalCount)
+        let quantile = percentile / 100.0
+        let spread = confidenceZ * (count * quantile * (1.0 - quantile)).squareRoot()
+        let lowerRank = (count * quantile - spread).rounded(.down)
+        let upperRank = (count * quantile + spread).rounded(.up) + 1
+
+        guard lowerRank >= 1, upperRank <= count else {
+            return .infinity
+        }
+
+        let value = Double(histogram.valueAtPercentile(percentile))
+        let lower = Double(histogram.valueAtPercentile(100.0 * lowerRank / count))
+        let upper = Double(histogram.valueAtPercentile(100.0 * upperRank / count))
+
+        guard value > 0 else {
+            return upper > lower ? .infinity : 0
+        }
+        return (upper - lower) / value
+    }
+
+    // The normal approximation of the Mann-Whitney U statistic of two equally sized windows,
+    // near zero when neither window tends to have larger values than the other
+    static func mannWhitneyZ(_ first: [Int], _ second: [Int]) -> Double {
+        var u = 0.0
+        for a in first {
+            for b in second {
+                if a < b {
+                    u += 1
+                } else if a == b {
+                    u += 0.5
+                }
+            }
+        }
+        let n1 = Double(first.count)
+        let n2 = Double(second.count)
+        let mean = n1 * n2 / 2
+        let deviation = (n1 * n2 * (n1 + n2 + 1) / 12).squareRoot()
+        return deviation > 0 ? (u - mean) / deviation : 0
+    }
+}
@@ -1,3 +1,5 @@
+import Foundation
+
 public extension Benchmark {
     /// Definition of a Benchmark
     /// - Parameters:
@@ -129,3 +131,155 @@ public extension Benchmark {
         }
     }
 }
+
+public extension Benchmark {
+    /// The tag holding the number of threads of each benchmark registered by ``scalability(_:threads:configuration:closure:setup:teardown:)``
+    static let threadsTag = "threads"
+
+    /// The thread counts used for scalability benchmarks by default, powers of two up to the number of active processors
+    static var defaultThreadCounts: [Int] {
+        let processors = max(ProcessInfo.processInfo.activeProcessorCount, 1)
+        var threadCounts: [Int] = []
+        var threads = 1
+        while threads < processors {
+            threadCounts.append(threads)
+            threads *= 2
+        }
+        threadCounts.append(processors)
+        return threadCounts
+    }
+
+    /// Definition of a multi-threaded scalability benchmark, registering one benchmark for each thread count
+    /// with the number of threads as the `threads` tag.
+    ///
+    /// For each iteration, the closure is run concurrently on all threads, released together by a barrier.
+    /// ``BenchmarkMetric/scalingEfficiency`` is reported for each thread count relative to the single
+    /// threaded throughput, which requires that `threads` includes 1.
+    /// - Parameters:
+    ///   - name: The name used for display purposes of the benchmarks (also used for
+    ///   matching when comparing to baselines)
+    ///   - threads: The thread counts to register benchmarks for
+    ///   - configuration: Defines the settings that should be used for the benchmarks
+    ///   - closure: The actual benchmark closure that will be measured, called concurrently from all threads
+    ///   - setup: A closure that will be run once before the benchmark iterations are run
+    ///   - teardown: A closure that will be run once after the benchmark iterations are done
+    @discardableResult
+    static func scalability(
+        _ name: String,
+        threads: [Int] = defaultThreadCounts,
+        configuration: Benchmark.Configuration = Benchmark.defaultConfiguration,
+        closure: @escaping BenchmarkClosure,
+        setup: BenchmarkSetupHook? = nil,
+        teardown: BenchmarkTeardownHook? = nil
+    ) -> [Benchmark] {
+        Set(threads.filter { $0 > 0 }).sorted().compactMap { threadCount in
+            var threadConfiguration = configuration
+            threadConfiguration.threads = threadCount
+            threadConfiguration.tags[threadsTag] = "\(threadCount)"
+            for metric in [BenchmarkMetric.throughput, .scalingEfficiency]
+            where threadConfiguration.metrics.contains(metric) == false {
+                threadConfiguration.metrics.append(metric)
+            }
+            return Benchmark(
+                name,
+                configuration: threadConfiguration,
+                closure: closure,
+                setup: setup,
+                teardown: teardown
+            )
+        }
+    }
+
+    /// The tag holding the size of each benchmark registered by ``sweep(_:sizes:bytesPerElement:configuration:closure:setup:teardown:)-swift.type.method``
+    static let sizeTag = "size"
+
+    /// The tag holding the bytes of the working set per unit of size of a sweep, when other than 1
+    static let bytesPerElementTag = "bytesPerElement"
+
+    /// Powers of two for the given exponents, e.g. `powersOfTwo(4...24)` for the sizes 16 to 16M
+    static func powersOfTwo(_ exponents: ClosedRange<Int>) -> [Int] {
+        exponents.filter { $0 >= 0 && $0 < Int.bitWidth - 1 }.map { 1 << $0 }
+    }
+
+    /// The sizes used for sweeps by default, the powers of two from 2^4 to 2^24
+    static var defaultSweepSizes: [Int] {
+        powersOfTwo(4...24)
+    }
+
+    /// Definition of a size sweep, registering one benchmark for each size with the size as the `size` tag.
+    ///
+    /// The median wall clock time of the sizes is fitted to O(1), O(log n), O(n), O(n log n) and O(n²) and
+    /// steps in the time per element are matched to the cache and TLB levels of the machine, using
+    /// `bytesPerElement` to get the working set of each size. ``BenchmarkMetric/growthExponent`` is
+    /// reported for each size, so that thresholds can be set on the growth rate.
+    /// - Parameters:
+    ///   - name: The name used for display purposes of the benchmarks (also used for
+    ///   matching when comparing to baselines)
+    ///   - sizes: The sizes to register benchmarks for, at least three are needed for a fit
+    ///   - bytesPerElement: The bytes of the working set per unit of size
+    ///   - configuration: Defines the settings that should be used for the benchmarks
+    ///   - closure: The actual benchmark closure that will be measured, taking the size as a parameter
+    ///   - setup: A closure that will be run once with the size before the benchmark iterations are run
+    ///   - teardown: A closure that will be run once after the benchmark iterations are done
+    @discardableResult
+    static func sweep(
+        _ name: String,
+        sizes: [Int] = defaultSweepSizes,
+        bytesPerElement: Int = 1,
+        configuration: Benchmark.Configuration = Benchmark.defaultConfiguration,
+        closure: @escaping (_ benchmark: Benchmark, _ size: Int) -> Void,
+        setup: ((_ size: Int) async throws -> Void)? = nil,
+        teardown: BenchmarkTeardownHook? = nil
+    ) -> [Benchmark] {
+        Set(sizes.filter { $0 > 0 }).sorted().compactMap { size in
+            Benchmark(
+                name,
+                configuration: sweepConfiguration(configuration, size: size, bytesPerElement: bytesPerElement),
+                closure: { closure($0, size) },
+                setup: setup.map { setup in { try await setup(size) } },
+                teardown: teardown
+            )
+        }
+    }
+
+    /// Definition of an async size sweep, registering one benchmark for each size with the size as the `size` tag.
+    ///
+    /// See ``sweep(_:sizes:bytesPerElement:configuration:closure:setup:teardown:)-swift.type.method``.
+    @discardableResult
+    static func sweep(
+        _ name: String,
+        sizes: [Int] = defaultSweepSizes,
+        bytesPerElement: Int = 1,
+        configuration: Benchmark.Configuration = Benchmark.defaultConfiguration,
+        closure: @escaping (_ benchmark: Benchmark, _ size: Int) async -> Void,
+        setup: ((_ size: Int) async throws -> Void)? = nil,
+        teardown: BenchmarkTeardownHook? = nil
+    ) -> [Benchmark] {
+        Set(sizes.filter { $0 > 0 }).sorted().compactMap { size in
+            Benchmark(
+                name,
+                configuration: sweepConfiguration(configuration, size: size, bytesPerElement: bytesPerElement),
+                closure: { await closure($0, size) },
+                setup: setup.map { setup in { try await setup(size) } },
+                teardown: teardown
+            )
+        }
+    }
+
+    private static func sweepConfiguration(
+        _ configuration: Benchmark.Configuration,
+        size: Int,
+        bytesPerElement: Int
+    ) -> Benchmark.Configuration {
+        var sizeConfiguration = configuration
+        sizeConfiguration.tags[sizeTag] = "\(size)"
+        if bytesPerElement != 1 {
+            sizeConfiguration.tags[bytesPerElementTag] = "\(bytesPerElement)"
+        }
+        for metric in [BenchmarkMetric.wallClock, .growthExponent]
+        where sizeConfiguration.metrics.contains(metric) == false {
+            sizeConfiguration.metrics.append(metric)
+        }
+        return sizeConfiguration
+    }
+}
@@ -185,7 +185,13 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
             maxDuration: .seconds(1),
             maxIterations: 10_000,
             skip: false,
-            thresholds: nil
+            thresholds: nil,
+            performanceCounterScope: .process,
+            batching: BenchmarkBatching.none,
+            threads: 1,
+            runLength: BenchmarkRunLength.fixed,
+            asyncExecution: BenchmarkAsyncExecution.taskPerIteration,
+            subtractTimingOverhead: false
         ),
         lock: configurationLock
     )
@@ -207,6 +213,7 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
 
     static var testSkipBenchmarkRegistrations = false // true in test to avoid bench registration fail
     var measurementCompleted = false // Keep track so we skip multiple 'end of measurement'
+    var explicitMeasurementUsed = false // Benchmarks using startMeasurement()/stopMeasurement() can't be batched
 
     enum CodingKeys: String, CodingKey {
         case baseName = "name"
@@ -387,7 +394,12 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
     /// If the benchmark contains a preamble setup that should not be part of the measurement
     /// `startMeasurement` can be called explicitly to define when measurement should begin.
     /// Otherwise the whole benchmark will be measured.
+    /// Not supported for benchmarks running on multiple threads, which are measured around all threads.
     public func startMeasurement() {
+        guard configuration.threads <= 1 else {
+            return
+        }
+        explicitMeasurementUsed = true
         _startMeasurement(true)
     }
 
@@ -401,7 +413,12 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
     /// If the benchmark contains a postample that should not be part of the measurement
     /// `stopMeasurement` can be called explicitly to define when measurement should stop.
     /// Otherwise the whole benchmark will be measured.
+    /// Not supported for benchmarks running on multiple threads, which are measured around all threads.
     public func stopMeasurement() {
+        guard configuration.threads <= 1 else {
+            return
+        }
+        explicitMeasurementUsed = true
         _stopMeasurement(true)
     }
 
@@ -427,11 +444,15 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
 
     // https://forums.swift.org/t/actually-waiting-for-a-task/56230
     // Async closures can possibly show false memory leaks possibly due to Swift runtime allocations
-    func runAsync() {
+    func runAsync(batchSize: Int = 1) {
         guard let asyncClosure else {
             fatalError("Tried to runAsync on benchmark instance without any async closure set")
         }
 
+        runAsync(batchSize: batchSize, closure: asyncClosure)
+    }
+
+    private func runAsync(batchSize: Int, closure asyncClosure: @escaping BenchmarkAsyncClosure) {
         let semaphore = DispatchSemaphore(value: 0)
 
         // Must do this in a separate thread, otherwise we block the concurrent thread pool
@@ -439,7 +460,9 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
             .async {
                 Task {
                     self._startMeasurement(false)
-                    await asyncClosure(self)
+                    for _ in 0..<batchSize {
+                        await asyncClosure(self)
+                    }
                     self._stopMeasurement(false)
 
                     semaphore.signal()
@@ -448,6 +471,41 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
         semaphore.wait()
     }
 
+    // Runs the async closure batchSize times per measurement for as long as `before` returns true and `after`
+    // doesn't return false, all in one task started by the configured async execution, so that no task is
+    // created and no thread hop is made per iteration. Returns once the task has completed.
+    func runAsyncIterations(batchSize: Int, before: @escaping () -> Bool, after: @escaping () -> Bool) {
+        guard let asyncClosure, let startTask = configuration.asyncExecution.startTask else {
+            fatalError("Tried to runAsyncIterations on benchmark instance without async closure or single task")
+        }
+
+        let semaphore = DispatchSemaphore(value: 0)
+
+        // Started from a separate thread, otherwise we block the concurrent thread pool
+        DispatchQueue.global(qos: .userInitiated)
+            .async {
+                let task = startTask {
+                    while before() {
+                        self._startMeasurement(false)
+                        for _ in 0..<batchSize {
+                            await asyncClosure(self)
+                        }
+                        self._stopMeasurement(false)
+
+                        if after() == false {
+                            break
+                        }
+                    }
+                }
+
+                Task {
+                    await task.value
+                    semaphore.signal()
+                }
+            }
+        semaphore.wait()
+    }
+
     // Public but should only be used by BenchmarkRunner
     @_documentation(visibility: internal)
     public func run() {
@@ -459,6 +517,41 @@ public final class Benchmark: Codable, Hashable { // swiftlint:disable:this type
             runAsync()
         }
     }
+
+    // Runs the benchmark closure once on each thread of the group as a single measurement, used for
+    // multi-threaded benchmarks
+    func run(threadGroup: BenchmarkThreadGroup) {
+        _startMeasurement(false)
+        threadGroup.run()
+        _stopMeasurement(false)
+    }
+
+    // Runs an empty closure through the same measurement path as the benchmark closure, used to measure
+    // the overhead of timing that is subtracted from the measurements
+    func runEmpty() {
+        if closure != nil {
+            let emptyClosure: BenchmarkClosure = identity { _ in }
+            _startMeasurement(false)
+            emptyClosure(self)
+            _stopMeasurement(false)
+        } else {
+            runAsync(batchSize: 1, closure: identity { _ in })
+        }
+    }
+
+    // Runs the benchmark closure batchSize times as a single measurement, used for automatic batching
+    @_documentation(visibility: internal)
+    public func run(batchSize: Int) {
+        if let closure {
+            _startMeasurement(false)
+            for _ in 0..<batchSize {
+                closure(self)
+            }
+            _stopMeasurement(false)
+        } else {
+            runAsync(batchSize: batchSize)
+        }
+    }
 }
 
 public extension Benchmark {
@@ -488,6 +581,25 @@ public extension Benchmark {
         public var skip = false
         /// Customized threshold tolerances for a given metric for the Benchmark used for checking for regressions/improvements/equality.
         public var thresholds: [BenchmarkMetric: BenchmarkThresholds]?
+        /// Whether hardware performance counters should count the whole process or only the thread running the benchmark
+        public var performanceCounterScope: BenchmarkPerformanceCounterScope
+        /// Whether multiple invocations of the benchmark closure should be timed together as a single sample,
+        /// for benchmarks running in the nanosecond range
+        public var batching: BenchmarkBatching
+        /// The number of threads running the benchmark closure concurrently for each iteration, released together
+        /// by a barrier. ``BenchmarkMetric/wallClock`` is then the latency of each invocation merged from all threads
+        /// and ``BenchmarkMetric/throughput`` the aggregate throughput of all threads.
+        public var threads: Int
+        /// Whether the benchmark runs for the configured warmup and maximum iterations/duration, or detects
+        /// the end of warmup and stops once the percentiles are measured precisely enough
+        public var runLength: BenchmarkRunLength
+        /// Whether each iteration of a benchmark with an async closure runs in a new task, or all iterations
+        /// run in one long-lived task, optionally on a custom executor
+        public var asyncExecution: BenchmarkAsyncExecution = .taskPerIteration
+        /// Whether the overhead of timing an empty closure is subtracted from each wall clock and throughput sample.
+        /// Off by default, so that the samples are the time measured. The overhead subtracted is recorded in the
+        /// results and comparisons with baselines measured otherwise warn about it.
+        public var subtractTimingOverhead = false
         /// Optional per-benchmark specific setup done before warmup and all iterations
         public var setup: BenchmarkSetupHook?
         /// Optional per-benchmark specific teardown done after final run is done
@@ -505,6 +617,12 @@ public extension Benchmark {
             skip: Bool = defaultConfiguration.skip,
             thresholds: [BenchmarkMetric: BenchmarkThresholds]? =
                 defaultConfiguration.thresholds,
+            performanceCounterScope: BenchmarkPerformanceCounterScope = defaultConfiguration.performanceCounterScope,
+            batching: BenchmarkBatching = defaultConfiguration.batching,
+            threads: Int = defaultConfiguration.threads,
+            runLength: BenchmarkRunLength = defaultConfiguration.runLength,
+            asyncExecution: BenchmarkAsyncExecution = defaultConfiguration.asyncExecution,
+            subtractTimingOverhead: Bool = defaultConfiguration.subtractTimingOverhead,
             setup: BenchmarkSetupHook? = nil,
             teardown: BenchmarkTeardownHook? = nil
         ) {
@@ -518,10 +636,37 @@ public extension Benchmark {
             self.maxIterations = maxIterations
             self.skip = skip
             self.thresholds = thresholds
+            self.performanceCounterScope = performanceCounterScope
+            self.batching = batching
+            self.threads = threads
+            self.runLength = runLength
+            self.asyncExecution = asyncExecution
+            self.subtractTimingOverhead = subtractTimingOverhead
             self.setup = setup
             self.teardown = teardown
         }
 
+        // Configurations encoded by older versions of the runner don't have the keys added since, those
+        // are decoded as the behavior of those versions
+        public init(from decoder: Decoder) throws {
+            let container = try decoder.container(keyedBy: CodingKeys.self)
+            metrics = try container.decode([BenchmarkMetric].self, forKey: .metrics)
+            tags = try container.decode([String: String].self, forKey: .tags)
+            timeUnits = try container.decode(BenchmarkTimeUnits.self, forKey: .timeUnits)
+            units = try container.decode([BenchmarkMetric: BenchmarkUnits].self, forKey: .units)
+            warmupIterations = try container.decode(Int.self, forKey: .warmupIterations)
+            scalingFactor = try container.decode(BenchmarkScalingFactor.self, forKey: .scalingFactor)
+            maxDuration = try container.decode(Duration.self, forKey: .maxDuration)
+            maxIterations = try container.decode(Int.self, forKey: .maxIterations)
+            thresholds = try container.decodeIfPresent([BenchmarkMetric: BenchmarkThresholds].self, forKey: .thresholds)
+            performanceCounterScope =
+                try container.decodeIfPresent(BenchmarkPerformanceCounterScope.self, forKey: .performanceCounterScope)
+                ?? .process
+            batching = try container.decodeIfPresent(BenchmarkBatching.self, forKey: .batching) ?? BenchmarkBatching.none
+            threads = try container.decodeIfPresent(Int.self, forKey: .threads) ?? 1
+            runLength = try container.decodeIfPresent(BenchmarkRunLength.self, forKey: .runLength) ?? .fixed
+        }
+
         // swiftlint:disable nesting
         enum CodingKeys: String, CodingKey {
             case metrics
@@ -533,6 +678,10 @@ public extension Benchmark {
             case maxDuration
             case maxIterations
             case thresholds
+            case performanceCounterScope
+            case batching
+            case threads
+            case runLength
         }
         // swiftlint:enable nesting
     }
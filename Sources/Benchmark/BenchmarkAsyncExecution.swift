@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+/// How the iterations of a benchmark with an async closure are run.
+public struct BenchmarkAsyncExecution {
+    // Starts the task running all iterations, nil if each iteration runs in a task of its own
+    let startTask: ((@escaping () async -> Void) -> Task<Void, Never>)?
+
+    /// Each iteration runs in a new task, started from a separate thread that the benchmark waits for.
+    public static var taskPerIteration: BenchmarkAsyncExecution {
+        BenchmarkAsyncExecution(startTask: nil)
+    }
+
+    /// All iterations run in one long-lived task on the global concurrent executor, which also takes the
+    /// measurements, so no task is created and no thread hop is made per iteration.
+    public static var singleTask: BenchmarkAsyncExecution {
+        BenchmarkAsyncExecution { operation in
+            Task {
+                await operation()
+            }
+        }
+    }
+
+    /// All iterations run in one long-lived task preferring `taskExecutor`, so that the benchmark closure
+    /// and the nonisolated async functions it calls run on that executor.
+    @available(macOS 15.0, iOS 18.0, tvOS 18.0, watchOS 11.0, visionOS 2.0, *)
+    public static func singleTask(taskExecutor: any TaskExecutor) -> BenchmarkAsyncExecution {
+        BenchmarkAsyncExecution { operation in
+            Task(executorPreference: taskExecutor) {
+                await operation()
+            }
+        }
+    }
+
+    /// All iterations run in one long-lived task whose jobs are all run by `serialExecutor`, so that actors
+    /// using the same executor are entered by the benchmark closure without switching threads.
+    @available(macOS 15.0, iOS 18.0, tvOS 18.0, watchOS 11.0, visionOS 2.0, *)
+    public static func singleTask(serialExecutor: any SerialExecutor) -> BenchmarkAsyncExecution {
+        singleTask(taskExecutor: SerialTaskExecutor(serialExecutor))
+    }
+}
+
+// Runs the jobs of the task preferring it on a serial executor
+@available(macOS 15.0, iOS 18.0, tvOS 18.0, watchOS 11.0, visionOS 2.0, *)
+private final class SerialTaskExecutor: TaskExecutor {
+    let serialExecutor: any SerialExecutor
+
+    init(_ serialExecutor: any SerialExecutor) {
+        self.serialExecutor = serialExecutor
+    }
+
+    func enqueue(_ job: consuming ExecutorJob) {
+        serialExecutor.enqueue(job)
+    }
+}
@@ -8,6 +8,8 @@
 
 // An implementation of a clock suitable for benchmarking using clock_gettime_nsec_np() on macOS
 // which is ~2-3 x less overhead.
+// On Linux the cycle counter (TSC on x86_64, CNTVCT on arm64) is read directly when it's invariant and
+// calibrates consistently against CLOCK_MONOTONIC_RAW, otherwise clock_gettime(CLOCK_BOOTTIME) is used.
 
 // swiftlint:disable identifier_name
 
@@ -24,6 +26,10 @@ import Musl
 #error("Unsupported Platform")
 #endif
 
+#if os(Linux)
+import CLinuxOperatingSystemStats
+#endif
+
 @_documentation(visibility: internal)
 public struct BenchmarkClock {
     /// A continuous point in time used for `BenchmarkClock`.
@@ -36,6 +42,14 @@ public struct BenchmarkClock {
     }
 
     public init() {}
+
+    #if os(Linux)
+    /// The calibration of the cycle counter, nil if it isn't reliable as a clock on this machine
+    static let cycleCounter: cycleClockCalibration? = {
+        var calibration = cycleClockCalibration()
+        return CLinuxCycleClockInit(&calibration) != 0 ? calibration : nil
+    }()
+    #endif
 }
 
 @_documentation(visibility: internal)
@@ -60,6 +74,10 @@ extension BenchmarkClock: Clock {
         #if canImport(Darwin)
         return Duration.nanoseconds(1)
         #elseif os(Linux)
+        if let cycleCounter = BenchmarkClock.cycleCounter {
+            return Duration.nanoseconds(max(cycleCounter.multiplier >> 32, 1))
+        }
+
         var resolution = timespec()
 
         let result = clock_getres(CLOCK_BOOTTIME, &resolution)
@@ -91,6 +109,17 @@ extension BenchmarkClock: Clock {
             )
         )
         #elseif os(Linux)
+        if let cycleCounter = BenchmarkClock.cycleCounter {
+            let nanos = CLinuxCycleClockNanoseconds(cycleCounter)
+
+            return BenchmarkClock.Instant(
+                _value: Duration(
+                    secondsComponent: Int64(nanos / 1_000_000_000),
+                    attosecondsComponent: Int64(nanos % 1_000_000_000) * 1_000_000_000
+                )
+            )
+        }
+
         var timespec = timespec()
         let result = clock_gettime(CLOCK_BOOTTIME, &timespec)
 
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Binary framing of replies sent from the benchmark process to the benchmark tool.
+//
+// Results are sent as a sequence of frames, one per metric, so neither side needs to
+// hold the encoding of all results at once. The histogram of each metric is sent in
+// the binary HdrHistogram encoding, while the (small) remaining metadata is JSON.
+// All other replies are sent as a single frame with the JSON encoded reply.
+
+import Foundation
+import Histogram
+
+@_documentation(visibility: internal)
+public enum BenchmarkReplyFrame: UInt8 {
+    case reply = 0 // JSON encoded BenchmarkCommandReply
+    case resultBegin = 1 // JSON encoded Benchmark
+    case metricResult = 2 // varint length, JSON encoded BenchmarkResult without histogram, encoded histogram
+    case resultEnd = 3
+}
+
+@_documentation(visibility: internal)
+public enum BenchmarkReplyCodingError: Error {
+    case invalidFrame
+    case unexpectedFrame(BenchmarkReplyFrame)
+}
+
+extension CodingUserInfoKey {
+    // If set to true, Statistics are encoded without the histogram which is sent separately
+    static let statisticsExcludeHistogram = CodingUserInfoKey(rawValue: "statisticsExcludeHistogram")!
+}
+
+@_documentation(visibility: internal)
+public struct BenchmarkReplyEncoder {
+    private let encoder = JSONEncoder()
+    private let resultEncoder = JSONEncoder()
+
+    public init() {
+        resultEncoder.userInfo[.statisticsExcludeHistogram] = true
+    }
+
+    /// Encodes the reply into one or more frames, passing each to `writeFrame` as soon as it's encoded
+    public func encode(_ reply: BenchmarkCommandReply, _ writeFrame: ([UInt8]) throws -> Void) throws {
+        guard case let .result(benchmark, results) = reply else {
+            var frame: [UInt8] = [BenchmarkReplyFrame.reply.rawValue]
+            frame.append(contentsOf: try encoder.encode(reply))
+            try writeFrame(frame)
+            return
+        }
+
+        var frame: [UInt8] = [BenchmarkReplyFrame.resultBegin.rawValue]
+        frame.append(contentsOf: try encoder.encode(benchmark))
+        try writeFrame(frame)
+
+        for result in results {
+            frame.removeAll(keepingCapacity: true)
+            frame.append(BenchmarkReplyFrame.metricResult.rawValue)
+            try result.encodeRecord(into: &frame, encoder: resultEncoder)
+            try writeFrame(frame)
+        }
+
+        try writeFrame([BenchmarkReplyFrame.resultEnd.rawValue])
+    }
+}
+
+@_documentation(visibility: internal)
+public struct BenchmarkReplyDecoder {
+    private let decoder = JSONDecoder()
+    private let resultDecoder = JSONDecoder()
+    private var benchmark: Benchmark?
+    private var results: [BenchmarkResult] = []
+
+    public init() {
+        resultDecoder.userInfo[.statisticsExcludeHistogram] = true
+    }
+
+    /// Decodes a frame, returns the reply once all of its frames have been decoded
+    public mutating func decode(_ frame: [UInt8]) throws -> BenchmarkCommandReply? {
+        guard let first = frame.first, let frameType = BenchmarkReplyFrame(rawValue: first) else {
+            throw BenchmarkReplyCodingError.invalidFrame
+        }
+
+        switch frameType {
+        case .reply:
+            return try decoder.decode(BenchmarkCommandReply.self, from: Data(frame[1...]))
+        case .resultBegin:
+            benchmark = try decoder.decode(Benchmark.self, from: Data(frame[1...]))
+            results.removeAll()
+            return nil
+        case .metricResult:
+            guard benchmark != nil else {
+                throw BenchmarkReplyCodingError.unexpectedFrame(frameType)
+            }
+            var offset = 1
+            results.append(try BenchmarkResult.decodeRecord(from: frame, offset: &offset, decoder: resultDecoder))
+            return nil
+        case .resultEnd:
+            guard let benchmark else {
+                throw BenchmarkReplyCodingError.unexpectedFrame(frameType)
+            }
+            let reply = BenchmarkCommandReply.result(benchmark: benchmark, results: results)
+            self.benchmark = nil
+            results = []
+            return reply
+        }
+    }
+}
+
+extension BenchmarkResult {
+    // Appends the varint length of the JSON encoded result without histogram, the JSON and the encoded histogram,
+    // `encoder` must have `statisticsExcludeHistogram` set
+    func encodeRecord(into buffer: inout [UInt8], encoder: JSONEncoder) throws {
+        let metadata = try encoder.encode(self)
+        buffer.appendVarint(UInt64(metadata.count))
+        buffer.append(contentsOf: metadata)
+        statistics.histogram.encode(into: &buffer)
+    }
+
+    // Decodes a result encoded with encodeRecord, `decoder` must have `statisticsExcludeHistogram` set
+    static func decodeRecord(from buffer: [UInt8], offset: inout Int, decoder: JSONDecoder) throws -> BenchmarkResult {
+        guard let metadataLength = Int(exactly: try buffer.readVarint(at: &offset)),
+            offset + metadataLength <= buffer.count
+        else {
+            throw BenchmarkReplyCodingError.invalidFrame
+        }
+        let result = try decoder.decode(BenchmarkResult.self, from: Data(buffer[offset..<offset + metadataLength]))
+        offset += metadataLength
+        result.statistics.histogram = try Histogram<UInt>.decode(from: buffer, offset: &offset)
+        return result
+    }
+}
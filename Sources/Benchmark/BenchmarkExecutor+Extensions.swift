@@ -12,7 +12,9 @@
 extension BenchmarkExecutor {
     func performanceCountersNeeded(_ metric: BenchmarkMetric) -> Bool {
         switch metric {
-        case .instructions:
+        case .instructions, .cpuCycles, .branchMisses, .cacheMisses, .l1dCacheMisses, .dTLBMisses:
+            return true
+        case .instructionsPerCycle, .cacheMissesPerKiloInstructions, .branchMissesPerKiloInstructions:
             return true
         default:
             return false
@@ -33,6 +35,20 @@ extension BenchmarkExecutor {
             return true
         case .allocatedResidentMemory:
             return true
+        case .mallocThreadCacheFills, .mallocThreadCacheFlushes:
+            return true
+        case .bytesAllocated, .bytesFreed, .mallocSizeClass:
+            return true
+        default:
+            return false
+        }
+    }
+
+    // The per size class statistics are only read if needed, as it's one query per size class
+    func sizeClassStatsNeeded(_ metric: BenchmarkMetric) -> Bool {
+        switch metric {
+        case .bytesAllocated, .bytesFreed, .mallocSizeClass:
+            return true
         default:
             return false
         }
@@ -54,7 +70,11 @@ extension BenchmarkExecutor {
             return true
         case .peakMemoryVirtual:
             return true
-        case .syscalls:
+        case .syscalls, .futexSyscalls, .epollWaitSyscalls:
+            return true
+        case .minorPageFaults, .majorPageFaults, .proportionalResidentMemory, .anonymousResidentMemory:
+            return true
+        case .runQueueDelay, .offCPUTime, .timeslices:
             return true
         case .contextSwitches:
             return true
@@ -74,7 +94,9 @@ extension BenchmarkExecutor {
             return true
         case .writeBytesPhysical:
             return true
-        case .instructions:
+        case .instructions, .cpuCycles, .branchMisses, .cacheMisses, .l1dCacheMisses, .dTLBMisses:
+            return true
+        case .instructionsPerCycle, .cacheMissesPerKiloInstructions, .branchMissesPerKiloInstructions:
             return true
         default:
             return false
@@ -93,4 +115,58 @@ extension BenchmarkExecutor {
     }
 }
 
+extension BenchmarkExecutor {
+    // Runs an empty measurement enough times for its floor to be stable, but for at most 10 ms
+    func measureTimingOverhead(_ measure: () -> Void) {
+        let maximumSamples = 1_000
+        let deadline = BenchmarkClock.now + .milliseconds(10)
+
+        for _ in 0..<maximumSamples {
+            measure()
+            if BenchmarkClock.now >= deadline {
+                break
+            }
+        }
+    }
+}
+
+extension BenchmarkExecutor {
+    // Finds how many invocations of the benchmark closure must be timed together for each sample to take
+    // at least targetDuration, similar to the iteration calibration done by Google Benchmark.
+    // Returns the batch size and the overhead in nanoseconds of timing an empty batch.
+    func calibrateBatchSize(
+        _ benchmark: Benchmark,
+        targetDuration: Duration,
+        measure: (_ batchSize: Int) -> Duration
+    ) -> (batchSize: Int, emptyBatchOverhead: Int) {
+        let maximumBatchSize = 1_000_000
+        let emptyBatchSamples = 10
+        var emptyBatchOverhead: Duration = .seconds(1)
+
+        for _ in 0..<emptyBatchSamples {
+            emptyBatchOverhead = min(emptyBatchOverhead, measure(0))
+        }
+
+        var batchSize = 1
+        while batchSize < maximumBatchSize {
+            let duration = measure(batchSize)
+
+            // Explicit start/stop of the measurement inside the closure can't be batched
+            if benchmark.explicitMeasurementUsed || benchmark.failureReason != nil {
+                return (1, Int(emptyBatchOverhead.nanoseconds()))
+            }
+
+            if duration >= targetDuration {
+                break
+            }
+
+            // Grow towards the target with some margin, but at least double each round
+            let growth = duration > .zero ? (targetDuration / duration) * 1.2 : 10.0
+            batchSize = min(maximumBatchSize, max(batchSize * 2, Int(Double(batchSize) * growth)))
+        }
+
+        return (batchSize, Int(emptyBatchOverhead.nanoseconds()))
+    }
+}
+
 // swiftlint:enable cyclomatic_complexity
@@ -8,6 +8,8 @@
 // http://www.apache.org/licenses/LICENSE-2.0
 //
 
+import Atomics
+
 #if canImport(OSLog)
 import OSLog
 #endif
@@ -27,6 +29,8 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
         var wallClockDuration: Duration = .zero
         var startMallocStats = MallocStats()
         var stopMallocStats = MallocStats()
+        var startSizeClassRequests: [Int] = []
+        var stopSizeClassRequests: [Int] = []
         var startOperatingSystemStats = OperatingSystemStats()
         var stopOperatingSystemStats = OperatingSystemStats()
         var startPerformanceCounters = PerformanceCounters()
@@ -35,6 +39,93 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
         var stopARCStats = ARCStats()
         var startTime = BenchmarkClock.now
         var stopTime = BenchmarkClock.now
+        var batchSize = 1
+        var calibrating = false // measurements are only used to calibrate the batch size, not recorded
+        var calibrationDuration: Duration = .zero
+        var detectingWarmup = false // measurements are only used to detect the end of warmup, not recorded
+        var measuring = false // set for the iterations recorded, after warmup and calibration
+        var iterationDuration: Duration = .zero
+        var measuringTimingOverhead = false // measurements of an empty closure, only used to find the overhead
+        var timingOverheadSamples = 0
+        var timingOverhead: Duration = .zero // the floor of the measurements of an empty closure
+        var timingOverheadInInstructions: UInt64 = 0
+        var timingOverheadInCycles: UInt64 = 0
+        var subtractTimingOverhead = false // from the wall clock, set once the overhead is measured
+        let threads = max(benchmark.configuration.threads, 1)
+        var threadGroup: BenchmarkThreadGroup?
+        let recordThreadLatencies = ManagedAtomic<Bool>(false) // only measured iterations are recorded, not warmup
+
+        // For multi-threaded benchmarks, each thread keeps its own latency statistics which are merged afterwards
+        let threadStatistics = (0..<threads).map { _ in
+            Statistics(units: Statistics.Units(benchmark.configuration.timeUnits))
+        }
+
+        // The scheduler statistics are only summed over the threads running the benchmark, which register
+        // themselves. The tasks of async benchmarks run on the threads of the concurrency runtime, which can't
+        // be told apart from those of the runner, so the statistics aren't recorded for them.
+        let schedStatsRequested =
+            benchmark.closure != nil
+            && benchmark.configuration.metrics.contains { $0 == .runQueueDelay || $0 == .offCPUTime || $0 == .timeslices }
+        var registerThread: (() -> Void)?
+
+        if schedStatsRequested {
+            let producer = operatingSystemStatsProducer
+            registerThread = { producer.registerBenchmarkThread() }
+            producer.registerBenchmarkThread()
+        }
+
+        if threads > 1 {
+            guard let closure = benchmark.closure else {
+                benchmark.error("Benchmark \(benchmark.name) with \(threads) threads must use a synchronous closure")
+                return []
+            }
+            threadGroup = BenchmarkThreadGroup(threads: threads, start: registerThread) { thread in
+                let threadStartTime = BenchmarkClock.now
+                closure(benchmark)
+                let threadStopTime = BenchmarkClock.now
+                if recordThreadLatencies.load(ordering: .relaxed) {
+                    threadStatistics[thread].add(Int(threadStartTime.duration(to: threadStopTime).nanoseconds()))
+                }
+            }
+        }
+
+        defer {
+            threadGroup?.shutdown()
+            if schedStatsRequested {
+                operatingSystemStatsProducer.resetBenchmarkThreads()
+            }
+        }
+
+        // Async benchmarks running all iterations in a single task run the whole loop inside that task
+        let singleTask = benchmark.closure == nil && benchmark.configuration.asyncExecution.startTask != nil
+
+        func runIteration() {
+            if let threadGroup {
+                recordThreadLatencies.store(measuring, ordering: .relaxed) // published by the release of the round
+                benchmark.run(threadGroup: threadGroup)
+            } else if batchSize > 1 {
+                benchmark.run(batchSize: batchSize)
+            } else {
+                benchmark.run()
+            }
+        }
+
+        // Runs iterations for as long as `before` returns true and `after` doesn't return false. The closures
+        // escape into the task of async benchmarks running all iterations in a single task.
+        func runIterations(before: @escaping () -> Bool, after: @escaping () -> Bool) {
+            if singleTask {
+                benchmark.runAsyncIterations(batchSize: batchSize, before: before, after: after)
+                return
+            }
+
+            while before() {
+                runIteration()
+
+                if after() == false {
+                    break
+                }
+            }
+        }
 
         // optionally run a few warmup iterations by default to clean out outliers due to cacheing etc.
 
@@ -50,9 +141,16 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
         }
         #endif
 
-        for iterations in 0..<benchmark.configuration.warmupIterations {
-            benchmark.currentIteration = iterations
-            benchmark.run()
+        var configuredWarmupIterations = 0
+        runIterations {
+            guard configuredWarmupIterations < benchmark.configuration.warmupIterations else {
+                return false
+            }
+            benchmark.currentIteration = configuredWarmupIterations
+            return true
+        } after: {
+            configuredWarmupIterations += 1
+            return true
         }
 
         #if canImport(OSLog)
@@ -65,16 +163,20 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
         var customStatistics: [BenchmarkMetric: Statistics] = [:]
         var performanceCountersRequested = false
         var operatingSystemStatsRequested = false
+        var memoryRollupRequested = false
         var mallocStatsRequested = false
+        var sizeClassStatsRequested = false
         var arcStatsRequested = false
         var operatingSystemMetricsRequested: Set<BenchmarkMetric> = []
+        var trace: IterationTraceRecorder?
+        var traceStartTime = BenchmarkClock.now
 
         // Create metric statistics as needed
         benchmark.configuration.metrics.forEach { metric in
             switch metric {
             case .custom:
                 customStatistics[metric] = Statistics(prefersLarger: metric.polarity == .prefersLarger)
-            case .wallClock, .cpuUser, .cpuTotal, .cpuSystem:
+            case .wallClock, .cpuUser, .cpuTotal, .cpuSystem, .runQueueDelay, .offCPUTime:
                 let units = Statistics.Units(benchmark.configuration.timeUnits)
                 statistics[metric.index] = Statistics(units: units)
             default:
@@ -87,21 +189,71 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
                 mallocStatsRequested = true
             }
 
+            if sizeClassStatsNeeded(metric) {
+                sizeClassStatsRequested = true
+            }
+
             if operatingSystemsStatsProducerNeeded(metric), operatingSystemStatsProducer.metricSupported(metric) {
                 operatingSystemMetricsRequested.insert(metric)
                 operatingSystemStatsRequested = true
+                if metric == .proportionalResidentMemory || metric == .anonymousResidentMemory {
+                    memoryRollupRequested = true
+                }
             }
 
             if arcStatsProducerNeeded(metric) {
                 arcStatsRequested = true
             }
 
-            if performanceCountersNeeded(metric) {
+            if performanceCountersNeeded(metric), operatingSystemStatsProducer.metricSupported(metric) {
                 performanceCountersRequested = true
             }
         }
 
         operatingSystemStatsProducer.configureMetrics(operatingSystemMetricsRequested)
+        // Thread scoped counters only count the thread running the executor, while async benchmarks and those
+        // with several threads do their work on other threads, so those are counted for the whole process
+        var performanceCounterScope = benchmark.configuration.performanceCounterScope
+        if performanceCounterScope == .thread, benchmark.closure == nil || threads > 1 {
+            performanceCounterScope = .process
+        }
+        operatingSystemStatsProducer.configurePerformanceCounters(performanceCounterScope)
+
+        // The metrics with a single value per iteration, the size class histogram gets one per allocation
+        let iterationMetrics = benchmark.configuration.metrics.filter { metric in
+            switch metric {
+            case .custom, .mallocSizeClass:
+                return false
+            default:
+                return (operatingSystemsStatsProducerNeeded(metric) == false && performanceCountersNeeded(metric) == false)
+                    || operatingSystemStatsProducer.metricSupported(metric)
+            }
+        }
+
+        // The values of the measured iterations are buffered and only added to the statistics every few thousand
+        // iterations, see MeasurementBuffer. The throughput is buffered as the time and only computed when added.
+        let measurements = MeasurementBuffer(iterationMetrics)
+        let requestedMetrics = measurements.metrics
+        var bookkeepingStart = BenchmarkClock.now
+        var bookkeepingDuration: Duration = .zero // outside the measured region, for the measured iterations
+        var bookkeepingIterations = 0
+
+        func flushMeasurements() {
+            let invocations = Double(batchSize * threads)
+            measurements.flush { metric, values in
+                let metricStatistics = statistics[metric.index]
+                guard metric == .throughput else {
+                    values.forEach { metricStatistics.add($0) }
+                    return
+                }
+                for nanoSeconds in values {
+                    let throughput = Int((1_000_000_000 * invocations / Double(nanoSeconds)).rounded(.toNearestOrEven))
+                    if throughput > 0 {
+                        metricStatistics.add(throughput)
+                    }
+                }
+            }
+        }
 
         var iterations = 0
         let initialStartTime = BenchmarkClock.now
@@ -109,6 +261,13 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
         // 'Warmup' to remove initial mallocs from stats in p100
         _ = MallocStatsProducer.makeMallocStats() // baselineMallocStats
 
+        // The size class requests are read into preallocated arrays, so sampling them doesn't allocate
+        if sizeClassStatsRequested {
+            startSizeClassRequests = .init(repeating: 0, count: MallocStatsProducer.sizeClasses.count)
+            stopSizeClassRequests = .init(repeating: 0, count: MallocStatsProducer.sizeClasses.count)
+            _ = MallocStatsProducer.makeMallocStats(sizeClassRequests: &stopSizeClassRequests)
+        }
+
         // Calculate typical sys call check overhead and deduct that to get 'clean' stats for the actual benchmark
         var operatingSystemStatsOverhead = OperatingSystemStats()
         var baselinePeakMemoryResidentDelta = 0
@@ -117,32 +276,20 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
             let statsTwo = operatingSystemStatsProducer.makeOperatingSystemStats()
 
             operatingSystemStatsOverhead.syscalls = statsTwo.syscalls - statsOne.syscalls
+            operatingSystemStatsOverhead.contextSwitches = statsTwo.contextSwitches - statsOne.contextSwitches
             operatingSystemStatsOverhead.readSyscalls = statsTwo.readSyscalls - statsOne.readSyscalls
             operatingSystemStatsOverhead.readBytesLogical = statsTwo.readBytesLogical - statsOne.readBytesLogical
             operatingSystemStatsOverhead.readBytesPhysical = statsTwo.readBytesPhysical - statsOne.readBytesPhysical
         }
 
-        var timingOverheadInInstructions: UInt64 = 0
-        if performanceCountersRequested {
-            let numberOfMeasurements: UInt64 = 5
-            operatingSystemStatsProducer.enablePerformanceCounters()
-            for _ in 0..<numberOfMeasurements {
-                blackHole(BenchmarkClock.now)
-                let statsOne = operatingSystemStatsProducer.makePerformanceCounters()
-                blackHole(BenchmarkClock.now) // must be as close to last in closure as possible
-                let statsTwo = operatingSystemStatsProducer.makePerformanceCounters()
-                timingOverheadInInstructions += max((statsTwo.instructions - statsOne.instructions), 0)
-            }
-            timingOverheadInInstructions /= numberOfMeasurements
-            operatingSystemStatsProducer.disablePerformanceCounters()
-        }
-
         // Hook that is called before the actual benchmark closure run, so we can capture metrics here
         // NB this code may be called twice if the user calls startMeasurement() manually and should
         // then reset to a new starting state.
         // NB that the order is important, as we will get leaked
         // ARC measurements if initializing it before malloc etc.
         benchmark.measurementPreSynchronization = { explicitStartStop in
+            bookkeepingStart = BenchmarkClock.now
+
             #if canImport(OSLog)
             if explicitStartStop {
                 explicitStartStopInterval = signPost.beginInterval(
@@ -153,7 +300,9 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
             }
             #endif
 
-            if mallocStatsRequested {
+            if sizeClassStatsRequested {
+                startMallocStats = MallocStatsProducer.makeMallocStats(sizeClassRequests: &startSizeClassRequests)
+            } else if mallocStatsRequested {
                 startMallocStats = MallocStatsProducer.makeMallocStats()
             }
 
@@ -162,6 +311,7 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
             }
 
             if operatingSystemStatsRequested {
+                operatingSystemStatsProducer.resetPeakMemoryResident()
                 startOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
             }
 
@@ -170,6 +320,18 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
                 startPerformanceCounters = operatingSystemStatsProducer.makePerformanceCounters()
             }
 
+            if AllocationProfiler.enabled {
+                AllocationProfiler.activate(true)
+            }
+
+            if ARCStatsProducer.typeAttributionEnabled {
+                ARCStatsProducer.attributeTypes(true)
+            }
+
+            if CPUProfiler.enabled {
+                CPUProfiler.activate(true)
+            }
+
             startTime = BenchmarkClock.now // must be as close to last in closure as possible
         }
 
@@ -182,15 +344,32 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
 
             stopTime = BenchmarkClock.now // must be as close to first in closure as possible (perf events only before)
 
+            if CPUProfiler.enabled {
+                CPUProfiler.activate(false)
+            }
+
+            if AllocationProfiler.enabled {
+                AllocationProfiler.activate(false)
+            }
+
+            if ARCStatsProducer.typeAttributionEnabled {
+                ARCStatsProducer.attributeTypes(false)
+            }
+
             if operatingSystemStatsRequested {
                 stopOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+                if memoryRollupRequested {
+                    operatingSystemStatsProducer.readMemoryRollup(into: &stopOperatingSystemStats)
+                }
             }
 
             if arcStatsRequested {
                 stopARCStats = ARCStatsProducer.makeARCStats()
             }
 
-            if mallocStatsRequested {
+            if sizeClassStatsRequested {
+                stopMallocStats = MallocStatsProducer.makeMallocStats(sizeClassRequests: &stopSizeClassRequests)
+            } else if mallocStatsRequested {
                 stopMallocStats = MallocStatsProducer.makeMallocStats()
             }
 
@@ -205,148 +384,318 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
 
             wallClockDuration = initialStartTime.duration(to: stopTime)
 
-            statistics.withUnsafeMutableBufferPointer { statistics in
-                if runningTime > .zero { // macOS sometimes gives us identical timestamps so let's skip those.
-                    let nanoSeconds = runningTime.nanoseconds()
-                    statistics[BenchmarkMetric.wallClock.index].add(Int(nanoSeconds))
+            if measuringTimingOverhead {
+                let instructions = stopPerformanceCounters.instructions &- startPerformanceCounters.instructions
+                let cycles = stopPerformanceCounters.cpuCycles &- startPerformanceCounters.cpuCycles
+                let first = timingOverheadSamples == 0
+                timingOverhead = first ? runningTime : min(timingOverhead, runningTime)
+                timingOverheadInInstructions = first ? instructions : min(timingOverheadInInstructions, instructions)
+                timingOverheadInCycles = first ? cycles : min(timingOverheadInCycles, cycles)
+                timingOverheadSamples += 1
+                return
+            }
 
-                    // We should eventually move the computation of the throughput to the
-                    // post processing instead
-                    var roundedThroughput = Double(1_000_000_000) / Double(nanoSeconds)
-                    roundedThroughput.round(.toNearestOrEven)
+            if calibrating {
+                calibrationDuration = runningTime
+                return
+            }
 
-                    let throughput = Int(roundedThroughput)
+            iterationDuration = runningTime
 
-                    if throughput > 0 {
-                        statistics[BenchmarkMetric.throughput.index].add(throughput)
-                    }
-                } else {
-                    //  fatalError("Zero running time \(self.startTime), \(self.stopTime), \(runningTime)")
+            if detectingWarmup {
+                return
+            }
+
+            // With automatic batching or multiple threads, record the value per invocation of the benchmark closure
+            let invocations = batchSize * threads
+            func perOperation(_ value: Int) -> Int {
+                guard invocations > 1 else {
+                    return value
                 }
+                return value >= 0 ? (value + invocations / 2) / invocations : value / invocations
+            }
 
-                if arcStatsRequested {
-                    let objectAllocDelta = stopARCStats.objectAllocCount - startARCStats.objectAllocCount
-                    statistics[BenchmarkMetric.objectAllocCount.index].add(Int(objectAllocDelta))
+            trace?.beginIteration(timestamp: Int(traceStartTime.duration(to: startTime).nanoseconds()))
 
-                    let retainDelta = stopARCStats.retainCount - startARCStats.retainCount - 1 // due to some ARC traffic in the path
-                    statistics[BenchmarkMetric.retainCount.index].add(Int(retainDelta))
+            // Buffers the value of the iteration for the statistics of the metric, and adds it to the trace if tracing
+            func record(_ metric: BenchmarkMetric, _ value: Int) {
+                measurements.record(metric, value)
+                trace?.record(metric, value)
+            }
 
-                    let releaseDelta = stopARCStats.releaseCount - startARCStats.releaseCount - 1 // due to some ARC traffic in the path
-                    statistics[BenchmarkMetric.releaseCount.index].add(Int(releaseDelta))
+            if runningTime > .zero { // macOS sometimes gives us identical timestamps so let's skip those.
+                var nanoSeconds = runningTime.nanoseconds()
+                // optionally remove the overhead of timing, but never below the resolution of the clock
+                if subtractTimingOverhead {
+                    nanoSeconds = max(nanoSeconds - timingOverhead.nanoseconds(), 1)
+                }
+                if threads == 1 { // otherwise the latencies measured by each thread are used
+                    record(.wallClock, perOperation(Int(nanoSeconds)))
+                }
 
-                    statistics[BenchmarkMetric.retainReleaseDelta.index]
-                        .add(Int(abs(objectAllocDelta + retainDelta - releaseDelta)))
+                // The throughput is computed from the time when the buffer is flushed
+                measurements.record(.throughput, Int(nanoSeconds))
+                if let trace, requestedMetrics.contains(.throughput) {
+                    let throughput = (1_000_000_000 * Double(invocations) / Double(nanoSeconds)).rounded(.toNearestOrEven)
+                    trace.record(.throughput, Int(throughput))
                 }
+            } else {
+                //  fatalError("Zero running time \(self.startTime), \(self.stopTime), \(runningTime)")
+            }
+
+            if arcStatsRequested {
+                let objectAllocDelta = stopARCStats.objectAllocCount - startARCStats.objectAllocCount
+                record(.objectAllocCount, perOperation(Int(objectAllocDelta)))
 
-                if mallocStatsRequested {
-                    delta = stopMallocStats.mallocCountTotal - startMallocStats.mallocCountTotal
-                    statistics[BenchmarkMetric.mallocCountTotal.index].add(Int(delta))
+                let retainDelta = stopARCStats.retainCount - startARCStats.retainCount - 1 // due to some ARC traffic in the path
+                record(.retainCount, perOperation(Int(retainDelta)))
 
-                    delta = stopMallocStats.mallocCountSmall - startMallocStats.mallocCountSmall
-                    statistics[BenchmarkMetric.mallocCountSmall.index].add(Int(delta))
+                let releaseDelta = stopARCStats.releaseCount - startARCStats.releaseCount - 1 // due to some ARC traffic in the path
+                record(.releaseCount, perOperation(Int(releaseDelta)))
 
-                    delta = stopMallocStats.mallocCountLarge - startMallocStats.mallocCountLarge
-                    statistics[BenchmarkMetric.mallocCountLarge.index].add(Int(delta))
+                record(.retainReleaseDelta, perOperation(Int(abs(objectAllocDelta + retainDelta - releaseDelta))))
+            }
 
-                    delta = stopMallocStats.allocatedResidentMemory - startMallocStats.allocatedResidentMemory
-                    statistics[BenchmarkMetric.memoryLeaked.index].add(Int(delta))
+            if mallocStatsRequested {
+                delta = stopMallocStats.mallocCountTotal - startMallocStats.mallocCountTotal
+                record(.mallocCountTotal, perOperation(Int(delta)))
 
-                    //                delta = stopMallocStats.allocatedResidentMemory - baselineMallocStats.allocatedResidentMemory // baselineMallocStats!
-                    statistics[BenchmarkMetric.allocatedResidentMemory.index]
-                        .add(Int(stopMallocStats.allocatedResidentMemory))
+                delta = stopMallocStats.mallocCountSmall - startMallocStats.mallocCountSmall
+                record(.mallocCountSmall, perOperation(Int(delta)))
+
+                delta = stopMallocStats.mallocCountLarge - startMallocStats.mallocCountLarge
+                record(.mallocCountLarge, perOperation(Int(delta)))
+
+                delta = stopMallocStats.allocatedResidentMemory - startMallocStats.allocatedResidentMemory
+                record(.memoryLeaked, perOperation(Int(delta)))
+
+                //                delta = stopMallocStats.allocatedResidentMemory - baselineMallocStats.allocatedResidentMemory // baselineMallocStats!
+                record(.allocatedResidentMemory, Int(stopMallocStats.allocatedResidentMemory))
+
+                delta = stopMallocStats.threadCacheFills - startMallocStats.threadCacheFills
+                record(.mallocThreadCacheFills, perOperation(Int(delta)))
+
+                delta = stopMallocStats.threadCacheFlushes - startMallocStats.threadCacheFlushes
+                record(.mallocThreadCacheFlushes, perOperation(Int(delta)))
+            }
+
+            if sizeClassStatsRequested {
+                let bytesAllocated = stopMallocStats.bytesAllocated &- startMallocStats.bytesAllocated
+                record(.bytesAllocated, perOperation(bytesAllocated))
+
+                delta = bytesAllocated - (stopMallocStats.bytesInUse - startMallocStats.bytesInUse)
+                record(.bytesFreed, perOperation(Int(delta)))
+
+                // One sample per allocation request, with the size class as the value
+                let sizeClasses = MallocStatsProducer.sizeClasses
+                for sizeClass in 0..<min(sizeClasses.count, startSizeClassRequests.count) {
+                    let requests = stopSizeClassRequests[sizeClass] - startSizeClassRequests[sizeClass]
+                    if requests > 0 {
+                        statistics[BenchmarkMetric.mallocSizeClass.index].histogram
+                            .record(UInt64(sizeClasses[sizeClass]), count: UInt(requests))
+                    }
                 }
+            }
 
-                if operatingSystemStatsRequested {
-                    delta = stopOperatingSystemStats.cpuUser - startOperatingSystemStats.cpuUser
-                    statistics[BenchmarkMetric.cpuUser.index].add(Int(delta))
+            if operatingSystemStatsRequested {
+                delta = stopOperatingSystemStats.cpuUser - startOperatingSystemStats.cpuUser
+                record(.cpuUser, perOperation(Int(delta)))
 
-                    delta = stopOperatingSystemStats.cpuSystem - startOperatingSystemStats.cpuSystem
-                    statistics[BenchmarkMetric.cpuSystem.index].add(Int(delta))
+                delta = stopOperatingSystemStats.cpuSystem - startOperatingSystemStats.cpuSystem
+                record(.cpuSystem, perOperation(Int(delta)))
 
-                    delta = stopOperatingSystemStats.cpuTotal - startOperatingSystemStats.cpuTotal
-                    statistics[BenchmarkMetric.cpuTotal.index].add(Int(delta))
+                delta = stopOperatingSystemStats.cpuTotal - startOperatingSystemStats.cpuTotal
+                record(.cpuTotal, perOperation(Int(delta)))
 
-                    delta = stopOperatingSystemStats.peakMemoryResident
-                    statistics[BenchmarkMetric.peakMemoryResident.index].add(Int(delta))
+                delta = stopOperatingSystemStats.peakMemoryResident
+                record(.peakMemoryResident, Int(delta))
 
-                    delta = stopOperatingSystemStats.peakMemoryResident - baselinePeakMemoryResidentDelta
-                    statistics[BenchmarkMetric.peakMemoryResidentDelta.index].add(Int(delta))
+                delta = stopOperatingSystemStats.peakMemoryResident - baselinePeakMemoryResidentDelta
+                record(.peakMemoryResidentDelta, Int(delta))
 
-                    delta = stopOperatingSystemStats.peakMemoryVirtual
-                    statistics[BenchmarkMetric.peakMemoryVirtual.index].add(Int(delta))
+                delta = stopOperatingSystemStats.peakMemoryVirtual
+                record(.peakMemoryVirtual, Int(delta))
 
-                    delta =
-                        stopOperatingSystemStats.syscalls - startOperatingSystemStats.syscalls
-                        - operatingSystemStatsOverhead.syscalls
-                    statistics[BenchmarkMetric.syscalls.index].add(Int(max(0, delta)))
+                delta =
+                    stopOperatingSystemStats.syscalls - startOperatingSystemStats.syscalls
+                    - operatingSystemStatsOverhead.syscalls
+                record(.syscalls, perOperation(Int(max(0, delta))))
 
-                    delta = stopOperatingSystemStats.contextSwitches - startOperatingSystemStats.contextSwitches
-                    statistics[BenchmarkMetric.contextSwitches.index].add(Int(delta))
+                delta = stopOperatingSystemStats.futexSyscalls - startOperatingSystemStats.futexSyscalls
+                record(.futexSyscalls, perOperation(Int(delta)))
 
-                    delta = stopOperatingSystemStats.threads
-                    statistics[BenchmarkMetric.threads.index].add(Int(delta))
+                delta = stopOperatingSystemStats.epollWaitSyscalls - startOperatingSystemStats.epollWaitSyscalls
+                record(.epollWaitSyscalls, perOperation(Int(delta)))
 
-                    delta = stopOperatingSystemStats.threadsRunning
-                    statistics[BenchmarkMetric.threadsRunning.index].add(Int(delta))
+                delta =
+                    stopOperatingSystemStats.contextSwitches - startOperatingSystemStats.contextSwitches
+                    - operatingSystemStatsOverhead.contextSwitches
+                record(.contextSwitches, perOperation(Int(max(0, delta))))
 
-                    delta =
-                        stopOperatingSystemStats.readSyscalls - startOperatingSystemStats.readSyscalls
-                        - operatingSystemStatsOverhead.readSyscalls
-                    statistics[BenchmarkMetric.readSyscalls.index].add(Int(max(0, delta)))
+                delta = stopOperatingSystemStats.threads
+                record(.threads, Int(delta))
 
-                    delta = stopOperatingSystemStats.writeSyscalls - startOperatingSystemStats.writeSyscalls
-                    statistics[BenchmarkMetric.writeSyscalls.index].add(Int(delta))
+                delta = stopOperatingSystemStats.threadsRunning
+                record(.threadsRunning, Int(delta))
 
-                    delta =
-                        stopOperatingSystemStats.readBytesLogical - startOperatingSystemStats.readBytesLogical
-                        - operatingSystemStatsOverhead.readBytesLogical
-                    statistics[BenchmarkMetric.readBytesLogical.index].add(Int(max(0, delta)))
+                delta =
+                    stopOperatingSystemStats.readSyscalls - startOperatingSystemStats.readSyscalls
+                    - operatingSystemStatsOverhead.readSyscalls
+                record(.readSyscalls, perOperation(Int(max(0, delta))))
+
+                delta = stopOperatingSystemStats.writeSyscalls - startOperatingSystemStats.writeSyscalls
+                record(.writeSyscalls, perOperation(Int(delta)))
+
+                delta =
+                    stopOperatingSystemStats.readBytesLogical - startOperatingSystemStats.readBytesLogical
+                    - operatingSystemStatsOverhead.readBytesLogical
+                record(.readBytesLogical, perOperation(Int(max(0, delta))))
 
-                    delta = stopOperatingSystemStats.writeBytesLogical - startOperatingSystemStats.writeBytesLogical
-                    statistics[BenchmarkMetric.writeBytesLogical.index].add(Int(delta))
+                delta = stopOperatingSystemStats.writeBytesLogical - startOperatingSystemStats.writeBytesLogical
+                record(.writeBytesLogical, perOperation(Int(delta)))
 
+                delta =
+                    stopOperatingSystemStats.readBytesPhysical - startOperatingSystemStats.readBytesPhysical
+                    - operatingSystemStatsOverhead.readBytesPhysical
+                record(.readBytesPhysical, perOperation(Int(max(0, delta))))
+
+                delta = stopOperatingSystemStats.writeBytesPhysical - startOperatingSystemStats.writeBytesPhysical
+                record(.writeBytesPhysical, perOperation(Int(delta)))
+
+                delta = stopOperatingSystemStats.minorPageFaults - startOperatingSystemStats.minorPageFaults
+                record(.minorPageFaults, perOperation(Int(delta)))
+
+                delta = stopOperatingSystemStats.majorPageFaults - startOperatingSystemStats.majorPageFaults
+                record(.majorPageFaults, perOperation(Int(delta)))
+
+                if schedStatsRequested {
+                    delta = stopOperatingSystemStats.runQueueDelay - startOperatingSystemStats.runQueueDelay
+                    record(.runQueueDelay, perOperation(Int(max(0, delta))))
+
+                    delta = stopOperatingSystemStats.timeslices - startOperatingSystemStats.timeslices
+                    record(.timeslices, perOperation(Int(max(0, delta))))
+                }
+
+                // What's left of the time of each thread running the benchmark after its time on a CPU and
+                // waiting for one, as schedstat has no blocked time
+                if schedStatsRequested, requestedMetrics.contains(.offCPUTime) {
                     delta =
-                        stopOperatingSystemStats.readBytesPhysical - startOperatingSystemStats.readBytesPhysical
-                        - operatingSystemStatsOverhead.readBytesPhysical
-                    statistics[BenchmarkMetric.readBytesPhysical.index].add(Int(max(0, delta)))
+                        Int(runningTime.nanoseconds()) * threads
+                        - (stopOperatingSystemStats.runTime - startOperatingSystemStats.runTime)
+                        - (stopOperatingSystemStats.runQueueDelay - startOperatingSystemStats.runQueueDelay)
+                    record(.offCPUTime, perOperation(Int(max(0, delta))))
+                }
+
+                if memoryRollupRequested {
+                    delta = stopOperatingSystemStats.proportionalResidentMemory
+                    record(.proportionalResidentMemory, Int(delta))
 
-                    delta = stopOperatingSystemStats.writeBytesPhysical - startOperatingSystemStats.writeBytesPhysical
-                    statistics[BenchmarkMetric.writeBytesPhysical.index].add(Int(delta))
+                    delta = stopOperatingSystemStats.anonymousResidentMemory
+                    record(.anonymousResidentMemory, Int(delta))
                 }
+            }
 
-                if performanceCountersRequested {
-                    delta = Int(stopPerformanceCounters.instructions - startPerformanceCounters.instructions)
-                    // remove overhead of startTime = BenchmarkClock.now, later we should measure dummy void benchmark
-                    if delta > timingOverheadInInstructions {
-                        delta -= Int(timingOverheadInInstructions)
-                    }
-                    if delta > 0 {
-                        statistics[BenchmarkMetric.instructions.index].add(Int(delta))
-                    }
+            if performanceCountersRequested {
+                // A counter read on another CPU than it was started on may be behind, so never below zero
+                func counterDelta(_ stop: UInt64, _ start: UInt64) -> Int {
+                    max(Int(truncatingIfNeeded: stop &- start), 0)
+                }
+
+                var instructions = counterDelta(stopPerformanceCounters.instructions, startPerformanceCounters.instructions)
+                // remove the overhead of the measurement path, measured with an empty closure
+                if instructions > timingOverheadInInstructions {
+                    instructions -= Int(timingOverheadInInstructions)
+                }
+                var cycles = counterDelta(stopPerformanceCounters.cpuCycles, startPerformanceCounters.cpuCycles)
+                if cycles > timingOverheadInCycles {
+                    cycles -= Int(timingOverheadInCycles)
+                }
+                let branchMisses = counterDelta(stopPerformanceCounters.branchMisses, startPerformanceCounters.branchMisses)
+                let cacheMisses = counterDelta(stopPerformanceCounters.cacheMisses, startPerformanceCounters.cacheMisses)
+
+                if instructions > 0, requestedMetrics.contains(.instructions) {
+                    record(.instructions, perOperation(instructions))
+                }
+
+                if cycles > 0, requestedMetrics.contains(.cpuCycles) {
+                    record(.cpuCycles, perOperation(cycles))
+                }
+
+                if requestedMetrics.contains(.branchMisses) {
+                    record(.branchMisses, perOperation(branchMisses))
+                }
+
+                if requestedMetrics.contains(.cacheMisses) {
+                    record(.cacheMisses, perOperation(cacheMisses))
+                }
+
+                if requestedMetrics.contains(.l1dCacheMisses) {
+                    delta = counterDelta(stopPerformanceCounters.l1dCacheMisses, startPerformanceCounters.l1dCacheMisses)
+                    record(.l1dCacheMisses, perOperation(delta))
                 }
+
+                if requestedMetrics.contains(.dTLBMisses) {
+                    delta = counterDelta(stopPerformanceCounters.dTLBMisses, startPerformanceCounters.dTLBMisses)
+                    record(.dTLBMisses, perOperation(delta))
+                }
+
+                // Ratios are stored multiplied by 1000 as the histograms only hold integers
+                if instructions > 0, cycles > 0,
+                    requestedMetrics.contains(.instructionsPerCycle)
+                {
+                    record(.instructionsPerCycle, instructions * 1_000 / cycles)
+                }
+
+                if instructions > 0,
+                    requestedMetrics.contains(.cacheMissesPerKiloInstructions)
+                {
+                    record(.cacheMissesPerKiloInstructions, cacheMisses * 1_000_000 / instructions)
+                }
+
+                if instructions > 0,
+                    requestedMetrics.contains(.branchMissesPerKiloInstructions)
+                {
+                    record(.branchMissesPerKiloInstructions, branchMisses * 1_000_000 / instructions)
+                }
+            }
+
+            trace?.endIteration()
+
+            if measurements.full {
+                flushMeasurements()
             }
+
+            // The time spent taking and recording the measurements of the iteration, including any flush
+            bookkeepingDuration += bookkeepingStart.duration(to: startTime) + stopTime.duration(to: BenchmarkClock.now)
+            bookkeepingIterations += 1
         }
 
         benchmark.customMetricMeasurement = { metric, value in
-            customStatistics[metric]?.add(value)
+            if detectingWarmup == false {
+                customStatistics[metric]?.add(value)
+            }
         }
 
-        if arcStatsRequested {
+        if arcStatsRequested || ARCStatsProducer.typeAttributionEnabled {
             ARCStatsProducer.hook()
         }
 
-        if benchmark.configuration.metrics.contains(.threads)
+        // Peak resident memory is measured per iteration without the sampler if supported
+        let samplingRequested = benchmark.configuration.metrics.contains(.threads)
             || benchmark.configuration.metrics.contains(.threadsRunning)
-            || benchmark.configuration.metrics.contains(.peakMemoryResident)
-            || benchmark.configuration.metrics.contains(.peakMemoryResidentDelta)
             || benchmark.configuration.metrics.contains(.peakMemoryVirtual)
-        {
+            || ((benchmark.configuration.metrics.contains(.peakMemoryResident)
+                || benchmark.configuration.metrics.contains(.peakMemoryResidentDelta))
+                && operatingSystemStatsProducer.precisePeakMemoryResident == false)
+
+        if samplingRequested {
             operatingSystemStatsProducer.startSampling(5_000) // ~5 ms
+        }
 
-            if benchmark.configuration.metrics.contains(.peakMemoryResidentDelta) {
-                baselinePeakMemoryResidentDelta =
-                    operatingSystemStatsProducer.makeOperatingSystemStats().peakMemoryResident
-            }
+        if benchmark.configuration.metrics.contains(.peakMemoryResidentDelta) {
+            operatingSystemStatsProducer.resetPeakMemoryResident()
+            baselinePeakMemoryResidentDelta =
+                operatingSystemStatsProducer.makeOperatingSystemStats().peakMemoryResident
         }
 
         var progressBar: ProgressBar?
@@ -378,27 +727,97 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
             operatingSystemStatsProducer.enablePerformanceCounters()
         }
 
-        // Run the benchmark at a minimum the desired iterations/runtime --
-        while iterations <= benchmark.configuration.maxIterations
-            || wallClockDuration <= benchmark.configuration.maxDuration
-        {
-            // and at a maximum the same...
-            guard wallClockDuration < benchmark.configuration.maxDuration,
-                iterations < benchmark.configuration.maxIterations
-            else {
-                break
+        // Measure an empty closure through the same path as the benchmark closure, the floor of those measurements
+        // is subtracted from the instructions and cycles of each sample, and from the wall clock if configured.
+        // Threads measure their own latencies without that path.
+        if threadGroup == nil {
+            measuringTimingOverhead = true
+            measureTimingOverhead { benchmark.runEmpty() }
+            measuringTimingOverhead = false
+            subtractTimingOverhead = benchmark.configuration.subtractTimingOverhead && timingOverheadSamples > 0
+        }
+
+        var emptyBatchOverhead: Int?
+        if case let .automatic(targetDuration) = benchmark.configuration.batching, threadGroup == nil {
+            let calibration = calibrateBatchSize(benchmark, targetDuration: targetDuration) { batch in
+                calibrating = true
+                benchmark.run(batchSize: batch)
+                calibrating = false
+                return calibrationDuration
             }
+            batchSize = calibration.batchSize
+            emptyBatchOverhead = calibration.emptyBatchOverhead
+        }
+
+        var adaptiveRunLength: AdaptiveRunLength?
+        if case let .adaptive(percentiles, relativeWidth) = benchmark.configuration.runLength {
+            adaptiveRunLength = AdaptiveRunLength(
+                percentiles: percentiles,
+                relativeWidth: relativeWidth,
+                maxIterations: benchmark.configuration.maxIterations
+            )
+        }
+
+        // Run until the samples settle down, using at most half of the iterations and time available
+        if var runLength = adaptiveRunLength {
+            detectingWarmup = true
+            runIterations {
+                guard wallClockDuration < benchmark.configuration.maxDuration / 2, benchmark.failureReason == nil else {
+                    return false
+                }
+                benchmark.currentIteration = runLength.warmupIterations + benchmark.configuration.warmupIterations
+                return true
+            } after: {
+                runLength.addWarmupSample(Int(iterationDuration.nanoseconds())) == false
+            }
+            detectingWarmup = false
+            adaptiveRunLength = runLength
 
             if benchmark.failureReason != nil {
                 return []
             }
+        }
 
-            benchmark.currentIteration = iterations + benchmark.configuration.warmupIterations
+        let warmupIterations = benchmark.configuration.warmupIterations + (adaptiveRunLength?.warmupIterations ?? 0)
 
-            benchmark.run()
+        // Only attribute the allocations and samples of measured iterations, not those taken while calibrating
+        if AllocationProfiler.enabled {
+            AllocationProfiler.reset()
+        }
 
+        if ARCStatsProducer.typeAttributionEnabled {
+            ARCStatsProducer.resetTypes()
+        }
+
+        if CPUProfiler.enabled {
+            CPUProfiler.reset()
+        }
+
+        // Only the measured iterations are traced
+        if IterationTraceRecorder.enabled {
+            trace = IterationTraceRecorder(benchmark, metrics: iterationMetrics)
+            traceStartTime = BenchmarkClock.now
+        }
+
+        // Run the benchmark until the desired iterations/runtime is reached
+        measuring = true
+        runIterations {
+            guard wallClockDuration < benchmark.configuration.maxDuration,
+                iterations < benchmark.configuration.maxIterations,
+                benchmark.failureReason == nil
+            else {
+                return false
+            }
+
+            benchmark.currentIteration = iterations + warmupIterations
+            return true
+        } after: {
             iterations += 1
 
+            if adaptiveRunLength?.addSample(Int(iterationDuration.nanoseconds())) == true {
+                return false
+            }
+
             if iterations < 1_000 || iterations.isMultiple(of: 500) { // only update for low iteration count benchmarks, else 1/500
                 if var progressBar {
                     let iterationsPercentage =
@@ -415,16 +834,35 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
                     }
                 }
             }
+
+            return true
+        }
+        measuring = false
+
+        if benchmark.failureReason != nil {
+            return []
         }
 
         if performanceCountersRequested {
             operatingSystemStatsProducer.disablePerformanceCounters()
         }
 
-        if arcStatsRequested {
+        if arcStatsRequested || ARCStatsProducer.typeAttributionEnabled {
             ARCStatsProducer.unhook()
         }
 
+        if ARCStatsProducer.typeAttributionEnabled {
+            ARCStatsProducer.writeTypeProfile(benchmark)
+        }
+
+        if AllocationProfiler.enabled {
+            AllocationProfiler.writeProfile(benchmark)
+        }
+
+        if CPUProfiler.enabled {
+            CPUProfiler.writeProfile(benchmark)
+        }
+
         #if canImport(OSLog)
         signPost.endInterval("Benchmark", benchmarkInterval, "\(iterations)")
         #endif
@@ -433,15 +871,19 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
             progressBar.setValue(100)
         }
 
-        if benchmark.configuration.metrics.contains(.threads)
-            || benchmark.configuration.metrics.contains(.threadsRunning)
-            || benchmark.configuration.metrics.contains(.peakMemoryResident)
-            || benchmark.configuration.metrics.contains(.peakMemoryResidentDelta)
-            || benchmark.configuration.metrics.contains(.peakMemoryVirtual)
-        {
+        if samplingRequested {
             operatingSystemStatsProducer.stopSampling()
         }
 
+        flushMeasurements()
+
+        if threadGroup != nil, benchmark.configuration.metrics.contains(.wallClock) {
+            threadStatistics.forEach { statistics[BenchmarkMetric.wallClock.index].add($0) }
+        }
+
+        let measurementOverhead =
+            bookkeepingIterations > 0 ? Int(bookkeepingDuration.nanoseconds()) / bookkeepingIterations : nil
+
         // construct metric result array
         var results: [BenchmarkResult] = []
 
@@ -460,16 +902,21 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
                             metric: metric,
                             timeUnits: units,
                             scalingFactor: benchmark.configuration.scalingFactor,
-                            warmupIterations: benchmark.configuration.warmupIterations,
+                            warmupIterations: warmupIterations,
                             thresholds: benchmark.configuration.thresholds?[metric],
                             tags: benchmark.configuration.tags,
-                            statistics: value
+                            statistics: value,
+                            batchSize: emptyBatchOverhead != nil ? batchSize : nil,
+                            emptyBatchOverhead: emptyBatchOverhead,
+                            timingOverhead: subtractTimingOverhead ? Int(timingOverhead.nanoseconds()) : nil,
+                            runPrecision: adaptiveRunLength?.precision,
+                            measurementOverhead: measurementOverhead
                         )
                         results.append(result)
                     }
                 }
             default:
-                if operatingSystemsStatsProducerNeeded(metric) == false
+                if (operatingSystemsStatsProducerNeeded(metric) == false && performanceCountersNeeded(metric) == false)
                     || operatingSystemStatsProducer.metricSupported(metric)
                 {
                     let value = statistics[metric.index]
@@ -484,10 +931,15 @@ struct BenchmarkExecutor { // swiftlint:disable:this type_body_length
                             metric: metric,
                             timeUnits: units,
                             scalingFactor: benchmark.configuration.scalingFactor,
-                            warmupIterations: benchmark.configuration.warmupIterations,
+                            warmupIterations: warmupIterations,
                             thresholds: benchmark.configuration.thresholds?[metric],
                             tags: benchmark.configuration.tags,
-                            statistics: value
+                            statistics: value,
+                            batchSize: emptyBatchOverhead != nil ? batchSize : nil,
+                            emptyBatchOverhead: emptyBatchOverhead,
+                            timingOverhead: subtractTimingOverhead ? Int(timingOverhead.nanoseconds()) : nil,
+                            runPrecision: adaptiveRunLength?.precision,
+                            measurementOverhead: measurementOverhead
                         )
                         results.append(result)
                     }
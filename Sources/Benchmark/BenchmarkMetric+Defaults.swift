@@ -66,6 +66,8 @@ public extension BenchmarkMetric {
             .mallocCountTotal,
             .memoryLeaked,
             .allocatedResidentMemory,
+            .minorPageFaults,
+            .majorPageFaults,
         ]
     }
 
@@ -84,6 +86,8 @@ public extension BenchmarkMetric {
         [
             .wallClock,
             .syscalls,
+            .futexSyscalls,
+            .epollWaitSyscalls,
             .contextSwitches,
             .threads,
             .threadsRunning,
@@ -103,6 +107,23 @@ public extension BenchmarkMetric {
         ]
     }
 
+    /// A collection of hardware performance counter metrics, opened as a single counter group.
+    ///
+    /// Which counters are available depends on the CPU and virtualization environment, unsupported ones are filtered out.
+    static var performanceCounters: [BenchmarkMetric] {
+        [
+            .instructions,
+            .cpuCycles,
+            .instructionsPerCycle,
+            .branchMisses,
+            .branchMissesPerKiloInstructions,
+            .cacheMisses,
+            .cacheMissesPerKiloInstructions,
+            .l1dCacheMisses,
+            .dTLBMisses,
+        ]
+    }
+
     /// A collection of all benchmarks supported by this library.
     static var all: [BenchmarkMetric] {
         [
@@ -134,6 +155,30 @@ public extension BenchmarkMetric {
             .retainCount,
             .releaseCount,
             .retainReleaseDelta,
+            .cpuCycles,
+            .branchMisses,
+            .cacheMisses,
+            .l1dCacheMisses,
+            .dTLBMisses,
+            .instructionsPerCycle,
+            .cacheMissesPerKiloInstructions,
+            .branchMissesPerKiloInstructions,
+            .futexSyscalls,
+            .epollWaitSyscalls,
+            .scalingEfficiency,
+            .bytesAllocated,
+            .bytesFreed,
+            .mallocThreadCacheFills,
+            .mallocThreadCacheFlushes,
+            .mallocSizeClass,
+            .growthExponent,
+            .minorPageFaults,
+            .majorPageFaults,
+            .proportionalResidentMemory,
+            .anonymousResidentMemory,
+            .runQueueDelay,
+            .offCPUTime,
+            .timeslices,
         ]
     }
 }
@@ -179,6 +224,11 @@ public extension [BenchmarkMetric] {
         BenchmarkMetric.disk
     }
 
+    /// A collection of hardware performance counter metrics.
+    static var performanceCounters: [BenchmarkMetric] {
+        BenchmarkMetric.performanceCounters
+    }
+
     /// A collection of all benchmarks supported by this library.
     static var all: [BenchmarkMetric] {
         BenchmarkMetric.all
@@ -25,9 +25,9 @@ public enum BenchmarkMetric: Hashable, Equatable, Codable, CustomStringConvertib
     case wallClock
     /// Operations / second, `.prefersLarger`
     case throughput
-    /// Measure resident memory usage - sampled during runtime
+    /// Measure peak resident memory usage per iteration - exact on Linux, sampled during runtime elsewhere
     case peakMemoryResident
-    /// Measure resident memory usage - sampled during runtime (subtracting start of benchmark baseline resident amount)
+    /// Measure peak resident memory usage per iteration (subtracting start of benchmark baseline resident amount)
     case peakMemoryResidentDelta
     /// Measure virtual memory usage - sampled during runtime
     case peakMemoryVirtual
@@ -72,6 +72,61 @@ public enum BenchmarkMetric: Hashable, Equatable, Codable, CustomStringConvertib
     case releaseCount
     /// ABS(retains-releases) - if this is non-zero, it would typically mean the benchmark has a retain cycle (use Memory Graph Debugger to troubleshoot) or that startMeasurement/stopMeasurement aren't used properly
     case retainReleaseDelta
+    /// The number of CPU cycles spent -- Linux (perf_events) and macOS (rusage) only
+    case cpuCycles
+    /// The number of mispredicted branches -- Linux only
+    case branchMisses
+    /// The number of last level cache misses -- Linux only
+    case cacheMisses
+    /// The number of L1 data cache read misses -- Linux only
+    case l1dCacheMisses
+    /// The number of data TLB read misses -- Linux only
+    case dTLBMisses
+    /// Instructions retired per CPU cycle (IPC) multiplied by 1000, `.prefersLarger` -- Linux and macOS only
+    case instructionsPerCycle
+    /// Last level cache misses per thousand instructions (MPKI) multiplied by 1000 -- Linux only
+    case cacheMissesPerKiloInstructions
+    /// Branch misses per thousand instructions multiplied by 1000 -- Linux only
+    case branchMissesPerKiloInstructions
+    /// Measure number of futex syscalls made during the test, typically lock contention -- Linux only
+    case futexSyscalls
+    /// Measure number of epoll wait syscalls made during the test, typically event loop wakeups -- Linux only
+    case epollWaitSyscalls
+    /// Parallel efficiency in percent of a benchmark in a thread sweep: its throughput relative to the
+    /// single threaded throughput times the number of threads, `.prefersLarger`
+    case scalingEfficiency
+    /// Number of bytes allocated, summed over the size classes the allocations were served from
+    case bytesAllocated
+    /// Number of bytes freed, the bytes allocated less the growth of the bytes in use
+    case bytesFreed
+    /// Number of thread cache fills from the allocator arenas
+    case mallocThreadCacheFills
+    /// Number of thread cache flushes to the allocator arenas
+    case mallocThreadCacheFlushes
+    /// The size classes (in bytes) of all allocations, recorded once per allocation request
+    /// to form a histogram of the allocation sizes rather than once per iteration
+    case mallocSizeClass
+    /// The growth of the wall clock time of a benchmark in a size sweep, the slope of the logarithm of its
+    /// median over the logarithm of the size from the next smaller size, multiplied by 100: 0 for constant
+    /// time, 100 for linear and 200 for quadratic growth
+    case growthExponent
+    /// The number of minor page faults, e.g. the first touch of newly allocated memory
+    case minorPageFaults
+    /// The number of major page faults, requiring I/O to read the page from storage
+    case majorPageFaults
+    /// The proportional resident memory (PSS) when the measurement stopped, counting shared pages divided by
+    /// the number of processes mapping them -- Linux only, opt-in as the kernel walks all mappings to read it
+    case proportionalResidentMemory
+    /// The anonymous resident memory, i.e. not backed by a file, when the measurement stopped -- Linux only,
+    /// opt-in as the kernel walks all mappings to read it
+    case anonymousResidentMemory
+    /// Time the threads running the benchmark were runnable but waiting for a CPU, from schedstat -- Linux only
+    case runQueueDelay
+    /// Wall clock time not spent on a CPU or waiting for one by the threads running the benchmark, i.e. blocked
+    /// on locks, I/O or sleeping, from schedstat -- Linux only
+    case offCPUTime
+    /// Number of times the threads running the benchmark were put on a CPU, from schedstat -- Linux only
+    case timeslices
     /// Custom metric
     case custom(_ name: String, polarity: Polarity = .prefersSmaller, useScalingFactor: Bool = true)
 
@@ -108,7 +163,7 @@ public extension BenchmarkMetric {
     // True if the metric is countable (otherwise it's a time/throughput unit)
     var countable: Bool {
         switch self {
-        case .cpuSystem, .cpuTotal, .cpuUser, .wallClock:
+        case .cpuSystem, .cpuTotal, .cpuUser, .wallClock, .runQueueDelay, .offCPUTime:
             return false
         default:
             return true
@@ -122,13 +177,19 @@ public extension BenchmarkMetric {
             return true
         case .mallocCountLarge, .mallocCountSmall, .mallocCountTotal, .memoryLeaked:
             return true
-        case .syscalls:
+        case .bytesAllocated, .bytesFreed, .mallocThreadCacheFills, .mallocThreadCacheFlushes:
+            return true
+        case .syscalls, .futexSyscalls, .epollWaitSyscalls:
+            return true
+        case .minorPageFaults, .majorPageFaults:
+            return true
+        case .runQueueDelay, .offCPUTime, .timeslices:
             return true
         case .readSyscalls, .readBytesLogical, .readBytesPhysical:
             return true
         case .writeSyscalls, .writeBytesLogical, .writeBytesPhysical:
             return true
-        case .instructions:
+        case .instructions, .cpuCycles, .branchMisses, .cacheMisses, .l1dCacheMisses, .dTLBMisses:
             return true
         case .objectAllocCount, .retainCount, .releaseCount, .retainReleaseDelta:
             return true
@@ -142,7 +203,7 @@ public extension BenchmarkMetric {
     /// Indicates whether larger or smaller measurements, relative to a set baseline, indicate better performance.
     var polarity: BenchmarkMetric.Polarity {
         switch self {
-        case .throughput:
+        case .throughput, .instructionsPerCycle, .scalingEfficiency:
             return .prefersLarger
         case let .custom(_, polarity, _):
             return polarity
@@ -209,6 +270,54 @@ public extension BenchmarkMetric {
             return "Releases"
         case .retainReleaseDelta:
             return "(Alloc + Retain) - Release Δ"
+        case .cpuCycles:
+            return "CPU cycles"
+        case .branchMisses:
+            return "Branch misses"
+        case .cacheMisses:
+            return "Cache misses (LLC)"
+        case .l1dCacheMisses:
+            return "Cache misses (L1d)"
+        case .dTLBMisses:
+            return "TLB misses (data)"
+        case .instructionsPerCycle:
+            return "Instructions / cycle (x1000)"
+        case .cacheMissesPerKiloInstructions:
+            return "Cache misses / K instructions (x1000)"
+        case .branchMissesPerKiloInstructions:
+            return "Branch misses / K instructions (x1000)"
+        case .futexSyscalls:
+            return "Syscalls (futex)"
+        case .epollWaitSyscalls:
+            return "Syscalls (epoll wait)"
+        case .scalingEfficiency:
+            return "Scaling efficiency (%)"
+        case .bytesAllocated:
+            return "Bytes (allocated)"
+        case .bytesFreed:
+            return "Bytes (freed)"
+        case .mallocThreadCacheFills:
+            return "Malloc (tcache fills)"
+        case .mallocThreadCacheFlushes:
+            return "Malloc (tcache flushes)"
+        case .mallocSizeClass:
+            return "Malloc (size class)"
+        case .growthExponent:
+            return "Growth exponent (x100)"
+        case .minorPageFaults:
+            return "Page faults (minor)"
+        case .majorPageFaults:
+            return "Page faults (major)"
+        case .proportionalResidentMemory:
+            return "Memory (proportional resident)"
+        case .anonymousResidentMemory:
+            return "Memory (anonymous resident)"
+        case .runQueueDelay:
+            return "Time (run queue)"
+        case .offCPUTime:
+            return "Time (off CPU)"
+        case .timeslices:
+            return "Timeslices"
         case .delta:
             return "Δ"
         case .deltaPercentage:
@@ -278,13 +387,61 @@ public extension BenchmarkMetric {
             return 27
         case .instructions:
             return 28
+        case .cpuCycles:
+            return 29
+        case .branchMisses:
+            return 30
+        case .cacheMisses:
+            return 31
+        case .l1dCacheMisses:
+            return 32
+        case .dTLBMisses:
+            return 33
+        case .instructionsPerCycle:
+            return 34
+        case .cacheMissesPerKiloInstructions:
+            return 35
+        case .branchMissesPerKiloInstructions:
+            return 36
+        case .futexSyscalls:
+            return 37
+        case .epollWaitSyscalls:
+            return 38
+        case .scalingEfficiency:
+            return 39
+        case .bytesAllocated:
+            return 40
+        case .bytesFreed:
+            return 41
+        case .mallocThreadCacheFills:
+            return 42
+        case .mallocThreadCacheFlushes:
+            return 43
+        case .mallocSizeClass:
+            return 44
+        case .growthExponent:
+            return 45
+        case .minorPageFaults:
+            return 46
+        case .majorPageFaults:
+            return 47
+        case .proportionalResidentMemory:
+            return 48
+        case .anonymousResidentMemory:
+            return 49
+        case .runQueueDelay:
+            return 50
+        case .offCPUTime:
+            return 51
+        case .timeslices:
+            return 52
         default:
             return 0 // custom payloads must be stored in dictionary
         }
     }
 
     @_documentation(visibility: internal)
-    static var maxIndex: Int { 28 } //
+    static var maxIndex: Int { 52 } //
 
     // Used by the Benchmark Executor for efficient indexing into results
     @_documentation(visibility: internal)
@@ -346,6 +503,54 @@ public extension BenchmarkMetric {
             return .retainReleaseDelta
         case 28:
             return .instructions
+        case 29:
+            return .cpuCycles
+        case 30:
+            return .branchMisses
+        case 31:
+            return .cacheMisses
+        case 32:
+            return .l1dCacheMisses
+        case 33:
+            return .dTLBMisses
+        case 34:
+            return .instructionsPerCycle
+        case 35:
+            return .cacheMissesPerKiloInstructions
+        case 36:
+            return .branchMissesPerKiloInstructions
+        case 37:
+            return .futexSyscalls
+        case 38:
+            return .epollWaitSyscalls
+        case 39:
+            return .scalingEfficiency
+        case 40:
+            return .bytesAllocated
+        case 41:
+            return .bytesFreed
+        case 42:
+            return .mallocThreadCacheFills
+        case 43:
+            return .mallocThreadCacheFlushes
+        case 44:
+            return .mallocSizeClass
+        case 45:
+            return .growthExponent
+        case 46:
+            return .minorPageFaults
+        case 47:
+            return .majorPageFaults
+        case 48:
+            return .proportionalResidentMemory
+        case 49:
+            return .anonymousResidentMemory
+        case 50:
+            return .runQueueDelay
+        case 51:
+            return .offCPUTime
+        case 52:
+            return .timeslices
         default:
             break
         }
@@ -413,6 +618,54 @@ public extension BenchmarkMetric {
             return "releaseCount"
         case .retainReleaseDelta:
             return "retainReleaseDelta"
+        case .cpuCycles:
+            return "cpuCycles"
+        case .branchMisses:
+            return "branchMisses"
+        case .cacheMisses:
+            return "cacheMisses"
+        case .l1dCacheMisses:
+            return "l1dCacheMisses"
+        case .dTLBMisses:
+            return "dTLBMisses"
+        case .instructionsPerCycle:
+            return "instructionsPerCycle"
+        case .cacheMissesPerKiloInstructions:
+            return "cacheMissesPerKiloInstructions"
+        case .branchMissesPerKiloInstructions:
+            return "branchMissesPerKiloInstructions"
+        case .futexSyscalls:
+            return "futexSyscalls"
+        case .epollWaitSyscalls:
+            return "epollWaitSyscalls"
+        case .scalingEfficiency:
+            return "scalingEfficiency"
+        case .bytesAllocated:
+            return "bytesAllocated"
+        case .bytesFreed:
+            return "bytesFreed"
+        case .mallocThreadCacheFills:
+            return "mallocThreadCacheFills"
+        case .mallocThreadCacheFlushes:
+            return "mallocThreadCacheFlushes"
+        case .mallocSizeClass:
+            return "mallocSizeClass"
+        case .growthExponent:
+            return "growthExponent"
+        case .minorPageFaults:
+            return "minorPageFaults"
+        case .majorPageFaults:
+            return "majorPageFaults"
+        case .proportionalResidentMemory:
+            return "proportionalResidentMemory"
+        case .anonymousResidentMemory:
+            return "anonymousResidentMemory"
+        case .runQueueDelay:
+            return "runQueueDelay"
+        case .offCPUTime:
+            return "offCPUTime"
+        case .timeslices:
+            return "timeslices"
         case .delta:
             return "Δ"
         case .deltaPercentage:
@@ -423,6 +676,38 @@ public extension BenchmarkMetric {
     }
 }
 
+// The performance counter events that must be opened by the benchmark process for a set of metrics,
+// these are opened by a constructor before main() so are passed by the benchmark tool in the environment.
+@_documentation(visibility: internal)
+public extension [BenchmarkMetric] {
+    var performanceCounterEvents: [String] {
+        var events: [BenchmarkMetric] = []
+        for metric in self {
+            switch metric {
+            case .instructions, .cpuCycles, .branchMisses, .cacheMisses, .l1dCacheMisses, .dTLBMisses:
+                events.append(metric)
+            case .syscalls, .futexSyscalls, .epollWaitSyscalls:
+                events.append(metric)
+            case .minorPageFaults, .majorPageFaults:
+                events.append(metric)
+            case .instructionsPerCycle:
+                events.append(contentsOf: [.instructions, .cpuCycles])
+            case .cacheMissesPerKiloInstructions:
+                events.append(contentsOf: [.instructions, .cacheMisses])
+            case .branchMissesPerKiloInstructions:
+                events.append(contentsOf: [.instructions, .branchMisses])
+            default:
+                break
+            }
+        }
+        return events.reduce(into: []) { names, metric in
+            if names.contains(metric.rawDescription) == false {
+                names.append(metric.rawDescription)
+            }
+        }
+    }
+}
+
 // swiftlint:disable cyclomatic_complexity function_body_length
 // As we can't have raw values and associated data we add this...
 @_documentation(visibility: internal)
@@ -485,6 +770,54 @@ public extension BenchmarkMetric {
             self = BenchmarkMetric.releaseCount
         case "retainReleaseDelta":
             self = BenchmarkMetric.retainReleaseDelta
+        case "cpuCycles":
+            self = BenchmarkMetric.cpuCycles
+        case "branchMisses":
+            self = BenchmarkMetric.branchMisses
+        case "cacheMisses":
+            self = BenchmarkMetric.cacheMisses
+        case "l1dCacheMisses":
+            self = BenchmarkMetric.l1dCacheMisses
+        case "dTLBMisses":
+            self = BenchmarkMetric.dTLBMisses
+        case "instructionsPerCycle":
+            self = BenchmarkMetric.instructionsPerCycle
+        case "cacheMissesPerKiloInstructions":
+            self = BenchmarkMetric.cacheMissesPerKiloInstructions
+        case "branchMissesPerKiloInstructions":
+            self = BenchmarkMetric.branchMissesPerKiloInstructions
+        case "futexSyscalls":
+            self = BenchmarkMetric.futexSyscalls
+        case "epollWaitSyscalls":
+            self = BenchmarkMetric.epollWaitSyscalls
+        case "scalingEfficiency":
+            self = BenchmarkMetric.scalingEfficiency
+        case "bytesAllocated":
+            self = BenchmarkMetric.bytesAllocated
+        case "bytesFreed":
+            self = BenchmarkMetric.bytesFreed
+        case "mallocThreadCacheFills":
+            self = BenchmarkMetric.mallocThreadCacheFills
+        case "mallocThreadCacheFlushes":
+            self = BenchmarkMetric.mallocThreadCacheFlushes
+        case "mallocSizeClass":
+            self = BenchmarkMetric.mallocSizeClass
+        case "growthExponent":
+            self = BenchmarkMetric.growthExponent
+        case "minorPageFaults":
+            self = BenchmarkMetric.minorPageFaults
+        case "majorPageFaults":
+            self = BenchmarkMetric.majorPageFaults
+        case "proportionalResidentMemory":
+            self = BenchmarkMetric.proportionalResidentMemory
+        case "anonymousResidentMemory":
+            self = BenchmarkMetric.anonymousResidentMemory
+        case "runQueueDelay":
+            self = BenchmarkMetric.runQueueDelay
+        case "offCPUTime":
+            self = BenchmarkMetric.offCPUTime
+        case "timeslices":
+            self = BenchmarkMetric.timeslices
         default:
             self = BenchmarkMetric.custom(argument)
         }
@@ -199,6 +199,72 @@ public enum BenchmarkScalingFactor: Int, Codable {
     }
 }
 
+/// Automatic batching of multiple invocations of the benchmark closure into a single sample.
+public enum BenchmarkBatching: Codable, Equatable {
+    /// Every invocation of the benchmark closure is measured as a separate sample.
+    case none
+    /// The number of invocations that are timed together is calibrated before the measurement starts, such that
+    /// each sample takes at least `targetDuration`. Samples are then recorded per invocation.
+    ///
+    /// Useful for benchmarks in the nanosecond range, where the overhead of the measurement itself and the clock
+    /// granularity would otherwise dominate. Benchmarks using `startMeasurement()`/`stopMeasurement()` aren't batched.
+    case automatic(targetDuration: Duration = .microseconds(10))
+}
+
+/// How many iterations of a benchmark are run, always within its `maxIterations` and `maxDuration`.
+public enum BenchmarkRunLength: Codable, Equatable {
+    /// The configured `warmupIterations` are run, then the benchmark is measured until `maxIterations`
+    /// or `maxDuration` is reached.
+    case fixed
+    /// After the configured `warmupIterations`, the end of warmup is detected from the samples, by comparing
+    /// each window of samples with the previous one until there is no significant change between them.
+    /// Samples taken during warmup aren't recorded. The measurement then stops as soon as the 95% confidence
+    /// intervals of the `percentiles` of the wall clock time are narrower than `relativeWidth` of their value.
+    ///
+    /// `maxIterations` and `maxDuration` remain hard limits, for benchmarks that never settle down.
+    /// The confidence intervals of p0 and p100 aren't defined, so those percentiles are ignored.
+    case adaptive(percentiles: [BenchmarkResult.Percentile] = [.p50, .p90, .p99], relativeWidth: Double = 0.02)
+}
+
+/// The warmup length and the precision reached by a benchmark run with an adaptive run length.
+public struct BenchmarkRunPrecision: Codable, Equatable {
+    /// The number of iterations detected as warmup, run after the configured `warmupIterations` but not recorded
+    public var warmupIterations: Int
+    /// Whether the samples settled down before the warmup detection ran out of iterations or time
+    public var steadyStateDetected: Bool
+    /// The percentiles the precision was tracked for
+    public var percentiles: [BenchmarkResult.Percentile]
+    /// The width of the 95% confidence interval of each percentile relative to its value when the run stopped
+    public var relativeWidths: [Double]
+    /// Whether all confidence intervals were narrower than the target, rather than the run being cut off
+    /// by `maxIterations` or `maxDuration`
+    public var converged: Bool
+
+    public init(
+        warmupIterations: Int,
+        steadyStateDetected: Bool,
+        percentiles: [BenchmarkResult.Percentile],
+        relativeWidths: [Double],
+        converged: Bool
+    ) {
+        self.warmupIterations = warmupIterations
+        self.steadyStateDetected = steadyStateDetected
+        self.percentiles = percentiles
+        self.relativeWidths = relativeWidths
+        self.converged = converged
+    }
+}
+
+/// The scope of the hardware performance counters used for e.g. the ``BenchmarkMetric/instructions`` metric.
+public enum BenchmarkPerformanceCounterScope: String, Codable {
+    /// Count all threads of the benchmark process, including threads started by the benchmark.
+    case process
+    /// Count only the thread running the benchmark closure. On Linux x86_64 the counters are then read from
+    /// user space without any syscalls, which substantially reduces the measurement overhead for short benchmarks.
+    /// Work done on other threads (e.g. dispatched to other queues or tasks) is not included.
+    case thread
+}
+
 // How we should scale a result for a given time unit (all results counted in nanos)
 public extension BenchmarkScalingFactor {
     init(_ units: BenchmarkTimeUnits) {
@@ -230,7 +296,12 @@ public struct BenchmarkResult: Codable, Comparable, Equatable {
         warmupIterations: Int,
         thresholds: BenchmarkThresholds? = nil,
         tags: [String: String] = [:],
-        statistics: Statistics
+        statistics: Statistics,
+        batchSize: Int? = nil,
+        emptyBatchOverhead: Int? = nil,
+        timingOverhead: Int? = nil,
+        runPrecision: BenchmarkRunPrecision? = nil,
+        measurementOverhead: Int? = nil
     ) {
         self.metric = metric
         self.timeUnits = timeUnits == .automatic ? BenchmarkTimeUnits(statistics.units()) : timeUnits
@@ -239,6 +310,11 @@ public struct BenchmarkResult: Codable, Comparable, Equatable {
         self.thresholds = thresholds
         self.tags = tags
         self.statistics = statistics
+        self.batchSize = batchSize
+        self.emptyBatchOverhead = emptyBatchOverhead
+        self.timingOverhead = timingOverhead
+        self.runPrecision = runPrecision
+        self.measurementOverhead = measurementOverhead
     }
 
     public var metric: BenchmarkMetric
@@ -248,6 +324,16 @@ public struct BenchmarkResult: Codable, Comparable, Equatable {
     public var thresholds: BenchmarkThresholds?
     public var tags: [String: String]
     public var statistics: Statistics
+    /// The number of invocations timed together for each sample if automatic batching was used
+    public var batchSize: Int?
+    /// The measured overhead in nanoseconds of timing an empty batch, if automatic batching was used
+    public var emptyBatchOverhead: Int?
+    /// The overhead in nanoseconds of timing an empty closure, if it was subtracted from each wall clock sample
+    public var timingOverhead: Int?
+    /// The detected warmup and the precision reached, if the run length was adaptive
+    public var runPrecision: BenchmarkRunPrecision?
+    /// The time in nanoseconds per iteration spent outside the measured region taking and recording the measurements
+    public var measurementOverhead: Int?
 
     public var scaledTimeUnits: BenchmarkTimeUnits {
         switch timeUnits {
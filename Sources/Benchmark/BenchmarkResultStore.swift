@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Binary storage of benchmark results, used by the benchmark tool for baselines.
+//
+// The results are stored as one record per benchmark and metric, in the same encoding as the
+// metric result frames sent by the benchmark process, followed by an index of the records.
+// A reader parses the index only, so that a (memory mapped) store can be queried for the few
+// benchmarks and metrics of interest without decoding the histograms of all the others.
+//
+// Layout, integers are varints unless noted:
+//
+//   "BMRS" version:UInt8
+//   metadata length, metadata bytes (opaque to the store)
+//   records: JSON length, JSON encoded BenchmarkResult without histogram, encoded histogram
+//   index: entry count, per entry: target, name, JSON encoded metric (each length prefixed), record offset, length
+//   index offset:UInt64 big endian
+
+import Foundation
+
+@_documentation(visibility: internal)
+public enum BenchmarkResultStoreError: Error {
+    case invalidMagic
+    case unsupportedVersion(UInt8)
+    case truncated
+}
+
+@_documentation(visibility: internal)
+public enum BenchmarkResultStore {
+    static let magic: [UInt8] = Array("BMRS".utf8)
+    static let version: UInt8 = 1
+    static let trailerSize = MemoryLayout<UInt64>.size
+
+    /// The location of the record of the result of one metric of a benchmark
+    public struct IndexEntry {
+        public var target: String
+        public var name: String
+        public var metric: BenchmarkMetric
+        var offset: Int
+        var length: Int
+    }
+
+    /// Encodes `results` with their benchmark target and name, and `metadata` stored as is
+    public static func encode(
+        metadata: [UInt8],
+        results: [(target: String, name: String, results: [BenchmarkResult])]
+    ) throws -> [UInt8] {
+        let resultEncoder = JSONEncoder()
+        resultEncoder.userInfo[.statisticsExcludeHistogram] = true
+        let metricEncoder = JSONEncoder()
+
+        var buffer = magic
+        buffer.append(version)
+        buffer.appendVarint(UInt64(metadata.count))
+        buffer.append(contentsOf: metadata)
+
+        var index: [UInt8] = []
+        var entryCount = 0
+
+        func appendString<Bytes: Collection>(_ bytes: Bytes) where Bytes.Element == UInt8 {
+            index.appendVarint(UInt64(bytes.count))
+            index.append(contentsOf: bytes)
+        }
+
+        for (target, name, benchmarkResults) in results {
+            for result in benchmarkResults {
+                let offset = buffer.count
+                try result.encodeRecord(into: &buffer, encoder: resultEncoder)
+
+                appendString(target.utf8)
+                appendString(name.utf8)
+                appendString(try metricEncoder.encode(result.metric))
+                index.appendVarint(UInt64(offset))
+                index.appendVarint(UInt64(buffer.count - offset))
+                entryCount += 1
+            }
+        }
+
+        let indexOffset = buffer.count
+        buffer.appendVarint(UInt64(entryCount))
+        buffer.append(contentsOf: index)
+        buffer.appendBigEndian(UInt64(indexOffset))
+
+        return buffer
+    }
+
+    /// Reads a store from `bytes`, which must stay valid for the lifetime of the reader
+    public struct Reader {
+        private let bytes: UnsafeRawBufferPointer
+        private let resultDecoder = JSONDecoder()
+
+        /// The metadata stored with the results
+        public let metadata: [UInt8]
+        /// The stored results, in the order they were encoded
+        public let index: [IndexEntry]
+
+        public init(_ bytes: UnsafeRawBufferPointer) throws {
+            self.bytes = bytes
+            resultDecoder.userInfo[.statisticsExcludeHistogram] = true
+
+            let headerSize = magic.count + 1
+            guard bytes.count >= headerSize + trailerSize else {
+                throw BenchmarkResultStoreError.truncated
+            }
+            guard bytes.prefix(magic.count).elementsEqual(magic) else {
+                throw BenchmarkResultStoreError.invalidMagic
+            }
+            guard bytes[magic.count] == version else {
+                throw BenchmarkResultStoreError.unsupportedVersion(bytes[magic.count])
+            }
+
+            var offset = 0
+            let trailer = [UInt8](bytes.suffix(trailerSize))
+            guard let indexOffset = Int(exactly: try trailer.readBigEndian(UInt64.self, at: &offset)),
+                (headerSize..<bytes.count - trailerSize).contains(indexOffset)
+            else {
+                throw BenchmarkResultStoreError.truncated
+            }
+
+            // The metadata and the index are copied, the records are left in place until decoded
+            let maxVarintSize = 10
+            let metadataHeader = [UInt8](bytes[headerSize..<min(headerSize + maxVarintSize, indexOffset)])
+            offset = 0
+            guard let metadataLength = Int(exactly: try metadataHeader.readVarint(at: &offset)),
+                metadataLength <= indexOffset - headerSize - offset
+            else {
+                throw BenchmarkResultStoreError.truncated
+            }
+            let metadataOffset = headerSize + offset
+            metadata = [UInt8](bytes[metadataOffset..<metadataOffset + metadataLength])
+
+            let indexBytes = [UInt8](bytes[indexOffset..<bytes.count - trailerSize])
+            let metricDecoder = JSONDecoder()
+            offset = 0
+
+            func readString() throws -> ArraySlice<UInt8> {
+                let length = try Self.readLength(indexBytes, at: &offset)
+                defer { offset += length }
+                return indexBytes[offset..<offset + length]
+            }
+
+            var index: [IndexEntry] = []
+            let entryCount = try Self.readLength(indexBytes, at: &offset)
+            index.reserveCapacity(entryCount)
+            for _ in 0..<entryCount {
+                let target = String(decoding: try readString(), as: UTF8.self)
+                let name = String(decoding: try readString(), as: UTF8.self)
+                let metric = try metricDecoder.decode(BenchmarkMetric.self, from: Data(try readString()))
+                guard let recordOffset = Int(exactly: try indexBytes.readVarint(at: &offset)),
+                    let recordLength = Int(exactly: try indexBytes.readVarint(at: &offset)),
+                    (headerSize...indexOffset).contains(recordOffset),
+                    recordLength <= indexOffset - recordOffset
+                else {
+                    throw BenchmarkResultStoreError.truncated
+                }
+                index.append(IndexEntry(
+                    target: target,
+                    name: name,
+                    metric: metric,
+                    offset: recordOffset,
+                    length: recordLength
+                ))
+            }
+            self.index = index
+        }
+
+        /// Decodes the result, including its histogram, of an entry of the index
+        public func result(_ entry: IndexEntry) throws -> BenchmarkResult {
+            let record = [UInt8](bytes[entry.offset..<entry.offset + entry.length])
+            var offset = 0
+            return try BenchmarkResult.decodeRecord(from: record, offset: &offset, decoder: resultDecoder)
+        }
+
+        private static func readLength(_ buffer: [UInt8], at offset: inout Int) throws -> Int {
+            guard let length = Int(exactly: try buffer.readVarint(at: &offset)), offset + length <= buffer.count else {
+                throw BenchmarkResultStoreError.truncated
+            }
+            return length
+        }
+    }
+}
@@ -24,18 +24,30 @@ extension BenchmarkRunner {
         guard outputFD != nil else {
             return
         }
-        let bytesArray = try JSONEncoder().encode(reply)
-        let count: Int = bytesArray.count
         let output = FileDescriptor(rawValue: outputFD!)
 
+        if jsonProtocol {
+            try write(frame: [UInt8](JSONEncoder().encode(reply)), to: output)
+            return
+        }
+
+        // Binary encoding, results are streamed with one frame per metric
+        try BenchmarkReplyEncoder().encode(reply) { frame in
+            try write(frame: frame, to: output)
+        }
+    }
+
+    private func write(frame: [UInt8], to output: FileDescriptor) throws {
+        let count: Int = frame.count
+
         // Length header
         try withUnsafeBytes(of: count) { (intPtr: UnsafeRawBufferPointer) in
             _ = try output.write(intPtr)
         }
 
-        // JSON serialization
-        try bytesArray.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
-            let written = try output.write(bytes)
+        // Frame contents
+        try frame.withUnsafeBytes { (bytes: UnsafeRawBufferPointer) in
+            let written = try output.writeAll(bytes)
             if count != written {
                 fatalError("count != written \(count) ---- \(written)")
             }
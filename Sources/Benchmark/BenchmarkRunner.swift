@@ -82,6 +82,9 @@ public struct BenchmarkRunner: AsyncParsableCommand, BenchmarkRunnerReadWrite {
     @Flag(name: .shortAndLong, help: "True if we should run the benchmarks for all metrics.")
     var allMetrics = false
 
+    @Flag(name: .long, help: "True if replies to the host process should be JSON encoded instead of binary (for debugging).")
+    var jsonProtocol = false
+
     var debug = false
 
     func shouldRunBenchmark(_ name: String) throws -> Bool {
@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Atomics
+import Foundation
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+// A fixed group of threads running a closure concurrently, used for multi-threaded benchmarks.
+//
+// The calling thread takes part as thread 0. For each round all threads are released together by
+// bumping a generation counter that the workers spin on, and the caller spins until all of them are
+// done. Both sides only spin briefly, then yield the CPU and finally block on a condition, so that
+// threads sharing a CPU (e.g. when pinned with --stabilize, where SCHED_FIFO threads never preempt
+// each other) still get to run, and idle workers don't burn CPU while the measurements between rounds
+// are taken. The counts of blocked threads are checked with sequentially consistent atomics after the
+// generation or running count is updated, so the conditions are only locked when someone is waiting.
+final class BenchmarkThreadGroup {
+    typealias Body = (_ thread: Int) -> Void
+
+    private static let spinIterations = 1_000
+    private static let yieldIterations = 100 // after spinning, before blocking
+
+    let threads: Int
+    private let body: Body
+    private let generation = ManagedAtomic<Int>(0)
+    private let running = ManagedAtomic<Int>(0)
+    private let shuttingDown = ManagedAtomic<Bool>(false)
+    private let released = NSCondition() // the workers wait for the next round
+    private let blockedWorkers = ManagedAtomic<Int>(0)
+    private let finished = NSCondition() // the caller waits for the workers to complete the round
+    private let callerBlocked = ManagedAtomic<Bool>(false)
+
+    /// Starts the worker threads, each of which runs `start` before the first round. Returns once all
+    /// workers have run it.
+    init(threads: Int, start: (() -> Void)? = nil, body: @escaping Body) {
+        self.threads = max(threads, 1)
+        self.body = body
+
+        running.store(self.threads - 1, ordering: .relaxed)
+
+        for thread in 1..<self.threads {
+            let worker = Thread { [self] in
+                start?()
+                running.wrappingDecrement(ordering: .releasing)
+                work(thread)
+            }
+            worker.name = "Benchmark worker \(thread)"
+            worker.start()
+        }
+
+        while running.load(ordering: .acquiring) > 0 {
+            sched_yield()
+        }
+    }
+
+    /// Runs the body once on each thread and returns when all of them have completed
+    func run() {
+        release()
+        body(0)
+        waitForWorkers()
+    }
+
+    /// Stops the worker threads, the group can't be used afterwards
+    func shutdown() {
+        shuttingDown.store(true, ordering: .releasing)
+        release()
+        waitForWorkers()
+    }
+
+    private func release() {
+        running.store(threads - 1, ordering: .relaxed)
+        generation.wrappingIncrement(ordering: .sequentiallyConsistent)
+
+        if blockedWorkers.load(ordering: .sequentiallyConsistent) > 0 {
+            released.lock()
+            released.broadcast()
+            released.unlock()
+        }
+    }
+
+    private func waitForWorkers() {
+        var spins = 0
+        while running.load(ordering: .acquiring) > 0 {
+            spins += 1
+            if spins < Self.spinIterations {
+                continue
+            }
+            if spins < Self.spinIterations + Self.yieldIterations {
+                sched_yield()
+                continue
+            }
+
+            finished.lock()
+            callerBlocked.store(true, ordering: .sequentiallyConsistent)
+            while running.load(ordering: .sequentiallyConsistent) > 0 {
+                finished.wait()
+            }
+            callerBlocked.store(false, ordering: .relaxed)
+            finished.unlock()
+        }
+    }
+
+    private func completed() {
+        if running.loadThenWrappingDecrement(ordering: .sequentiallyConsistent) == 1,
+            callerBlocked.load(ordering: .sequentiallyConsistent)
+        {
+            finished.lock()
+            finished.signal()
+            finished.unlock()
+        }
+    }
+
+    private func work(_ thread: Int) {
+        var seenGeneration = 0
+
+        while true {
+            var spins = 0
+            while generation.load(ordering: .acquiring) == seenGeneration {
+                spins += 1
+                if spins < Self.spinIterations {
+                    continue
+                }
+                if spins < Self.spinIterations + Self.yieldIterations {
+                    sched_yield()
+                    continue
+                }
+
+                released.lock()
+                blockedWorkers.wrappingIncrement(ordering: .sequentiallyConsistent)
+                while generation.load(ordering: .sequentiallyConsistent) == seenGeneration {
+                    released.wait()
+                }
+                blockedWorkers.wrappingDecrement(ordering: .relaxed)
+                released.unlock()
+            }
+            seenGeneration += 1 // the next round is only released once all workers are done with this one
+
+            if shuttingDown.load(ordering: .acquiring) {
+                completed()
+                return
+            }
+
+            body(thread)
+            completed()
+        }
+    }
+}
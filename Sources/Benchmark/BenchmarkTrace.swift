@@ -0,0 +1,265 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// The values of each measured iteration in the order they were run, as recorded by IterationTraceRecorder,
+// and the tests for whether they are independent samples, used by the benchmark tool.
+//
+// The trace file is columnar, all integers are 64 bits in the byte order of the machine:
+//
+//   "BMTRACE1", columns, capacity, iterations recorded
+//   columns × 32 byte NUL padded column names, "timestamp" first
+//   columns × capacity values, a ring buffer per column, Int64.min where not recorded
+//
+// When more iterations than the capacity were run, the oldest value of each column is found at
+// iterations % capacity.
+
+import Foundation
+
+/// The values of each measured iteration of a benchmark, in the order they were run
+@_documentation(visibility: internal)
+public struct BenchmarkTrace: Equatable {
+    /// The iterations recorded by default, the oldest are overwritten when running more
+    public static let defaultCapacity = 65_536
+
+    static let magic = Array("BMTRACE1".utf8)
+    static let nameLength = 32
+    static let missing = Int64.min
+
+    static func headerSize(columns: Int) -> Int {
+        magic.count + 3 * MemoryLayout<UInt64>.size + columns * nameLength
+    }
+
+    static func fileSize(columns: Int, capacity: Int) -> Int {
+        headerSize(columns: columns) + columns * capacity * MemoryLayout<Int64>.size
+    }
+
+    /// The name of the first column, the nanoseconds from the start of the measured iterations to the start of each
+    public static let timestampColumn = "timestamp"
+
+    /// The column names, the timestamp followed by the metrics recorded
+    public var columns: [String]
+    /// The values of each column, oldest iteration first, nil if not recorded for an iteration
+    public var values: [[Int?]]
+    /// The iterations run, more than the values kept if the ring buffer wrapped around
+    public var iterations: Int
+
+    public init(columns: [String], values: [[Int?]], iterations: Int) {
+        self.columns = columns
+        self.values = values
+        self.iterations = iterations
+    }
+
+    /// Reads a trace file, nil if it isn't one
+    public init?(_ bytes: [UInt8]) {
+        guard bytes.count >= Self.headerSize(columns: 0), Array(bytes.prefix(Self.magic.count)) == Self.magic else {
+            return nil
+        }
+
+        func load<T: FixedWidthInteger>(_ offset: Int, as _: T.Type) -> T {
+            bytes.withUnsafeBytes { $0.loadUnaligned(fromByteOffset: offset, as: T.self) }
+        }
+
+        let columnCount = Int(load(Self.magic.count, as: UInt64.self))
+        let capacity = Int(load(Self.magic.count + 8, as: UInt64.self))
+        let iterations = Int(load(Self.magic.count + 16, as: UInt64.self))
+
+        guard columnCount > 0, capacity > 0, bytes.count >= Self.fileSize(columns: columnCount, capacity: capacity) else {
+            return nil
+        }
+
+        columns = (0..<columnCount).map { column in
+            let offset = Self.headerSize(columns: 0) + column * Self.nameLength
+            let name = bytes[offset..<(offset + Self.nameLength)].prefix { $0 != 0 }
+            return String(decoding: name, as: UTF8.self)
+        }
+
+        let recorded = min(iterations, capacity)
+        let oldest = iterations > capacity ? iterations % capacity : 0
+        let dataOffset = Self.headerSize(columns: columnCount)
+
+        values = (0..<columnCount).map { column in
+            (0..<recorded).map { index in
+                let row = (oldest + index) % capacity
+                let value = load(dataOffset + (column * capacity + row) * 8, as: Int64.self)
+                return value == Self.missing ? nil : Int(value)
+            }
+        }
+        self.iterations = iterations
+    }
+
+    public static func fileName(target: String, name: String) -> String {
+        "\(target).\(name).trace"
+            .replacingOccurrences(of: "/", with: "_")
+            .replacingOccurrences(of: " ", with: "_")
+    }
+
+    /// One line per iteration with a header line of the column names, empty where not recorded
+    public func csv() -> String {
+        var csv = columns.joined(separator: ",") + "\n"
+        for row in 0..<(values.first?.count ?? 0) {
+            csv += values.map { $0[row].map { String($0) } ?? "" }.joined(separator: ",")
+            csv += "\n"
+        }
+        return csv
+    }
+
+    /// The summary of each metric recorded, keyed by column name, for the metrics that varied between iterations
+    public func summaries() -> [String: BenchmarkTraceSummary] {
+        var summaries: [String: BenchmarkTraceSummary] = [:]
+        for (column, values) in zip(columns, values).dropFirst() {
+            if let summary = BenchmarkTraceSummary(values.compactMap { $0 }) {
+                summaries[column] = summary
+            }
+        }
+        return summaries
+    }
+}
+
+/// Whether consecutive iterations of a benchmark are independent samples, as assumed by the percentiles
+/// and the comparisons made, or show periodic stalls, throttling or drift over the run.
+@_documentation(visibility: internal)
+public struct BenchmarkTraceSummary: Codable, Equatable {
+    /// The lags up to which a period is looked for
+    public static let maxPeriod = 1_000
+
+    /// Autocorrelations smaller than this are taken as independent regardless of the number of samples
+    public static let minimumAutocorrelation = 0.1
+
+    public var samples: Int
+    /// The autocorrelation of the ranks of consecutive samples, around zero for independent samples
+    public var lag1Autocorrelation: Double
+    /// The number of iterations after which the samples repeat, or between regularly recurring outliers
+    public var period: Int?
+    /// The relative change of the median from the first to the second half of the samples
+    public var drift: Double
+
+    /// The autocorrelation that independent samples stay below, with 95% confidence
+    public var significance: Double {
+        max(1.96 / Double(max(samples, 1)).squareRoot(), Self.minimumAutocorrelation)
+    }
+
+    public var independent: Bool {
+        abs(lag1Autocorrelation) <= significance && period == nil
+    }
+
+    public init(samples: Int, lag1Autocorrelation: Double, period: Int?, drift: Double) {
+        self.samples = samples
+        self.lag1Autocorrelation = lag1Autocorrelation
+        self.period = period
+        self.drift = drift
+    }
+
+    /// Summarizes the samples in the order they were taken, nil if there are too few or they're all the same.
+    /// Ranks are used rather than the values, so that a few large outliers don't decide the autocorrelation.
+    public init?(_ samples: [Int]) {
+        guard samples.count >= 8 else {
+            return nil
+        }
+
+        let ranks = Self.ranks(samples)
+        let mean = ranks.reduce(0, +) / Double(ranks.count)
+        let deviations = ranks.map { $0 - mean }
+        let variance = deviations.reduce(0) { $0 + $1 * $1 }
+        guard variance > 0 else {
+            return nil
+        }
+
+        func autocorrelation(_ lag: Int) -> Double {
+            var sum = 0.0
+            for index in 0..<(deviations.count - lag) {
+                sum += deviations[index] * deviations[index + lag]
+            }
+            return sum / variance
+        }
+
+        self.samples = samples.count
+        lag1Autocorrelation = autocorrelation(1)
+
+        // The highest peak of the autocorrelation once it has dropped to zero, as it only drops slowly with drift
+        let maxLag = min(samples.count / 4, Self.maxPeriod)
+        if maxLag >= 3 {
+            let correlations = [1.0] + (1...(maxLag + 1)).map { autocorrelation($0) }
+            let threshold = 2 * max(1.96 / Double(samples.count).squareRoot(), Self.minimumAutocorrelation)
+            var best: (lag: Int, autocorrelation: Double)?
+            if let firstBelowZero = (1...maxLag).first(where: { correlations[$0] <= 0 }), firstBelowZero < maxLag {
+                for lag in (firstBelowZero + 1)...maxLag {
+                    let value = correlations[lag]
+                    if value >= threshold, value >= correlations[lag - 1], value >= correlations[lag + 1],
+                        value > (best?.autocorrelation ?? 0)
+                    {
+                        best = (lag, value)
+                    }
+                }
+            }
+            period = best?.lag
+        }
+
+        // Rare stalls hardly show in the autocorrelation, but recur at a fixed interval
+        period = period ?? Self.outlierPeriod(samples)
+
+        let half = samples.count / 2
+        let firstMedian = Self.median(Array(samples[..<half]))
+        let secondMedian = Self.median(Array(samples[half...]))
+        drift = firstMedian != 0 ? (secondMedian - firstMedian) / abs(firstMedian) : 0
+    }
+
+    // The typical distance between outliers, if most of them are a multiple of it apart
+    static func outlierPeriod(_ samples: [Int]) -> Int? {
+        let sorted = samples.sorted()
+        func quartile(_ fraction: Double) -> Int {
+            sorted[min(sorted.count - 1, Int(fraction * Double(sorted.count)))]
+        }
+        let threshold = quartile(0.5) + 3 * max(quartile(0.75) - quartile(0.25), 1)
+
+        let outliers = samples.indices.filter { samples[$0] > threshold }
+        guard outliers.count >= 4, outliers.count <= samples.count / 4 else {
+            return nil
+        }
+
+        let gaps = zip(outliers, outliers.dropFirst()).map { $1 - $0 }
+        let gap = gaps.sorted()[gaps.count / 2]
+        guard gap >= 2 else {
+            return nil
+        }
+
+        // Allowing for an outlier that didn't stand out enough
+        let tolerance = max(1, gap / 10)
+        let regular = gaps.filter { abs($0 - (($0 + gap / 2) / gap) * gap) <= tolerance }
+        return 5 * regular.count >= 4 * gaps.count ? gap : nil
+    }
+
+    // The rank of each sample, tied samples get the average of their ranks
+    static func ranks(_ samples: [Int]) -> [Double] {
+        let order = samples.indices.sorted { samples[$0] < samples[$1] }
+        var ranks = [Double](repeating: 0, count: samples.count)
+        var start = 0
+        while start < order.count {
+            var end = start
+            while end + 1 < order.count, samples[order[end + 1]] == samples[order[start]] {
+                end += 1
+            }
+            let rank = Double(start + end) / 2
+            for index in start...end {
+                ranks[order[index]] = rank
+            }
+            start = end + 1
+        }
+        return ranks
+    }
+
+    static func median(_ samples: [Int]) -> Double {
+        let sorted = samples.sorted()
+        guard sorted.isEmpty == false else {
+            return 0
+        }
+        let middle = sorted.count / 2
+        return sorted.count.isMultiple(of: 2) ? Double(sorted[middle - 1] + sorted[middle]) / 2 : Double(sorted[middle])
+    }
+}
@@ -0,0 +1,141 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Change point detection for the history of a benchmark metric, used by the benchmark tool.
+//
+// Uses E-divisive with means (Matteson and James, 2014): the series is split hierarchically at the
+// point that maximizes the energy distance between the two sides, as long as a permutation test finds
+// the split significant. It makes no assumptions on the distribution of the values, and finds steps
+// that are small compared to the noise when they persist over enough runs.
+
+@_documentation(visibility: internal)
+public enum ChangePointDetection {
+    /// The indices of `series` where a change in distribution starts, in ascending order
+    public static func eDivisive(
+        _ series: [Double],
+        significance: Double = 0.05,
+        permutations: Int = 199,
+        minimumSegmentLength: Int = 3
+    ) -> [Int] {
+        let minimumSegmentLength = max(minimumSegmentLength, 2)
+        var generator = SplitMix64(seed: 0x5EED) // deterministic, so that reports are reproducible
+        var changePoints: [Int] = []
+
+        while true {
+            let segments = zip([0] + changePoints, changePoints + [series.count]).map { $0..<$1 }
+
+            func bestSplit(_ values: [Double]) -> (index: Int, divergence: Double)? {
+                segments.compactMap { split(values, $0, minimumSegmentLength: minimumSegmentLength) }
+                    .max { $0.divergence < $1.divergence }
+            }
+
+            guard let best = bestSplit(series) else {
+                break
+            }
+
+            // The fraction of permutations within the segments that diverge as much as the split,
+            // stopping as soon as it can't be significant any more
+            let limit = Int(significance * Double(permutations + 1))
+            var permuted = series
+            var exceeding = 0
+            for _ in 0..<permutations where exceeding < limit {
+                for segment in segments {
+                    permuted[segment].shuffle(using: &generator)
+                }
+                if let split = bestSplit(permuted), split.divergence >= best.divergence {
+                    exceeding += 1
+                }
+            }
+
+            guard Double(exceeding + 1) / Double(permutations + 1) <= significance else {
+                break
+            }
+
+            changePoints.append(best.index)
+            changePoints.sort()
+        }
+
+        return changePoints
+    }
+
+    // The split of values[range] with the largest divergence between the two sides
+    static func split(
+        _ values: [Double],
+        _ range: Range<Int>,
+        minimumSegmentLength: Int
+    ) -> (index: Int, divergence: Double)? {
+        let count = range.count
+        guard count >= 2 * minimumSegmentLength else {
+            return nil
+        }
+
+        var left = 0.0 // sum of the distances within the left side
+        var right = 0.0 // within the right side
+        var between = 0.0 // between the sides
+        for i in range {
+            for j in i + 1..<range.upperBound {
+                right += abs(values[i] - values[j])
+            }
+        }
+
+        var best: (index: Int, divergence: Double)?
+
+        // Move one value at a time from the right side to the left side
+        for index in range.lowerBound + 1..<range.upperBound {
+            let moved = index - 1
+            var toLeft = 0.0
+            var toRight = 0.0
+            for i in range.lowerBound..<moved {
+                toLeft += abs(values[i] - values[moved])
+            }
+            for j in moved + 1..<range.upperBound {
+                toRight += abs(values[moved] - values[j])
+            }
+            left += toLeft
+            right -= toRight
+            between += toRight - toLeft
+
+            let leftCount = Double(index - range.lowerBound)
+            let rightCount = Double(range.upperBound - index)
+            guard leftCount >= Double(minimumSegmentLength), rightCount >= Double(minimumSegmentLength) else {
+                continue
+            }
+
+            let divergence = leftCount * rightCount / Double(count) * (
+                2 * between / (leftCount * rightCount)
+                    - left / (leftCount * (leftCount - 1) / 2)
+                    - right / (rightCount * (rightCount - 1) / 2)
+            )
+
+            if divergence > best?.divergence ?? -.infinity {
+                best = (index, divergence)
+            }
+        }
+
+        return best
+    }
+}
+
+// A small seedable generator, see https://prng.di.unimi.it/splitmix64.c
+struct SplitMix64: RandomNumberGenerator {
+    private var state: UInt64
+
+    init(seed: UInt64) {
+        state = seed
+    }
+
+    mutating func next() -> UInt64 {
+        state &+= 0x9E37_79B9_7F4A_7C15
+        var value = state
+        value = (value ^ (value >> 30)) &* 0xBF58_476D_1CE4_E5B9
+        value = (value ^ (value >> 27)) &* 0x94D0_49BB_1331_11EB
+        return value ^ (value >> 31)
+    }
+}
@@ -0,0 +1,211 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Empirical complexity of a size sweep, used by the benchmark tool.
+//
+// The median wall clock time of each size is fitted to t(n) = c * f(n) for each complexity model as done
+// by Google Benchmark, but minimizing the relative rather than the absolute error, as the sizes of a sweep
+// typically span several orders of magnitude and the largest sizes would otherwise decide the fit alone.
+// A cliff is a step in the time per unit of the fitted model between two neighbouring sizes, which is
+// matched to the cache or TLB level whose capacity the working set crossed.
+
+import Foundation
+
+/// A level of the memory hierarchy of the machine, as matched against the working sets of a size sweep
+@_documentation(visibility: internal)
+public struct BenchmarkCacheLevel: Codable, Equatable {
+    /// e.g. L1d, L2, L3 or dTLB
+    public var name: String
+    /// The capacity, or the memory covered by all entries for a TLB
+    public var bytes: Int
+
+    public init(name: String, bytes: Int) {
+        self.name = name
+        self.bytes = bytes
+    }
+
+    public var description: String {
+        "\(name) (\(BenchmarkComplexityFit.formatBytes(bytes)))"
+    }
+}
+
+/// The complexity model fitted to a size sweep, with the points it was fitted to and the cliffs found
+@_documentation(visibility: internal)
+public struct BenchmarkComplexityFit: Codable, Equatable {
+    public enum Model: String, Codable, CaseIterable, Comparable {
+        case constant = "O(1)"
+        case logarithmic = "O(log n)"
+        case linear = "O(n)"
+        case linearithmic = "O(n log n)"
+        case quadratic = "O(n²)"
+
+        public func callAsFunction(_ size: Int) -> Double {
+            let n = Double(max(size, 1))
+            let logN = log2(max(n, 2))
+            switch self {
+            case .constant:
+                return 1
+            case .logarithmic:
+                return logN
+            case .linear:
+                return n
+            case .linearithmic:
+                return n * logN
+            case .quadratic:
+                return n * n
+            }
+        }
+
+        public static func < (lhs: Model, rhs: Model) -> Bool {
+            allCases.firstIndex(of: lhs)! < allCases.firstIndex(of: rhs)!
+        }
+    }
+
+    public struct Point: Codable, Equatable {
+        public var size: Int
+        /// The median wall clock time in nanoseconds
+        public var nanoseconds: Double
+
+        public init(size: Int, nanoseconds: Double) {
+            self.size = size
+            self.nanoseconds = nanoseconds
+        }
+    }
+
+    public struct Cliff: Codable, Equatable {
+        /// The size before the step
+        public var fromSize: Int
+        /// The size after the step
+        public var toSize: Int
+        /// How much the time per unit of the fitted model grew over the step
+        public var slowdown: Double
+        /// The level whose capacity the working set crossed, if any lines up
+        public var cacheLevel: BenchmarkCacheLevel?
+    }
+
+    public var points: [Point]
+    /// The bytes of the working set per unit of size, used to match cliffs to cache levels
+    public var bytesPerElement: Int
+    public var model: Model
+    /// The nanoseconds per unit of the model
+    public var coefficient: Double
+    /// The root mean square of the relative error of each model, the best fitting model has the smallest
+    public var relativeErrors: [Model: Double]
+    public var cliffs: [Cliff]
+
+    /// Steps in the time per unit of the model smaller than this are taken as noise
+    public static let cliffSlowdown = 1.3
+
+    /// Fits the models to `points`, nil if there are fewer than three sizes to fit
+    public static func fit(
+        _ points: [Point],
+        bytesPerElement: Int = 1,
+        cacheLevels: [BenchmarkCacheLevel] = []
+    ) -> BenchmarkComplexityFit? {
+        let points = points.filter { $0.nanoseconds > 0 }.sorted { $0.size < $1.size }
+        guard Set(points.map(\.size)).count >= 3 else {
+            return nil
+        }
+
+        var relativeErrors: [Model: Double] = [:]
+        var coefficients: [Model: Double] = [:]
+
+        for model in Model.allCases {
+            // Least squares of (t - c * f) / t, with c = sum(f / t) / sum((f / t)^2)
+            let ratios = points.map { model($0.size) / $0.nanoseconds }
+            let coefficient = ratios.reduce(0, +) / ratios.reduce(0) { $0 + $1 * $1 }
+            let squaredErrors = ratios.map { (1 - coefficient * $0) * (1 - coefficient * $0) }
+            coefficients[model] = coefficient
+            relativeErrors[model] = (squaredErrors.reduce(0, +) / Double(points.count)).squareRoot()
+        }
+
+        // The simplest model wins a tie
+        let model = Model.allCases.min { relativeErrors[$0]! < relativeErrors[$1]! }!
+
+        var cliffs: [Cliff] = []
+        for (previous, point) in zip(points, points.dropFirst()) {
+            let slowdown = (point.nanoseconds / model(point.size)) / (previous.nanoseconds / model(previous.size))
+            if slowdown >= cliffSlowdown {
+                cliffs.append(
+                    Cliff(
+                        fromSize: previous.size,
+                        toSize: point.size,
+                        slowdown: slowdown,
+                        cacheLevel: cacheLevel(
+                            crossedFrom: previous.size * bytesPerElement,
+                            to: point.size * bytesPerElement,
+                            in: cacheLevels
+                        )
+                    )
+                )
+            }
+        }
+
+        return BenchmarkComplexityFit(
+            points: points,
+            bytesPerElement: bytesPerElement,
+            model: model,
+            coefficient: coefficients[model]!,
+            relativeErrors: relativeErrors,
+            cliffs: cliffs
+        )
+    }
+
+    // The level closest to the middle of the two working sets, allowing for some of a cache being used by
+    // other data and for the hardware prefetchers hiding the step until the working set is somewhat larger
+    static func cacheLevel(
+        crossedFrom workingSet: Int,
+        to nextWorkingSet: Int,
+        in cacheLevels: [BenchmarkCacheLevel]
+    ) -> BenchmarkCacheLevel? {
+        let middle = log2(Double(max(workingSet, 1)) * Double(max(nextWorkingSet, 1))) / 2
+        return cacheLevels
+            .filter { $0.bytes >= workingSet / 2 && $0.bytes <= 2 * nextWorkingSet }
+            .min { abs(log2(Double($0.bytes)) - middle) < abs(log2(Double($1.bytes)) - middle) }
+    }
+
+    /// The slope of the logarithm of the time over the logarithm of the size from the next smaller size,
+    /// or towards the next larger size for the smallest one, for each of `points` sorted by size
+    public static func growthExponents(_ points: [Point]) -> [Double] {
+        let points = points.sorted { $0.size < $1.size }
+        guard points.count >= 2 else {
+            return points.map { _ in 0 }
+        }
+
+        func slope(_ from: Point, _ to: Point) -> Double {
+            guard from.size != to.size, from.nanoseconds > 0, to.nanoseconds > 0 else {
+                return 0
+            }
+            return log(to.nanoseconds / from.nanoseconds) / log(Double(to.size) / Double(from.size))
+        }
+
+        return points.indices.map { index in
+            index == 0 ? slope(points[0], points[1]) : slope(points[index - 1], points[index])
+        }
+    }
+
+    public var description: String {
+        let time = coefficient >= 1 ? String(format: "%.1f", coefficient) : String(format: "%.3g", coefficient)
+        let unit = model == .constant ? "" : " × \(model.rawValue.dropFirst(2).dropLast())"
+        return "\(model.rawValue), \(time) ns\(unit) (rms error \(String(format: "%.1f", 100 * (relativeErrors[model] ?? 0)))%)"
+    }
+
+    static func formatBytes(_ bytes: Int) -> String {
+        let units = ["B", "KiB", "MiB", "GiB"]
+        var value = Double(bytes)
+        var unit = 0
+        while value >= 1_024, unit < units.count - 1 {
+            value /= 1_024
+            unit += 1
+        }
+        let number = value.rounded() == value ? "\(Int(value))" : String(format: "%.1f", value)
+        return "\(number) \(units[unit])"
+    }
+}
@@ -0,0 +1,200 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Binary encoding of histograms following the HdrHistogram V2 encoding layout:
+// a big endian header followed by the counts array, where each count is a zigzag
+// LEB128 varint and runs of empty buckets are stored as a single negative number.
+// The outer DEFLATE compression of the V2 compressed format is not applied, as
+// the zero run length encoding already removes the bulk of the (sparse) counts.
+
+import Histogram
+
+@_documentation(visibility: internal)
+public enum HistogramEncodingError: Error {
+    case invalidCookie
+    case truncated
+    case unsupportedParameters
+}
+
+// The bucket index layout of HdrHistogram, derived from the histogram parameters
+private struct HistogramBucketLayout {
+    let unitMagnitude: Int
+    let subBucketHalfCountMagnitude: Int
+    let subBucketHalfCount: Int
+    let subBucketMask: UInt64
+    let leadingZeroCountBase: Int
+
+    init(lowestDiscernibleValue: UInt64, numberOfSignificantValueDigits: Int) {
+        var largestValueWithSingleUnitResolution: UInt64 = 2
+        for _ in 0..<numberOfSignificantValueDigits {
+            largestValueWithSingleUnitResolution *= 10
+        }
+        let subBucketCountMagnitude = 64 - (largestValueWithSingleUnitResolution - 1).leadingZeroBitCount
+
+        unitMagnitude = 63 - max(lowestDiscernibleValue, 1).leadingZeroBitCount
+        subBucketHalfCountMagnitude = max(subBucketCountMagnitude, 1) - 1
+        subBucketHalfCount = 1 << subBucketHalfCountMagnitude
+        subBucketMask = (UInt64(1 << subBucketCountMagnitude) - 1) << unitMagnitude
+        leadingZeroCountBase = 64 - unitMagnitude - subBucketCountMagnitude
+    }
+
+    func countsIndex(for value: UInt64) -> Int {
+        let bucketIndex = leadingZeroCountBase - (value | subBucketMask).leadingZeroBitCount
+        let subBucketIndex = Int(truncatingIfNeeded: value >> UInt64(bucketIndex + unitMagnitude))
+        return ((bucketIndex + 1) << subBucketHalfCountMagnitude) + (subBucketIndex - subBucketHalfCount)
+    }
+
+    func value(for countsIndex: Int) -> UInt64 {
+        var bucketIndex = (countsIndex >> subBucketHalfCountMagnitude) - 1
+        var subBucketIndex = (countsIndex & (subBucketHalfCount - 1)) + subBucketHalfCount
+        if bucketIndex < 0 {
+            subBucketIndex -= subBucketHalfCount
+            bucketIndex = 0
+        }
+        return UInt64(subBucketIndex) << UInt64(bucketIndex + unitMagnitude)
+    }
+}
+
+@_documentation(visibility: internal)
+public extension Histogram {
+    static var encodingCookie: UInt32 { 0x1C84_9303 }
+
+    /// Appends the V2 encoding of the histogram to `buffer`
+    func encode(into buffer: inout [UInt8]) {
+        let layout = HistogramBucketLayout(
+            lowestDiscernibleValue: lowestDiscernibleValue,
+            numberOfSignificantValueDigits: Int(numberOfSignificantValueDigits.rawValue)
+        )
+        var payload: [UInt8] = []
+        var nextIndex = 0
+
+        payload.reserveCapacity(64)
+
+        for recordedValue in recordedValues() {
+            let index = layout.countsIndex(for: recordedValue.value)
+            if index > nextIndex {
+                payload.appendZigZagVarint(-Int64(index - nextIndex))
+            }
+            payload.appendZigZagVarint(Int64(truncatingIfNeeded: recordedValue.count))
+            nextIndex = index + 1
+        }
+
+        buffer.appendBigEndian(Self.encodingCookie)
+        buffer.appendBigEndian(UInt32(payload.count))
+        buffer.appendBigEndian(UInt32(0)) // normalizing index offset
+        buffer.appendBigEndian(UInt32(numberOfSignificantValueDigits.rawValue))
+        buffer.appendBigEndian(lowestDiscernibleValue)
+        buffer.appendBigEndian(highestTrackableValue)
+        buffer.appendBigEndian(Double(1.0).bitPattern) // integer to double value conversion ratio
+        buffer.append(contentsOf: payload)
+    }
+
+    /// Decodes a histogram encoded with `encode(into:)`, starting at `offset` which is advanced past it
+    static func decode(from buffer: [UInt8], offset: inout Int) throws -> Histogram<Count> {
+        guard try buffer.readBigEndian(UInt32.self, at: &offset) == encodingCookie else {
+            throw HistogramEncodingError.invalidCookie
+        }
+        let payloadLength = Int(try buffer.readBigEndian(UInt32.self, at: &offset))
+        _ = try buffer.readBigEndian(UInt32.self, at: &offset) // normalizing index offset
+        let digits = try buffer.readBigEndian(UInt32.self, at: &offset)
+        let lowestDiscernibleValue = try buffer.readBigEndian(UInt64.self, at: &offset)
+        let highestTrackableValue = try buffer.readBigEndian(UInt64.self, at: &offset)
+        _ = try buffer.readBigEndian(UInt64.self, at: &offset) // integer to double value conversion ratio
+
+        guard let numberOfSignificantValueDigits = SignificantDigits(rawValue: .init(digits)) else {
+            throw HistogramEncodingError.unsupportedParameters
+        }
+        guard offset + payloadLength <= buffer.count else {
+            throw HistogramEncodingError.truncated
+        }
+
+        var histogram = Histogram<Count>(
+            lowestDiscernibleValue: lowestDiscernibleValue,
+            highestTrackableValue: highestTrackableValue,
+            numberOfSignificantValueDigits: numberOfSignificantValueDigits
+        )
+        histogram.autoResize = true
+
+        let layout = HistogramBucketLayout(
+            lowestDiscernibleValue: lowestDiscernibleValue,
+            numberOfSignificantValueDigits: Int(digits)
+        )
+        let payloadEnd = offset + payloadLength
+        var index = 0
+
+        while offset < payloadEnd {
+            let count = try buffer.readZigZagVarint(at: &offset)
+            if count < 0 {
+                index += Int(-count)
+            } else {
+                if count > 0 {
+                    histogram.record(layout.value(for: index), count: Count(count))
+                }
+                index += 1
+            }
+        }
+
+        return histogram
+    }
+}
+
+extension [UInt8] {
+    mutating func appendBigEndian<T: FixedWidthInteger>(_ value: T) {
+        Swift.withUnsafeBytes(of: value.bigEndian) { append(contentsOf: $0) }
+    }
+
+    mutating func appendVarint(_ value: UInt64) {
+        var value = value
+        while value >= 0x80 {
+            append(UInt8(truncatingIfNeeded: value) | 0x80)
+            value >>= 7
+        }
+        append(UInt8(value))
+    }
+
+    mutating func appendZigZagVarint(_ value: Int64) {
+        appendVarint(UInt64(bitPattern: (value << 1) ^ (value >> 63)))
+    }
+
+    func readBigEndian<T: FixedWidthInteger>(_: T.Type, at offset: inout Int) throws -> T {
+        let size = MemoryLayout<T>.size
+        guard offset + size <= count else {
+            throw HistogramEncodingError.truncated
+        }
+        var value: T = 0
+        for byte in self[offset..<offset + size] {
+            value = value << 8 | T(byte)
+        }
+        offset += size
+        return value
+    }
+
+    func readVarint(at offset: inout Int) throws -> UInt64 {
+        var value: UInt64 = 0
+        var shift: UInt64 = 0
+        while true {
+            guard offset < count, shift < 64 else {
+                throw HistogramEncodingError.truncated
+            }
+            let byte = self[offset]
+            offset += 1
+            value |= UInt64(byte & 0x7F) << shift
+            if byte & 0x80 == 0 {
+                return value
+            }
+            shift += 7
+        }
+    }
+
+    func readZigZagVarint(at offset: inout Int) throws -> Int64 {
+        let value = try readVarint(at: &offset)
+        return Int64(bitPattern: value >> 1) ^ -Int64(bitPattern: value & 1)
+    }
+}
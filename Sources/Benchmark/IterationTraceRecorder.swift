@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Records the start time and the value of each metric of every measured iteration into the trace file,
+// see BenchmarkTrace for the format. The file is mapped into memory and its pages touched up front, so
+// recording an iteration neither allocates, faults nor makes system calls, and the iterations recorded
+// survive a crash of the benchmark.
+
+import BenchmarkShared
+import Foundation
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#else
+#error("Unsupported Platform")
+#endif
+
+final class IterationTraceRecorder {
+    static let outputDirectory: String? = getenv(traceEnvironmentVariable).map { String(cString: $0) }
+
+    static let capacity: Int = getenv(traceCapacityEnvironmentVariable)
+        .flatMap { Int(String(cString: $0)) }
+        .map { max($0, 1) } ?? BenchmarkTrace.defaultCapacity
+
+    static var enabled: Bool {
+        outputDirectory != nil
+    }
+
+    private let address: UnsafeMutableRawPointer
+    private let size: Int
+    private let capacity: Int
+    private let columnCount: Int
+    private let iterations: UnsafeMutablePointer<UInt64> // in the header, counts the rows completed
+    private let values: UnsafeMutablePointer<Int64> // columnCount rings of capacity values
+    private let columns: UnsafeMutablePointer<Int> // by metric index, 0 if not recorded as the timestamp is
+    private var row = 0
+
+    // Creates the trace file of the benchmark in the output directory, nil if not tracing or it failed
+    convenience init?(_ benchmark: Benchmark, metrics: [BenchmarkMetric]) {
+        guard let outputDirectory = Self.outputDirectory else {
+            return nil
+        }
+        self.init(
+            path: "\(outputDirectory)/\(BenchmarkTrace.fileName(target: benchmark.target, name: benchmark.name))",
+            metrics: metrics,
+            capacity: Self.capacity
+        )
+    }
+
+    init?(path: String, metrics: [BenchmarkMetric], capacity: Int) {
+        let names = [BenchmarkTrace.timestampColumn] + metrics.map(\.rawDescription)
+        self.capacity = capacity
+        columnCount = names.count
+        size = BenchmarkTrace.fileSize(columns: columnCount, capacity: capacity)
+
+        let fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0o600)
+        guard fd >= 0 else {
+            print("Failed to create the trace file \(path), errno = [\(errno)]")
+            return nil
+        }
+        defer {
+            close(fd)
+        }
+
+        guard ftruncate(fd, off_t(size)) == 0,
+            let address = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0),
+            address != UnsafeMutableRawPointer(bitPattern: -1)
+        else {
+            print("Failed to map the trace file \(path), errno = [\(errno)]")
+            return nil
+        }
+        self.address = address
+
+        // Writing every value touches all pages of the file before measuring
+        let header = address.assumingMemoryBound(to: UInt8.self)
+        BenchmarkTrace.magic.enumerated().forEach { header[$0.offset] = $0.element }
+        let counts = (address + BenchmarkTrace.magic.count).assumingMemoryBound(to: UInt64.self)
+        counts[0] = UInt64(columnCount)
+        counts[1] = UInt64(capacity)
+        counts[2] = 0
+        iterations = counts + 2
+
+        let nameBytes = address + BenchmarkTrace.headerSize(columns: 0)
+        memset(nameBytes, 0, columnCount * BenchmarkTrace.nameLength)
+        for (column, name) in names.enumerated() {
+            for (offset, byte) in name.utf8.prefix(BenchmarkTrace.nameLength - 1).enumerated() {
+                nameBytes.storeBytes(of: byte, toByteOffset: column * BenchmarkTrace.nameLength + offset, as: UInt8.self)
+            }
+        }
+
+        values = (address + BenchmarkTrace.headerSize(columns: columnCount)).assumingMemoryBound(to: Int64.self)
+        values.initialize(repeating: BenchmarkTrace.missing, count: columnCount * capacity)
+
+        columns = .allocate(capacity: BenchmarkMetric.maxIndex + 1)
+        columns.initialize(repeating: 0, count: BenchmarkMetric.maxIndex + 1)
+        for (column, metric) in metrics.enumerated() {
+            columns[metric.index] = column + 1
+        }
+    }
+
+    deinit {
+        columns.deallocate()
+        munmap(address, size)
+    }
+
+    // Starts the row of the next iteration, overwriting the oldest one when full
+    @inline(__always)
+    func beginIteration(timestamp: Int) {
+        var column = 0
+        while column < columnCount {
+            values[column * capacity + row] = BenchmarkTrace.missing
+            column += 1
+        }
+        values[row] = Int64(timestamp)
+    }
+
+    @inline(__always)
+    func record(_ metric: BenchmarkMetric, _ value: Int) {
+        let column = columns[metric.index]
+        if column > 0 {
+            values[column * capacity + row] = Int64(value)
+        }
+    }
+
+    // Only completed rows are counted, so a crash while recording one leaves a consistent trace
+    @inline(__always)
+    func endIteration() {
+        iterations.pointee += 1
+        row = row + 1 == capacity ? 0 : row + 1
+    }
+}
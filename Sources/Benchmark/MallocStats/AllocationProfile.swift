@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Foundation
+
+/// The allocations of the measured region of a benchmark attributed to their call stacks,
+/// as sampled by the jemalloc heap profiler and scaled up to estimate the actual allocations.
+@_documentation(visibility: internal)
+public struct BenchmarkAllocationProfile: Codable, Equatable {
+    public struct Site: Codable, Equatable {
+        /// The symbolicated call stack, outermost frame first
+        public var stack: [String]
+        public var allocations: Int
+        public var bytes: Int
+
+        public init(stack: [String], allocations: Int, bytes: Int) {
+            self.stack = stack
+            self.allocations = allocations
+            self.bytes = bytes
+        }
+
+        /// The stack in the folded format used by flame graph tools, frames separated by ';'
+        public var foldedStack: String {
+            stack.map { $0.replacingOccurrences(of: ";", with: ":") }.joined(separator: ";")
+        }
+    }
+
+    /// The average number of bytes allocated between samples
+    public var sampleInterval: Int
+    /// The allocation sites, most allocations first
+    public var sites: [Site]
+
+    public init(sampleInterval: Int, sites: [Site]) {
+        self.sampleInterval = sampleInterval
+        self.sites = sites.sorted { ($0.allocations, $0.bytes) > ($1.allocations, $1.bytes) }
+    }
+
+    public var totalAllocations: Int {
+        sites.reduce(0) { $0 + $1.allocations }
+    }
+
+    public var totalBytes: Int {
+        sites.reduce(0) { $0 + $1.bytes }
+    }
+
+    /// The sites in the folded stacks format, one "frame;frame;frame count" line per site
+    public func folded(_ count: KeyPath<Site, Int> = \.allocations) -> String {
+        sites.filter { $0[keyPath: count] > 0 }
+            .map { "\($0.foldedStack) \($0[keyPath: count])\n" }
+            .joined()
+    }
+
+    /// Keeps the `count` sites with the most allocations, to bound the size of stored baselines
+    public func top(_ count: Int) -> BenchmarkAllocationProfile {
+        BenchmarkAllocationProfile(sampleInterval: sampleInterval, sites: Array(sites.prefix(count)))
+    }
+
+    /// The name of the file a benchmark process stores the profile of a benchmark in
+    public static func fileName(target: String, name: String) -> String {
+        "\(target).\(name).allocations.json"
+            .replacingOccurrences(of: "/", with: "_")
+            .replacingOccurrences(of: " ", with: "_")
+    }
+}
+
+@_documentation(visibility: internal)
+public extension BenchmarkAllocationProfile {
+    /// Parses a jemalloc heap profile ("heap_v2" format) dumped with accumulated counts (`prof_accum`),
+    /// returning the sample interval and the sampled allocations and bytes of each backtrace.
+    static func parseHeapProfile(
+        _ profile: String
+    ) -> (sampleInterval: Int, backtraces: [(addresses: [UInt], allocations: Int, bytes: Int)])? {
+        let lines = profile.split(separator: "\n", omittingEmptySubsequences: true)
+
+        guard let header = lines.first, header.hasPrefix("heap_v2/"),
+            let sampleInterval = Int(header.dropFirst("heap_v2/".count))
+        else {
+            return nil
+        }
+
+        var backtraces: [(addresses: [UInt], allocations: Int, bytes: Int)] = []
+        var addresses: [UInt]?
+
+        for line in lines.dropFirst() {
+            if line.hasPrefix("MAPPED_LIBRARIES") {
+                break
+            }
+            if line.hasPrefix("@") {
+                addresses = line.dropFirst().split(separator: " ").compactMap {
+                    UInt($0.hasPrefix("0x") ? $0.dropFirst(2) : $0, radix: 16)
+                }
+                continue
+            }
+
+            // "  t*: <curobjs>: <curbytes> [<accumobjs>: <accumbytes>]", the totals over all threads
+            let fields = line.trimmingCharacters(in: .whitespaces)
+            guard let backtrace = addresses, fields.hasPrefix("t*:"),
+                let open = fields.firstIndex(of: "["), let close = fields.firstIndex(of: "]")
+            else {
+                continue
+            }
+            let accumulated = fields[fields.index(after: open)..<close]
+                .split(separator: ":")
+                .compactMap { Int($0.trimmingCharacters(in: .whitespaces)) }
+            if accumulated.count == 2, accumulated[0] > 0 {
+                backtraces.append((backtrace, accumulated[0], accumulated[1]))
+            }
+            addresses = nil
+        }
+
+        return (sampleInterval, backtraces)
+    }
+
+    /// Scales sampled counts up to the estimated actual counts, the same way as jeprof: an allocation
+    /// of `size` bytes is sampled with probability 1 - exp(-size / sampleInterval).
+    static func unsample(allocations: Int, bytes: Int, sampleInterval: Int) -> (allocations: Int, bytes: Int) {
+        guard allocations > 0, sampleInterval > 1 else {
+            return (allocations, bytes)
+        }
+        let averageSize = Double(bytes) / Double(allocations)
+        let scale = 1.0 / (1.0 - exp(-averageSize / Double(sampleInterval)))
+        return (Int((Double(allocations) * scale).rounded()), Int((Double(bytes) * scale).rounded()))
+    }
+}
@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Allocation call site attribution using the jemalloc heap profiler. The benchmark tool starts the
+// benchmark process with profiling enabled but inactive (MALLOC_CONF), sampling is then only
+// activated for the measured region, and the accumulated samples are dumped after the benchmark.
+
+import Foundation
+
+#if canImport(jemalloc)
+import BenchmarkShared
+import jemalloc
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#endif
+
+enum AllocationProfiler {
+    static let outputDirectory: String? = getenv(allocationProfileEnvironmentVariable).map { String(cString: $0) }
+
+    // Profiling must have been enabled at startup, which needs jemalloc built with --enable-prof
+    static let enabled: Bool = {
+        guard outputDirectory != nil else {
+            return false
+        }
+        var enabled = false
+        var size = MemoryLayout<Bool>.size
+        guard mallctl("opt.prof", &enabled, &size, nil, 0) == 0, enabled else {
+            print("Warning: Allocation profiling requires jemalloc built with --enable-prof, not profiling.")
+            return false
+        }
+        return true
+    }()
+
+    static var activeMIB = MallocStatsProducer.setupMIB(name: "prof.active")
+
+    // Clears all samples taken so far, e.g. during warmup
+    static func reset() {
+        if mallctl("prof.reset", nil, nil, nil, 0) != 0 {
+            print("mallctl prof.reset failed")
+        }
+    }
+
+    static func activate(_ active: Bool) {
+        var active = active
+        _ = mallctlbymib(activeMIB, activeMIB.count, nil, nil, &active, MemoryLayout<Bool>.size)
+    }
+
+    // Dumps the heap profile, symbolicates it and writes the profile of the benchmark to the output directory
+    static func writeProfile(_ benchmark: Benchmark) {
+        guard let outputDirectory else {
+            return
+        }
+
+        let dumpPath = "\(outputDirectory)/\(getpid()).heap"
+        let result = dumpPath.withCString { path in
+            var path: UnsafePointer<CChar>? = path
+            return mallctl("prof.dump", nil, nil, &path, MemoryLayout<UnsafePointer<CChar>?>.size)
+        }
+        defer { unlink(dumpPath) }
+
+        guard result == 0,
+            let dump = try? String(contentsOfFile: dumpPath, encoding: .utf8),
+            let heapProfile = BenchmarkAllocationProfile.parseHeapProfile(dump)
+        else {
+            print("Failed to dump the allocation profile for \(benchmark.name) [\(result)]")
+            return
+        }
+
+        var sites: [String: BenchmarkAllocationProfile.Site] = [:]
+        var symbolizer = AllocationSymbolizer()
+
+        for backtrace in heapProfile.backtraces {
+            let stack = symbolizer.stack(backtrace.addresses)
+            let counts = BenchmarkAllocationProfile.unsample(
+                allocations: backtrace.allocations,
+                bytes: backtrace.bytes,
+                sampleInterval: heapProfile.sampleInterval
+            )
+            let key = stack.joined(separator: ";")
+            var site = sites[key] ?? .init(stack: stack, allocations: 0, bytes: 0)
+            site.allocations += counts.allocations
+            site.bytes += counts.bytes
+            sites[key] = site
+        }
+
+        let profile = BenchmarkAllocationProfile(sampleInterval: heapProfile.sampleInterval, sites: Array(sites.values))
+        let fileName = BenchmarkAllocationProfile.fileName(target: benchmark.target, name: benchmark.name)
+
+        do {
+            try JSONEncoder().encode(profile).write(to: URL(fileURLWithPath: "\(outputDirectory)/\(fileName)"))
+        } catch {
+            print("Failed to write the allocation profile for \(benchmark.name): \(error)")
+        }
+    }
+
+    // Resolves return addresses to (demangled) symbol names, skipping the frames of the allocator itself
+    private struct AllocationSymbolizer {
+        private var symbolizer = Symbolizer()
+        private let allocatorImage: UnsafeMutableRawPointer? = {
+            var info = Dl_info()
+            guard let mallctlAddress = dlsym(dlopen(nil, RTLD_NOW), "mallctl") else {
+                return nil
+            }
+            return dladdr(mallctlAddress, &info) != 0 ? info.dli_fbase : nil
+        }()
+
+        private let mainImage: UnsafeMutableRawPointer? = {
+            var info = Dl_info()
+            return dladdr(#dsohandle, &info) != 0 ? info.dli_fbase : nil
+        }()
+
+        mutating func stack(_ addresses: [UInt]) -> [String] {
+            var frames = addresses[...]
+
+            // A statically linked allocator can't be told apart from the benchmark by image
+            if allocatorImage != mainImage {
+                while let address = frames.first, symbolizer.image(address) == allocatorImage, frames.count > 1 {
+                    frames = frames.dropFirst()
+                }
+            }
+
+            return frames.reversed().map { symbolizer.symbol($0) }
+        }
+    }
+}
+
+#else
+
+// stub if no jemalloc available
+enum AllocationProfiler {
+    static let enabled = false
+
+    static func reset() {}
+
+    static func activate(_: Bool) {}
+
+    static func writeProfile(_: Benchmark) {}
+}
+
+#endif
@@ -24,4 +24,14 @@ struct MallocStats {
     /// not actually be physically resident if they correspond to demand-zeroed virtual memory
     /// that has not yet been touched. This is a multiple of the page size.
     var allocatedResidentMemory: Int = 0 // in bytes
+
+    /// Number of bytes currently allocated by the application, i.e. in small and large allocations
+    var bytesInUse: Int = 0 // in bytes
+    /// Total number of bytes requested, summed over the size class sizes, only
+    /// available if the size class requests are read
+    var bytesAllocated: Int = 0 // in bytes
+    /// Number of thread cache fills from the arenas
+    var threadCacheFills: Int = 0
+    /// Number of thread cache flushes to the arenas
+    var threadCacheFlushes: Int = 0
 }
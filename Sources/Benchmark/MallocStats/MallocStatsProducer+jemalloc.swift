@@ -26,14 +26,43 @@ final class MallocStatsProducer {
     static var totalAllocatedMIB: [size_t] = setupMIB(name: "stats.resident")
     static var smallNRequestsMIB: [size_t] = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.nrequests")
     static var largeNRequestsMIB: [size_t] = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.nrequests")
+    static var smallAllocatedMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.allocated")
+    static var largeAllocatedMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.allocated")
+    static var smallNFillsMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.nfills")
+    static var largeNFillsMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.nfills")
+    static var smallNFlushesMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.nflushes")
+    static var largeNFlushesMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.nflushes")
     //    var smallNMallocMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.nmalloc")
     //    var largeNMallocMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.nmalloc")
     //    var smallNDallocMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.ndalloc")
     //    var largeNDallocMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.ndalloc")
-    //    var smallAllocatedMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.allocated")
-    //    var largeAllocatedMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.allocated")
-    //    var smallNFillsMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).small.nfills")
-    //    var largeNFillsMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).large.nfills")
+
+    // The sizes of the small bins and large extents, taken once from the parsed statistics
+    // tree as the size class layout is fixed for the lifetime of the process
+    private static let sizeClassLayout: (bins: [Int], extents: [Int]) = {
+        guard let arenas = jemallocStatistics()?.arenas else {
+            return ([], [])
+        }
+        // The largest extents are beyond Int, no allocation will ever be served from them
+        return (arenas.bin.map(\.size), arenas.lextent.map { $0.size < Double(Int.max) ? Int($0.size) : Int.max })
+    }()
+
+    // All size classes, the small bins followed by the large extents
+    static let sizeClasses: [Int] = sizeClassLayout.bins + sizeClassLayout.extents
+
+    // One cached MIB per size class for the number of requests served by it, with the bin / extent
+    // index substituted into the MIB for "stats.arenas.<ALL>.bins.0.nrequests"
+    static var sizeClassNRequestsMIBs: [[size_t]] = {
+        let binMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).bins.0.nrequests")
+        let extentMIB = setupMIB(name: "stats.arenas.\(MALLCTL_ARENAS_ALL).lextents.0.nrequests")
+        let bins = sizeClassLayout.bins.count
+
+        return sizeClasses.indices.map { sizeClass in
+            var mib = sizeClass < bins ? binMIB : extentMIB
+            mib[4] = sizeClass < bins ? sizeClass : sizeClass - bins
+            return mib
+        }
+    }()
 
     static func setupMIB(name: String) -> [size_t] {
         precondition(!name.split(separator: ".").isEmpty, "setupMIB with 0 count")
@@ -81,6 +110,27 @@ final class MallocStatsProducer {
 
     static func makeMallocStats() -> MallocStats {
         updateEpoch()
+        return readMallocStats()
+    }
+
+    // Also reads the number of requests per size class into `sizeClassRequests`, which must have room for
+    // all size classes so it's updated in place - allocating here would show up in the malloc counts.
+    static func makeMallocStats(sizeClassRequests: inout [Int]) -> MallocStats {
+        updateEpoch()
+        var mallocStats = readMallocStats()
+        var bytesAllocated = 0
+
+        for sizeClass in 0..<min(sizeClassRequests.count, sizeClasses.count) {
+            let requests = readStats(sizeClassNRequestsMIBs[sizeClass])
+            sizeClassRequests[sizeClass] = requests
+            bytesAllocated &+= requests &* sizeClasses[sizeClass] // wraps consistently, so deltas stay exact
+        }
+        mallocStats.bytesAllocated = bytesAllocated
+
+        return mallocStats
+    }
+
+    private static func readMallocStats() -> MallocStats {
         let allocationsCountSmall = readStats(smallNRequestsMIB)
         let allocationsCountLarge = readStats(largeNRequestsMIB)
         let allocatedResidentMemory = readStats(totalAllocatedMIB)
@@ -88,7 +138,10 @@ final class MallocStatsProducer {
             mallocCountTotal: allocationsCountSmall + allocationsCountLarge,
             mallocCountSmall: allocationsCountSmall,
             mallocCountLarge: allocationsCountLarge,
-            allocatedResidentMemory: allocatedResidentMemory
+            allocatedResidentMemory: allocatedResidentMemory,
+            bytesInUse: readStats(smallAllocatedMIB) + readStats(largeAllocatedMIB),
+            threadCacheFills: readStats(smallNFillsMIB) + readStats(largeNFillsMIB),
+            threadCacheFlushes: readStats(smallNFlushesMIB) + readStats(largeNFlushesMIB)
         )
     }
 
@@ -151,6 +204,12 @@ final class MallocStatsProducer {
 
 // stub if no jemalloc available
 enum MallocStatsProducer {
+    static let sizeClasses: [Int] = []
+
+    static func makeMallocStats(sizeClassRequests _: inout [Int]) -> MallocStats {
+        makeMallocStats()
+    }
+
     static func makeMallocStats() -> MallocStats {
         MallocStats(
             mallocCountTotal: 0,
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// The values of the measured iterations are kept column by column in memory allocated before measuring,
+// and only added to the statistics in bulk every few thousand iterations and after the last one. Between
+// iterations, recording a value is then a store into a column rather than a histogram update, which keeps
+// the memory touched by the benchmark tool between the iterations small, so that less of the working set
+// of the benchmark is evicted from the caches.
+
+/// A set of metrics as a bitmask of their indices, for checking which metrics were requested between iterations
+struct BenchmarkMetricMask {
+    private var bits: UInt64 = 0
+
+    init() {}
+
+    init(_ metrics: [BenchmarkMetric]) {
+        metrics.forEach { insert($0) }
+    }
+
+    mutating func insert(_ metric: BenchmarkMetric) {
+        precondition(BenchmarkMetric.maxIndex < UInt64.bitWidth, "Too many metrics for the metric mask")
+        if case .custom = metric {
+            return
+        }
+        bits |= 1 << UInt64(metric.index)
+    }
+
+    @inline(__always)
+    func contains(_ metric: BenchmarkMetric) -> Bool {
+        bits & (1 << UInt64(metric.index)) != 0
+    }
+
+    var isEmpty: Bool {
+        bits == 0
+    }
+}
+
+final class MeasurementBuffer {
+    /// The iterations buffered before the values are added to the statistics
+    static let defaultCapacity = 4_096
+
+    let metrics: BenchmarkMetricMask
+    private let capacity: Int
+    private let columnMetrics: [BenchmarkMetric]
+    private let columns: UnsafeMutablePointer<Int> // by metric index, -1 if not buffered
+    private let counts: UnsafeMutablePointer<Int> // the values in each column
+    private let values: UnsafeMutablePointer<Int> // a column of capacity values per metric
+    private(set) var full = false
+
+    init(_ metrics: [BenchmarkMetric], capacity: Int = defaultCapacity) {
+        columnMetrics = metrics.filter {
+            if case .custom = $0 {
+                return false
+            }
+            return true
+        }
+        self.metrics = BenchmarkMetricMask(columnMetrics)
+        self.capacity = capacity
+
+        columns = .allocate(capacity: BenchmarkMetric.maxIndex + 1)
+        columns.initialize(repeating: -1, count: BenchmarkMetric.maxIndex + 1)
+        for (column, metric) in columnMetrics.enumerated() {
+            columns[metric.index] = column
+        }
+
+        counts = .allocate(capacity: max(columnMetrics.count, 1))
+        counts.initialize(repeating: 0, count: max(columnMetrics.count, 1))
+
+        // Touched up front, so that recording doesn't page fault
+        values = .allocate(capacity: max(columnMetrics.count * capacity, 1))
+        values.initialize(repeating: 0, count: max(columnMetrics.count * capacity, 1))
+    }
+
+    deinit {
+        columns.deallocate()
+        counts.deallocate()
+        values.deallocate()
+    }
+
+    /// Buffers the value of an iteration, ignored if the metric wasn't requested
+    @inline(__always)
+    func record(_ metric: BenchmarkMetric, _ value: Int) {
+        let column = columns[metric.index]
+        guard column >= 0 else {
+            return
+        }
+        let count = counts[column]
+        values[column * capacity + count] = value
+        counts[column] = count + 1
+        if count + 1 == capacity {
+            full = true
+        }
+    }
+
+    /// Hands the buffered values of each metric to `add`, oldest first, and empties the buffer
+    func flush(_ add: (BenchmarkMetric, UnsafeBufferPointer<Int>) -> Void) {
+        for (column, metric) in columnMetrics.enumerated() where counts[column] > 0 {
+            add(metric, UnsafeBufferPointer(start: values + column * capacity, count: counts[column]))
+            counts[column] = 0
+        }
+        full = false
+    }
+}
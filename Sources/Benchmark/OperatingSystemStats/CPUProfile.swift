@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Foundation
+
+/// The call stacks sampled at a fixed frequency during the measured region of a benchmark, the data
+/// of a flame graph of where the CPU time of the benchmark was spent.
+@_documentation(visibility: internal)
+public struct BenchmarkCPUProfile: Codable, Equatable {
+    public struct Stack: Codable, Equatable {
+        /// The symbolicated call stack, outermost frame first
+        public var stack: [String]
+        public var samples: Int
+
+        public init(stack: [String], samples: Int) {
+            self.stack = stack
+            self.samples = samples
+        }
+
+        /// The stack in the folded format used by flame graph tools, frames separated by ';'
+        public var foldedStack: String {
+            stack.map { $0.replacingOccurrences(of: ";", with: ":") }.joined(separator: ";")
+        }
+    }
+
+    /// The samples taken in a function, and in the functions it called
+    public struct Function: Equatable {
+        public var name: String
+        public var selfSamples: Int
+        public var totalSamples: Int
+    }
+
+    /// The sampling frequency in Hz
+    public var frequency: Int
+    /// The samples lost because the ring buffers filled up before being drained
+    public var lostSamples: Int
+    /// The sampled stacks, most samples first
+    public var stacks: [Stack]
+
+    public init(frequency: Int, lostSamples: Int, stacks: [Stack]) {
+        self.frequency = frequency
+        self.lostSamples = lostSamples
+        self.stacks = stacks.sorted { ($0.samples, $1.foldedStack) > ($1.samples, $0.foldedStack) }
+    }
+
+    public var totalSamples: Int {
+        stacks.reduce(0) { $0 + $1.samples }
+    }
+
+    /// The stacks in the folded stacks format, one "frame;frame;frame count" line per stack
+    public func folded() -> String {
+        stacks.map { "\($0.foldedStack) \($0.samples)\n" }.joined()
+    }
+
+    /// The functions sampled, most samples in the function itself first. Recursive functions are only
+    /// counted once per stack in their total samples.
+    public func functions() -> [Function] {
+        var functions: [String: Function] = [:]
+
+        for stack in stacks {
+            for name in Set(stack.stack) {
+                functions[name, default: Function(name: name, selfSamples: 0, totalSamples: 0)].totalSamples +=
+                    stack.samples
+            }
+            if let innermost = stack.stack.last {
+                functions[innermost]!.selfSamples += stack.samples
+            }
+        }
+
+        return functions.values.sorted {
+            ($0.selfSamples, $0.totalSamples, $1.name) > ($1.selfSamples, $1.totalSamples, $0.name)
+        }
+    }
+
+    /// Keeps the `count` stacks with the most samples, to bound the size of stored baselines
+    public func top(_ count: Int) -> BenchmarkCPUProfile {
+        BenchmarkCPUProfile(frequency: frequency, lostSamples: lostSamples, stacks: Array(stacks.prefix(count)))
+    }
+
+    /// The name of the file a benchmark process stores the profile of a benchmark in
+    public static func fileName(target: String, name: String) -> String {
+        "\(target).\(name).cpu-profile.json"
+            .replacingOccurrences(of: "/", with: "_")
+            .replacingOccurrences(of: " ", with: "_")
+    }
+}
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+// Sampling CPU profiler using perf events. The benchmark tool starts the benchmark process with the
+// sampling frequency set, so that the sampling events are opened before any threads are created,
+// sampling is then only enabled for the measured region. The sampled call chains are aggregated by
+// address while measuring, and symbolicated after the benchmark has finished.
+
+import Foundation
+
+#if os(Linux)
+import BenchmarkShared
+import CLinuxOperatingSystemStats
+
+#if canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#endif
+
+enum CPUProfiler {
+    static let outputDirectory: String? = getenv(cpuProfileEnvironmentVariable).map { String(cString: $0) }
+
+    static let enabled: Bool = {
+        guard outputDirectory != nil else {
+            return false
+        }
+        guard CLinuxSamplingProfilerFrequency() > 0 else {
+            print("Warning: CPU profiling requires access to perf events (kernel.perf_event_paranoid <= 2), not profiling.")
+            return false
+        }
+        return true
+    }()
+
+    // Discards all samples taken so far, e.g. during warmup
+    static func reset() {
+        CLinuxSamplingProfilerReset()
+    }
+
+    static func activate(_ active: Bool) {
+        if active {
+            CLinuxSamplingProfilerEnable()
+        } else {
+            CLinuxSamplingProfilerDisable()
+        }
+    }
+
+    // Symbolicates the sampled call chains and writes the profile of the benchmark to the output directory
+    static func writeProfile(_ benchmark: Benchmark) {
+        guard let outputDirectory else {
+            return
+        }
+
+        var stacks: [String: BenchmarkCPUProfile.Stack] = [:]
+        var symbolizer = Symbolizer()
+        var cursor: UInt64 = 0
+        var addresses: UnsafePointer<UInt64>?
+        var depth: Int32 = 0
+        var count: UInt64 = 0
+
+        // The first address is the sampled instruction, the others are return addresses
+        while CLinuxSamplingProfilerStack(&cursor, &addresses, &depth, &count) != 0 {
+            guard let addresses else {
+                continue
+            }
+            let stack = (0..<Int(depth)).reversed().map {
+                symbolizer.symbol(UInt(addresses[$0]), isReturnAddress: $0 > 0)
+            }
+            let key = stack.joined(separator: ";")
+            stacks[key, default: .init(stack: stack, samples: 0)].samples += Int(count)
+        }
+
+        let lostSamples = Int(CLinuxSamplingProfilerLost())
+        if lostSamples > 0 {
+            print("Warning: \(lostSamples) CPU profile samples lost for \(benchmark.name), try a lower frequency.")
+        }
+
+        let profile = BenchmarkCPUProfile(
+            frequency: Int(CLinuxSamplingProfilerFrequency()),
+            lostSamples: lostSamples,
+            stacks: Array(stacks.values)
+        )
+        let fileName = BenchmarkCPUProfile.fileName(target: benchmark.target, name: benchmark.name)
+
+        do {
+            try JSONEncoder().encode(profile).write(to: URL(fileURLWithPath: "\(outputDirectory)/\(fileName)"))
+        } catch {
+            print("Failed to write the CPU profile for \(benchmark.name): \(error)")
+        }
+    }
+}
+
+#else
+
+// stub if no perf events available
+enum CPUProfiler {
+    static let enabled = false
+
+    static func reset() {}
+
+    static func activate(_: Bool) {}
+
+    static func writeProfile(_: Benchmark) {}
+}
+
+#endif
@@ -22,6 +22,10 @@ struct OperatingSystemStats {
     var peakMemoryVirtual: Int = 0
     /// Measure number of syscalls made during the test
     var syscalls: Int = 0
+    /// Measure number of futex syscalls made during the test -- Linux only
+    var futexSyscalls: Int = 0
+    /// Measure number of epoll wait syscalls made during the test -- Linux only
+    var epollWaitSyscalls: Int = 0
     /// Measure number of context switches made during the test
     var contextSwitches: Int = 0
     /// Sample the maximum number of threads in the process under the test (not exact)
@@ -40,9 +44,33 @@ struct OperatingSystemStats {
     var readBytesPhysical: Int = 0
     /// The number of bytes physicall written to a block device (i.e. disk) -- Linux only
     var writeBytesPhysical: Int = 0
+    /// The number of minor page faults
+    var minorPageFaults: Int = 0
+    /// The number of major page faults
+    var majorPageFaults: Int = 0
+    /// The proportional resident memory, only read at the end of a measurement -- Linux only
+    var proportionalResidentMemory: Int = 0
+    /// The anonymous resident memory, only read at the end of a measurement -- Linux only
+    var anonymousResidentMemory: Int = 0
+    /// Time the threads running the benchmark spent on a CPU in nanoseconds -- Linux only
+    var runTime: Int = 0
+    /// Time the threads running the benchmark spent waiting for a CPU in nanoseconds -- Linux only
+    var runQueueDelay: Int = 0
+    /// Number of times the threads running the benchmark were put on a CPU -- Linux only
+    var timeslices: Int = 0
 }
 
 struct PerformanceCounters {
     /// The number instructions executed
     var instructions: UInt64 = 0
+    /// The number of CPU cycles spent -- Linux and macOS only
+    var cpuCycles: UInt64 = 0
+    /// The number of mispredicted branches -- Linux only
+    var branchMisses: UInt64 = 0
+    /// The number of last level cache misses -- Linux only
+    var cacheMisses: UInt64 = 0
+    /// The number of L1 data cache read misses -- Linux only
+    var l1dCacheMisses: UInt64 = 0
+    /// The number of data TLB read misses -- Linux only
+    var dTLBMisses: UInt64 = 0
 }
@@ -28,6 +28,7 @@ final class OperatingSystemStatsProducer {
     var sampleRate: Int = 10_000
     var metrics: Set<BenchmarkMetric>?
     var pid = getpid()
+    let precisePeakMemoryResident = false // no way to reset the peak, so it's always sampled
 
     enum RunState {
         case running
@@ -170,6 +171,15 @@ final class OperatingSystemStatsProducer {
         self.metrics = metrics
     }
 
+    func resetPeakMemoryResident() {
+    }
+
+    func registerBenchmarkThread() {
+    }
+
+    func resetBenchmarkThreads() {
+    }
+
     func makeOperatingSystemStats() -> OperatingSystemStats {
         #if os(macOS)
         guard let metrics else {
@@ -219,7 +229,9 @@ final class OperatingSystemStatsProducer {
             readBytesLogical: 0,
             writeBytesLogical: 0,
             readBytesPhysical: Int(usage.ri_diskio_bytesread),
-            writeBytesPhysical: Int(usage.ri_diskio_byteswritten)
+            writeBytesPhysical: Int(usage.ri_diskio_byteswritten),
+            minorPageFaults: Int(procTaskInfo.pti_faults) - Int(procTaskInfo.pti_pageins),
+            majorPageFaults: Int(procTaskInfo.pti_pageins)
         )
 
         return stats
@@ -228,6 +240,9 @@ final class OperatingSystemStatsProducer {
         #endif
     }
 
+    func readMemoryRollup(into _: inout OperatingSystemStats) {
+    }
+
     func metricSupported(_ metric: BenchmarkMetric) -> Bool {
         #if canImport(Darwin)
         switch metric {
@@ -237,6 +252,16 @@ final class OperatingSystemStatsProducer {
             return false
         case .readBytesLogical:
             return false
+        case .branchMisses, .cacheMisses, .l1dCacheMisses, .dTLBMisses:
+            return false
+        case .futexSyscalls, .epollWaitSyscalls:
+            return false
+        case .cacheMissesPerKiloInstructions, .branchMissesPerKiloInstructions:
+            return false
+        case .proportionalResidentMemory, .anonymousResidentMemory:
+            return false
+        case .runQueueDelay, .offCPUTime, .timeslices:
+            return false
         default:
             return true
         }
@@ -246,6 +271,9 @@ final class OperatingSystemStatsProducer {
         #endif
     }
 
+    func configurePerformanceCounters(_: BenchmarkPerformanceCounterScope) {
+    }
+
     func enablePerformanceCounters() {
     }
 
@@ -258,7 +286,7 @@ final class OperatingSystemStatsProducer {
     func makePerformanceCounters() -> PerformanceCounters {
         #if os(macOS)
         let performanceCounters = getRusage()
-        return .init(instructions: performanceCounters.ri_instructions)
+        return .init(instructions: performanceCounters.ri_instructions, cpuCycles: performanceCounters.ri_cycles)
         #else
         return .init()
         #endif
@@ -17,7 +17,6 @@ import Glibc
 #elseif canImport(Musl)
 import Musl
 #endif
-import SystemPackage
 
 final class OperatingSystemStatsProducer {
     var nsPerSchedulerTick: Int
@@ -32,6 +31,9 @@ final class OperatingSystemStatsProducer {
     var sampleRate: Int = 10_000
     var runState: RunState = .running
     var metrics: Set<BenchmarkMetric>?
+    var performanceCounterScope: BenchmarkPerformanceCounterScope = .process
+    var threadPerformanceCountersEnabled = false
+    var precisePeakMemoryResident = false
 
     enum RunState {
         case running
@@ -48,57 +50,19 @@ final class OperatingSystemStatsProducer {
 
     deinit {}
 
-    // We should cache the open file(s) and just read from file offset 0 to reduce overhead
-    func read(path: FilePath) -> String {
-        var string = ""
-        let maxReadBuffer = 8_192
-
-        do {
-            let fileDescriptor = try FileDescriptor.open(path, .readOnly, options: [], permissions: .ownerRead)
-            do {
-                try fileDescriptor.closeAfter {
-                    do {
-                        let fileData = try [UInt8](unsafeUninitializedCapacity: maxReadBuffer) { buf, count in
-                            count = try fileDescriptor.read(into: UnsafeMutableRawBufferPointer(buf))
-                            // Add null byte to end of read data as it's used as the cString initializer below.
-                            buf.initializeElement(at: min(count, maxReadBuffer - 1), to: 0)
-                            precondition(
-                                count < maxReadBuffer,
-                                "\(#function) read unexpectedly filled the buffer completely"
-                            )
-                        }
-
-                        fileData.withUnsafeBufferPointer {
-                            string = String(cString: $0.baseAddress!)
-                        }
-                    } catch {
-                        print("Failed to open file for reading \(path)")
-                    }
-                }
-            } catch {
-                print("Failed to close fileDescriptor for \(path) after reading.")
-            }
-        } catch {
-            if errno != ENOENT { // file not found is ok, e.g. when no baselines exist
-                print("Failed to open file \(path), errno = [\(errno)]")
-            }
-        }
-
-        return string
-    }
-
     func readIOStats() -> ioStats {
-        let stats = read(path: FilePath("/proc/self/io"))
         var ioStats: ioStats = .init()
-        CLinuxIOStats(stats, &ioStats)
+        if CLinuxIOStatsCurrent(&ioStats) == 0 {
+            return .init()
+        }
         return ioStats
     }
 
     func readProcessStats() -> processStats {
-        let statsRead = read(path: FilePath("/proc/self/stat"))
-
         var stats: processStats = .init()
-        CLinuxProcessStats(statsRead, &stats)
+        if CLinuxProcessStatsCurrent(&stats) == 0 {
+            return .init()
+        }
         stats.cpuUser *= nsPerSchedulerTick
         stats.cpuSystem *= nsPerSchedulerTick
         stats.cpuTotal *= nsPerSchedulerTick
@@ -109,6 +73,29 @@ final class OperatingSystemStatsProducer {
 
     func configureMetrics(_ metrics: Set<BenchmarkMetric>) {
         self.metrics = metrics
+
+        // Peak resident memory is measured per iteration by resetting the high water mark
+        // if the kernel supports it, otherwise we fall back to the sampling thread.
+        if metrics.contains(.peakMemoryResident) || metrics.contains(.peakMemoryResidentDelta) {
+            precisePeakMemoryResident = CLinuxPeakMemoryResidentReset() != 0
+        } else {
+            precisePeakMemoryResident = false
+        }
+    }
+
+    func resetPeakMemoryResident() {
+        if precisePeakMemoryResident {
+            CLinuxPeakMemoryResidentReset()
+        }
+    }
+
+    /// Includes the calling thread in the scheduler statistics, called by each thread running the benchmark
+    func registerBenchmarkThread() {
+        CLinuxSchedStatsRegisterThread()
+    }
+
+    func resetBenchmarkThreads() {
+        CLinuxSchedStatsResetThreads()
     }
 
     func makeOperatingSystemStats() -> OperatingSystemStats {
@@ -123,6 +110,29 @@ final class OperatingSystemStatsProducer {
         var threadsRunning = 0
         var peakResident = 0
         var peakVirtual = 0
+        var syscallStats: syscallStats = .init()
+        var contextSwitches = 0
+        var pageFaultStats: pageFaultStats = .init()
+        var schedStats: schedStats = .init()
+
+        if metrics.contains(.syscalls) || metrics.contains(.futexSyscalls) || metrics.contains(.epollWaitSyscalls) {
+            CLinuxSyscallStatsCurrent(&syscallStats)
+        }
+
+        if metrics.contains(.contextSwitches) {
+            contextSwitches = Int(CLinuxContextSwitchesCurrent())
+        }
+
+        if metrics.contains(.runQueueDelay) || metrics.contains(.offCPUTime) || metrics.contains(.timeslices) {
+            CLinuxSchedStatsCurrent(&schedStats)
+        }
+
+        // The counts from the perf software events replace those from /proc/self/stat if opened
+        if metrics.contains(.minorPageFaults) || metrics.contains(.majorPageFaults) {
+            pageFaultStats.minorPageFaults = Int64(processStats.minorPageFaults)
+            pageFaultStats.majorPageFaults = Int64(processStats.majorPageFaults)
+            CLinuxPageFaultCountersCurrent(&pageFaultStats)
+        }
 
         if metrics.contains(.threads) || metrics.contains(.threadsRunning) || metrics.contains(.peakMemoryResident)
             || metrics.contains(.peakMemoryResidentDelta) || metrics.contains(.peakMemoryVirtual)
@@ -135,38 +145,90 @@ final class OperatingSystemStatsProducer {
             lock.unlock()
         }
 
+        if precisePeakMemoryResident {
+            peakResident = Int(CLinuxPeakMemoryResidentCurrent())
+        }
+
         return OperatingSystemStats(
             cpuUser: Int(processStats.cpuUser),
             cpuSystem: Int(processStats.cpuSystem),
             cpuTotal: Int(processStats.cpuTotal),
             peakMemoryResident: peakResident,
             peakMemoryVirtual: peakVirtual,
-            syscalls: 0,
-            contextSwitches: 0,
+            syscalls: Int(syscallStats.syscalls),
+            futexSyscalls: Int(syscallStats.futexSyscalls),
+            epollWaitSyscalls: Int(syscallStats.epollWaitSyscalls),
+            contextSwitches: contextSwitches,
             threads: threads,
-            threadsRunning: threadsRunning, // we can go dig in /proc/self/task/ later if want this
+            threadsRunning: threadsRunning,
             readSyscalls: Int(ioStats.readSyscalls),
             writeSyscalls: Int(ioStats.writeSyscalls),
             readBytesLogical: Int(ioStats.readBytesLogical),
             writeBytesLogical: Int(ioStats.writeBytesLogical),
             readBytesPhysical: Int(ioStats.readBytesPhysical),
-            writeBytesPhysical: Int(ioStats.writeBytesPhysical)
+            writeBytesPhysical: Int(ioStats.writeBytesPhysical),
+            minorPageFaults: Int(pageFaultStats.minorPageFaults),
+            majorPageFaults: Int(pageFaultStats.majorPageFaults),
+            runTime: Int(schedStats.runTime),
+            runQueueDelay: Int(schedStats.runQueueWait),
+            timeslices: Int(schedStats.timeslices)
         )
     }
 
+    // Reads the proportional and anonymous resident memory, which is kept out of makeOperatingSystemStats()
+    // as the kernel walks all mappings to produce it, so it's only read when a measurement stops
+    func readMemoryRollup(into stats: inout OperatingSystemStats) {
+        var rollup: memoryRollup = .init()
+        if CLinuxMemoryRollupCurrent(&rollup) == 0 {
+            return
+        }
+        stats.proportionalResidentMemory = Int(rollup.proportionalResident)
+        stats.anonymousResidentMemory = Int(rollup.anonymousResident)
+    }
+
     func metricSupported(_ metric: BenchmarkMetric) -> Bool {
         switch metric {
         case .syscalls:
-            return false
-        case .contextSwitches:
-            return false
-        case .threadsRunning:
-            return false
+            return CLinuxSyscallStatsAvailable() & UInt32(CLINUX_SYSCALL_COUNTER_TOTAL) != 0
+        case .futexSyscalls:
+            return CLinuxSyscallStatsAvailable() & UInt32(CLINUX_SYSCALL_COUNTER_FUTEX) != 0
+        case .epollWaitSyscalls:
+            return CLinuxSyscallStatsAvailable() & UInt32(CLINUX_SYSCALL_COUNTER_EPOLL_WAIT) != 0
+        case .instructions:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS)
+        case .cpuCycles:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_CPU_CYCLES)
+        case .branchMisses:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_BRANCH_MISSES)
+        case .cacheMisses:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_CACHE_MISSES)
+        case .l1dCacheMisses:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_L1D_CACHE_MISSES)
+        case .dTLBMisses:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_DTLB_MISSES)
+        case .instructionsPerCycle:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_CPU_CYCLES)
+        case .cacheMissesPerKiloInstructions:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_CACHE_MISSES)
+        case .branchMissesPerKiloInstructions:
+            return performanceCounterAvailable(CLINUX_PERFORMANCE_COUNTER_BRANCH_MISSES)
+        case .proportionalResidentMemory, .anonymousResidentMemory:
+            var rollup: memoryRollup = .init()
+            return CLinuxMemoryRollupCurrent(&rollup) != 0
+        case .runQueueDelay, .offCPUTime, .timeslices:
+            return CLinuxSchedStatsAvailable() != 0
         default:
             return true
         }
     }
 
+    // Derived metrics implicitly require instructions, which is always the group leader
+    private func performanceCounterAvailable(_ event: Int32) -> Bool {
+        let available = CLinuxPerformanceCountersAvailable()
+        let required = UInt32(event) | UInt32(CLINUX_PERFORMANCE_COUNTER_INSTRUCTIONS)
+        return available & required == required
+    }
+
     func startSampling(_: Int = 10_000) { // sample rate in microseconds
         let sampleSemaphore = DispatchSemaphore(value: 0)
 
@@ -175,7 +237,9 @@ final class OperatingSystemStatsProducer {
                 self.lock.lock()
 
                 let rate = self.sampleRate
+                let sampleThreadsRunning = self.metrics?.contains(.threadsRunning) ?? false
                 self.peakThreads = 0
+                self.peakThreadsRunning = 0
                 self.peakMemoryResident = 0
                 self.peakMemoryVirtual = 0
                 self.runState = .running
@@ -185,9 +249,14 @@ final class OperatingSystemStatsProducer {
 
                 while true {
                     let processStats = self.readProcessStats()
+                    let threadsRunning = sampleThreadsRunning ? Int(CLinuxThreadsRunningCurrent()) : 0
 
                     self.lock.lock()
 
+                    if threadsRunning > self.peakThreadsRunning {
+                        self.peakThreadsRunning = threadsRunning
+                    }
+
                     if processStats.threads > self.peakThreads {
                         self.peakThreads = processStats.threads
                     }
@@ -233,22 +302,51 @@ final class OperatingSystemStatsProducer {
         semaphore.wait()
     }
 
+    func configurePerformanceCounters(_ scope: BenchmarkPerformanceCounterScope) {
+        performanceCounterScope = scope
+    }
+
+    // Thread scoped counters are opened for the calling thread, so this must be called from the
+    // thread running the benchmark. Falls back to the process counters if they can't be opened.
     func enablePerformanceCounters() {
+        if performanceCounterScope == .thread, CLinuxPerformanceCountersThreadInit() > 0 {
+            threadPerformanceCountersEnabled = true
+            return
+        }
         CLinuxPerformanceCountersEnable()
     }
 
     func disablePerformanceCounters() {
+        if threadPerformanceCountersEnabled {
+            CLinuxPerformanceCountersThreadDeinit()
+            threadPerformanceCountersEnabled = false
+            return
+        }
         CLinuxPerformanceCountersDisable()
     }
 
     func resetPerformanceCounters() {
+        if threadPerformanceCountersEnabled { // only deltas are used, so skip the syscall
+            return
+        }
         CLinuxPerformanceCountersReset()
     }
 
     func makePerformanceCounters() -> PerformanceCounters {
         var performanceCounters: performanceCounters = .init()
-        CLinuxPerformanceCountersCurrent(&performanceCounters)
-        return .init(instructions: performanceCounters.instructions)
+        if threadPerformanceCountersEnabled {
+            CLinuxPerformanceCountersThreadCurrent(&performanceCounters)
+        } else {
+            CLinuxPerformanceCountersCurrent(&performanceCounters)
+        }
+        return .init(
+            instructions: performanceCounters.instructions,
+            cpuCycles: performanceCounters.cpuCycles,
+            branchMisses: performanceCounters.branchMisses,
+            cacheMisses: performanceCounters.cacheMisses,
+            l1dCacheMisses: performanceCounters.l1dCacheMisses,
+            dTLBMisses: performanceCounters.dTLBMisses
+        )
     }
 }
 #endif
@@ -139,6 +139,47 @@ public final class Statistics: Codable {
     public let timeUnits: Statistics.Units
     public var histogram: Histogram<UInt>
 
+    enum CodingKeys: String, CodingKey {
+        case _cachedPercentiles
+        case _cacheUnits
+        case _cachedPercentilesHistogramCount
+        case prefersLarger
+        case timeUnits
+        case histogram
+    }
+
+    // The histogram may be left out when encoding (see `CodingUserInfoKey.statisticsExcludeHistogram`),
+    // it's then decoded as an empty histogram to be filled in by the caller.
+    public init(from decoder: Decoder) throws {
+        let container = try decoder.container(keyedBy: CodingKeys.self)
+        _cachedPercentiles = try container.decode([Int].self, forKey: ._cachedPercentiles)
+        _cacheUnits = try container.decode(Statistics.Units.self, forKey: ._cacheUnits)
+        _cachedPercentilesHistogramCount = try container.decode(UInt64.self, forKey: ._cachedPercentilesHistogramCount)
+        prefersLarger = try container.decode(Bool.self, forKey: .prefersLarger)
+        timeUnits = try container.decode(Statistics.Units.self, forKey: .timeUnits)
+        if let histogram = try container.decodeIfPresent(Histogram<UInt>.self, forKey: .histogram) {
+            self.histogram = histogram
+        } else {
+            histogram = Histogram(
+                highestTrackableValue: UInt64(Self.defaultMaximumMeasurement),
+                numberOfSignificantValueDigits: .three
+            )
+            histogram.autoResize = true
+        }
+    }
+
+    public func encode(to encoder: Encoder) throws {
+        var container = encoder.container(keyedBy: CodingKeys.self)
+        try container.encode(_cachedPercentiles, forKey: ._cachedPercentiles)
+        try container.encode(_cacheUnits, forKey: ._cacheUnits)
+        try container.encode(_cachedPercentilesHistogramCount, forKey: ._cachedPercentilesHistogramCount)
+        try container.encode(prefersLarger, forKey: .prefersLarger)
+        try container.encode(timeUnits, forKey: .timeUnits)
+        if encoder.userInfo[.statisticsExcludeHistogram] as? Bool != true {
+            try container.encode(histogram, forKey: .histogram)
+        }
+    }
+
     public var onlyZeroMeasurements: Bool {
         histogram.countForValue(0) == histogram.totalCount
     }
@@ -180,6 +221,13 @@ public final class Statistics: Codable {
         histogram.record(UInt64(measurement))
     }
 
+    /// Add all measurements of another statistics, e.g. when merging measurements taken on several threads
+    public func add(_ other: Statistics) {
+        for recordedValue in other.histogram.recordedValues() {
+            histogram.record(recordedValue.value, count: recordedValue.count)
+        }
+    }
+
     // Rounds decimals for display
     public static func roundToDecimalplaces(_ original: Double, _ decimals: Int = 2) -> Double {
         let factor: Double = .pow(10.0, Double(decimals))
@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Foundation
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#endif
+
+@_silgen_name("swift_demangle")
+private func _swiftDemangle(
+    _ mangledName: UnsafePointer<CChar>?,
+    _ mangledNameLength: Int,
+    _ outputBuffer: UnsafeMutablePointer<CChar>?,
+    _ outputBufferSize: UnsafeMutablePointer<Int>?,
+    _ flags: UInt32
+) -> UnsafeMutablePointer<CChar>?
+
+// Resolves code addresses of the benchmark process to (demangled) symbol names, for the profilers.
+// Only run after the measured region, as looking up symbols is slow and allocates.
+struct Symbolizer {
+    private var symbols: [UInt: String] = [:]
+
+    // The image containing the code the return address returns into
+    func image(_ address: UInt) -> UnsafeMutableRawPointer? {
+        var info = Dl_info()
+        guard let pointer = UnsafeRawPointer(bitPattern: address &- 1), dladdr(pointer, &info) != 0 else {
+            return nil
+        }
+        return info.dli_fbase
+    }
+
+    // Return addresses point after the call, so look up the address before to get the calling function,
+    // other addresses (e.g. the sampled instruction) are looked up as they are
+    mutating func symbol(_ address: UInt, isReturnAddress: Bool = true) -> String {
+        let lookup = isReturnAddress ? address &- 1 : address
+        if let symbol = symbols[lookup] {
+            return symbol
+        }
+
+        var info = Dl_info()
+        var symbol = String(format: "0x%lx", address)
+
+        if let pointer = UnsafeRawPointer(bitPattern: lookup), dladdr(pointer, &info) != 0 {
+            if let name = info.dli_sname {
+                if let demangled = _swiftDemangle(name, strlen(name), nil, nil, 0) {
+                    symbol = String(cString: demangled)
+                    free(demangled)
+                } else {
+                    symbol = String(cString: name)
+                }
+            } else if let fileName = info.dli_fname, let base = info.dli_fbase {
+                let image = String(cString: fileName).split(separator: "/").last.map(String.init) ?? ""
+                symbol = "\(image)+0x\(String(address - UInt(bitPattern: base), radix: 16))"
+            }
+        }
+
+        symbols[lookup] = symbol
+        return symbol
+    }
+}
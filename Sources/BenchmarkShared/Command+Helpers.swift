@@ -10,6 +10,55 @@
 
 // Project wide shared types
 
+/// Environment variable used by the benchmark tool to tell a benchmark process which
+/// hardware performance counters to open at startup, a comma separated list of metric names.
+@_documentation(visibility: internal)
+public let performanceCountersEnvironmentVariable = "BENCHMARK_PERFORMANCE_COUNTERS"
+
+/// Environment variable that makes the benchmark tool ask benchmark processes to send their
+/// replies JSON encoded instead of using the binary encoding, useful when debugging.
+@_documentation(visibility: internal)
+public let jsonProtocolEnvironmentVariable = "BENCHMARK_JSON_PROTOCOL"
+
+/// Environment variable used by the benchmark tool to pin a benchmark process to a set of CPUs
+/// when running benchmarks in parallel, in the Linux cpu list format (e.g. "0-3,8-11").
+@_documentation(visibility: internal)
+public let cpuSetEnvironmentVariable = "BENCHMARK_CPU_SET"
+
+/// Environment variable used by the benchmark tool to apply the stabilization profile to a benchmark
+/// process, a comma separated list of "norandomize", "mlockall", "prefault" and "fifo".
+@_documentation(visibility: internal)
+public let stabilizationEnvironmentVariable = "BENCHMARK_STABILIZATION"
+
+/// Environment variable used by the benchmark tool to ask a benchmark process to profile the allocations
+/// of the measured region with the jemalloc heap profiler, the directory to write the profiles to.
+@_documentation(visibility: internal)
+public let allocationProfileEnvironmentVariable = "BENCHMARK_ALLOCATION_PROFILE"
+
+/// Environment variable used by the benchmark tool to ask a benchmark process to attribute the retains,
+/// releases and object allocations of the measured region to types, the directory to write the profiles to.
+@_documentation(visibility: internal)
+public let arcTypeProfileEnvironmentVariable = "BENCHMARK_ARC_TYPES"
+
+/// Environment variable used by the benchmark tool to ask a benchmark process to sample the call stacks
+/// of the measured region, the directory to write the profiles to.
+@_documentation(visibility: internal)
+public let cpuProfileEnvironmentVariable = "BENCHMARK_CPU_PROFILE"
+
+/// Environment variable with the sampling frequency of CPU profiling in Hz, read at startup of the
+/// benchmark process to open the sampling events.
+@_documentation(visibility: internal)
+public let cpuProfileFrequencyEnvironmentVariable = "BENCHMARK_CPU_PROFILE_FREQUENCY"
+
+/// Environment variable used by the benchmark tool to ask a benchmark process to record the values of each
+/// measured iteration in order, the directory to write the traces to.
+@_documentation(visibility: internal)
+public let traceEnvironmentVariable = "BENCHMARK_TRACE"
+
+/// Environment variable with the number of iterations kept in the trace of each benchmark.
+@_documentation(visibility: internal)
+public let traceCapacityEnvironmentVariable = "BENCHMARK_TRACE_CAPACITY"
+
 @_documentation(visibility: internal)
 public enum Command: String, CaseIterable {
     case run
@@ -18,6 +67,7 @@ public enum Command: String, CaseIterable {
     case thresholds
     case help
     case `init`
+    case history
 }
 
 /// The benchmark data output format.
@@ -74,6 +124,7 @@ public enum BaselineOperation: String, CaseIterable {
     case update
     case list
     case delete
+    case convert
     case compare
     case check
 }
@@ -0,0 +1,347 @@
+// Thread-local counting of Swift object allocations, retains and releases.
+//
+// Each thread increments its own counters without atomic read-modify-write operations, so threads doing
+// ARC traffic in parallel don't contend on a shared cache line. The counters of all threads are summed
+// when read. Threads register their counters on first use, and fold them into the retired totals on exit.
+//
+// Optionally the counts are also keyed by the metadata pointer of the object (its first word), in a
+// per-thread open addressing table, so that the traffic can be attributed to types at report time.
+// The tables are allocated when the types are reset before measuring, or when a thread registers after
+// that, never by the hooks. Resetting only bumps a generation, each thread clears its own table when it
+// next attributes traffic, and tables of an older generation are skipped when reading.
+//
+// A thread's counters live in its TLS, which is freed when the thread exits. ARC traffic from TLS
+// destructors running after ours is counted directly in the retired totals, as re-registering the
+// counters would leave freed memory in the registry.
+
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "SwiftRuntimeHooks.h"
+
+#define TYPE_TABLE_SIZE 4096 // per thread, power of two
+#define TYPE_TABLE_PROBES 16 // types not found within this many slots are counted in the overflow slot
+
+struct type_slot_s {
+    _Atomic(const void *) metadata;
+    _Atomic int64_t allocs;
+    _Atomic int64_t retains;
+    _Atomic int64_t releases;
+};
+
+struct thread_counters_s {
+    _Atomic int64_t allocs;
+    _Atomic int64_t retains;
+    _Atomic int64_t releases;
+    _Atomic(struct type_slot_s *) types; // TYPE_TABLE_SIZE slots followed by the overflow slot, NULL if not allocated
+    _Atomic uint64_t types_generation; // the reset the counts of the table are from
+    struct thread_counters_s *next;
+    struct thread_counters_s *prev;
+    int registered;
+    int exited; // set by the TLS destructor, the counters must not be registered again
+};
+
+static _Thread_local struct thread_counters_s _thread_counters;
+
+static pthread_mutex_t _registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t _registry_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _registry_key;
+static struct thread_counters_s *_registry = NULL;
+static struct thread_counters_s _retired; // the counts of exited threads, only accessed under the lock
+
+static atomic_int _attribute_types = 0;
+static atomic_int _types_allocated = 0; // threads registering allocate their table once types have been reset
+static _Atomic uint64_t _types_generation = 1;
+
+/*===========================================================================*/
+
+static inline void _increment(_Atomic int64_t *counter) {
+    // only the owning thread writes, so a plain load and store is enough
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+// mmap rather than malloc, so that the table doesn't show up in the malloc metrics of the benchmark
+static struct type_slot_s *_allocate_type_table(void) {
+    size_t size = (TYPE_TABLE_SIZE + 1) * sizeof(struct type_slot_s);
+    void *table = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return table == MAP_FAILED ? NULL : table;
+}
+
+static void _merge_type_table(struct type_slot_s *merged, struct type_slot_s *table);
+
+static void _thread_exit(void *value) {
+    struct thread_counters_s *counters = value;
+    pthread_mutex_lock(&_registry_lock);
+    atomic_fetch_add(&_retired.allocs, atomic_load(&counters->allocs));
+    atomic_fetch_add(&_retired.retains, atomic_load(&counters->retains));
+    atomic_fetch_add(&_retired.releases, atomic_load(&counters->releases));
+    struct type_slot_s *types = atomic_load(&counters->types);
+    if (types != NULL) {
+        if (_retired.types != NULL && atomic_load(&counters->types_generation) == atomic_load(&_types_generation)) {
+            _merge_type_table(_retired.types, types);
+        }
+        atomic_store(&counters->types, NULL);
+        munmap(types, (TYPE_TABLE_SIZE + 1) * sizeof(struct type_slot_s));
+    }
+    if (counters->prev != NULL) {
+        counters->prev->next = counters->next;
+    } else {
+        _registry = counters->next;
+    }
+    if (counters->next != NULL) {
+        counters->next->prev = counters->prev;
+    }
+    counters->registered = 0;
+    counters->exited = 1;
+    pthread_mutex_unlock(&_registry_lock);
+}
+
+static void _create_registry_key(void) {
+    pthread_key_create(&_registry_key, _thread_exit);
+}
+
+static struct thread_counters_s *_register_thread(void) {
+    struct thread_counters_s *counters = &_thread_counters;
+    if (counters->exited) {
+        return NULL;
+    }
+    pthread_once(&_registry_once, _create_registry_key);
+    struct type_slot_s *types = atomic_load(&_types_allocated) ? _allocate_type_table() : NULL;
+    pthread_mutex_lock(&_registry_lock);
+    if (types != NULL) {
+        atomic_store(&counters->types_generation, atomic_load(&_types_generation));
+        atomic_store(&counters->types, types);
+    }
+    counters->prev = NULL;
+    counters->next = _registry;
+    if (_registry != NULL) {
+        _registry->prev = counters;
+    }
+    _registry = counters;
+    counters->registered = 1;
+    pthread_mutex_unlock(&_registry_lock);
+    pthread_setspecific(_registry_key, counters);
+    return counters;
+}
+
+// NULL once the thread has exited
+static inline struct thread_counters_s *_current_thread_counters(void) {
+    struct thread_counters_s *counters = &_thread_counters;
+    return counters->registered ? counters : _register_thread();
+}
+
+/*===========================================================================*/
+
+static inline size_t _type_slot_index(const void *metadata) {
+    uint64_t hash = (uint64_t)(uintptr_t)metadata * UINT64_C(0x9E3779B97F4A7C15);
+    return (size_t)(hash >> 32) & (TYPE_TABLE_SIZE - 1);
+}
+
+// Finds or claims the slot of the type, the table is only written by its owning thread (or under the lock)
+static struct type_slot_s *_type_slot(struct type_slot_s *table, const void *metadata) {
+    size_t index = _type_slot_index(metadata);
+    for (size_t probe = 0; probe < TYPE_TABLE_PROBES; probe++) {
+        struct type_slot_s *slot = &table[(index + probe) & (TYPE_TABLE_SIZE - 1)];
+        const void *slot_metadata = atomic_load_explicit(&slot->metadata, memory_order_relaxed);
+        if (slot_metadata == metadata) {
+            return slot;
+        }
+        if (slot_metadata == NULL) {
+            atomic_store_explicit(&slot->metadata, metadata, memory_order_release);
+            return slot;
+        }
+    }
+    return &table[TYPE_TABLE_SIZE];
+}
+
+static void _add_type_counts(struct type_slot_s *table, const void *metadata,
+                             int64_t allocs, int64_t retains, int64_t releases) {
+    if (allocs == 0 && retains == 0 && releases == 0) {
+        return;
+    }
+    struct type_slot_s *slot = metadata != NULL ? _type_slot(table, metadata) : &table[TYPE_TABLE_SIZE];
+    atomic_fetch_add_explicit(&slot->allocs, allocs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->retains, retains, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slot->releases, releases, memory_order_relaxed);
+}
+
+// The overflow slot has no metadata, and its counts end up in the overflow slot of the merged table
+static void _merge_type_table(struct type_slot_s *merged, struct type_slot_s *table) {
+    for (size_t i = 0; table != NULL && i <= TYPE_TABLE_SIZE; i++) {
+        struct type_slot_s *slot = &table[i];
+        _add_type_counts(merged, atomic_load(&slot->metadata),
+                         atomic_load(&slot->allocs), atomic_load(&slot->retains), atomic_load(&slot->releases));
+    }
+}
+
+static void _clear_type_table(struct type_slot_s *table);
+
+static inline struct type_slot_s *_thread_type_slot(struct thread_counters_s *counters, const void *object) {
+    struct type_slot_s *types = atomic_load_explicit(&counters->types, memory_order_acquire);
+    if (object == NULL || types == NULL) {
+        return NULL;
+    }
+    uint64_t generation = atomic_load_explicit(&_types_generation, memory_order_acquire);
+    if (atomic_load_explicit(&counters->types_generation, memory_order_relaxed) != generation) {
+        _clear_type_table(types);
+        atomic_store_explicit(&counters->types_generation, generation, memory_order_release);
+    }
+    // the first word of a heap object is its metadata pointer, releases are hooked before the object can be freed
+    return _type_slot(types, *(const void * const *)object);
+}
+
+/*===========================================================================*/
+
+static void _alloc_object_hook(const void *object, void *context) {
+    (void)context;
+    struct thread_counters_s *counters = _current_thread_counters();
+    if (counters == NULL) {
+        atomic_fetch_add_explicit(&_retired.allocs, 1, memory_order_relaxed);
+        return;
+    }
+    _increment(&counters->allocs);
+    if (atomic_load_explicit(&_attribute_types, memory_order_relaxed)) {
+        struct type_slot_s *slot = _thread_type_slot(counters, object);
+        if (slot != NULL) {
+            _increment(&slot->allocs);
+        }
+    }
+}
+
+static void _retain_hook(const void *object, void *context) {
+    (void)context;
+    struct thread_counters_s *counters = _current_thread_counters();
+    if (counters == NULL) {
+        atomic_fetch_add_explicit(&_retired.retains, 1, memory_order_relaxed);
+        return;
+    }
+    _increment(&counters->retains);
+    if (atomic_load_explicit(&_attribute_types, memory_order_relaxed)) {
+        struct type_slot_s *slot = _thread_type_slot(counters, object);
+        if (slot != NULL) {
+            _increment(&slot->retains);
+        }
+    }
+}
+
+static void _release_hook(const void *object, void *context) {
+    (void)context;
+    struct thread_counters_s *counters = _current_thread_counters();
+    if (counters == NULL) {
+        atomic_fetch_add_explicit(&_retired.releases, 1, memory_order_relaxed);
+        return;
+    }
+    _increment(&counters->releases);
+    if (atomic_load_explicit(&_attribute_types, memory_order_relaxed)) {
+        struct type_slot_s *slot = _thread_type_slot(counters, object);
+        if (slot != NULL) {
+            _increment(&slot->releases);
+        }
+    }
+}
+
+void swift_runtime_arc_counters_hook(void) {
+    swift_runtime_set_alloc_object_hook(_alloc_object_hook, NULL);
+    swift_runtime_set_retain_hook(_retain_hook, NULL);
+    swift_runtime_set_release_hook(_release_hook, NULL);
+}
+
+void swift_runtime_arc_counters_unhook(void) {
+    swift_runtime_set_release_hook(NULL, NULL);
+    swift_runtime_set_retain_hook(NULL, NULL);
+    swift_runtime_set_alloc_object_hook(NULL, NULL);
+}
+
+swift_runtime_arc_counts_t swift_runtime_arc_counters_read(void) {
+    pthread_mutex_lock(&_registry_lock);
+    swift_runtime_arc_counts_t counts = {
+        atomic_load_explicit(&_retired.allocs, memory_order_relaxed),
+        atomic_load_explicit(&_retired.retains, memory_order_relaxed),
+        atomic_load_explicit(&_retired.releases, memory_order_relaxed),
+    };
+    for (struct thread_counters_s *counters = _registry; counters != NULL; counters = counters->next) {
+        counts.allocs += atomic_load_explicit(&counters->allocs, memory_order_relaxed);
+        counts.retains += atomic_load_explicit(&counters->retains, memory_order_relaxed);
+        counts.releases += atomic_load_explicit(&counters->releases, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&_registry_lock);
+    return counts;
+}
+
+void swift_runtime_arc_counters_attribute_types(int enabled) {
+    atomic_store_explicit(&_attribute_types, enabled, memory_order_relaxed);
+}
+
+// Atomic stores, as the table may be read for a report at the same time
+static void _clear_type_table(struct type_slot_s *table) {
+    for (size_t i = 0; table != NULL && i <= TYPE_TABLE_SIZE; i++) {
+        atomic_store_explicit(&table[i].metadata, NULL, memory_order_relaxed);
+        atomic_store_explicit(&table[i].allocs, 0, memory_order_relaxed);
+        atomic_store_explicit(&table[i].retains, 0, memory_order_relaxed);
+        atomic_store_explicit(&table[i].releases, 0, memory_order_relaxed);
+    }
+}
+
+// Called outside the measured region, allocates the tables of the threads that don't have one yet.
+// The tables of other threads are left to be cleared by their owners, which may be writing to them.
+void swift_runtime_arc_counters_reset_types(void) {
+    _current_thread_counters();
+    atomic_store(&_types_allocated, 1);
+
+    pthread_mutex_lock(&_registry_lock);
+    uint64_t generation = atomic_fetch_add(&_types_generation, 1) + 1;
+
+    if (_retired.types == NULL) {
+        _retired.types = _allocate_type_table();
+    }
+    _clear_type_table(_retired.types);
+
+    for (struct thread_counters_s *counters = _registry; counters != NULL; counters = counters->next) {
+        if (atomic_load(&counters->types) == NULL) {
+            struct type_slot_s *types = _allocate_type_table();
+            if (types != NULL) {
+                atomic_store(&counters->types_generation, generation);
+                atomic_store_explicit(&counters->types, types, memory_order_release);
+            }
+        }
+    }
+    pthread_mutex_unlock(&_registry_lock);
+}
+
+size_t swift_runtime_arc_counters_types(swift_runtime_arc_type_counts_t *types, size_t capacity) {
+    struct type_slot_s *merged = _allocate_type_table();
+    if (merged == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&_registry_lock);
+    uint64_t generation = atomic_load(&_types_generation);
+    _merge_type_table(merged, _retired.types);
+    for (struct thread_counters_s *counters = _registry; counters != NULL; counters = counters->next) {
+        // a table of an older generation has had no traffic attributed since the reset
+        if (atomic_load_explicit(&counters->types_generation, memory_order_acquire) == generation) {
+            _merge_type_table(merged, atomic_load(&counters->types));
+        }
+    }
+    pthread_mutex_unlock(&_registry_lock);
+
+    size_t count = 0;
+    for (size_t i = 0; i <= TYPE_TABLE_SIZE && count < capacity; i++) {
+        struct type_slot_s *slot = &merged[i];
+        swift_runtime_arc_type_counts_t entry = {
+            atomic_load(&slot->metadata), atomic_load(&slot->allocs),
+            atomic_load(&slot->retains), atomic_load(&slot->releases),
+        };
+        if (entry.allocs != 0 || entry.retains != 0 || entry.releases != 0) {
+            types[count++] = entry;
+        }
+    }
+
+    munmap(merged, (TYPE_TABLE_SIZE + 1) * sizeof(struct type_slot_s));
+    return count;
+}
@@ -1,10 +1,38 @@
 #ifndef PACKAGE_BENCHMARK_SWIFT_RUNTIME_HOOKS_H
 #define PACKAGE_BENCHMARK_SWIFT_RUNTIME_HOOKS_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef void (*swift_runtime_hook_t)(const void *, void *);
 
 void swift_runtime_set_alloc_object_hook(swift_runtime_hook_t hook, void * context);
 void swift_runtime_set_retain_hook(swift_runtime_hook_t hook, void * context);
 void swift_runtime_set_release_hook(swift_runtime_hook_t hook, void * context);
 
+// Thread-local counters of object allocations, retains and releases, installed with the hooks above
+typedef struct swift_runtime_arc_counts_s {
+    int64_t allocs;
+    int64_t retains;
+    int64_t releases;
+} swift_runtime_arc_counts_t;
+
+typedef struct swift_runtime_arc_type_counts_s {
+    const void * metadata; // NULL for the counts of types that didn't fit in the tables
+    int64_t allocs;
+    int64_t retains;
+    int64_t releases;
+} swift_runtime_arc_type_counts_t;
+
+void swift_runtime_arc_counters_hook(void);
+void swift_runtime_arc_counters_unhook(void);
+// the sum over all threads, including exited ones
+swift_runtime_arc_counts_t swift_runtime_arc_counters_read(void);
+
+// Keys the counts by the metadata pointer of the objects while enabled
+void swift_runtime_arc_counters_attribute_types(int enabled);
+void swift_runtime_arc_counters_reset_types(void);
+// the counts per type merged over all threads, returns the number of entries written
+size_t swift_runtime_arc_counters_types(swift_runtime_arc_type_counts_t * types, size_t capacity);
+
 #endif
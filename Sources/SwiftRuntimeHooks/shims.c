@@ -105,20 +105,20 @@ void swift_runtime_set_retain_hook(swift_runtime_hook_t hook, void * context) {
 
 static struct hook_data_s _swift_release_hook_data = {NULL, NULL, NULL, NULL, NULL};
 
+// The hook runs before the release, as the final release deinitializes and frees the object,
+// after which the hook must not read it
 static HeapObject * _swift_release_hook(HeapObject * heapObject) {
-    HeapObject * ret = (*_swift_release_hook_data.orig)(heapObject);
     (*_swift_release_hook_data.hook)(heapObject, _swift_release_hook_data.context);
-    return ret;
+    return (*_swift_release_hook_data.orig)(heapObject);
 }
 
 // This doesn't seem to be called for Apple Silicon at least, but keeping it here
 static HeapObject * _swift_release_n_hook(HeapObject * heapObject, uint32_t n) {
     int i;
-    HeapObject * ret = (*_swift_release_hook_data.orig_n)(heapObject, n);
     for (i = 0; i < n; i++) {
         (*_swift_release_hook_data.hook)(heapObject, _swift_release_hook_data.context);
     }
-    return ret;
+    return (*_swift_release_hook_data.orig_n)(heapObject, n);
 }
 
 void swift_runtime_set_release_hook(swift_runtime_hook_t hook, void * context) {
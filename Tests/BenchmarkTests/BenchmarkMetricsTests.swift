@@ -42,6 +42,30 @@ final class BenchmarkMetricsTests: XCTestCase {
         .retainCount,
         .releaseCount,
         .retainReleaseDelta,
+        .cpuCycles,
+        .branchMisses,
+        .cacheMisses,
+        .l1dCacheMisses,
+        .dTLBMisses,
+        .instructionsPerCycle,
+        .cacheMissesPerKiloInstructions,
+        .branchMissesPerKiloInstructions,
+        .futexSyscalls,
+        .epollWaitSyscalls,
+        .scalingEfficiency,
+        .bytesAllocated,
+        .bytesFreed,
+        .mallocThreadCacheFills,
+        .mallocThreadCacheFlushes,
+        .mallocSizeClass,
+        .growthExponent,
+        .minorPageFaults,
+        .majorPageFaults,
+        .proportionalResidentMemory,
+        .anonymousResidentMemory,
+        .runQueueDelay,
+        .offCPUTime,
+        .timeslices,
         .custom("test", polarity: .prefersSmaller, useScalingFactor: false),
         .custom("test2", polarity: .prefersLarger, useScalingFactor: true),
     ]
@@ -75,6 +99,30 @@ final class BenchmarkMetricsTests: XCTestCase {
         "retainCount",
         "releaseCount",
         "retainReleaseDelta",
+        "cpuCycles",
+        "branchMisses",
+        "cacheMisses",
+        "l1dCacheMisses",
+        "dTLBMisses",
+        "instructionsPerCycle",
+        "cacheMissesPerKiloInstructions",
+        "branchMissesPerKiloInstructions",
+        "futexSyscalls",
+        "epollWaitSyscalls",
+        "scalingEfficiency",
+        "bytesAllocated",
+        "bytesFreed",
+        "mallocThreadCacheFills",
+        "mallocThreadCacheFlushes",
+        "mallocSizeClass",
+        "growthExponent",
+        "minorPageFaults",
+        "majorPageFaults",
+        "proportionalResidentMemory",
+        "anonymousResidentMemory",
+        "runQueueDelay",
+        "offCPUTime",
+        "timeslices",
     ]
 
     func testBenchmarkMetrics() throws {
@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import XCTest
+
+@testable import Benchmark
+
+final class BenchmarkReplyCodingTests: XCTestCase {
+    func testHistogramEncodingRoundtrip() throws {
+        let stats = Statistics()
+
+        for measurement in [0, 1, 2, 3, 1_000, 1_001, 123_456, 987_654_321, 5_000_000_000] {
+            stats.add(measurement)
+        }
+        for _ in 0..<1_000 {
+            stats.add(42)
+        }
+
+        var buffer: [UInt8] = []
+        stats.histogram.encode(into: &buffer)
+
+        var offset = 0
+        let decoded = try type(of: stats.histogram).decode(from: buffer, offset: &offset)
+
+        XCTAssertEqual(offset, buffer.count)
+        XCTAssertEqual(decoded.totalCount, stats.histogram.totalCount)
+        XCTAssertEqual(decoded.max, stats.histogram.max)
+        for percentile in [0.0, 25.0, 50.0, 75.0, 90.0, 99.0, 100.0] {
+            XCTAssertEqual(decoded.valueAtPercentile(percentile), stats.histogram.valueAtPercentile(percentile))
+        }
+    }
+
+    func testHistogramEncodingTruncated() throws {
+        let stats = Statistics()
+        stats.add(1_000)
+
+        var buffer: [UInt8] = []
+        stats.histogram.encode(into: &buffer)
+        buffer.removeLast()
+
+        var offset = 0
+        XCTAssertThrowsError(try type(of: stats.histogram).decode(from: buffer, offset: &offset))
+    }
+
+    func testResultReplyRoundtrip() throws {
+        Benchmark.testSkipBenchmarkRegistrations = true
+        let benchmark = try XCTUnwrap(Benchmark("testResultReplyRoundtrip benchmark") { _ in })
+
+        let wallClock = Statistics()
+        let mallocs = Statistics()
+        for measurement in 1...100 {
+            wallClock.add(measurement * 1_000)
+            mallocs.add(measurement % 3)
+        }
+
+        let results = [
+            BenchmarkResult(
+                metric: .wallClock,
+                timeUnits: .microseconds,
+                scalingFactor: .one,
+                warmupIterations: 1,
+                statistics: wallClock
+            ),
+            BenchmarkResult(
+                metric: .mallocCountTotal,
+                timeUnits: .nanoseconds,
+                scalingFactor: .kilo,
+                warmupIterations: 1,
+                statistics: mallocs
+            ),
+        ]
+
+        var frames: [[UInt8]] = []
+        try BenchmarkReplyEncoder().encode(.result(benchmark: benchmark, results: results)) { frames.append($0) }
+        XCTAssertEqual(frames.count, results.count + 2) // begin, one per metric, end
+
+        var decoder = BenchmarkReplyDecoder()
+        var reply: BenchmarkCommandReply?
+        for frame in frames {
+            XCTAssertNil(reply)
+            reply = try decoder.decode(frame)
+        }
+
+        guard case let .result(decodedBenchmark, decodedResults) = reply else {
+            return XCTFail("Expected a result reply, got \(String(describing: reply))")
+        }
+
+        XCTAssertEqual(decodedBenchmark.name, benchmark.name)
+        XCTAssertEqual(decodedResults.count, results.count)
+        for (decoded, original) in zip(decodedResults, results) {
+            XCTAssertEqual(decoded.metric, original.metric)
+            XCTAssertEqual(decoded.timeUnits, original.timeUnits)
+            XCTAssertEqual(decoded.scalingFactor, original.scalingFactor)
+            XCTAssertEqual(decoded.statistics.measurementCount, original.statistics.measurementCount)
+            XCTAssertEqual(decoded.statistics.percentiles(), original.statistics.percentiles())
+        }
+    }
+
+    func testResultStoreRoundtrip() throws {
+        let wallClock = Statistics()
+        for measurement in 1...100 {
+            wallClock.add(measurement * 1_000)
+        }
+
+        let result = BenchmarkResult(
+            metric: .wallClock,
+            timeUnits: .microseconds,
+            scalingFactor: .one,
+            warmupIterations: 1,
+            statistics: wallClock
+        )
+        let custom = BenchmarkResult(
+            metric: .custom("bytes", polarity: .prefersLarger),
+            timeUnits: .automatic,
+            scalingFactor: .one,
+            warmupIterations: 1,
+            statistics: wallClock
+        )
+
+        let encoded = try BenchmarkResultStore.encode(
+            metadata: Array("metadata".utf8),
+            results: [("target", "first", [result, custom]), ("target", "second", [result])]
+        )
+
+        try encoded.withUnsafeBytes { bytes in
+            let reader = try BenchmarkResultStore.Reader(bytes)
+            XCTAssertEqual(reader.metadata, Array("metadata".utf8))
+            XCTAssertEqual(reader.index.map(\.name), ["first", "first", "second"])
+            XCTAssertEqual(reader.index[1].metric, custom.metric)
+
+            let decoded = try reader.result(reader.index[2])
+            XCTAssertEqual(decoded.metric, .wallClock)
+            XCTAssertEqual(decoded.statistics.percentiles(), wallClock.percentiles())
+        }
+
+        var truncated = encoded
+        truncated.removeLast()
+        truncated.withUnsafeBytes { bytes in
+            XCTAssertThrowsError(try BenchmarkResultStore.Reader(bytes))
+        }
+    }
+
+    func testReplyRoundtrip() throws {
+        var frames: [[UInt8]] = []
+        try BenchmarkReplyEncoder().encode(.error("failure")) { frames.append($0) }
+        XCTAssertEqual(frames.count, 1)
+
+        var decoder = BenchmarkReplyDecoder()
+        guard case let .error(description) = try decoder.decode(frames[0]) else {
+            return XCTFail("Expected an error reply")
+        }
+        XCTAssertEqual(description, "failure")
+    }
+
+    // Configurations encoded by older runners don't have the keys added since
+    func testConfigurationDecodingWithoutNewerKeys() throws {
+        let configuration = Benchmark.Configuration(metrics: [.wallClock, .instructions], performanceCounterScope: .thread)
+        let encoded = try JSONEncoder().encode(configuration)
+        var object = try XCTUnwrap(JSONSerialization.jsonObject(with: encoded) as? [String: Any])
+        for key in ["performanceCounterScope", "batching", "threads", "runLength"] {
+            object.removeValue(forKey: key)
+        }
+
+        let data = try JSONSerialization.data(withJSONObject: object)
+        let decoded = try JSONDecoder().decode(Benchmark.Configuration.self, from: data)
+
+        XCTAssertEqual(decoded.metrics, configuration.metrics)
+        XCTAssertEqual(decoded.performanceCounterScope, .process)
+        XCTAssertEqual(decoded.runLength, .fixed)
+        XCTAssertEqual(decoded.threads, 1)
+        XCTAssertEqual(decoded.batching, BenchmarkBatching.none)
+    }
+}
@@ -29,6 +29,165 @@ final class BenchmarkTests: XCTestCase {
         benchmark?.runAsync()
     }
 
+    func testBenchmarkRunAsyncIterations() throws {
+        func asyncFunc() async {}
+        var invocations = 0
+        var measurements = 0
+        let benchmark = Benchmark(
+            "testBenchmarkRunAsyncIterations benchmark",
+            configuration: .init(asyncExecution: .singleTask)
+        ) { _ in
+            await asyncFunc()
+            invocations += 1
+        }
+        XCTAssertNotNil(benchmark)
+        benchmark?.measurementPostSynchronization = { _ in
+            measurements += 1
+        }
+
+        var iterations = 0
+        benchmark?.runAsyncIterations(batchSize: 2) {
+            iterations < 10
+        } after: {
+            iterations += 1
+            return iterations < 5
+        }
+        XCTAssertEqual(iterations, 5)
+        XCTAssertEqual(measurements, 5)
+        XCTAssertEqual(invocations, 10)
+    }
+
+    func testBenchmarkRunBatched() throws {
+        var invocations = 0
+        let benchmark = Benchmark(
+            "testBenchmarkRunBatched benchmark",
+            configuration: .init(batching: .automatic(targetDuration: .microseconds(1)))
+        ) { _ in
+            invocations += 1
+        }
+        XCTAssertNotNil(benchmark)
+        benchmark?.run(batchSize: 10)
+        XCTAssertEqual(invocations, 10)
+    }
+
+    func testBenchmarkRunEmpty() throws {
+        var invocations = 0
+        var measurements = 0
+        let benchmark = Benchmark("testBenchmarkRunEmpty benchmark") { _ in
+            invocations += 1
+        }
+        XCTAssertNotNil(benchmark)
+        benchmark?.measurementPostSynchronization = { _ in
+            measurements += 1
+        }
+        benchmark?.runEmpty()
+        XCTAssertEqual(invocations, 0)
+        XCTAssertEqual(measurements, 1)
+    }
+
+    func testBenchmarkClockMonotonic() throws {
+        var previous = BenchmarkClock.now
+        for _ in 0..<10_000 {
+            let now = BenchmarkClock.now
+            XCTAssertGreaterThanOrEqual(now, previous)
+            previous = now
+        }
+        XCTAssertGreaterThan(BenchmarkClock().minimumResolution, .zero)
+    }
+
+    func testBenchmarkRunThreads() throws {
+        let lock = NSLock()
+        var invocations = 0
+        let benchmarks = Benchmark.scalability("testBenchmarkRunThreads benchmark", threads: [1, 4, 2, 4]) { _ in
+            lock.lock()
+            invocations += 1
+            lock.unlock()
+        }
+        XCTAssertEqual(benchmarks.map(\.configuration.threads), [1, 2, 4])
+        XCTAssertEqual(benchmarks.map(\.name), [
+            "testBenchmarkRunThreads benchmark (threads: 1)",
+            "testBenchmarkRunThreads benchmark (threads: 2)",
+            "testBenchmarkRunThreads benchmark (threads: 4)",
+        ])
+        XCTAssertTrue(benchmarks.allSatisfy { $0.configuration.metrics.contains(.scalingEfficiency) })
+
+        let threadGroup = BenchmarkThreadGroup(threads: 4) { _ in
+            benchmarks[2].closure?(benchmarks[2])
+        }
+        for _ in 0..<10 {
+            benchmarks[2].run(threadGroup: threadGroup)
+        }
+        threadGroup.shutdown()
+        XCTAssertEqual(invocations, 40)
+    }
+
+    // Each thread records the latency of its invocation in the measured iterations, but not in warmup
+    func testBenchmarkRunThreadsExcludesWarmup() throws {
+        let benchmark = try XCTUnwrap(
+            Benchmark(
+                "testBenchmarkRunThreadsExcludesWarmup benchmark",
+                configuration: .init(
+                    metrics: [.wallClock],
+                    warmupIterations: 5,
+                    maxDuration: .seconds(60),
+                    maxIterations: 10,
+                    threads: 2
+                )
+            ) { _ in
+                blackHole(1)
+            }
+        )
+
+        let results = BenchmarkExecutor(quiet: true).run(benchmark)
+        let wallClock = try XCTUnwrap(results.first { $0.metric == .wallClock })
+        XCTAssertEqual(wallClock.statistics.measurementCount, 2 * 10)
+    }
+
+    func testBenchmarkSweep() throws {
+        var sizes: [Int] = []
+        let benchmarks = Benchmark.sweep("testBenchmarkSweep benchmark", sizes: [64, 16, 0, 64], bytesPerElement: 8) { _, size in
+            sizes.append(size)
+        }
+        XCTAssertEqual(benchmarks.map(\.name), [
+            "testBenchmarkSweep benchmark (bytesPerElement: 8, size: 16)",
+            "testBenchmarkSweep benchmark (bytesPerElement: 8, size: 64)",
+        ])
+        XCTAssertTrue(benchmarks.allSatisfy { $0.configuration.metrics.contains(.growthExponent) })
+
+        benchmarks[1].run()
+        XCTAssertTrue(sizes.allSatisfy { $0 == 64 })
+        XCTAssertEqual(Benchmark.powersOfTwo(4...6), [16, 32, 64])
+    }
+
+    func testComplexityFit() throws {
+        let sizes = Benchmark.powersOfTwo(4...16)
+        func points(_ time: (Double) -> Double) -> [BenchmarkComplexityFit.Point] {
+            sizes.map { .init(size: $0, nanoseconds: time(Double($0))) }
+        }
+
+        XCTAssertEqual(BenchmarkComplexityFit.fit(points { _ in 20 })?.model, .constant)
+        XCTAssertEqual(BenchmarkComplexityFit.fit(points { 3 * log2($0) })?.model, .logarithmic)
+        XCTAssertEqual(BenchmarkComplexityFit.fit(points { 2 * $0 + 5 })?.model, .linear)
+        XCTAssertEqual(BenchmarkComplexityFit.fit(points { $0 * log2($0) })?.model, .linearithmic)
+        XCTAssertEqual(BenchmarkComplexityFit.fit(points { $0 * $0 / 10 })?.model, .quadratic)
+        XCTAssertNil(BenchmarkComplexityFit.fit(Array(points { $0 }.prefix(2))))
+
+        let linear = try XCTUnwrap(BenchmarkComplexityFit.fit(points { 2 * $0 }))
+        XCTAssertEqual(linear.coefficient, 2, accuracy: 0.001)
+        XCTAssertTrue(linear.cliffs.isEmpty)
+        XCTAssertEqual(BenchmarkComplexityFit.growthExponents(linear.points).map { ($0 * 100).rounded() }, sizes.map { _ in 100 })
+
+        // Each element costs 3 times as much once the working set exceeds 32 KiB
+        let cacheLevels = [BenchmarkCacheLevel(name: "L1d", bytes: 32_768), BenchmarkCacheLevel(name: "L2", bytes: 1_048_576)]
+        let cliff = try XCTUnwrap(
+            BenchmarkComplexityFit.fit(points { $0 * 8 > 32_768 ? 3 * $0 : $0 }, bytesPerElement: 8, cacheLevels: cacheLevels)
+        )
+        XCTAssertEqual(cliff.cliffs.count, 1)
+        XCTAssertEqual(cliff.cliffs.first?.fromSize, 4_096)
+        XCTAssertEqual(cliff.cliffs.first?.toSize, 8_192)
+        XCTAssertEqual(cliff.cliffs.first?.cacheLevel?.name, "L1d")
+    }
+
     func testBenchmarkRunCustomMetric() throws {
         let benchmark = Benchmark(
             "testBenchmarkRunCustomMetric benchmark",
@@ -62,6 +62,235 @@ final class OperatingSystemAndMallocTests: XCTestCase {
         blackHole(operatingSystemStatsProducer.metricSupported(.throughput))
     }
 
+    func testOperatingSystemStatsProducerPageFaults() throws {
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        operatingSystemStatsProducer.configureMetrics([.minorPageFaults, .majorPageFaults, .anonymousResidentMemory])
+
+        let bytes = 16 * 1_024 * 1_024
+        let startOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+        let memory = try XCTUnwrap(malloc(bytes))
+        memset(memory, 1, bytes) // first touch of each page is a minor fault
+        var stopOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+        operatingSystemStatsProducer.readMemoryRollup(into: &stopOperatingSystemStats)
+
+        XCTAssertGreaterThan(stopOperatingSystemStats.minorPageFaults, startOperatingSystemStats.minorPageFaults)
+        XCTAssertGreaterThanOrEqual(stopOperatingSystemStats.majorPageFaults, startOperatingSystemStats.majorPageFaults)
+        if operatingSystemStatsProducer.metricSupported(.anonymousResidentMemory) {
+            XCTAssertGreaterThanOrEqual(stopOperatingSystemStats.anonymousResidentMemory, bytes)
+        }
+        free(memory)
+    }
+
+    #if os(Linux)
+    private func readProcFile(_ path: String) throws -> String {
+        let file = try XCTUnwrap(fopen(path, "r"))
+        defer { fclose(file) }
+        var buffer = [UInt8](repeating: 0, count: 1_024)
+        let bytes = fread(&buffer, 1, buffer.count, file)
+        return String(decoding: buffer[0..<bytes], as: UTF8.self)
+    }
+
+    private func writeProcFile(_ path: String, _ contents: String) throws {
+        let file = try XCTUnwrap(fopen(path, "w"))
+        defer { fclose(file) }
+        XCTAssertGreaterThanOrEqual(fputs(contents, file), 0)
+    }
+
+    func testProcessStatsParser() throws {
+        // The command name is in parentheses in /proc/self/stat and may contain parentheses and spaces itself
+        let command = try readProcFile("/proc/self/comm").split(separator: "\n").first.map(String.init) ?? ""
+        try writeProcFile("/proc/self/comm", "a) (b) 1 2 3")
+        defer { try? writeProcFile("/proc/self/comm", command) }
+
+        // Read independently of the parser under test, field n of proc(5) is at index n - 3
+        let contents = try readProcFile("/proc/self/stat")
+        XCTAssertTrue(contents.contains("(a) (b) 1 2 3) "))
+        let commandEnd = try XCTUnwrap(contents.lastIndex(of: ")"))
+        let fields = contents[contents.index(after: commandEnd)...].split(separator: " ")
+
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        let startProcessStats = operatingSystemStatsProducer.readProcessStats()
+        XCTAssertEqual(startProcessStats.majorPageFaults, try XCTUnwrap(Int(fields[12 - 3])))
+        XCTAssertEqual(startProcessStats.threads, try XCTUnwrap(Int(fields[20 - 3])))
+
+        XCTAssertEqual(startProcessStats.cpuTotal, startProcessStats.cpuUser + startProcessStats.cpuSystem)
+        XCTAssertGreaterThan(startProcessStats.minorPageFaults, 0)
+        XCTAssertGreaterThan(startProcessStats.peakMemoryResident, 0)
+        XCTAssertGreaterThanOrEqual(startProcessStats.peakMemoryVirtual, startProcessStats.peakMemoryResident)
+
+        // The file is read again through the same fd
+        let clock = ContinuousClock()
+        let deadline = clock.now + .milliseconds(100)
+        var value = 0
+        while clock.now < deadline {
+            value &+= value &* 31 &+ 1
+            blackHole(value)
+        }
+        let stopProcessStats = operatingSystemStatsProducer.readProcessStats()
+        XCTAssertGreaterThan(stopProcessStats.cpuTotal, startProcessStats.cpuTotal)
+        XCTAssertGreaterThanOrEqual(stopProcessStats.cpuUser, startProcessStats.cpuUser)
+        XCTAssertGreaterThanOrEqual(stopProcessStats.minorPageFaults, startProcessStats.minorPageFaults)
+    }
+
+    func testIOStatsParser() throws {
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        let file = try XCTUnwrap(tmpfile())
+        defer { fclose(file) }
+        let fildes = fileno(file)
+
+        var buffer = [UInt8](repeating: 1, count: 4_096)
+        XCTAssertEqual(write(fildes, buffer, buffer.count), buffer.count)
+
+        let startIOStats = operatingSystemStatsProducer.readIOStats()
+        for _ in 0..<10 {
+            XCTAssertEqual(pread(fildes, &buffer, buffer.count, 0), buffer.count)
+        }
+        XCTAssertEqual(write(fildes, buffer, buffer.count), buffer.count)
+        let stopIOStats = operatingSystemStatsProducer.readIOStats()
+
+        // The reads of /proc/self/io itself are counted too
+        XCTAssertGreaterThanOrEqual(stopIOStats.readSyscalls - startIOStats.readSyscalls, 10)
+        XCTAssertGreaterThanOrEqual(stopIOStats.readBytesLogical - startIOStats.readBytesLogical, 10 * 4_096)
+        XCTAssertGreaterThanOrEqual(stopIOStats.writeSyscalls - startIOStats.writeSyscalls, 1)
+        XCTAssertGreaterThanOrEqual(stopIOStats.writeBytesLogical - startIOStats.writeBytesLogical, 4_096)
+    }
+
+    func testOperatingSystemStatsProducerSyscalls() throws {
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        guard operatingSystemStatsProducer.metricSupported(.syscalls) else {
+            throw XCTSkip("the syscall tracepoints weren't requested in BENCHMARK_PERFORMANCE_COUNTERS or can't be opened")
+        }
+        operatingSystemStatsProducer.configureMetrics([.syscalls])
+
+        let startOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+        for _ in 0..<100 {
+            blackHole(getppid()) // not cached by the C library
+        }
+        let stopOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+
+        XCTAssertGreaterThanOrEqual(stopOperatingSystemStats.syscalls - startOperatingSystemStats.syscalls, 100)
+    }
+
+    func testOperatingSystemStatsProducerContextSwitches() throws {
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        XCTAssertTrue(operatingSystemStatsProducer.metricSupported(.contextSwitches))
+        operatingSystemStatsProducer.configureMetrics([.contextSwitches])
+
+        let startOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+        for _ in 0..<100 {
+            usleep(100) // each sleep is a voluntary context switch
+        }
+        let stopOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+
+        XCTAssertGreaterThanOrEqual(
+            stopOperatingSystemStats.contextSwitches - startOperatingSystemStats.contextSwitches,
+            100
+        )
+    }
+
+    func testOperatingSystemStatsProducerThreadsRunning() throws {
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        XCTAssertTrue(operatingSystemStatsProducer.metricSupported(.threadsRunning))
+        operatingSystemStatsProducer.configureMetrics([.threadsRunning])
+        operatingSystemStatsProducer.startSampling()
+
+        // The sampling thread doesn't count itself, but does count this thread while it's spinning
+        let clock = ContinuousClock()
+        let deadline = clock.now + .milliseconds(200)
+        var value = 0
+        while clock.now < deadline {
+            value &+= value &* 31 &+ 1
+            blackHole(value)
+        }
+
+        let operatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+        operatingSystemStatsProducer.stopSampling()
+
+        XCTAssertGreaterThanOrEqual(operatingSystemStats.threadsRunning, 1)
+    }
+    #endif
+
+    func testOperatingSystemStatsProducerSchedulerStats() throws {
+        let operatingSystemStatsProducer = OperatingSystemStatsProducer()
+        guard operatingSystemStatsProducer.metricSupported(.runQueueDelay) else {
+            throw XCTSkip("schedstat isn't available")
+        }
+        operatingSystemStatsProducer.configureMetrics([.runQueueDelay, .offCPUTime, .timeslices])
+
+        let startOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+        for outerloop in 0..<100 {
+            blackHole(outerloop * outerloop)
+            usleep(100) // each sleep ends the timeslice of the thread
+        }
+        let stopOperatingSystemStats = operatingSystemStatsProducer.makeOperatingSystemStats()
+
+        XCTAssertGreaterThan(stopOperatingSystemStats.runTime, startOperatingSystemStats.runTime)
+        XCTAssertGreaterThanOrEqual(stopOperatingSystemStats.runQueueDelay, startOperatingSystemStats.runQueueDelay)
+        XCTAssertGreaterThanOrEqual(stopOperatingSystemStats.timeslices - startOperatingSystemStats.timeslices, 100)
+    }
+
+    func testAllocationProfileParsing() throws {
+        let dump = """
+            heap_v2/1024
+              t*: 3: 3072 [40: 40960]
+              t0: 3: 3072 [40: 40960]
+            @ 0x10 0x20 0x30
+              t*: 1: 1024 [30: 30720]
+              t0: 1: 1024 [30: 30720]
+            @ 0x10 0x40
+              t*: 2: 2048 [10: 10240]
+              t0: 2: 2048 [10: 10240]
+            @ 0x50
+              t*: 1: 64 [0: 0]
+              t0: 1: 64 [0: 0]
+
+            MAPPED_LIBRARIES:
+            00400000-00452000 r-xp 00000000 08:02 173521 /usr/bin/benchmark
+            """
+
+        let heapProfile = try XCTUnwrap(BenchmarkAllocationProfile.parseHeapProfile(dump))
+        XCTAssertEqual(heapProfile.sampleInterval, 1_024)
+        XCTAssertEqual(heapProfile.backtraces.count, 2) // backtraces without accumulated allocations are skipped
+        XCTAssertEqual(heapProfile.backtraces[0].addresses, [0x10, 0x20, 0x30])
+        XCTAssertEqual(heapProfile.backtraces[0].allocations, 30)
+        XCTAssertEqual(heapProfile.backtraces[1].bytes, 10_240)
+
+        // Allocations at the size of the sample interval are sampled with probability 1 - 1/e
+        let counts = BenchmarkAllocationProfile.unsample(allocations: 30, bytes: 30_720, sampleInterval: 1_024)
+        XCTAssertEqual(counts.allocations, 47)
+
+        let profile = BenchmarkAllocationProfile(
+            sampleInterval: 1_024,
+            sites: [
+                .init(stack: ["main", "parse"], allocations: 10, bytes: 100),
+                .init(stack: ["main", "decode;copy"], allocations: 30, bytes: 200),
+            ]
+        )
+        XCTAssertEqual(profile.totalAllocations, 40)
+        XCTAssertEqual(profile.folded(), "main;decode:copy 30\nmain;parse 10\n")
+        XCTAssertEqual(profile.top(1).sites.map(\.allocations), [30])
+    }
+
+    func testCPUProfileFunctions() throws {
+        let profile = BenchmarkCPUProfile(
+            frequency: 999,
+            lostSamples: 0,
+            stacks: [
+                .init(stack: ["main", "parse"], samples: 10),
+                .init(stack: ["main", "parse", "parse", "scan;next"], samples: 30),
+                .init(stack: ["main"], samples: 5),
+            ]
+        )
+        XCTAssertEqual(profile.totalSamples, 45)
+        XCTAssertEqual(profile.folded(), "main;parse;parse;scan:next 30\nmain;parse 10\nmain 5\n")
+        XCTAssertEqual(profile.top(2).stacks.map(\.samples), [30, 10])
+
+        let functions = profile.functions()
+        XCTAssertEqual(functions.map(\.name), ["scan;next", "parse", "main"])
+        XCTAssertEqual(functions.map(\.selfSamples), [30, 10, 5])
+        XCTAssertEqual(functions.map(\.totalSamples), [30, 40, 45]) // recursion is counted once per stack
+    }
+
     #if canImport(jemalloc)
     func testMallocProducerLeaks() throws {
         let startMallocStats = MallocStatsProducer.makeMallocStats()
@@ -78,6 +307,26 @@ final class OperatingSystemAndMallocTests: XCTestCase {
             100 * 1_024
         )
     }
+
+    func testMallocProducerSizeClasses() throws {
+        var startRequests = [Int](repeating: 0, count: MallocStatsProducer.sizeClasses.count)
+        var stopRequests = [Int](repeating: 0, count: MallocStatsProducer.sizeClasses.count)
+        let startMallocStats = MallocStatsProducer.makeMallocStats(sizeClassRequests: &startRequests)
+
+        for _ in 1...100 {
+            free(malloc(3_000))
+        }
+
+        let stopMallocStats = MallocStatsProducer.makeMallocStats(sizeClassRequests: &stopRequests)
+
+        XCTAssertFalse(MallocStatsProducer.sizeClasses.isEmpty)
+        let sizeClass = try XCTUnwrap(MallocStatsProducer.sizeClasses.firstIndex { $0 >= 3_000 })
+        XCTAssertGreaterThanOrEqual(stopRequests[sizeClass] - startRequests[sizeClass], 100)
+        XCTAssertGreaterThanOrEqual(
+            stopMallocStats.bytesAllocated - startMallocStats.bytesAllocated,
+            100 * MallocStatsProducer.sizeClasses[sizeClass]
+        )
+    }
     #endif
 
     func testARCStatsProducer() throws {
@@ -108,6 +357,63 @@ final class OperatingSystemAndMallocTests: XCTestCase {
         XCTAssertGreaterThanOrEqual(releaseDelta, 100)
     }
 
+    func testARCStatsProducerTypeAttribution() throws {
+        final class Node {
+            var value = 0
+        }
+
+        if ARCStatsProducer.usesPreloadedInterposer {
+            throw XCTSkip("ARC type attribution isn't supported with the preloaded runtime interposer")
+        }
+
+        ARCStatsProducer.hook()
+        ARCStatsProducer.resetTypes()
+        ARCStatsProducer.attributeTypes(true)
+
+        for outerloop in 1...100 {
+            let node = Node()
+            node.value = outerloop
+            blackHole(node)
+        }
+
+        ARCStatsProducer.attributeTypes(false)
+        ARCStatsProducer.unhook()
+
+        let profile = ARCStatsProducer.typeProfile()
+        let node = try XCTUnwrap(profile.types.first { $0.type.hasSuffix(".Node") })
+        XCTAssertGreaterThanOrEqual(node.allocations, 100)
+        XCTAssertEqual(profile.typesByAllocations.first?.allocations, profile.types.map(\.allocations).max())
+    }
+
+    // The final release frees the object, so its type must be read before that
+    func testARCStatsProducerTypeAttributionOfFinalRelease() throws {
+        final class Leaf {
+            var value = 0
+        }
+
+        if ARCStatsProducer.usesPreloadedInterposer {
+            throw XCTSkip("ARC type attribution isn't supported with the preloaded runtime interposer")
+        }
+
+        ARCStatsProducer.hook()
+        ARCStatsProducer.resetTypes()
+        ARCStatsProducer.attributeTypes(true)
+
+        for outerloop in 1...100 {
+            var leaf: Leaf? = Leaf()
+            leaf?.value = outerloop
+            blackHole(leaf)
+            leaf = nil // releases the last reference
+        }
+
+        ARCStatsProducer.attributeTypes(false)
+        ARCStatsProducer.unhook()
+
+        let leaf = try XCTUnwrap(ARCStatsProducer.typeProfile().types.first { $0.type.hasSuffix(".Leaf") })
+        XCTAssertGreaterThanOrEqual(leaf.allocations, 100)
+        XCTAssertGreaterThanOrEqual(leaf.releases, leaf.allocations)
+    }
+
     func testIOStatProducer() throws {
         let statsProducer = OperatingSystemStatsProducer()
 
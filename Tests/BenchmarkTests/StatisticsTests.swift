@@ -128,4 +128,139 @@ final class StatisticsTests: XCTestCase {
         XCTAssert(Int(stats.average) > (measurementCount / 3))
         XCTAssertGreaterThan(stats.histogram.totalCount, 100)
     }
+
+    func testAdaptiveRunLength() throws {
+        var runLength = AdaptiveRunLength(percentiles: [.p50, .p90, .p99], relativeWidth: 0.02, maxIterations: 10_000)
+
+        // A warmup trend followed by noise around a steady state
+        for iteration in 0..<50 {
+            XCTAssertFalse(runLength.addWarmupSample(10_000 - iteration * 150))
+        }
+        var iteration = 0
+        while runLength.addWarmupSample(1_000 + (iteration * 37) % 20) == false {
+            iteration += 1
+        }
+        XCTAssertTrue(runLength.steadyStateDetected)
+        XCTAssertLessThan(runLength.warmupIterations, 200)
+
+        var samples = 0
+        while runLength.addSample(1_000 + (samples * 37) % 20) == false, samples < 10_000 {
+            samples += 1
+        }
+        XCTAssertTrue(runLength.converged)
+        XCTAssertLessThan(samples, 2_000)
+        XCTAssertTrue(runLength.relativeWidths.allSatisfy { $0 <= 0.02 })
+        XCTAssertEqual(runLength.precision.percentiles, [.p50, .p90, .p99])
+
+        XCTAssertGreaterThan(AdaptiveRunLength.mannWhitneyZ([1, 2, 3, 4, 5], [6, 7, 8, 9, 10]), 2.0)
+        XCTAssertEqual(AdaptiveRunLength.mannWhitneyZ([1, 2, 3], [1, 2, 3]), 0)
+    }
+
+    func testChangePointDetection() throws {
+        let noise = (0..<30).map { Double($0 % 3) }
+        XCTAssertEqual(ChangePointDetection.eDivisive(noise.map { 100 + $0 }), [])
+
+        let step = (0..<20).map { ($0 < 10 ? 100 : 120) + noise[$0] }
+        XCTAssertEqual(ChangePointDetection.eDivisive(step), [10])
+
+        let steps = (0..<30).map { ($0 < 10 ? 100 : $0 < 20 ? 120 : 90) + noise[$0] }
+        XCTAssertEqual(ChangePointDetection.eDivisive(steps), [10, 20])
+        XCTAssertEqual(ChangePointDetection.eDivisive([1, 2, 3]), []) // too short to split
+    }
+
+    func testIterationTrace() throws {
+        var state: UInt64 = 12_345
+        let noise = (0..<2_000).map { _ -> Int in
+            state = state &* 6_364_136_223_846_793_005 &+ 1_442_695_040_888_963_407
+            return Int(state >> 33) % 100
+        }
+
+        let independent = try XCTUnwrap(BenchmarkTraceSummary(noise.map { 1_000 + $0 }))
+        XCTAssertTrue(independent.independent)
+        XCTAssertNil(independent.period)
+
+        // A stall every 50 iterations
+        let stalls = try XCTUnwrap(BenchmarkTraceSummary(noise.indices.map { 1_000 + noise[$0] + ($0 % 50 == 0 ? 5_000 : 0) }))
+        XCTAssertEqual(stalls.period, 50)
+        XCTAssertFalse(stalls.independent)
+
+        let oscillating = try XCTUnwrap(
+            BenchmarkTraceSummary(noise.indices.map { 1_000 + Int(200 * sin(2 * Double.pi * Double($0) / 20)) + noise[$0] })
+        )
+        XCTAssertEqual(oscillating.period, 20)
+
+        let drifting = try XCTUnwrap(BenchmarkTraceSummary(noise.indices.map { 1_000 + $0 + noise[$0] }))
+        XCTAssertGreaterThan(drifting.lag1Autocorrelation, 0.9)
+        XCTAssertGreaterThan(drifting.drift, 0.5)
+        XCTAssertFalse(drifting.independent)
+
+        XCTAssertNil(BenchmarkTraceSummary(Array(repeating: 1, count: 100))) // nothing varies
+
+        // Ten iterations recorded into a ring of eight, the first two are overwritten
+        let path = FileManager.default.temporaryDirectory.appendingPathComponent("testIterationTrace.trace").path
+        defer {
+            try? FileManager.default.removeItem(atPath: path)
+        }
+        do {
+            let recorder = try XCTUnwrap(IterationTraceRecorder(path: path, metrics: [.wallClock, .mallocCountTotal], capacity: 8))
+            for iteration in 0..<10 {
+                recorder.beginIteration(timestamp: iteration * 100)
+                recorder.record(.wallClock, iteration + 1)
+                if iteration.isMultiple(of: 2) {
+                    recorder.record(.mallocCountTotal, iteration)
+                }
+                recorder.record(.cpuCycles, 1) // not traced
+                recorder.endIteration()
+            }
+        }
+
+        let data = try XCTUnwrap(FileManager.default.contents(atPath: path))
+        let trace = try XCTUnwrap(BenchmarkTrace([UInt8](data)))
+        XCTAssertEqual(trace.columns, [BenchmarkTrace.timestampColumn, "wallClock", "mallocCountTotal"])
+        XCTAssertEqual(trace.iterations, 10)
+        XCTAssertEqual(trace.values[0], (2..<10).map { $0 * 100 })
+        XCTAssertEqual(trace.values[1], (3...10).map { $0 })
+        XCTAssertEqual(trace.values[2], [2, nil, 4, nil, 6, nil, 8, nil])
+        XCTAssertEqual(trace.csv().split(separator: "\n").first, "timestamp,wallClock,mallocCountTotal")
+        XCTAssertEqual(trace.csv().split(separator: "\n").last, "900,10,")
+        XCTAssertNil(BenchmarkTrace(Array(data.prefix(16))))
+    }
+
+    func testMeasurementBuffer() throws {
+        let buffer = MeasurementBuffer([.wallClock, .mallocCountTotal, .custom("custom")], capacity: 4)
+        XCTAssertTrue(buffer.metrics.contains(.wallClock))
+        XCTAssertTrue(buffer.metrics.contains(.mallocCountTotal))
+        XCTAssertFalse(buffer.metrics.contains(.cpuCycles))
+        XCTAssertFalse(BenchmarkMetricMask().contains(.wallClock))
+        XCTAssertTrue(BenchmarkMetricMask().isEmpty)
+
+        var flushed: [BenchmarkMetric: [Int]] = [:]
+        func flush() {
+            buffer.flush { metric, values in
+                flushed[metric, default: []].append(contentsOf: values)
+            }
+        }
+
+        for iteration in 0..<6 {
+            buffer.record(.wallClock, iteration)
+            if iteration.isMultiple(of: 2) {
+                buffer.record(.mallocCountTotal, -iteration)
+            }
+            buffer.record(.cpuCycles, 1) // not requested
+            if buffer.full {
+                flush()
+            }
+        }
+        XCTAssertEqual(flushed[.wallClock], [0, 1, 2, 3])
+        XCTAssertEqual(flushed[.mallocCountTotal], [0, -2])
+
+        flush()
+        XCTAssertFalse(buffer.full)
+        XCTAssertEqual(flushed[.wallClock], [0, 1, 2, 3, 4, 5])
+        XCTAssertEqual(flushed[.mallocCountTotal], [0, -2, -4])
+        XCTAssertNil(flushed[.cpuCycles])
+
+        flush() // nothing left
+        XCTAssertEqual(flushed[.wallClock]?.count, 6)
+    }
 }
@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import XCTest
+
+@testable import BenchmarkTool
+
+final class CPUTopologyTests: XCTestCase {
+    func testParseList() {
+        XCTAssertEqual(CPUTopology.parseList("0-3,8,10-11\n"), [0, 1, 2, 3, 8, 10, 11])
+        XCTAssertEqual(CPUTopology.parseList(" 5 "), [5])
+        XCTAssertEqual(CPUTopology.parseList(""), [])
+        XCTAssertEqual(CPUTopology.parseList("\n"), [])
+        XCTAssertEqual(CPUTopology.parseList("3-1,x,4"), [4]) // malformed ranges are skipped
+    }
+
+    func testFormatList() {
+        XCTAssertEqual(CPUTopology.formatList([0, 1, 2, 3, 8, 10, 11]), "0-3,8,10-11")
+        XCTAssertEqual(CPUTopology.formatList([11, 10, 2]), "2,10-11")
+        XCTAssertEqual(CPUTopology.formatList([7]), "7")
+        XCTAssertEqual(CPUTopology.formatList([]), "")
+    }
+
+    func testParseListRoundTrip() {
+        let cpus = [0, 2, 3, 4, 6, 9, 10]
+        XCTAssertEqual(CPUTopology.parseList(CPUTopology.formatList(cpus)), cpus)
+    }
+
+    func testUnitsKeepSiblingsTogether() {
+        // Two cores with SMT, the siblings of a CPU are 0,4 / 1,5 / ...
+        let siblings: (Int) -> [Int]? = { [$0 % 4, $0 % 4 + 4] }
+        XCTAssertEqual(CPUTopology.units(allowed: Array(0..<8), siblings: siblings), [[0, 4], [1, 5], [2, 6], [3, 7]])
+
+        // Siblings we aren't allowed to run on are left out
+        XCTAssertEqual(CPUTopology.units(allowed: [0, 1, 4], siblings: siblings), [[0, 4], [1]])
+    }
+
+    func testUnitsWithoutTopology() {
+        XCTAssertEqual(CPUTopology.units(allowed: [2, 3, 5]) { _ in nil }, [[2], [3], [5]])
+    }
+
+    func testCPUSets() {
+        let units = [[0, 4], [1, 5], [2, 6], [3, 7]]
+        XCTAssertEqual(CPUTopology.cpuSets(count: 2, units: units), [[0, 1, 4, 5], [2, 3, 6, 7]])
+        XCTAssertEqual(CPUTopology.cpuSets(count: 3, units: units), [[0, 1, 4, 5], [2, 6], [3, 7]])
+        XCTAssertEqual(CPUTopology.cpuSets(count: 1, units: units), [[0, 1, 2, 3, 4, 5, 6, 7]])
+    }
+
+    func testCPUSetsAreLimitedByUnits() {
+        XCTAssertEqual(CPUTopology.cpuSets(count: 8, units: [[0], [1]]), [[0], [1]])
+        XCTAssertEqual(CPUTopology.cpuSets(count: 0, units: [[0], [1]]), [[0, 1]])
+        XCTAssertEqual(CPUTopology.cpuSets(count: 2, units: []), [])
+    }
+
+    func testCPUSetsFromTopologyAreDisjoint() {
+        let cpuSets = CPUTopology.cpuSets(count: 2, partitioning: .cores)
+        let cpus = cpuSets.flatMap { $0 }
+        XCTAssertFalse(cpuSets.isEmpty)
+        XCTAssertEqual(Set(cpus).count, cpus.count)
+        XCTAssertEqual(Set(cpus), Set(CPUTopology.allowedCPUs()))
+    }
+}
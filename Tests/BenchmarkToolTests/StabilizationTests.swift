@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Benchmark
+import BenchmarkShared
+import XCTest
+
+@testable import BenchmarkTool
+
+#if canImport(Darwin)
+import Darwin
+#elseif canImport(Glibc)
+import Glibc
+#elseif canImport(Musl)
+import Musl
+#endif
+
+final class StabilizationTests: XCTestCase {
+    private func tool(_ arguments: [String] = []) throws -> BenchmarkTool {
+        try BenchmarkTool.parse(
+            ["--command", "run", "--format", "text", "--baseline-storage-path", "/tmp", "--grouping", "metric"]
+                + arguments
+        )
+    }
+
+    func testStabilizationCPUPrefersAllowedIsolatedCPU() {
+        XCTAssertEqual(BenchmarkTool.stabilizationCPU(isolated: [2, 3], allowed: [0, 1, 2, 3]), 2)
+        XCTAssertEqual(BenchmarkTool.stabilizationCPU(isolated: [2, 3], allowed: [0, 1, 3]), 3)
+    }
+
+    func testStabilizationCPUFallsBackToLastAllowedCPU() {
+        XCTAssertEqual(BenchmarkTool.stabilizationCPU(isolated: [], allowed: [0, 1, 2, 3]), 3)
+        XCTAssertEqual(BenchmarkTool.stabilizationCPU(isolated: [6, 7], allowed: [0, 1, 2, 3]), 3)
+        XCTAssertEqual(BenchmarkTool.stabilizationCPU(isolated: [], allowed: []), 0)
+    }
+
+    func testStabilizationCPUOption() throws {
+        XCTAssertEqual(try tool(["--stabilize", "--stabilize-cpu", "5"]).stabilizationCPU(), 5)
+    }
+
+    func testChildEnvironment() throws {
+        var tool = try tool(["--stabilize", "--stabilize-realtime"])
+        tool.cpuSet = [2, 3, 5]
+        let benchmark = try XCTUnwrap(
+            Benchmark("testChildEnvironment benchmark", configuration: .init(metrics: [.wallClock])) { _ in }
+        )
+
+        setenv(cpuSetEnvironmentVariable, "0", 1)
+        setenv(stabilizationEnvironmentVariable, "mlockall", 1)
+        defer {
+            unsetenv(cpuSetEnvironmentVariable)
+            unsetenv(stabilizationEnvironmentVariable)
+        }
+
+        let environment = tool.childEnvironment(benchmark: benchmark)
+        XCTAssertEqual(environment.filter { $0.hasPrefix("\(cpuSetEnvironmentVariable)=") }, ["\(cpuSetEnvironmentVariable)=2-3,5"])
+        XCTAssertEqual(
+            environment.filter { $0.hasPrefix("\(stabilizationEnvironmentVariable)=") },
+            ["\(stabilizationEnvironmentVariable)=norandomize,mlockall,prefault,fifo"]
+        )
+        XCTAssertFalse(environment.contains { $0.hasPrefix("\(performanceCountersEnvironmentVariable)=") })
+    }
+
+    // The tool also runs the benchmark executable to list the benchmarks, which isn't stabilized
+    func testChildEnvironmentWithoutBenchmark() throws {
+        let environment = try tool(["--stabilize"]).childEnvironment(benchmark: nil)
+        XCTAssertFalse(environment.contains { $0.hasPrefix("\(stabilizationEnvironmentVariable)=") })
+    }
+}
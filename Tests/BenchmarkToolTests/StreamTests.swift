@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2022 Ordo One AB.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// You may obtain a copy of the License at
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+
+import Benchmark
+import XCTest
+
+@testable import BenchmarkTool
+
+final class StreamTests: XCTestCase {
+    private let machine = BenchmarkMachine(
+        hostname: "host",
+        processors: 8,
+        processorType: "arm64",
+        memory: 16,
+        kernelVersion: "Darwin 23"
+    )
+
+    private func results() -> BenchmarkResults {
+        let statistics = Statistics(units: .count)
+        (1...100).forEach { statistics.add($0) }
+        let result = BenchmarkResult(
+            metric: .wallClock,
+            timeUnits: .nanoseconds,
+            scalingFactor: .one,
+            warmupIterations: 3,
+            tags: ["size": "small world"],
+            statistics: statistics
+        )
+        return [BenchmarkIdentifier(target: "Target", name: "Parse, small"): [result]]
+    }
+
+    func testNDJSONStream() throws {
+        let path = FileManager.default.temporaryDirectory.appendingPathComponent("testNDJSONStream.ndjson").path
+        try? FileManager.default.removeItem(atPath: path)
+        defer {
+            try? FileManager.default.removeItem(atPath: path)
+        }
+
+        do {
+            let writer = try BenchmarkStreamWriter(path: path, format: .ndjson, machine: machine)
+            writer.write(results())
+            writer.write(results()) // appended
+        }
+
+        let contents = try String(contentsOfFile: path, encoding: .utf8)
+        let lines = contents.split(separator: "\n")
+        XCTAssertEqual(lines.count, 2)
+        XCTAssertTrue(contents.hasSuffix("\n"))
+
+        let record = try JSONDecoder().decode(BenchmarkStreamRecord.self, from: Data(lines[0].utf8))
+        XCTAssertEqual(record.hostname, "host")
+        XCTAssertEqual(record.target, "Target")
+        XCTAssertEqual(record.name, "Parse, small")
+        XCTAssertEqual(record.metric, "wallClock")
+        XCTAssertEqual(record.iterations, 100)
+        XCTAssertEqual(record.warmupIterations, 3)
+        XCTAssertEqual(record.tags, ["size": "small world"])
+        XCTAssertEqual(record.percentiles["p0"], 1)
+        XCTAssertEqual(record.percentiles["p100"], 100)
+        XCTAssertEqual(Set(record.percentiles.keys), ["p0", "p25", "p50", "p75", "p90", "p99", "p100"])
+    }
+
+    func testInfluxLine() throws {
+        let path = FileManager.default.temporaryDirectory.appendingPathComponent("testInfluxLine.influx").path
+        defer {
+            try? FileManager.default.removeItem(atPath: path)
+        }
+        let writer = try BenchmarkStreamWriter(path: path, format: .influx, machine: machine)
+        let (identifier, benchmarkResults) = try XCTUnwrap(results().first)
+
+        let line = writer.influxLine(identifier, benchmarkResults[0], timestamp: 1.5)
+
+        // Spaces and commas in tag values are escaped, separating the tags, fields and timestamp is left to unescaped spaces
+        XCTAssertTrue(line.hasPrefix("Target,hostName=host,processorType=arm64,processors=8,memory=16,"), line)
+        XCTAssertTrue(line.contains(",kernelVersion=Darwin\\ 23,test=Parse\\,\\ small,metric=wallClock,size=small\\ world "), line)
+        XCTAssertTrue(line.contains(" p0=1i,p25=25i,"), line)
+        XCTAssertTrue(line.contains(",p100=100i,iterations=100i,warmup_iterations=3i "), line)
+        XCTAssertTrue(line.hasSuffix(" 1500000000"), line)
+    }
+}